@@ -4,6 +4,7 @@
 
 #include "qt-typeset-engine.h"
 
+#include "tex/delimiterbuilder.h"
 #include "tex/mathchars.h"
 
 #include <QFontMetricsF>
@@ -19,7 +20,7 @@ QtFontMetrics::QtFontMetrics()
 QtFontMetricsProdiver::QtFontMetricsProdiver(FontTable & fonts)
   : m_fonts(fonts)
 {
- 
+  setSfcodes(tex::SfcodeTable::nonfrenchspacing());
 }
 
 tex::BoxMetrics QtFontMetricsProdiver::metrics(tex::Character c, tex::Font font)
@@ -62,26 +63,9 @@ float QtFontMetricsProdiver::italicCorrection(const std::shared_ptr<tex::Symbol>
   return 0;
 }
 
-int QtFontMetricsProdiver::sfcode(tex::Character c)
-{
-  if (frenchspacing)
-    return 1000;
-
-  if (c == '.' || c == '?' || c == '!')
-    return 3000;
-  else if (c == ':')
-    return 2000;
-  else if (c == ';')
-    return 1500;
-  else if (c == ',')
-    return 1250;
-
-  return 1000;
-}
-
 const tex::FontDimen& QtFontMetricsProdiver::fontdimen(tex::Font f)
 {
-  return m_fonts[f.id()].fontdimen;
+  return m_fonts.at(f.id()).fontdimen;
 }
 
 const QFontMetricsF & QtFontMetricsProdiver::info(tex::Font f) const
@@ -111,12 +95,14 @@ std::shared_ptr<tex::FontMetricsProvider> TypesetEngine::metrics() const
 TypesetEngine::TypesetEngine(float mag)
   : m_mag(mag)
 {
+  setCustomCharacterBoxes(true);
   reset(mag);
 }
 
 void TypesetEngine::reset(float mag)
 {
   m_mag = mag;
+  invalidateGlyphMetrics();
 
   initFont("textfont0", "Times New Roman", 10, false, tex::tfm::cmr10());
   initFont("scriptfont0", "Times New Roman", 7, false, tex::tfm::cmr7());
@@ -194,6 +180,11 @@ std::shared_ptr<tex::Box> TypesetEngine::typeset(tex::Character c, tex::Font fon
   return std::make_shared<CharBox>(c, font, box, this->font(font));
 }
 
+std::shared_ptr<tex::Box> TypesetEngine::typeset(tex::Character c, tex::Font font, const tex::BoxMetrics& metrics)
+{
+  return std::make_shared<CharBox>(c, font, metrics, this->font(font));
+}
+
 std::shared_ptr<tex::Box> TypesetEngine::typeset(const std::string& text, tex::Font font)
 {
   // @TODO: handle this case
@@ -217,40 +208,15 @@ std::shared_ptr<tex::Box> TypesetEngine::typeset(const std::shared_ptr<tex::Symb
 
 std::shared_ptr<tex::Box> TypesetEngine::typesetRadicalSign(float minTotalHeight)
 {
-  tex::Font font = tex::Font(mRadicalSign->family() * 3);
-  auto metrics = mMetrics->metrics(mRadicalSign, font);
-  auto ret = std::make_shared<CharBox>(mRadicalSign->character(), font, metrics, m_fonts[font.id()].font);
-  const float ratio = minTotalHeight / (metrics.height + metrics.depth);
-
-  if (ratio > 1.f)
-  {
-    metrics.height *= ratio;
-    metrics.depth *= ratio;
-    ret->deform(metrics);
-    ret->rawfont = m_fonts[mRadicalSign->family() * 3].rawfont;
-  }
-
-  return ret;
+  const tex::Font font = tex::Font(mRadicalSign->family() * 3);
+  return stretched(delimiters()->build({ font, mRadicalSign->character() }, minTotalHeight), minTotalHeight);
 }
 
 std::shared_ptr<tex::Box> TypesetEngine::typesetDelimiter(const std::shared_ptr<tex::Symbol> & symbol, float minTotalHeight)
 {
   auto mathsymbol = std::static_pointer_cast<tex::MathSymbol>(symbol);
-
-  tex::Font font = tex::Font(mathsymbol->family() * 3);
-  auto metrics = mMetrics->metrics(mathsymbol, font);
-  auto ret = std::make_shared<CharBox>(mathsymbol->character(), font, metrics, m_fonts[font.id()].font);
-  const float ratio = minTotalHeight / (metrics.height + metrics.depth);
-
-  if (ratio > 1.f)
-  {
-    metrics.height *= ratio;
-    metrics.depth *= ratio;
-    ret->deform(metrics);
-    ret->rawfont = m_fonts[mathsymbol->family() * 3].rawfont;
-  }
-
-  return ret;
+  const tex::Font font = tex::Font(mathsymbol->family() * 3);
+  return stretched(delimiters()->build({ font, mathsymbol->character() }, minTotalHeight), minTotalHeight);
 }
 
 std::shared_ptr<tex::Box> TypesetEngine::typesetLargeOp(const std::shared_ptr<tex::Symbol> & symbol)
@@ -258,6 +224,26 @@ std::shared_ptr<tex::Box> TypesetEngine::typesetLargeOp(const std::shared_ptr<te
   return typeset(symbol, tex::Font::MathRoman);
 }
 
+// Qt fonts have neither successors nor extensible recipes: a delimiter 
+// that is still too short is scaled as a last resort.
+std::shared_ptr<tex::Box> TypesetEngine::stretched(const std::shared_ptr<tex::Box>& box, float minTotalHeight)
+{
+  if (!box->isCharacterBox() || box->totalHeight() <= 0.f || box->totalHeight() >= minTotalHeight)
+    return box;
+
+  auto cbox = std::static_pointer_cast<CharBox>(box);
+  tex::BoxMetrics metrics = cbox->oribox;
+  auto ret = std::make_shared<CharBox>(cbox->character(), cbox->font(), metrics, cbox->qfont);
+  const float ratio = minTotalHeight / (metrics.height + metrics.depth);
+
+  metrics.height *= ratio;
+  metrics.depth *= ratio;
+  ret->deform(metrics);
+  ret->rawfont = m_fonts[cbox->font().id()].rawfont;
+
+  return ret;
+}
+
 QFont & TypesetEngine::font(tex::Font f)
 {
   return m_fonts[f.id()].font;
@@ -37,9 +37,6 @@ using FontTable = std::vector<Font>;
 
 class QtFontMetricsProdiver : public tex::FontMetricsProvider
 {
-public:
-  bool frenchspacing = false;
-
 public:
   QtFontMetricsProdiver(FontTable& fonts);
   ~QtFontMetricsProdiver() = default;
@@ -47,7 +44,6 @@ public:
   tex::BoxMetrics metrics(tex::Character c, tex::Font font) override;
   tex::BoxMetrics metrics(const std::shared_ptr<tex::Symbol> & symbol, tex::Font font) override;
   float italicCorrection(const std::shared_ptr<tex::Symbol> & symbol, tex::Font font) override;
-  int sfcode(tex::Character c) override;
 
   const tex::FontDimen& fontdimen(tex::Font f) override;
 
@@ -85,6 +81,7 @@ public:
   void setFontMetricsProvider()
   {
     mMetrics = std::make_shared<T>(m_fonts);
+    invalidateGlyphMetrics();
   }
 
   tex::Font loadFont(const std::string fontname, const std::string& spec);
@@ -98,6 +95,7 @@ public:
   std::shared_ptr<tex::FontMetricsProvider> metrics() const override;
 
   std::shared_ptr<tex::Box> typeset(tex::Character c, tex::Font font) override;
+  std::shared_ptr<tex::Box> typeset(tex::Character c, tex::Font font, const tex::BoxMetrics& metrics) override;
   std::shared_ptr<tex::Box> typeset(const std::string& text, tex::Font font) override;
   std::shared_ptr<tex::Box> typeset(const std::shared_ptr<tex::Symbol> & symbol, tex::Font font) override;
   std::shared_ptr<tex::Box> typesetRadicalSign(float minTotalHeight) override;
@@ -107,6 +105,7 @@ public:
 protected:
 
   QFont& font(tex::Font f);
+  std::shared_ptr<tex::Box> stretched(const std::shared_ptr<tex::Box>& box, float minTotalHeight);
   int initFont(const QString& displayname, const QString & fontname, int size, bool italic, tex::TFM tfm);
   int initFont(const QString& displayname, const QFont& qfont, tex::TFM tfm);
 
@@ -7,35 +7,11 @@
 #include "qt-typeset-engine.h"
 
 #include <tex/charbox.h>
-#include <tex/layoutreader.h>
 
 #include <QBrush>
 #include <QGlyphRun>
 #include <QPainter>
 
-class LayoutVisitor : tex::LayoutReader
-{
-public:
-  RenderWidget* widget;
-  QPainter* painter;
-
-  LayoutVisitor(RenderWidget*w, QPainter* p)
-    : widget(w), painter(p)
-  {
-
-  }
-
-  void operator()(const std::shared_ptr<tex::Box>& box, tex::Pos pos)
-  {
-    widget->paint(*painter, box, QPointF{ pos.x, pos.y });
-  }
-
-  void operator()(const std::shared_ptr<tex::Rule>& rule, tex::Pos pos)
-  {
-    widget->paint(*painter, rule, QPointF{ pos.x, pos.y });
-  }
-};
-
 RenderWidget::RenderWidget(QWidget* parent)
   : QWidget(parent)
 {
@@ -70,9 +46,20 @@ const QMargins& RenderWidget::margins() const
 void RenderWidget::setBox(std::shared_ptr<tex::Box> box)
 {
   m_box = box;
+  m_index = box != nullptr ? tex::LayoutIndex(box) : tex::LayoutIndex();
   update();
 }
 
+std::shared_ptr<tex::Box> RenderWidget::boxAt(const QPointF& pos) const
+{
+  if (m_box == nullptr)
+    return nullptr;
+
+  const QPointF o = origin();
+  const tex::LayoutIndex::Entry* entry = m_index.hitTest(tex::Pos{ float(pos.x() - o.x()), float(pos.y() - o.y()) });
+  return entry != nullptr ? entry->box : nullptr;
+}
+
 void RenderWidget::paintEvent(QPaintEvent* ev)
 {
   QPainter p{ this };
@@ -84,28 +71,38 @@ void RenderWidget::paintEvent(QPaintEvent* ev)
 
   if (m_box != nullptr)
   {
-    visit(p, m_box);
+    visit(p, ev->rect());
   }
 }
 
-void RenderWidget::visit(QPainter& painter, std::shared_ptr<tex::Box> box)
+QPointF RenderWidget::origin() const
 {
-  LayoutVisitor visitor{ this, &painter };
-
   float x = margins().left();
   float y = margins().top();
 
   if (centered())
   {
     x += (width() - margins().left() - margins().right() - m_box->width()) * 0.5f;
-    y += (height() - margins().top() - margins().bottom() - m_box->totalHeight()) * 0.5f + m_box->height();
+    y += (height() - margins().top() - margins().bottom() - m_box->totalHeight()) * 0.5f;
   }
-  else
+
+  return QPointF{ x, y };
+}
+
+void RenderWidget::visit(QPainter& painter, const QRect& area)
+{
+  const QPointF o = origin();
+  const tex::Rect visible{ float(area.x() - o.x()), float(area.y() - o.y()), float(area.width()), float(area.height()) };
+
+  for (const tex::LayoutIndex::Entry* e : m_index.query(visible))
   {
-    y += m_box->height();
-  }
+    const QPointF pos{ e->pos.x + o.x(), e->pos.y + o.y() };
 
-  tex::read(visitor, m_box, { x, y });
+    if (e->box->is<tex::Rule>())
+      paint(painter, std::static_pointer_cast<tex::Rule>(e->box), pos);
+    else
+      paint(painter, e->box, pos);
+  }
 }
 
 QRectF RenderWidget::getRect(const QPointF& pos, const tex::Box& box)
@@ -9,7 +9,7 @@
 
 #include <QMargins>
 
-#include "tex/box.h"
+#include "tex/layoutindex.h"
 
 namespace tex
 {
@@ -32,13 +32,15 @@ public:
 
   void setBox(std::shared_ptr<tex::Box> box);
 
+  std::shared_ptr<tex::Box> boxAt(const QPointF& pos) const;
+
 protected:
   void paintEvent(QPaintEvent* ev) override;
 
 protected:
-  friend class LayoutVisitor;
+  QPointF origin() const;
 
-  void visit(QPainter& painter, std::shared_ptr<tex::Box> box);
+  void visit(QPainter& painter, const QRect& area);
 
   static QRectF getRect(const QPointF& pos, const tex::Box& box);
 
@@ -49,6 +51,7 @@ private:
   bool m_center = false;
   QMargins m_margins;
   std::shared_ptr<tex::Box> m_box;
+  tex::LayoutIndex m_index;
 };
 
 #endif // LIBTYPESET_APPCOMMON_RENDERWIDGET_H
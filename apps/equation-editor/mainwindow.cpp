@@ -226,10 +226,7 @@ void MainWindow::processText()
 
   tex::parsing::Lexer lexer;
 
-  for (char c : text)
-  {
-    lexer.write(c);
-  }
+  lexer.write(text);
 
   auto tokenization_end = std::chrono::high_resolution_clock::now();
 
@@ -268,7 +265,7 @@ void MainWindow::processText()
     }
     else if (tok.isControlSequence())
     {
-      parser.writeControlSequence(tok.controlSequence());
+      parser.writeControlSequence(tok.controlSequenceId());
     }
   }
 
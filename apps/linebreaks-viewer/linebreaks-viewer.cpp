@@ -6,6 +6,7 @@
 
 #include "linebreaks-viewer-render-widget.h"
 
+#include "tex/glyphmetricscache.h"
 #include "tex/hlist.h"
 #include "tex/lexer.h"
 #include "tex/linebreaks.h"
@@ -420,7 +421,7 @@ void LinebreaksViewerWindow::processText()
     return;
 
   tex::HListBuilder builder{ m_engine };
-  static_cast<QtFontMetricsProdiver*>(m_engine->metrics().get())->frenchspacing = m_frenchspacing_input->isChecked();
+  m_engine->glyphMetrics()->setSfcodes(m_frenchspacing_input->isChecked() ? tex::SfcodeTable::frenchspacing() : tex::SfcodeTable::nonfrenchspacing());
 
   m_list.clear();
 
@@ -438,6 +439,7 @@ void LinebreaksViewerWindow::processText()
     }
   }
 
+  builder.flush();
   m_list = std::move(builder.result);
 
   tex::Paragraph paragraph;
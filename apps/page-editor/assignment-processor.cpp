@@ -18,9 +18,9 @@ AssignmentProcessor::~AssignmentProcessor()
 
 }
 
-const std::map<std::string, AssignmentProcessor::CS>& AssignmentProcessor::csmap()
+const tex::parsing::CsMap<AssignmentProcessor::CS>& AssignmentProcessor::csmap()
 {
-  static const std::map<std::string, AssignmentProcessor::CS> map = {
+  static const tex::parsing::CsMap<AssignmentProcessor::CS> map = {
     {"parshape", CS::PARSHAPE},
     {"font", CS::font},
   };
@@ -28,14 +28,14 @@ const std::map<std::string, AssignmentProcessor::CS>& AssignmentProcessor::csmap
   return map;
 }
 
-AssignmentProcessor::CS AssignmentProcessor::controlSequence(const std::string& name)
+AssignmentProcessor::CS AssignmentProcessor::controlSequence(tex::parsing::CsId cs)
 {
-  auto it = csmap().find(name);
+  const CS* result = csmap().find(cs);
 
-  if (it == csmap().end())
+  if (result == nullptr)
     throw std::runtime_error{ "Unknown control sequence" };
 
-  return it->second;
+  return *result;
 }
 
 void AssignmentProcessor::write(tex::parsing::Token& t)
@@ -54,14 +54,14 @@ void AssignmentProcessor::write(tex::parsing::Token& t)
   }
 }
 
-bool AssignmentProcessor::handleCs(const std::string& csname)
+bool AssignmentProcessor::handleCs(tex::parsing::CsId csname)
 {
-  auto it = csmap().find(csname);
+  const CS* it = csmap().find(csname);
 
-  if (it == csmap().end())
+  if (it == nullptr)
     return false;
 
-  CS cs = it->second;
+  CS cs = *it;
 
   switch (cs)
   {
@@ -86,7 +86,7 @@ bool AssignmentProcessor::handleCs(const std::string& csname)
   return true;
 }
 
-bool AssignmentProcessor::changeFont(const std::string& csname)
+bool AssignmentProcessor::changeFont(tex::parsing::CsId csname)
 {
   auto it = m_font_map.find(csname);
 
@@ -102,10 +102,10 @@ void AssignmentProcessor::write_main(tex::parsing::Token& t)
 {
   if (t.isControlSequence())
   {
-    if (handleCs(t.controlSequence()))
+    if (handleCs(t.controlSequenceId()))
       return;
 
-    if (changeFont(t.controlSequence()))
+    if (changeFont(t.controlSequenceId()))
       return;
 
     m_output.push_back(std::move(t));
@@ -149,7 +149,7 @@ void AssignmentProcessor::write_font(tex::parsing::Token& t)
   if (m_font->isFinished())
   {
     tex::Font f = m_machine.typesetEngine()->loadFont(m_font->fontname(), m_font->fontspec());
-    m_font_map[m_font->fontname()] = f;
+    m_font_map[tex::parsing::CsTable::global().intern(m_font->fontname())] = f;
     m_state = State::Main;
   }
 }
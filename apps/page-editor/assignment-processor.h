@@ -9,8 +9,8 @@
 #include "tex/token.h"
 #include "tex/parsing/parshapeparser.h"
 
-#include <map>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 class FontParser;
@@ -38,16 +38,16 @@ public:
     font,
   };
 
-  static const std::map<std::string, CS>& csmap();
-  static CS controlSequence(const std::string& name);
+  static const tex::parsing::CsMap<CS>& csmap();
+  static CS controlSequence(tex::parsing::CsId cs);
 
   void write(tex::parsing::Token& t);
 
   std::vector<tex::parsing::Token>& output();
 
 protected:
-  bool handleCs(const std::string& csname);
-  bool changeFont(const std::string& csname);
+  bool handleCs(tex::parsing::CsId csname);
+  bool changeFont(tex::parsing::CsId csname);
 
   void write_main(tex::parsing::Token&);
   void write_parshape(tex::parsing::Token&);
@@ -56,7 +56,7 @@ protected:
 private:
   State m_state = State::Main;
   TypesettingMachine& m_machine;
-  std::map<std::string, tex::Font> m_font_map;
+  std::unordered_map<tex::parsing::CsId, tex::Font> m_font_map;
   std::vector<tex::parsing::Token> m_output;
   std::unique_ptr<tex::parsing::ParshapeParser> m_parshape;
   std::unique_ptr<FontParser> m_font;
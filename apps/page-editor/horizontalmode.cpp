@@ -41,7 +41,7 @@ void HorizontalMode::write_main(tex::parsing::Token& t)
 {
   if (t.isControlSequence())
   {
-    CS cs = controlSequence(t.controlSequence());
+    CS cs = controlSequence(t.controlSequenceId());
 
     switch (cs)
     {
@@ -208,9 +208,9 @@ Mode::Kind HorizontalMode::kind() const
   return Mode::Kind::Horizontal;
 }
 
-const std::map<std::string, HorizontalMode::CS>& HorizontalMode::csmap()
+const tex::parsing::CsMap<HorizontalMode::CS>& HorizontalMode::csmap()
 {
-  static const std::map<std::string, HorizontalMode::CS> map = {
+  static const tex::parsing::CsMap<HorizontalMode::CS> map = {
     {"par", CS::PAR},
     {"kern", CS::KERN},
     {"hbox", CS::HBOX},
@@ -220,14 +220,14 @@ const std::map<std::string, HorizontalMode::CS>& HorizontalMode::csmap()
   return map;
 }
 
-HorizontalMode::CS HorizontalMode::controlSequence(const std::string& name)
+HorizontalMode::CS HorizontalMode::controlSequence(tex::parsing::CsId cs)
 {
-  auto it = csmap().find(name);
+  const CS* result = csmap().find(cs);
 
-  if (it == csmap().end())
+  if (result == nullptr)
     throw std::runtime_error{ "Unknown control sequence" };
 
-  return it->second;
+  return *result;
 }
 
 void HorizontalMode::write(tex::parsing::Token& t)
@@ -283,6 +283,7 @@ void HorizontalMode::writeOutput()
 
 void HorizontalMode::writeToHorizontalMode(HorizontalMode& output, HorizontalMode& self)
 {
+  self.hlist().flush();
   auto b = tex::hbox(std::move(self.hlist().result));
   output.write(b);
 }
@@ -296,6 +297,7 @@ void HorizontalMode::writeToVerticalMode(tex::VListBuilder& output, HorizontalMo
   p.lineskiplimit = self.machine().memory().lineskiplimit;
   p.hsize = self.machine().memory().hsize;
   p.parshape = self.machine().memory().parshape;
+  self.hlist().flush();
   p.prepare(self.hlist().result);
   tex::List l = p.create(self.hlist().result);
 
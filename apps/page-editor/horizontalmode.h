@@ -45,8 +45,8 @@ public:
     LOWER,
   };
 
-  static const std::map<std::string, CS>& csmap();
-  static CS controlSequence(const std::string& name);
+  static const tex::parsing::CsMap<CS>& csmap();
+  static CS controlSequence(tex::parsing::CsId cs);
 
   Kind kind() const override;
   void write(tex::parsing::Token& t) override;
@@ -109,7 +109,7 @@ void MainWindow::processText()
 
   TypesettingMachine machine{ m_engine, tex::Font(0) };
   machine.memory().hsize = m_pagewidget->hsize();
-  auto box = machine.typeset(text);
+  auto box = machine.typeset(std::move(text));
 
   auto end = std::chrono::high_resolution_clock::now();
 
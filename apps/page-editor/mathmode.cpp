@@ -44,23 +44,23 @@ Mode::Kind MathMode::kind() const
 }
 
 
-const std::map<std::string, MathMode::CS>& MathMode::csmap()
+const tex::parsing::CsMap<MathMode::CS>& MathMode::csmap()
 {
-  static const std::map<std::string, MathMode::CS> map = {
+  static const tex::parsing::CsMap<MathMode::CS> map = {
 
   };
 
   return map;
 }
 
-MathMode::CS MathMode::controlSequence(const std::string& name)
+MathMode::CS MathMode::controlSequence(tex::parsing::CsId cs)
 {
-  auto it = csmap().find(name);
+  const CS* result = csmap().find(cs);
 
-  if (it == csmap().end())
+  if (result == nullptr)
     throw std::runtime_error{ "Unknown control sequence" };
 
-  return it->second;
+  return *result;
 }
 
 void MathMode::write(tex::parsing::Token& t)
@@ -101,6 +101,7 @@ void MathMode::writeToHorizontalMode(HorizontalMode& output, MathMode& self)
 
   tex::List hlist = mt.mlist2hlist(self.mlist(), tex::math::Style::T);
 
+  output.hlist().flush();
   output.hlist().result.insert(output.hlist().result.end(), hlist.begin(), hlist.end());
   output.hlist().spacefactor = 1000;
 }
@@ -125,11 +126,11 @@ void MathMode::write_main(tex::parsing::Token& t)
 {
   if (t.isControlSequence())
   {
-    auto it = csmap().find(t.controlSequence());
+    const CS* it = csmap().find(t.controlSequenceId());
 
-    if (it != csmap().end())
+    if (it != nullptr)
     {
-      CS cs = it->second;
+      CS cs = *it;
 
       switch (cs)
       {
@@ -140,7 +141,7 @@ void MathMode::write_main(tex::parsing::Token& t)
     }
     else
     {
-      m_parser.writeControlSequence(t.controlSequence());
+      m_parser.writeControlSequence(t.controlSequenceId());
     }
   }
   else
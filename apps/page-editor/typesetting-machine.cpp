@@ -45,7 +45,6 @@ TypesettingException::TypesettingException(size_t l, size_t c, const char* mssg)
 
 TypesettingMachine::TypesettingMachine(std::shared_ptr<TypesetEngine> te, tex::Font f)
   : m_memory{},
-  m_inputstream{},
   m_preprocessor{},
   m_assignment_processor{*this},
   m_typeset_engine(te)
@@ -70,11 +69,24 @@ TypesettingMachine::TypesettingMachine(std::shared_ptr<TypesetEngine> te, tex::F
 
 std::shared_ptr<tex::VBox> TypesettingMachine::typeset(std::string text)
 {
-  m_inputstream = InputStream(std::move(text));
+  return typeset(std::unique_ptr<tex::parsing::InputSource>(new tex::parsing::StringInputSource(std::move(text))));
+}
+
+std::shared_ptr<tex::VBox> TypesettingMachine::typeset(std::unique_ptr<tex::parsing::InputSource> input)
+{
+  m_input_line = 0;
+  m_input_column = 0;
+
+  if (m_pipelined)
+    m_lexer_thread.reset(new tex::parsing::LexerThread(std::move(input), m_lexer.catcodes()));
+  else
+    m_input = std::move(input);
 
   m_state = State::ReadChar;
   resume();
 
+  m_lexer_thread.reset();
+
   VerticalMode& vm = dynamic_cast<VerticalMode&>(currentMode());
   tex::List vlist = vm.vlist().result;
   return tex::vbox(std::move(vlist));
@@ -90,6 +102,35 @@ tex::UnitSystem TypesettingMachine::unitSystem() const
   return us;
 }
 
+/*!
+ * \fn void setPipelined(bool on)
+ * \brief sets whether the input is lexed ahead on a separate thread
+ *
+ * Takes effect on the next call to typeset().
+ */
+void TypesettingMachine::setPipelined(bool on)
+{
+  m_pipelined = on;
+}
+
+/*!
+ * \fn void setCatcodes(const tex::parsing::Lexer::CatCodeTable& catcodes)
+ * \brief changes the catcodes of the characters that have not been read yet
+ *
+ * In pipelined mode, the tokens lexed ahead by the lexer thread are 
+ * discarded and the input is lexed again from the first character that 
+ * follows the last token read.
+ */
+void TypesettingMachine::setCatcodes(const tex::parsing::Lexer::CatCodeTable& catcodes)
+{
+  memory().catcodes = catcodes;
+
+  if (m_lexer_thread != nullptr)
+    m_lexer_thread->setCatcodes(catcodes);
+  else
+    m_lexer.catcodes() = catcodes;
+}
+
 void TypesettingMachine::beginGroup()
 {
   m_preprocessor.beginGroup();
@@ -154,6 +195,34 @@ void TypesettingMachine::resume()
   }
 }
 
+bool TypesettingMachine::readLine()
+{
+  if (input().atEnd())
+    return false;
+
+  // errors are reported at the beginning of the last line read
+  m_input_line = input().line();
+  m_input_column = input().column();
+
+  const char* line = nullptr;
+  const size_t n = input().read(line);
+  m_lexer.write(line, n);
+  return true;
+}
+
+bool TypesettingMachine::readLexedToken()
+{
+  tex::parsing::LexerThread::Item item;
+
+  if (!m_lexer_thread->read(item))
+    return false;
+
+  m_input_line = item.line;
+  m_input_column = item.column;
+  m_lexer.output().push_back(item.token);
+  return true;
+}
+
 void TypesettingMachine::advance()
 {
   try
@@ -162,7 +231,7 @@ void TypesettingMachine::advance()
     {
     case State::ReadChar:
     {
-      if (inputStream().atEnd())
+      if (m_lexer_thread != nullptr ? !readLexedToken() : !readLine())
       {
         while (m_modes.size() > 1)
         {
@@ -176,7 +245,6 @@ void TypesettingMachine::advance()
       }
       else
       {
-        m_lexer.write(inputStream().read());
         m_state = m_lexer.output().empty() ? State::ReadChar : State::ReadToken;
       }
     }
@@ -228,7 +296,6 @@ void TypesettingMachine::advance()
   }
   catch (std::runtime_error& ex)
   {
-    auto pos = m_inputstream.position();
-    throw TypesettingException{ pos.first, pos.second, ex.what() };
+    throw TypesettingException{ m_input_line, m_input_column, ex.what() };
   }
 }
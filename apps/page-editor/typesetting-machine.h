@@ -6,13 +6,14 @@
 #define TYPESET_PAGEEDITOR_TYPESETTINGMACHINE_H
 
 #include "assignment-processor.h"
-#include "inputstream.h"
 #include "mode.h"
 
 #include "common/qt-typeset-engine.h"
 
 #include "tex/parsing/preprocessor.h"
+#include "tex/inputsource.h"
 #include "tex/lexer.h"
+#include "tex/lexerthread.h"
 
 #include "tex/parshape.h"
 #include "tex/typeset.h"
@@ -64,6 +65,10 @@ public:
   State state() const;
 
   std::shared_ptr<tex::VBox> typeset(std::string text);
+  std::shared_ptr<tex::VBox> typeset(std::unique_ptr<tex::parsing::InputSource> input);
+
+  bool pipelined() const;
+  void setPipelined(bool on = true);
 
   const std::shared_ptr<TypesetEngine>& typesetEngine() const;
 
@@ -71,12 +76,14 @@ public:
   Memory& memory();
   const Memory& memory() const;
 
-  InputStream& inputStream();
+  tex::parsing::InputSource& input();
   tex::parsing::Lexer& lexer();
   tex::parsing::Preprocessor& preprocessor();
 
   tex::UnitSystem unitSystem() const;
 
+  void setCatcodes(const tex::parsing::Lexer::CatCodeTable& catcodes);
+
   void resume();
 
   void beginGroup();
@@ -97,13 +104,19 @@ public:
 
 protected:
   void advance();
+  bool readLine();
+  bool readLexedToken();
   void sendToken();
   bool digestToken();
 
 private:
   std::vector<Memory> m_memory;
-  InputStream m_inputstream;
+  std::unique_ptr<tex::parsing::InputSource> m_input;
+  size_t m_input_line = 0;
+  size_t m_input_column = 0;
   tex::parsing::Lexer m_lexer;
+  bool m_pipelined = false;
+  std::unique_ptr<tex::parsing::LexerThread> m_lexer_thread;
   tex::parsing::Preprocessor m_preprocessor;
   AssignmentProcessor m_assignment_processor;
   std::vector<tex::parsing::Token> m_tokens;
@@ -118,6 +131,11 @@ inline TypesettingMachine::State TypesettingMachine::state() const
   return m_state;
 }
 
+inline bool TypesettingMachine::pipelined() const
+{
+  return m_pipelined;
+}
+
 inline const std::shared_ptr<TypesetEngine>& TypesettingMachine::typesetEngine() const
 {
   return m_typeset_engine;
@@ -133,9 +151,9 @@ inline const TypesettingMachine::Memory& TypesettingMachine::memory() const
   return m_memory.back();
 }
 
-inline InputStream& TypesettingMachine::inputStream()
+inline tex::parsing::InputSource& TypesettingMachine::input()
 {
-  return m_inputstream;
+  return *m_input;
 }
 
 inline tex::parsing::Lexer& TypesettingMachine::lexer()
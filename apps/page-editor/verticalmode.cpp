@@ -20,9 +20,9 @@ Mode::Kind VerticalMode::kind() const
   return Mode::Kind::Vertical;
 }
 
-const std::map<std::string, VerticalMode::CS>& VerticalMode::csmap()
+const tex::parsing::CsMap<VerticalMode::CS>& VerticalMode::csmap()
 {
-  static const std::map<std::string, VerticalMode::CS> map = {
+  static const tex::parsing::CsMap<VerticalMode::CS> map = {
     {"par", CS::PAR},
     {"kern", CS::KERN}
   };
@@ -30,14 +30,14 @@ const std::map<std::string, VerticalMode::CS>& VerticalMode::csmap()
   return map;
 }
 
-VerticalMode::CS VerticalMode::controlSequence(const std::string& name)
+VerticalMode::CS VerticalMode::controlSequence(tex::parsing::CsId cs)
 {
-  auto it = csmap().find(name);
+  const CS* result = csmap().find(cs);
 
-  if (it == csmap().end())
+  if (result == nullptr)
     throw std::runtime_error{ "Unknown control sequence" };
 
-  return it->second;
+  return *result;
 }
 
 void VerticalMode::write(tex::parsing::Token& t)
@@ -69,7 +69,7 @@ void VerticalMode::write_main(tex::parsing::Token& t)
 {
   if (t.isControlSequence())
   {
-    CS cs = controlSequence(t.controlSequence());
+    CS cs = controlSequence(t.controlSequenceId());
     
     switch (cs)
     {
@@ -38,8 +38,8 @@ public:
     KERN,
   };
 
-  static const std::map<std::string, CS>& csmap();
-  static CS controlSequence(const std::string& name);
+  static const tex::parsing::CsMap<CS>& csmap();
+  static CS controlSequence(tex::parsing::CsId cs);
 
   void write(tex::parsing::Token& t) override;
   void finish() override;
@@ -0,0 +1,108 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_HEADLESS_FONT_REGISTRY_H
+#define LIBTYPESET_HEADLESS_FONT_REGISTRY_H
+
+#include "tex/font.h"
+#include "tex/fontdimen.h"
+#include "tex/tfmfile.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace tex
+{
+
+namespace headless
+{
+
+struct TfmFont
+{
+  std::string name;
+  std::shared_ptr<const TfmFile> file;
+  float size;
+  FontDimen fontdimen;
+};
+
+/*!
+ * \class FontRegistry
+ * \brief a table of fonts that can be shared by several engines and threads
+ *
+ * A font is published once and then never modified: its id stays valid 
+ * for the lifetime of the registry and reading it requires no lock.
+ * Adding the same file at the same size under the same name returns the 
+ * font that was already published.
+ *
+ * Reloading a file publishes new TfmFont objects for the fonts that use it,
+ * under the same ids; the previous objects are retired but kept alive so 
+ * that references obtained from font() remain valid.
+ * Each reload therefore retains one TfmFont (and the previous TfmFile) per 
+ * reloaded font until reclaim() is called, at a point where no thread 
+ * still uses a reference obtained before the reload (e.g. between two 
+ * jobs of a worker, after the engines have dropped their cached metrics).
+ */
+class FontRegistry
+{
+public:
+  FontRegistry();
+  FontRegistry(const FontRegistry&) = delete;
+  ~FontRegistry();
+
+  static const std::shared_ptr<FontRegistry>& global();
+
+  static const size_t SegmentSize = 256;
+  static const size_t MaxSegments = 1024;
+
+  std::shared_ptr<const TfmFile> loadFile(const std::string& path);
+  Font add(const std::string& name, std::shared_ptr<const TfmFile> file, float size);
+  std::vector<Font> reload(const std::string& path);
+
+  size_t size() const { return m_size.load(std::memory_order_acquire); }
+  const TfmFont& font(Font f) const;
+
+  size_t retiredCount() const;
+  void reclaim();
+
+  FontRegistry& operator=(const FontRegistry&) = delete;
+
+protected:
+  void publish(size_t id, const TfmFont* font);
+
+private:
+  struct Segment
+  {
+    std::atomic<const TfmFont*> fonts[SegmentSize];
+  };
+
+  std::atomic<Segment*> m_segments[MaxSegments];
+  std::atomic<size_t> m_size;
+  mutable std::mutex m_mutex;
+  std::vector<std::unique_ptr<TfmFont>> m_storage;
+  std::vector<std::unique_ptr<TfmFont>> m_retired;
+  std::map<std::tuple<std::string, const TfmFile*, float>, Font> m_index;
+  std::map<std::string, std::shared_ptr<const TfmFile>> m_files;
+};
+
+inline const TfmFont& FontRegistry::font(Font f) const
+{
+  if (f.id() < 0 || static_cast<size_t>(f.id()) >= size())
+    throw std::out_of_range{ "FontRegistry::font()" };
+
+  const size_t id = static_cast<size_t>(f.id());
+  const Segment* segment = m_segments[id / SegmentSize].load(std::memory_order_acquire);
+  return *segment->fonts[id % SegmentSize].load(std::memory_order_acquire);
+}
+
+} // namespace headless
+
+} // namespace tex
+
+#endif // LIBTYPESET_HEADLESS_FONT_REGISTRY_H
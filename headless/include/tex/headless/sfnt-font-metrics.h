@@ -0,0 +1,64 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_HEADLESS_SFNT_FONT_METRICS_H
+#define LIBTYPESET_HEADLESS_SFNT_FONT_METRICS_H
+
+#include "tex/fontmetrics.h"
+#include "tex/sfntfile.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace tex
+{
+
+namespace headless
+{
+
+struct SfntFont
+{
+  std::string name;
+  std::shared_ptr<const SfntFile> file;
+  float size;
+  FontDimen fontdimen;
+};
+
+/*!
+ * \class SfntFontMetricsProvider
+ * \brief a font metrics provider that reads its metrics from OpenType and TrueType fonts
+ *
+ * Kerning pairs are reported through ligKern(); these fonts have no 
+ * ligature program that the HListBuilder could run.
+ */
+class SfntFontMetricsProvider : public tex::FontMetricsProvider
+{
+public:
+  SfntFontMetricsProvider() = default;
+  ~SfntFontMetricsProvider() = default;
+
+  Font loadFont(const std::string& path, float size);
+  Font addFont(const std::string& name, std::shared_ptr<const SfntFile> file, float size);
+
+  size_t fontCount() const { return m_fonts.size(); }
+  const SfntFont& font(Font f) const;
+
+  BoxMetrics metrics(Character c, Font font) override;
+  BoxMetrics metrics(const std::shared_ptr<Symbol>& symbol, Font font) override;
+  float italicCorrection(const std::shared_ptr<Symbol>& symbol, Font font) override;
+  LigKern ligKern(Font font, Character left, Character right) override;
+  bool hasChar(Font font, Character c) override;
+
+  const FontDimen& fontdimen(Font font) override;
+
+private:
+  std::vector<SfntFont> m_fonts;
+};
+
+} // namespace headless
+
+} // namespace tex
+
+#endif // LIBTYPESET_HEADLESS_SFNT_FONT_METRICS_H
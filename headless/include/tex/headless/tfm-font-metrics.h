@@ -0,0 +1,56 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_HEADLESS_TFM_FONT_METRICS_H
+#define LIBTYPESET_HEADLESS_TFM_FONT_METRICS_H
+
+#include "tex/fontmetrics.h"
+#include "tex/headless/font-registry.h"
+
+namespace tex
+{
+
+namespace headless
+{
+
+/*!
+ * \class TfmFontMetricsProvider
+ * \brief a font metrics provider that reads all its metrics from TFM files
+ *
+ * Fonts are stored in a FontRegistry, by default the process-wide one, 
+ * so that providers do not own a copy of the fonts they use; the same 
+ * TFM file can be used at several sizes.
+ */
+class TfmFontMetricsProvider : public tex::FontMetricsProvider
+{
+public:
+  TfmFontMetricsProvider();
+  explicit TfmFontMetricsProvider(std::shared_ptr<FontRegistry> registry);
+  ~TfmFontMetricsProvider() = default;
+
+  const std::shared_ptr<FontRegistry>& registry() const { return m_registry; }
+
+  Font addFont(const std::string& name, std::shared_ptr<const TfmFile> file, float size);
+
+  const TfmFont& font(Font f) const { return m_registry->font(f); }
+
+  BoxMetrics metrics(Character c, Font font) override;
+  BoxMetrics metrics(const std::shared_ptr<Symbol>& symbol, Font font) override;
+  float italicCorrection(const std::shared_ptr<Symbol>& symbol, Font font) override;
+  LigKern ligKern(Font font, Character left, Character right) override;
+  bool hasChar(Font font, Character c) override;
+  Character successor(Font font, Character c) override;
+  bool extensible(Font font, Character c, ExtensibleRecipe& recipe) override;
+
+  const FontDimen& fontdimen(Font font) override;
+
+private:
+  std::shared_ptr<FontRegistry> m_registry;
+};
+
+} // namespace headless
+
+} // namespace tex
+
+#endif // LIBTYPESET_HEADLESS_TFM_FONT_METRICS_H
@@ -0,0 +1,91 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_HEADLESS_TYPESET_ENGINE_H
+#define LIBTYPESET_HEADLESS_TYPESET_ENGINE_H
+
+#include "tex/headless/sfnt-font-metrics.h"
+#include "tex/headless/tfm-font-metrics.h"
+
+#include "tex/typeset.h"
+#include "tex/math/math-typeset.h"
+
+#include <array>
+#include <map>
+
+namespace tex
+{
+
+namespace headless
+{
+
+/*!
+ * \class TypesetEngine
+ * \brief a typeset engine that does not depend on any GUI toolkit
+ *
+ * Metrics come from any FontMetricsProvider, by default one that reads 
+ * TFM files; characters are typeset as plain CharacterBox.
+ * Fonts can be loaded through the engine when its provider reads TFM 
+ * files or OpenType and TrueType fonts.
+ * Delimiters and radical signs are built by the DelimiterBuilder of the 
+ * engine from their small and large variants.
+ * The default variants are those of plain TeX (\c{\delcode} and \c{\radical}).
+ */
+class TypesetEngine : public tex::TypesetEngine
+{
+public:
+  TypesetEngine();
+  explicit TypesetEngine(std::shared_ptr<FontMetricsProvider> metrics);
+  ~TypesetEngine() = default;
+
+  struct Variant
+  {
+    int family;
+    Character character;
+  };
+
+  Font loadFont(const std::string& path, float size);
+  Font addFont(const std::string& name, std::shared_ptr<const TfmFile> file, float size);
+  Font addFont(const std::string& name, std::shared_ptr<const SfntFile> file, float size);
+  void reloadFont(const std::string& path);
+
+  void setMathFont(int fam, Font textfont, Font scriptfont, Font scriptscriptfont);
+  const std::array<MathFont, 16>& mathfonts() const;
+
+  void setLargeVariant(Variant small, Variant large);
+  void setRadical(Variant small, Variant large);
+
+  std::shared_ptr<FontMetricsProvider> metrics() const override;
+  const std::shared_ptr<TfmFontMetricsProvider>& tfmMetrics() const { return m_tfm_metrics; }
+  const std::shared_ptr<SfntFontMetricsProvider>& sfntMetrics() const { return m_sfnt_metrics; }
+
+  std::shared_ptr<Box> typeset(Character c, Font font) override;
+  std::shared_ptr<Box> typeset(const std::string& text, Font font) override;
+  std::shared_ptr<Box> typeset(const std::shared_ptr<Symbol>& symbol, Font font) override;
+  std::shared_ptr<Box> typesetRadicalSign(float minTotalHeight) override;
+  std::shared_ptr<Box> typesetDelimiter(const std::shared_ptr<Symbol>& symbol, float minTotalHeight) override;
+  std::shared_ptr<Box> typesetLargeOp(const std::shared_ptr<Symbol>& symbol) override;
+
+protected:
+  std::shared_ptr<Box> varDelimiter(Variant small, Variant large, float minTotalHeight);
+  std::shared_ptr<Box> charBox(Character c, Font font);
+  bool isLoaded(Font font) const;
+  TfmFontMetricsProvider& tfm() const;
+  SfntFontMetricsProvider& sfnt() const;
+
+private:
+  std::shared_ptr<FontMetricsProvider> m_metrics;
+  std::shared_ptr<TfmFontMetricsProvider> m_tfm_metrics;
+  std::shared_ptr<SfntFontMetricsProvider> m_sfnt_metrics;
+  std::array<MathFont, 16> m_mathfonts;
+  std::map<std::pair<int, Character>, Variant> m_large_variants;
+  Variant m_radical_small;
+  Variant m_radical_large;
+};
+
+} // namespace headless
+
+} // namespace tex
+
+#endif // LIBTYPESET_HEADLESS_TYPESET_ENGINE_H
@@ -0,0 +1,179 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/headless/font-registry.h"
+
+#include <stdexcept>
+
+namespace tex
+{
+
+namespace headless
+{
+
+const size_t FontRegistry::SegmentSize;
+const size_t FontRegistry::MaxSegments;
+
+static std::unique_ptr<TfmFont> make_font(const std::string& name, std::shared_ptr<const TfmFile> file, float size)
+{
+  TFM tfm = file->tfm();
+  tfm.design_size = size;
+  tfm = tfm::to_absolute(tfm);
+
+  return std::unique_ptr<TfmFont>(new TfmFont{ name, std::move(file), size, tfm.fontdimen });
+}
+
+FontRegistry::FontRegistry()
+  : m_size(0)
+{
+  for (std::atomic<Segment*>& s : m_segments)
+    s.store(nullptr, std::memory_order_relaxed);
+}
+
+FontRegistry::~FontRegistry()
+{
+  for (std::atomic<Segment*>& s : m_segments)
+    delete s.load(std::memory_order_relaxed);
+}
+
+const std::shared_ptr<FontRegistry>& FontRegistry::global()
+{
+  static const std::shared_ptr<FontRegistry> instance = std::make_shared<FontRegistry>();
+  return instance;
+}
+
+/*!
+ * \fn std::shared_ptr<const TfmFile> loadFile(const std::string& path)
+ * \brief reads a TFM file, or returns the one already read from that path
+ */
+std::shared_ptr<const TfmFile> FontRegistry::loadFile(const std::string& path)
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  std::shared_ptr<const TfmFile>& file = m_files[path];
+
+  if (file == nullptr)
+    file = std::make_shared<TfmFile>(path);
+
+  return file;
+}
+
+Font FontRegistry::add(const std::string& name, std::shared_ptr<const TfmFile> file, float size)
+{
+  if (file == nullptr)
+    throw std::runtime_error{ "FontRegistry::add(): null file" };
+
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  auto key = std::make_tuple(name, file.get(), size);
+  auto it = m_index.find(key);
+
+  if (it != m_index.end())
+    return it->second;
+
+  const size_t id = m_size.load(std::memory_order_relaxed);
+
+  if (id >= SegmentSize * MaxSegments)
+    throw std::runtime_error{ "FontRegistry::add(): too many fonts" };
+
+  m_storage.push_back(make_font(name, std::move(file), size));
+  publish(id, m_storage.back().get());
+
+  // the font must be visible before its id
+  m_size.store(id + 1, std::memory_order_release);
+
+  const Font result{ static_cast<int>(id) };
+  m_index[key] = result;
+  return result;
+}
+
+/*!
+ * \fn std::vector<Font> reload(const std::string& path)
+ * \brief reads a TFM file again and republishes the fonts using it
+ *
+ * Returns the fonts that were updated; engines should drop the metrics 
+ * they cached for these fonts.
+ */
+std::vector<Font> FontRegistry::reload(const std::string& path)
+{
+  auto file = std::make_shared<const TfmFile>(path);
+
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  std::shared_ptr<const TfmFile>& current = m_files[path];
+  const TfmFile* previous = current.get();
+  current = file;
+
+  std::vector<Font> result;
+
+  if (previous == nullptr)
+    return result;
+
+  std::map<std::tuple<std::string, const TfmFile*, float>, Font> index;
+
+  for (const auto& entry : m_index)
+  {
+    if (std::get<1>(entry.first) != previous)
+    {
+      index.insert(entry);
+      continue;
+    }
+
+    const Font f = entry.second;
+    std::unique_ptr<TfmFont>& slot = m_storage[f.id()];
+    std::unique_ptr<TfmFont> updated = make_font(slot->name, file, slot->size);
+
+    publish(static_cast<size_t>(f.id()), updated.get());
+    m_retired.push_back(std::move(slot));
+    slot = std::move(updated);
+
+    index[std::make_tuple(slot->name, file.get(), slot->size)] = f;
+    result.push_back(f);
+  }
+
+  m_index = std::move(index);
+
+  return result;
+}
+
+size_t FontRegistry::retiredCount() const
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  return m_retired.size();
+}
+
+/*!
+ * \fn void reclaim()
+ * \brief frees the fonts that were replaced by reload()
+ *
+ * No reference to these fonts, obtained from font() before they were 
+ * reloaded, may be used after this call.
+ */
+void FontRegistry::reclaim()
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+  m_retired.clear();
+}
+
+void FontRegistry::publish(size_t id, const TfmFont* font)
+{
+  std::atomic<Segment*>& slot = m_segments[id / SegmentSize];
+  Segment* segment = slot.load(std::memory_order_relaxed);
+
+  if (segment == nullptr)
+  {
+    segment = new Segment;
+
+    for (std::atomic<const TfmFont*>& f : segment->fonts)
+      f.store(nullptr, std::memory_order_relaxed);
+
+    slot.store(segment, std::memory_order_release);
+  }
+
+  segment->fonts[id % SegmentSize].store(font, std::memory_order_release);
+}
+
+} // namespace headless
+
+} // namespace tex
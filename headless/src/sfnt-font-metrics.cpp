@@ -0,0 +1,94 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/headless/sfnt-font-metrics.h"
+
+#include <stdexcept>
+
+namespace tex
+{
+
+namespace headless
+{
+
+Font SfntFontMetricsProvider::loadFont(const std::string& path, float size)
+{
+  for (const SfntFont& f : m_fonts)
+  {
+    if (f.name == path && f.size == size)
+      return Font(static_cast<int>(&f - m_fonts.data()));
+  }
+
+  return addFont(path, std::make_shared<SfntFile>(path), size);
+}
+
+Font SfntFontMetricsProvider::addFont(const std::string& name, std::shared_ptr<const SfntFile> file, float size)
+{
+  if (file == nullptr)
+    throw std::runtime_error{ "SfntFontMetricsProvider::addFont(): null file" };
+
+  FontDimen fontdimen = file->fontdimen(size);
+  m_fonts.push_back(SfntFont{ name, std::move(file), size, fontdimen });
+  return Font(static_cast<int>(m_fonts.size() - 1));
+}
+
+const SfntFont& SfntFontMetricsProvider::font(Font f) const
+{
+  if (f.id() < 0 || static_cast<size_t>(f.id()) >= m_fonts.size())
+    throw std::out_of_range{ "SfntFontMetricsProvider: invalid font" };
+
+  return m_fonts[f.id()];
+}
+
+BoxMetrics SfntFontMetricsProvider::metrics(Character c, Font font)
+{
+  const SfntFont& f = this->font(font);
+  return f.file->metrics(c, f.size);
+}
+
+BoxMetrics SfntFontMetricsProvider::metrics(const std::shared_ptr<Symbol>& symbol, Font font)
+{
+  if (!symbol->isMathSymbol())
+    throw std::runtime_error{ "SfntFontMetricsProvider::metrics() - supports only mathsymbol" };
+
+  return metrics(static_cast<MathSymbol*>(symbol.get())->character(), font);
+}
+
+float SfntFontMetricsProvider::italicCorrection(const std::shared_ptr<Symbol>& /* symbol */, Font /* font */)
+{
+  return 0.f;
+}
+
+LigKern SfntFontMetricsProvider::ligKern(Font font, Character left, Character right)
+{
+  LigKern result;
+
+  if (left == LigKern::Boundary || right == LigKern::Boundary)
+    return result;
+
+  const SfntFont& f = this->font(font);
+  const float kern = f.file->kerning(left, right, f.size);
+
+  if (kern != 0.f)
+  {
+    result.kind = LigKern::Kern;
+    result.kern = kern;
+  }
+
+  return result;
+}
+
+bool SfntFontMetricsProvider::hasChar(Font font, Character c)
+{
+  return this->font(font).file->glyphIndex(c) != 0;
+}
+
+const FontDimen& SfntFontMetricsProvider::fontdimen(Font font)
+{
+  return this->font(font).fontdimen;
+}
+
+} // namespace headless
+
+} // namespace tex
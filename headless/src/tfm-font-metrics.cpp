@@ -0,0 +1,122 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/headless/tfm-font-metrics.h"
+
+#include <stdexcept>
+
+namespace tex
+{
+
+namespace headless
+{
+
+TfmFontMetricsProvider::TfmFontMetricsProvider()
+  : TfmFontMetricsProvider(FontRegistry::global())
+{
+
+}
+
+TfmFontMetricsProvider::TfmFontMetricsProvider(std::shared_ptr<FontRegistry> registry)
+  : m_registry(std::move(registry))
+{
+  if (m_registry == nullptr)
+    throw std::runtime_error{ "TfmFontMetricsProvider: null registry" };
+}
+
+Font TfmFontMetricsProvider::addFont(const std::string& name, std::shared_ptr<const TfmFile> file, float size)
+{
+  if (file == nullptr)
+    throw std::runtime_error{ "TfmFontMetricsProvider::addFont(): null file" };
+
+  return m_registry->add(name, std::move(file), size);
+}
+
+BoxMetrics TfmFontMetricsProvider::metrics(Character c, Font font)
+{
+  const TfmFont& f = m_registry->font(font);
+  return f.file->metrics(c, f.size);
+}
+
+BoxMetrics TfmFontMetricsProvider::metrics(const std::shared_ptr<Symbol>& symbol, Font font)
+{
+  if (!symbol->isMathSymbol())
+    throw std::runtime_error{ "TfmFontMetricsProvider::metrics() - supports only mathsymbol" };
+
+  return metrics(static_cast<MathSymbol*>(symbol.get())->character(), font);
+}
+
+float TfmFontMetricsProvider::italicCorrection(const std::shared_ptr<Symbol>& symbol, Font font)
+{
+  if (!symbol->isMathSymbol())
+    return 0.f;
+
+  const TfmFont& f = m_registry->font(font);
+  return f.size * f.file->italicCorrection(static_cast<MathSymbol*>(symbol.get())->character());
+}
+
+LigKern TfmFontMetricsProvider::ligKern(Font font, Character left, Character right)
+{
+  const TfmFont& f = m_registry->font(font);
+
+  if (right == LigKern::Boundary)
+    right = f.file->rightBoundaryChar();
+
+  const size_t i = f.file->findLigKern(left, right);
+
+  LigKern result;
+
+  if (i == TfmFile::npos)
+    return result;
+
+  const tfm::LigKernInstruction instr = f.file->ligKern(i);
+
+  if (instr.isKern())
+  {
+    result.kind = LigKern::Kern;
+    result.kern = f.size * f.file->kern(instr.kernIndex());
+  }
+  else
+  {
+    result.kind = LigKern::Ligature;
+    result.ligature = instr.remainder;
+    result.op = instr.op_byte;
+  }
+
+  return result;
+}
+
+bool TfmFontMetricsProvider::hasChar(Font font, Character c)
+{
+  return m_registry->font(font).file->hasChar(c);
+}
+
+Character TfmFontMetricsProvider::successor(Font font, Character c)
+{
+  return m_registry->font(font).file->successor(c);
+}
+
+bool TfmFontMetricsProvider::extensible(Font font, Character c, ExtensibleRecipe& recipe)
+{
+  const TfmFile& file = *m_registry->font(font).file;
+
+  if (!file.isExtensible(c))
+    return false;
+
+  const tfm::ExtensibleRecipe r = file.extensible(c);
+  recipe.top = r.top;
+  recipe.mid = r.mid;
+  recipe.bot = r.bot;
+  recipe.rep = r.rep;
+  return true;
+}
+
+const FontDimen& TfmFontMetricsProvider::fontdimen(Font font)
+{
+  return m_registry->font(font).fontdimen;
+}
+
+} // namespace headless
+
+} // namespace tex
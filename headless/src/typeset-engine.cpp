@@ -0,0 +1,237 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/headless/typeset-engine.h"
+
+#include "tex/charbox.h"
+#include "tex/delimiterbuilder.h"
+#include "tex/glyphmetricscache.h"
+#include "tex/hbox.h"
+
+#include <stdexcept>
+
+namespace tex
+{
+
+namespace headless
+{
+
+TypesetEngine::TypesetEngine()
+  : TypesetEngine(std::make_shared<TfmFontMetricsProvider>())
+{
+
+}
+
+TypesetEngine::TypesetEngine(std::shared_ptr<FontMetricsProvider> metrics)
+  : m_metrics(std::move(metrics)),
+    m_tfm_metrics(std::dynamic_pointer_cast<TfmFontMetricsProvider>(m_metrics)),
+    m_sfnt_metrics(std::dynamic_pointer_cast<SfntFontMetricsProvider>(m_metrics))
+{
+  if (m_metrics == nullptr)
+    throw std::runtime_error{ "TypesetEngine: null metrics provider" };
+
+  // Variants from plain.tex: \delcode, \delimiter and \radical
+  const std::pair<Variant, Character> delimiters[] = {
+    { { 0, '(' }, 0x00 },
+    { { 0, ')' }, 0x01 },
+    { { 0, '[' }, 0x02 },
+    { { 0, ']' }, 0x03 },
+    { { 2, 0x62 }, 0x04 }, // \lfloor
+    { { 2, 0x63 }, 0x05 }, // \rfloor
+    { { 2, 0x64 }, 0x06 }, // \lceil
+    { { 2, 0x65 }, 0x07 }, // \rceil
+    { { 2, 0x66 }, 0x08 }, // \lbrace
+    { { 2, 0x67 }, 0x09 }, // \rbrace
+    { { 2, 0x68 }, 0x0A }, // \langle
+    { { 2, 0x69 }, 0x0B }, // \rangle
+    { { 2, 0x6A }, 0x0C }, // \vert
+    { { 2, 0x6B }, 0x0D }, // \Vert
+    { { 0, '/' }, 0x0E },
+    { { 2, 0x6E }, 0x0F }, // \backslash
+    { { 2, 0x22 }, 0x78 }, // \uparrow
+    { { 2, 0x23 }, 0x79 }, // \downarrow
+    { { 2, 0x6C }, 0x3F }, // \updownarrow
+    { { 2, 0x2A }, 0x7E }, // \Uparrow
+    { { 2, 0x2B }, 0x7F }, // \Downarrow
+    { { 2, 0x6D }, 0x77 }, // \Updownarrow
+  };
+
+  for (const auto& d : delimiters)
+    setLargeVariant(d.first, Variant{ 3, d.second });
+
+  setRadical(Variant{ 2, 0x70 }, Variant{ 3, 0x70 });
+
+  for (int i(0); i < 16; ++i)
+    m_mathfonts[i] = MathFont{ Font(-1), Font(-1), Font(-1) };
+}
+
+/*!
+ * \fn Font loadFont(const std::string& path, float size)
+ * \brief loads a TFM file, or a font file if the provider reads OpenType fonts
+ */
+Font TypesetEngine::loadFont(const std::string& path, float size)
+{
+  if (m_sfnt_metrics)
+    return m_sfnt_metrics->loadFont(path, size);
+
+  return addFont(path, tfm().registry()->loadFile(path), size);
+}
+
+Font TypesetEngine::addFont(const std::string& name, std::shared_ptr<const TfmFile> file, float size)
+{
+  return tfm().addFont(name, std::move(file), size);
+}
+
+Font TypesetEngine::addFont(const std::string& name, std::shared_ptr<const SfntFile> file, float size)
+{
+  return sfnt().addFont(name, std::move(file), size);
+}
+
+/*!
+ * \fn void reloadFont(const std::string& path)
+ * \brief reads a TFM file again and updates all the fonts loaded from it
+ *
+ * As fonts are shared through the registry, other engines using these
+ * fonts see the new metrics too but must invalidate their own caches.
+ * The replaced fonts are freed by FontRegistry::reclaim().
+ */
+void TypesetEngine::reloadFont(const std::string& path)
+{
+  for (Font f : tfm().registry()->reload(path))
+    invalidateGlyphMetrics(f);
+}
+
+void TypesetEngine::setMathFont(int fam, Font textfont, Font scriptfont, Font scriptscriptfont)
+{
+  m_mathfonts.at(fam) = MathFont{ textfont, scriptfont, scriptscriptfont };
+}
+
+const std::array<MathFont, 16>& TypesetEngine::mathfonts() const
+{
+  return m_mathfonts;
+}
+
+void TypesetEngine::setLargeVariant(Variant small, Variant large)
+{
+  m_large_variants[std::make_pair(small.family, small.character)] = large;
+}
+
+void TypesetEngine::setRadical(Variant small, Variant large)
+{
+  m_radical_small = small;
+  m_radical_large = large;
+}
+
+std::shared_ptr<FontMetricsProvider> TypesetEngine::metrics() const
+{
+  return m_metrics;
+}
+
+std::shared_ptr<Box> TypesetEngine::typeset(Character c, Font font)
+{
+  return charBox(c, font);
+}
+
+std::shared_ptr<Box> TypesetEngine::typeset(const std::string& text, Font font)
+{
+  List list;
+
+  for (auto it = text.begin(); it != text.end(); )
+    list.push_back(charBox(read_utf8_char(it), font));
+
+  return tex::hbox(std::move(list));
+}
+
+std::shared_ptr<Box> TypesetEngine::typeset(const std::shared_ptr<Symbol>& symbol, Font font)
+{
+  if (symbol->isMathSymbol())
+    return charBox(static_cast<MathSymbol*>(symbol.get())->character(), font);
+  else
+    return typeset(symbol->as<TextSymbol>().text(), font);
+}
+
+std::shared_ptr<Box> TypesetEngine::typesetRadicalSign(float minTotalHeight)
+{
+  return varDelimiter(m_radical_small, m_radical_large, minTotalHeight);
+}
+
+std::shared_ptr<Box> TypesetEngine::typesetDelimiter(const std::shared_ptr<Symbol>& symbol, float minTotalHeight)
+{
+  if (!symbol->isMathSymbol())
+    throw std::runtime_error{ "TypesetEngine::typesetDelimiter(): delimiter must be a math symbol" };
+
+  const MathSymbol& ms = *static_cast<MathSymbol*>(symbol.get());
+  const Variant small{ ms.family(), ms.character() };
+
+  auto it = m_large_variants.find(std::make_pair(small.family, small.character));
+  const Variant large = it != m_large_variants.end() ? it->second : Variant{ -1, 0 };
+
+  return varDelimiter(small, large, minTotalHeight);
+}
+
+std::shared_ptr<Box> TypesetEngine::typesetLargeOp(const std::shared_ptr<Symbol>& symbol)
+{
+  if (!symbol->isMathSymbol())
+    throw std::runtime_error{ "TypesetEngine::typesetLargeOp(): operator must be a math symbol" };
+
+  const MathSymbol& ms = *static_cast<MathSymbol*>(symbol.get());
+  const Font font = m_mathfonts.at(ms.family()).textfont;
+  const Character successor = m_metrics->successor(font, ms.character());
+
+  return charBox(successor >= 0 ? successor : ms.character(), font);
+}
+
+std::shared_ptr<Box> TypesetEngine::varDelimiter(Variant small, Variant large, float minTotalHeight)
+{
+  auto font = [this](const Variant& v) -> DelimiterBuilder::Variant {
+    if (v.family < 0 || v.family >= 16)
+      return DelimiterBuilder::Variant{ Font(-1), 0 };
+
+    const Font f = m_mathfonts[v.family].textfont;
+
+    if (!isLoaded(f))
+      return DelimiterBuilder::Variant{ Font(-1), 0 };
+
+    return DelimiterBuilder::Variant{ f, v.character };
+  };
+
+  return delimiters()->build(font(small), font(large), minTotalHeight);
+}
+
+std::shared_ptr<Box> TypesetEngine::charBox(Character c, Font font)
+{
+  return std::make_shared<CharacterBox>(c, font, glyphMetrics()->glyph(c, font));
+}
+
+bool TypesetEngine::isLoaded(Font font) const
+{
+  if (font.id() < 0)
+    return false;
+  else if (m_tfm_metrics)
+    return static_cast<size_t>(font.id()) < m_tfm_metrics->registry()->size();
+  else if (m_sfnt_metrics)
+    return static_cast<size_t>(font.id()) < m_sfnt_metrics->fontCount();
+  else
+    return true;
+}
+
+TfmFontMetricsProvider& TypesetEngine::tfm() const
+{
+  if (m_tfm_metrics == nullptr)
+    throw std::runtime_error{ "TypesetEngine: the metrics provider does not read TFM files" };
+
+  return *m_tfm_metrics;
+}
+
+SfntFontMetricsProvider& TypesetEngine::sfnt() const
+{
+  if (m_sfnt_metrics == nullptr)
+    throw std::runtime_error{ "TypesetEngine: the metrics provider does not read OpenType fonts" };
+
+  return *m_sfnt_metrics;
+}
+
+} // namespace headless
+
+} // namespace tex
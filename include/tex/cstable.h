@@ -0,0 +1,153 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_CSTABLE_H
+#define LIBTYPESET_CSTABLE_H
+
+#include "tex/defs.h"
+
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace tex
+{
+
+namespace parsing
+{
+
+typedef uint32_t CsId;
+
+/*!
+ * \class CsTable
+ * \brief interns the names of control sequences to dense integer ids
+ *
+ * Ids are attributed in order starting from 0 and are never reused, so
+ * they can index arrays. The control sequences that the preprocessor
+ * handles itself are interned on construction and have fixed ids.
+ *
+ * A name is published once and never modified: name() requires no lock
+ * and the returned reference stays valid for the lifetime of the table.
+ */
+class LIBTYPESET_API CsTable
+{
+public:
+  CsTable();
+  CsTable(const CsTable&) = delete;
+  ~CsTable();
+
+  static CsTable& global();
+
+  enum Builtin : CsId
+  {
+    Par,
+    Def,
+    Csname,
+    Endcsname,
+    Expandafter,
+    Ifbr,
+    Else,
+    Fi,
+    BuiltinCount,
+  };
+
+  static const CsId Invalid = CsId(-1);
+
+  static const size_t SegmentSize = 1024;
+  static const size_t MaxSegments = 4096;
+
+  CsId intern(const std::string& name);
+  CsId find(const std::string& name) const;
+
+  size_t size() const { return m_size.load(std::memory_order_acquire); }
+  const std::string& name(CsId id) const;
+
+  CsTable& operator=(const CsTable&) = delete;
+
+private:
+  struct Segment
+  {
+    std::string names[SegmentSize];
+  };
+
+  std::atomic<Segment*> m_segments[MaxSegments];
+  std::atomic<size_t> m_size;
+  mutable std::mutex m_mutex;
+  std::unordered_map<std::string, CsId> m_ids;
+};
+
+inline const std::string& CsTable::name(CsId id) const
+{
+  if (id >= size())
+    throw std::out_of_range{ "CsTable::name()" };
+
+  const Segment* segment = m_segments[id / SegmentSize].load(std::memory_order_acquire);
+  return segment->names[id % SegmentSize];
+}
+
+/*!
+ * \class CsMap
+ * \brief a static map from control sequences to values
+ *
+ * The names are interned in the global CsTable on construction;
+ * lookups index a flat array with the id of the control sequence.
+ */
+template<typename T>
+class CsMap
+{
+public:
+  CsMap() = default;
+  CsMap(std::initializer_list<std::pair<const char*, T>> entries);
+
+  const T* find(CsId id) const;
+  const T* find(const std::string& name) const;
+
+private:
+  std::vector<int> m_index;
+  std::vector<T> m_values;
+};
+
+template<typename T>
+inline CsMap<T>::CsMap(std::initializer_list<std::pair<const char*, T>> entries)
+{
+  m_values.reserve(entries.size());
+
+  for (const auto& e : entries)
+  {
+    const CsId id = CsTable::global().intern(e.first);
+
+    if (id >= m_index.size())
+      m_index.resize(id + 1, -1);
+
+    m_index[id] = static_cast<int>(m_values.size());
+    m_values.push_back(e.second);
+  }
+}
+
+template<typename T>
+inline const T* CsMap<T>::find(CsId id) const
+{
+  if (id >= m_index.size() || m_index[id] < 0)
+    return nullptr;
+
+  return &m_values[m_index[id]];
+}
+
+template<typename T>
+inline const T* CsMap<T>::find(const std::string& name) const
+{
+  return find(CsTable::global().find(name));
+}
+
+} // namespace parsing
+
+} // namespace tex
+
+#endif // LIBTYPESET_CSTABLE_H
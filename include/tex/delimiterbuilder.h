@@ -0,0 +1,84 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_DELIMITERBUILDER_H
+#define LIBTYPESET_DELIMITERBUILDER_H
+
+#include "tex/box.h"
+#include "tex/fontmetrics.h"
+
+#include <cstdint>
+#include <unordered_map>
+
+namespace tex
+{
+
+class TypesetEngine;
+
+/*!
+ * \class DelimiterBuilder
+ * \brief builds delimiters and radical signs of a given size
+ *
+ * As in TeX (§706), the successors of the small variant, then those of 
+ * the large variant, are searched for the first character that is tall 
+ * enough; if an extensible character is met on the way, the delimiter is 
+ * assembled from its pieces into a VBox (§713).
+ * The characters, successors and recipes come from the glyph metrics 
+ * of the engine.
+ *
+ * Results are cached by variants and by height, rounded up to a 
+ * multiple of quantum(), so that delimiters of the same size share the 
+ * same box; boxes returned by build() must not be modified.
+ */
+class LIBTYPESET_API DelimiterBuilder
+{
+public:
+  explicit DelimiterBuilder(TypesetEngine& engine);
+  ~DelimiterBuilder();
+
+  struct Variant
+  {
+    Font font;
+    Character character;
+  };
+
+  float quantum() const { return m_quantum; }
+  void setQuantum(float q);
+
+  std::shared_ptr<Box> build(Variant small, Variant large, float minTotalHeight);
+  std::shared_ptr<Box> build(Variant v, float minTotalHeight);
+
+  size_t cacheSize() const { return m_cache.size(); }
+  void clear();
+
+protected:
+  std::shared_ptr<Box> search(Variant small, Variant large, float minTotalHeight);
+  std::shared_ptr<Box> extensible(Font font, const ExtensibleRecipe& recipe, float minTotalHeight);
+  std::shared_ptr<Box> glyph(Character c, Font font);
+
+private:
+  struct Key
+  {
+    int small_font;
+    Character small_char;
+    int large_font;
+    Character large_char;
+    int32_t height;
+
+    bool operator==(const Key& other) const;
+  };
+
+  struct KeyHash
+  {
+    size_t operator()(const Key& k) const;
+  };
+
+  TypesetEngine& m_engine;
+  float m_quantum;
+  std::unordered_map<Key, std::shared_ptr<Box>, KeyHash> m_cache;
+};
+
+} // namespace tex
+
+#endif // LIBTYPESET_DELIMITERBUILDER_H
@@ -0,0 +1,121 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_DVIWRITER_H
+#define LIBTYPESET_DVIWRITER_H
+
+#include "tex/charbox.h"
+#include "tex/listbox.h"
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace tex
+{
+
+/*!
+ * \class DviWriter
+ * \brief streams layouts as a DVI file
+ *
+ * One layout unit is one TeX point; all dimensions are rounded to 
+ * scaled points as the layout is traversed, the same way TeX's 
+ * \c{hlist_out} and \c{vlist_out} do. 
+ * Each page is written as soon as writePage() is called; finish() writes 
+ * the postamble.
+ *
+ * Horizontal and vertical movements are written using the w/x and y/z 
+ * registers whenever a recently used amount is repeated.
+ */
+class LIBTYPESET_API DviWriter
+{
+public:
+  explicit DviWriter(std::ostream& out, const std::string& comment = std::string());
+  DviWriter(const DviWriter&) = delete;
+  ~DviWriter() = default;
+
+  void setFont(Font f, const std::string& name, float size, float designSize, uint32_t checksum = 0);
+  void setFont(Font f, const std::string& name, float size);
+
+  void writePage(const Box& page);
+
+  size_t pageCount() const { return m_page_count; }
+  uint64_t bytesWritten() const { return m_offset; }
+
+  void finish();
+
+  static int32_t scaled(float x);
+
+  DviWriter& operator=(const DviWriter&) = delete;
+
+protected:
+  void outputBox(const Box* box, bool horizontal, int32_t h, int32_t v);
+  void outputLists();
+
+  void selectFont(Font f);
+  void setChar(Character c);
+  void setRule(int32_t height, int32_t width, bool advance);
+  void moveTo(int32_t h, int32_t v);
+  void push();
+  void pop();
+
+  void writeFontDef(int k);
+
+  void writeByte(uint8_t b);
+  void writeSigned(int32_t value, int bytes);
+  void writeUnsigned(uint32_t value, int bytes);
+  void writeCommand(uint8_t base, int32_t value);
+  void writeMove(uint8_t w0, uint8_t x0, int32_t delta, int32_t regs[2], int& lru);
+
+private:
+  struct FontInfo
+  {
+    std::string name;
+    int32_t size = 0;
+    int32_t design_size = 0;
+    uint32_t checksum = 0;
+    bool defined = false;
+  };
+
+  struct State
+  {
+    int32_t h = 0;
+    int32_t v = 0;
+    int32_t wx[2] = { 0, 0 };
+    int32_t yz[2] = { 0, 0 };
+    int wx_lru = 0;
+    int yz_lru = 0;
+  };
+
+  struct Frame
+  {
+    const ListBox* box;
+    List::const_iterator current;
+    List::const_iterator end;
+    int32_t h;
+    int32_t v;
+    bool pushed;
+    State saved;
+  };
+
+private:
+  std::ostream& m_out;
+  uint64_t m_offset = 0;
+  std::vector<FontInfo> m_fonts;
+  std::vector<Frame> m_frames;
+  State m_state;
+  int m_current_font = -1;
+  size_t m_page_count = 0;
+  int64_t m_last_bop = -1;
+  int32_t m_max_height = 0;
+  int32_t m_max_width = 0;
+  size_t m_push_depth = 0;
+  size_t m_max_push = 0;
+  bool m_finished = false;
+};
+
+} // namespace tex
+
+#endif // LIBTYPESET_DVIWRITER_H
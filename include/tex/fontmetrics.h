@@ -8,6 +8,7 @@
 #include "tex/boxmetrics.h"
 #include "tex/font.h"
 #include "tex/fontdimen.h"
+#include "tex/sfcodetable.h"
 #include "tex/symbol.h"
 
 #include <memory>
@@ -15,6 +16,46 @@
 namespace tex
 {
 
+/*!
+ * \class LigKern
+ * \brief the result of a ligature/kern lookup for a pair of characters
+ *
+ * For ligatures, \c op is the TFM op byte (0 for \c{=:}, 1 for \c{=:|}, 
+ * 2 for \c{|=:}, 3 for \c{|=:|}, 5 for \c{=:|>}, 6 for \c{|=:>}, 7 for 
+ * \c{|=:|>} and 11 for \c{|=:|>>}).
+ * \c Boundary stands for the left or right boundary of a word.
+ */
+struct LigKern
+{
+  enum Kind
+  {
+    None,
+    Kern,
+    Ligature,
+  };
+
+  static constexpr Character Boundary = -1;
+
+  Kind kind = None;
+  float kern = 0.f;
+  Character ligature = 0;
+  int op = 0;
+};
+
+/*!
+ * \class ExtensibleRecipe
+ * \brief the pieces an extensible delimiter is made of
+ *
+ * Pieces equal to 0 are absent, except for the repeated piece.
+ */
+struct ExtensibleRecipe
+{
+  Character top = 0;
+  Character mid = 0;
+  Character bot = 0;
+  Character rep = 0;
+};
+
 class LIBTYPESET_API FontMetricsProvider
 {
 public:
@@ -24,7 +65,16 @@ public:
   virtual BoxMetrics metrics(tex::Character c, tex::Font font) = 0;
   virtual BoxMetrics metrics(const std::shared_ptr<tex::Symbol> & symbol, tex::Font font) = 0;
   virtual float italicCorrection(const std::shared_ptr<tex::Symbol> & symbol, tex::Font font) = 0;
-  virtual int sfcode(tex::Character c);
+
+  int sfcode(Character c) const { return m_sfcodes->get(c); }
+  const std::shared_ptr<const SfcodeTable>& sfcodes() const { return m_sfcodes; }
+  virtual void setSfcodes(std::shared_ptr<const SfcodeTable> table);
+
+  virtual LigKern ligKern(Font font, Character left, Character right);
+
+  virtual bool hasChar(Font font, Character c);
+  virtual Character successor(Font font, Character c);
+  virtual bool extensible(Font font, Character c, ExtensibleRecipe& recipe);
 
   virtual const FontDimen& fontdimen(Font font) = 0;
 
@@ -60,6 +110,9 @@ public:
   virtual float bigOpSpacing5(Font font);
 
   FontMetricsProvider & operator=(const FontMetricsProvider &) = delete;
+
+private:
+  std::shared_ptr<const SfcodeTable> m_sfcodes = SfcodeTable::frenchspacing();
 };
 
 
@@ -148,6 +201,96 @@ template<> inline float FontMetrics::xi<11>() const { return bigOpSpacing3(); }
 template<> inline float FontMetrics::xi<12>() const { return bigOpSpacing4(); }
 template<> inline float FontMetrics::xi<13>() const { return bigOpSpacing5(); }
 
+
+/*!
+ * \class ResolvedFontMetrics
+ * \brief a copy of the parameters of a font
+ *
+ * Unlike FontMetrics, no call to the FontMetricsProvider is made when 
+ * reading a parameter.
+ */
+class LIBTYPESET_API ResolvedFontMetrics
+{
+public:
+  ResolvedFontMetrics();
+  ResolvedFontMetrics(Font font, const FontDimen& fontdimen);
+  explicit ResolvedFontMetrics(const FontMetrics& metrics);
+  ResolvedFontMetrics(const ResolvedFontMetrics&) = default;
+  ~ResolvedFontMetrics() = default;
+
+  bool isValid() const { return m_font.id() >= 0; }
+  Font font() const { return m_font; }
+  const FontDimen& fontdimen() const { return m_fontdimen; }
+
+  float slantPerPt() const { return m_fontdimen.slant_per_pt; }
+  float interwordSpace() const { return m_fontdimen.interword_space; }
+  float interwordStretch() const { return m_fontdimen.interword_stretch; }
+  float interwordShrink() const { return m_fontdimen.interword_shrink; }
+  float extraSpace() const { return m_fontdimen.extra_space; }
+
+  float xHeight() const { return m_fontdimen.x_height; }
+  float quad() const { return m_fontdimen.quad; }
+  float num1() const { return m_fontdimen.num1; }
+  float num2() const { return m_fontdimen.num2; }
+  float num3() const { return m_fontdimen.num3; }
+  float denom1() const { return m_fontdimen.denom1; }
+  float denom2() const { return m_fontdimen.denom2; }
+  float sup1() const { return m_fontdimen.sup1; }
+  float sup2() const { return m_fontdimen.sup2; }
+  float sup3() const { return m_fontdimen.sup3; }
+  float sub1() const { return m_fontdimen.sub1; }
+  float sub2() const { return m_fontdimen.sub2; }
+  float supDrop() const { return m_fontdimen.sup_drop; }
+  float subDrop() const { return m_fontdimen.sub_drop; }
+  float delim1() const { return m_fontdimen.delim1; }
+  float delim2() const { return m_fontdimen.delim2; }
+  float axisHeight() const { return m_fontdimen.axis_height; }
+
+  float defaultRuleThickness() const { return m_fontdimen.default_rule_thickness; }
+  float bigOpSpacing1() const { return m_fontdimen.big_op_spacing1; }
+  float bigOpSpacing2() const { return m_fontdimen.big_op_spacing2; }
+  float bigOpSpacing3() const { return m_fontdimen.big_op_spacing3; }
+  float bigOpSpacing4() const { return m_fontdimen.big_op_spacing4; }
+  float bigOpSpacing5() const { return m_fontdimen.big_op_spacing5; }
+
+  template<size_t I>
+  float sigma() const;
+
+  template<size_t I>
+  float xi() const;
+
+  ResolvedFontMetrics& operator=(const ResolvedFontMetrics&) = default;
+
+private:
+  Font m_font;
+  FontDimen m_fontdimen;
+};
+
+template<> inline float ResolvedFontMetrics::sigma<5>() const { return xHeight(); }
+template<> inline float ResolvedFontMetrics::sigma<6>() const { return quad(); }
+template<> inline float ResolvedFontMetrics::sigma<8>() const { return num1(); }
+template<> inline float ResolvedFontMetrics::sigma<9>() const { return num2(); }
+template<> inline float ResolvedFontMetrics::sigma<10>() const { return num3(); }
+template<> inline float ResolvedFontMetrics::sigma<11>() const { return denom1(); }
+template<> inline float ResolvedFontMetrics::sigma<12>() const { return denom2(); }
+template<> inline float ResolvedFontMetrics::sigma<13>() const { return sup1(); }
+template<> inline float ResolvedFontMetrics::sigma<14>() const { return sup2(); }
+template<> inline float ResolvedFontMetrics::sigma<15>() const { return sup3(); }
+template<> inline float ResolvedFontMetrics::sigma<16>() const { return sub1(); }
+template<> inline float ResolvedFontMetrics::sigma<17>() const { return sub2(); }
+template<> inline float ResolvedFontMetrics::sigma<18>() const { return supDrop(); }
+template<> inline float ResolvedFontMetrics::sigma<19>() const { return subDrop(); }
+template<> inline float ResolvedFontMetrics::sigma<20>() const { return delim1(); }
+template<> inline float ResolvedFontMetrics::sigma<21>() const { return delim2(); }
+template<> inline float ResolvedFontMetrics::sigma<22>() const { return axisHeight(); }
+
+template<> inline float ResolvedFontMetrics::xi<8>() const { return defaultRuleThickness(); }
+template<> inline float ResolvedFontMetrics::xi<9>() const { return bigOpSpacing1(); }
+template<> inline float ResolvedFontMetrics::xi<10>() const { return bigOpSpacing2(); }
+template<> inline float ResolvedFontMetrics::xi<11>() const { return bigOpSpacing3(); }
+template<> inline float ResolvedFontMetrics::xi<12>() const { return bigOpSpacing4(); }
+template<> inline float ResolvedFontMetrics::xi<13>() const { return bigOpSpacing5(); }
+
 } // namespace tex
 
 #endif // LIBTYPESET_FONTMETRICS_H
@@ -0,0 +1,126 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_GLYPHMETRICSCACHE_H
+#define LIBTYPESET_GLYPHMETRICSCACHE_H
+
+#include "tex/fontmetrics.h"
+
+#include <array>
+#include <bitset>
+#include <unordered_map>
+#include <vector>
+
+namespace tex
+{
+
+struct InterwordGlue
+{
+  float space;
+  float stretch;
+  float shrink;
+};
+
+/*!
+ * \class GlyphMetricsCache
+ * \brief caches the metrics returned by another FontMetricsProvider
+ *
+ * Metrics are fetched from the underlying provider on first use and then
+ * stored per font: in a flat array indexed by the character for Latin-1,
+ * in a hash table for the rest of Unicode.
+ * Font dimensions are cached the same way, together with the interword 
+ * glue of each font for every bucket of the space factor codes.
+ *
+ * The cache must be invalidated whenever the underlying provider starts
+ * returning different values for a font (e.g. when the font is reloaded).
+ */
+class LIBTYPESET_API GlyphMetricsCache : public FontMetricsProvider
+{
+public:
+  explicit GlyphMetricsCache(std::shared_ptr<FontMetricsProvider> provider);
+  ~GlyphMetricsCache();
+
+  const std::shared_ptr<FontMetricsProvider>& provider() const { return m_provider; }
+
+  const BoxMetrics& glyph(Character c, Font font);
+
+  BoxMetrics metrics(Character c, Font font) override;
+  BoxMetrics metrics(const std::shared_ptr<Symbol>& symbol, Font font) override;
+  float italicCorrection(const std::shared_ptr<Symbol>& symbol, Font font) override;
+  void setSfcodes(std::shared_ptr<const SfcodeTable> table) override;
+  LigKern ligKern(Font font, Character left, Character right) override;
+  bool hasChar(Font font, Character c) override;
+  Character successor(Font font, Character c) override;
+  bool extensible(Font font, Character c, ExtensibleRecipe& recipe) override;
+
+  const FontDimen& fontdimen(Font font) override;
+
+  const InterwordGlue& interwordGlue(Font font, size_t bucket);
+
+  void invalidate();
+  void invalidate(Font font);
+
+protected:
+  struct FontEntry
+  {
+    std::array<BoxMetrics, 256> latin1;
+    std::bitset<256> latin1_filled;
+    std::unordered_map<Character, BoxMetrics> others;
+    bool has_fontdimen = false;
+    FontDimen fontdimen;
+    std::vector<InterwordGlue> interword;
+  };
+
+  FontEntry* entry(Font font);
+  void buildInterwordGlue(FontEntry& e, Font font);
+
+private:
+  std::shared_ptr<FontMetricsProvider> m_provider;
+  std::vector<std::unique_ptr<FontEntry>> m_fonts;
+};
+
+inline const BoxMetrics& GlyphMetricsCache::glyph(Character c, Font font)
+{
+  FontEntry* e = entry(font);
+
+  if (static_cast<unsigned>(c) < 256)
+  {
+    if (!e->latin1_filled[c])
+    {
+      e->latin1[c] = m_provider->metrics(c, font);
+      e->latin1_filled[c] = true;
+    }
+
+    return e->latin1[c];
+  }
+
+  auto it = e->others.find(c);
+
+  if (it == e->others.end())
+    it = e->others.emplace(c, m_provider->metrics(c, font)).first;
+
+  return it->second;
+}
+
+/*!
+ * \fn const InterwordGlue& interwordGlue(Font font, size_t bucket)
+ * \brief returns the interword glue of a font for a space factor bucket
+ *
+ * \a bucket is a bucket of sfcodes(); as in TeX, the stretch is multiplied 
+ * and the shrink divided by the space factor over 1000, and the extra space 
+ * is added from a space factor of 2000.
+ */
+inline const InterwordGlue& GlyphMetricsCache::interwordGlue(Font font, size_t bucket)
+{
+  FontEntry* e = entry(font);
+
+  if (e->interword.empty())
+    buildInterwordGlue(*e, font);
+
+  return e->interword[bucket];
+}
+
+} // namespace tex
+
+#endif // LIBTYPESET_GLYPHMETRICSCACHE_H
@@ -0,0 +1,104 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_GLYPHRUN_H
+#define LIBTYPESET_GLYPHRUN_H
+
+#include "tex/charbox.h"
+#include "tex/layoutreader.h"
+
+#include <vector>
+
+namespace tex
+{
+
+/*!
+ * \class GlyphRun
+ * \brief a sequence of glyphs sharing a font and a baseline
+ *
+ * The i-th glyph is drawn at \c{origin.x + advances[0] + ... + advances[i-1]}; 
+ * the last advance is the width of the last glyph.
+ */
+struct LIBTYPESET_API GlyphRun
+{
+  Font font;
+  Pos origin;
+  std::vector<Character> glyphs;
+  std::vector<float> advances;
+
+  bool empty() const { return glyphs.empty(); }
+  size_t size() const { return glyphs.size(); }
+
+  float width() const;
+
+  void clear();
+};
+
+class LIBTYPESET_API GlyphRunBuilder
+{
+public:
+  GlyphRunBuilder() = default;
+  ~GlyphRunBuilder() = default;
+
+  bool empty() const { return m_run.empty(); }
+
+  bool accepts(const CharacterBox& box, Pos pos) const;
+  void push_back(const CharacterBox& box, Pos pos);
+
+  const GlyphRun& run() const { return m_run; }
+  GlyphRun take();
+  void clear();
+
+private:
+  GlyphRun m_run;
+  float m_last_x = 0.f;
+};
+
+/*!
+ * \class GlyphRunList
+ * \brief the glyphs of a layout grouped into runs
+ *
+ * Runs are stored in reading order; they are also grouped by font 
+ * so that a backend can select each font only once.
+ */
+class LIBTYPESET_API GlyphRunList
+{
+public:
+  struct FontBucket
+  {
+    Font font;
+    std::vector<size_t> runs;
+  };
+
+  GlyphRunList() = default;
+  GlyphRunList(const GlyphRunList&) = default;
+  GlyphRunList(GlyphRunList&&) = default;
+  ~GlyphRunList() = default;
+
+  explicit GlyphRunList(const Box& layout);
+  GlyphRunList(const Box& layout, Pos pos);
+
+  bool empty() const { return m_runs.empty(); }
+  const std::vector<GlyphRun>& runs() const { return m_runs; }
+  const std::vector<FontBucket>& buckets() const { return m_buckets; }
+  const FontBucket* bucket(Font f) const;
+
+  size_t glyphCount() const;
+
+  void push_back(GlyphRun run);
+
+  GlyphRunList& operator=(const GlyphRunList&) = default;
+  GlyphRunList& operator=(GlyphRunList&&) = default;
+
+private:
+  std::vector<GlyphRun> m_runs;
+  std::vector<FontBucket> m_buckets;
+};
+
+LIBTYPESET_API GlyphRunList glyph_runs(const Box& layout);
+LIBTYPESET_API GlyphRunList glyph_runs(const Box& layout, Pos pos);
+
+} // namespace tex
+
+#endif // LIBTYPESET_GLYPHRUN_H
@@ -15,6 +15,17 @@ namespace tex
 class Kern;
 class TypesetEngine;
 
+/*!
+ * \class HListBuilder
+ * \brief builds a horizontal list, character by character
+ *
+ * Ligatures and kerns are inserted as in TeX's main loop, following the 
+ * lig/kern program of the font. 
+ * As the last characters of a word may still be affected by the next 
+ * one, they are only appended to \c result when the word ends, i.e. when 
+ * something other than a character is pushed, when the font changes 
+ * or when flush() is called.
+ */
 class LIBTYPESET_API HListBuilder
 {
 public:
@@ -30,6 +41,23 @@ public:
   void push_back(std::shared_ptr<tex::Box> b);
   void push_back(std::shared_ptr<tex::Glue> g);
   void push_back(std::shared_ptr<tex::Kern> k);
+
+  void flush();
+
+protected:
+  void ligkern();
+  void emit(tex::Character c);
+  tex::Character pop();
+
+private:
+  static const int LigStackCapacity = 4;
+
+  bool m_in_word = false;
+  tex::Font m_word_font;
+  tex::Character m_cur_l = 0;
+  tex::Character m_lig_stack[LigStackCapacity];
+  int m_lig_stack_size = 0;
+  size_t m_spacefactor_bucket = 0;
 };
 
 } // namespace tex
@@ -0,0 +1,84 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_INCREMENTALLEXER_H
+#define LIBTYPESET_INCREMENTALLEXER_H
+
+#include "tex/lexer.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace tex
+{
+
+namespace parsing
+{
+
+/*!
+ * \class IncrementalLexer
+ * \brief keeps the tokens of an edited text up to date
+ *
+ * The text is lexed line by line and a checkpoint (offset, state of the
+ * lexer, version of the catcode table, index of the first token) is
+ * recorded at the start of each line, unless a control sequence or a
+ * parameter is still being read there.
+ *
+ * After an edit, lexing resumes from the last checkpoint before the edit
+ * and stops at the first line start after it where the state matches the
+ * checkpoint of the previous run at the same place in the unchanged text:
+ * from there on, the tokens are those of the previous run.
+ * The lexing work therefore depends on the size of the edit (and on how
+ * far it propagates, e.g. when it opens a comment), not on the size of
+ * the text.
+ */
+class LIBTYPESET_API IncrementalLexer
+{
+public:
+  explicit IncrementalLexer(const Lexer::CatCodeTable& catcodes = Lexer::DefaultCatCodes);
+
+  struct Checkpoint
+  {
+    size_t offset;
+    LexerState state;
+    uint32_t catcodes_version;
+    size_t token;
+  };
+
+  struct Change
+  {
+    size_t token = 0;
+    size_t removed = 0;
+    size_t inserted = 0;
+    size_t lines = 0;
+  };
+
+  const std::string& text() const { return m_text; }
+  const std::vector<Token>& tokens() const { return m_tokens; }
+  const std::vector<Checkpoint>& checkpoints() const { return m_checkpoints; }
+
+  const Lexer::CatCodeTable& catcodes() const { return m_catcodes; }
+  uint32_t catcodesVersion() const { return m_catcodes_version; }
+  Change setCatcodes(const Lexer::CatCodeTable& catcodes);
+
+  Change setText(std::string text);
+  Change replace(size_t offset, size_t length, const std::string& text);
+
+protected:
+  Change relex(size_t first, size_t edit_end, ptrdiff_t delta);
+
+private:
+  std::string m_text;
+  Lexer::CatCodeTable m_catcodes;
+  uint32_t m_catcodes_version = 0;
+  std::vector<Token> m_tokens;
+  std::vector<Checkpoint> m_checkpoints;
+};
+
+} // namespace parsing
+
+} // namespace tex
+
+#endif // LIBTYPESET_INCREMENTALLEXER_H
@@ -0,0 +1,130 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_INPUTSOURCE_H
+#define LIBTYPESET_INPUTSOURCE_H
+
+#include "tex/mappedfile.h"
+
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace tex
+{
+
+namespace parsing
+{
+
+/*!
+ * \class InputSource
+ * \brief a source of characters for the Lexer
+ *
+ * Derived classes provide the input in chunks through fetch();
+ * the characters are then read line by line.
+ * Ends of line are normalized on the fly: CRLF and lone CR become LF,
+ * even when a CRLF pair is split across two chunks.
+ * Only chunks that contain a CR are copied, into a buffer of the size
+ * of the chunk.
+ *
+ * The source keeps track of the line and column of the next character,
+ * both counted from 0.
+ */
+class LIBTYPESET_API InputSource
+{
+public:
+  InputSource() = default;
+  InputSource(const InputSource&) = delete;
+  virtual ~InputSource();
+
+  static const size_t DefaultChunkSize = 64 * 1024;
+
+  bool atEnd();
+  size_t read(const char*& data);
+
+  size_t line() const { return m_line; }
+  size_t column() const { return m_column; }
+
+  InputSource& operator=(const InputSource&) = delete;
+
+protected:
+  virtual bool fetch(const char*& data, size_t& size) = 0;
+
+  bool refill();
+  void normalize(const char* data, size_t size);
+
+private:
+  const char* m_chunk = nullptr;
+  size_t m_size = 0;
+  size_t m_pos = 0;
+  bool m_pending_cr = false;
+  std::vector<char> m_buffer;
+  size_t m_line = 0;
+  size_t m_column = 0;
+};
+
+/*!
+ * \class StringInputSource
+ * \brief reads the characters of a string
+ */
+class LIBTYPESET_API StringInputSource : public InputSource
+{
+public:
+  explicit StringInputSource(std::string text, size_t chunk_size = DefaultChunkSize);
+
+  const std::string& text() const { return m_text; }
+
+protected:
+  bool fetch(const char*& data, size_t& size) override;
+
+private:
+  std::string m_text;
+  size_t m_chunk_size;
+  size_t m_offset = 0;
+};
+
+/*!
+ * \class MappedInputSource
+ * \brief reads the characters of a memory-mapped file
+ *
+ * The constructor throws std::runtime_error if the file cannot be opened.
+ */
+class LIBTYPESET_API MappedInputSource : public InputSource
+{
+public:
+  explicit MappedInputSource(const std::string& path, size_t chunk_size = DefaultChunkSize);
+
+protected:
+  bool fetch(const char*& data, size_t& size) override;
+
+private:
+  MappedFile m_file;
+  size_t m_chunk_size;
+  size_t m_offset = 0;
+};
+
+/*!
+ * \class StreamInputSource
+ * \brief reads the characters of a std::istream through a refill buffer
+ *
+ * The stream must outlive the source.
+ */
+class LIBTYPESET_API StreamInputSource : public InputSource
+{
+public:
+  explicit StreamInputSource(std::istream& stream, size_t chunk_size = DefaultChunkSize);
+
+protected:
+  bool fetch(const char*& data, size_t& size) override;
+
+private:
+  std::istream& m_stream;
+  std::vector<char> m_chunk;
+};
+
+} // namespace parsing
+
+} // namespace tex
+
+#endif // LIBTYPESET_INPUTSOURCE_H
@@ -0,0 +1,145 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_LAYOUTINDEX_H
+#define LIBTYPESET_LAYOUTINDEX_H
+
+#include "tex/layoutreader.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace tex
+{
+
+struct Rect
+{
+  float x;
+  float y;
+  float width;
+  float height;
+
+  float left() const { return x; }
+  float top() const { return y; }
+  float right() const { return x + width; }
+  float bottom() const { return y + height; }
+
+  bool contains(const Pos& p) const
+  {
+    return p.x >= left() && p.x <= right() && p.y >= top() && p.y <= bottom();
+  }
+
+  bool intersects(const Rect& other) const
+  {
+    return other.left() <= right() && other.right() >= left()
+      && other.top() <= bottom() && other.bottom() >= top();
+  }
+};
+
+LIBTYPESET_API Rect united(const Rect& a, const Rect& b);
+
+/*!
+ * \class LayoutIndex
+ * \brief a packed R-tree over the boxes of a layout
+ *
+ * Entries are stored in reading order (a list box comes before its content);
+ * hitTest() returns the last entry containing the point, i.e. the innermost 
+ * box that is painted on top.
+ */
+class LIBTYPESET_API LayoutIndex
+{
+public:
+
+  struct Entry
+  {
+    std::shared_ptr<Box> box;
+    Pos pos;
+    Rect rect;
+  };
+
+  LayoutIndex() = default;
+  LayoutIndex(const LayoutIndex&) = default;
+  LayoutIndex(LayoutIndex&&) = default;
+  ~LayoutIndex() = default;
+
+  explicit LayoutIndex(const std::shared_ptr<Box>& layout);
+  LayoutIndex(const std::shared_ptr<Box>& layout, Pos pos);
+
+  static const size_t NodeCapacity = 16;
+
+  bool empty() const { return m_entries.empty(); }
+  size_t size() const { return m_entries.size(); }
+  const std::vector<Entry>& entries() const { return m_entries; }
+
+  const Rect& bounds() const;
+
+  template<typename F>
+  void query(const Rect& rect, F&& func) const;
+
+  std::vector<const Entry*> query(const Rect& rect) const;
+
+  const Entry* hitTest(Pos p) const;
+
+  LayoutIndex& operator=(const LayoutIndex&) = default;
+  LayoutIndex& operator=(LayoutIndex&&) = default;
+
+protected:
+  void build();
+
+private:
+  struct TreeNode
+  {
+    Rect bounds;
+    uint32_t first;
+    uint32_t count;
+  };
+
+  std::vector<Entry> m_entries;
+  std::vector<uint32_t> m_items;
+  std::vector<TreeNode> m_nodes;
+  size_t m_leaf_count = 0;
+};
+
+template<typename F>
+inline void LayoutIndex::query(const Rect& rect, F&& func) const
+{
+  if (m_nodes.empty())
+    return;
+
+  // The tree is at most 8 levels deep for any realistic number of boxes,
+  // so that a fixed-size stack is always large enough.
+  uint32_t stack[8 * NodeCapacity];
+  size_t stack_size = 0;
+
+  stack[stack_size++] = static_cast<uint32_t>(m_nodes.size() - 1);
+
+  while (stack_size > 0)
+  {
+    const uint32_t index = stack[--stack_size];
+    const TreeNode& node = m_nodes[index];
+
+    if (!node.bounds.intersects(rect))
+      continue;
+
+    if (index < m_leaf_count)
+    {
+      for (uint32_t i(node.first); i < node.first + node.count; ++i)
+      {
+        const Entry& e = m_entries[m_items[i]];
+
+        if (e.rect.intersects(rect))
+          func(e);
+      }
+    }
+    else
+    {
+      for (uint32_t i(node.first); i < node.first + node.count; ++i)
+        stack[stack_size++] = i;
+    }
+  }
+}
+
+} // namespace tex
+
+#endif // LIBTYPESET_LAYOUTINDEX_H
@@ -13,6 +13,7 @@
 
 #include <cassert>
 #include <type_traits>
+#include <vector>
 
 namespace tex
 {
@@ -366,7 +367,7 @@ struct layout_reader_impl<bool>
 template<typename Reader>
 void read(Reader && reader, const std::shared_ptr<Box> & layout)
 {
-  Pos pos = Pos(0, layout->height());
+  Pos pos = Pos{ 0.f, layout->height() };
   layout_reader_impl< std::result_of_t<Reader(std::shared_ptr<Box>, Pos)> >::read(std::forward<Reader>(reader), layout, pos);
 }
 
@@ -376,6 +377,199 @@ void read(Reader && reader, const std::shared_ptr<Box> & layout, Pos pos)
   layout_reader_impl< std::result_of_t<Reader(std::shared_ptr<Box>, Pos)> >::read(std::forward<Reader>(reader), layout, pos);
 }
 
+class LayoutTraversalStack
+{
+public:
+  struct Frame
+  {
+    const ListBox* box;
+    List::const_iterator current;
+    List::const_iterator end;
+    Pos pos;
+  };
+
+  LayoutTraversalStack() = default;
+  LayoutTraversalStack(const LayoutTraversalStack&) = delete;
+  ~LayoutTraversalStack() = default;
+
+  static const size_t InlineCapacity = 32;
+
+  bool empty() const { return m_size == 0; }
+  size_t size() const { return m_size; }
+
+  Frame& top()
+  {
+    return m_size <= InlineCapacity ? m_inline[m_size - 1] : m_overflow[m_size - InlineCapacity - 1];
+  }
+
+  void push(const ListBox* box, Pos pos)
+  {
+    Frame f{ box, box->list().begin(), box->list().end(), pos };
+
+    if (m_size < InlineCapacity)
+      m_inline[m_size] = f;
+    else if (m_size - InlineCapacity < m_overflow.size())
+      m_overflow[m_size - InlineCapacity] = f;
+    else
+      m_overflow.push_back(f);
+
+    ++m_size;
+  }
+
+  void pop() { --m_size; }
+
+  LayoutTraversalStack& operator=(const LayoutTraversalStack&) = delete;
+
+private:
+  size_t m_size = 0;
+  Frame m_inline[InlineCapacity];
+  std::vector<Frame> m_overflow;
+};
+
+namespace details
+{
+
+template<typename Reader, typename T>
+inline bool traversal_visit(Reader& reader, const T* box, Pos pos, std::true_type /* partial reader */)
+{
+  return reader(box, pos);
+}
+
+template<typename Reader, typename T>
+inline bool traversal_visit(Reader& reader, const T* box, Pos pos, std::false_type /* partial reader */)
+{
+  reader(box, pos);
+  return PartialLayoutReader::Continue;
+}
+
+template<typename Reader, typename Partial>
+inline bool traversal_visit_box(Reader& reader, const Box* box, Pos pos, Partial partial)
+{
+  if (box->is<Rule>())
+    return traversal_visit(reader, static_cast<const Rule*>(box), pos, partial);
+  else if (box->isHBox())
+    return traversal_visit(reader, static_cast<const HBox*>(box), pos, partial);
+  else if (box->isVBox())
+    return traversal_visit(reader, static_cast<const VBox*>(box), pos, partial);
+  else
+    return traversal_visit(reader, box, pos, partial);
+}
+
+template<typename Reader, typename Partial>
+inline void traverse(Reader& reader, const Box* layout, Pos pos, Partial partial)
+{
+  if (traversal_visit_box(reader, layout, pos, partial))
+    return;
+
+  if (!layout->isListBox())
+    return;
+
+  LayoutTraversalStack stack;
+
+  if (layout->isVBox())
+    pos.y -= layout->height();
+
+  stack.push(static_cast<const ListBox*>(layout), pos);
+
+  while (!stack.empty())
+  {
+    LayoutTraversalStack::Frame& frame = stack.top();
+
+    if (frame.current == frame.end)
+    {
+      stack.pop();
+      continue;
+    }
+
+    const Node* node = (frame.current++)->get();
+    const bool horizontal = frame.box->isHBox();
+
+    if (node->isBox())
+    {
+      const Box* box = static_cast<const Box*>(node);
+
+      if (!horizontal)
+        frame.pos.y += box->height();
+
+      if (box->isListBox())
+      {
+        const ListBox* listbox = static_cast<const ListBox*>(box);
+        Pos child_pos = horizontal ? Pos{ frame.pos.x, frame.pos.y + listbox->shiftAmount() } : Pos{ frame.pos.x + listbox->shiftAmount(), frame.pos.y };
+
+        if (traversal_visit_box(reader, box, child_pos, partial))
+          return;
+
+        if (horizontal)
+          frame.pos.x += box->width();
+        else
+          frame.pos.y += box->depth();
+
+        if (listbox->isVBox())
+          child_pos.y -= listbox->height();
+
+        stack.push(listbox, child_pos);
+      }
+      else
+      {
+        if (traversal_visit_box(reader, box, frame.pos, partial))
+          return;
+
+        if (horizontal)
+          frame.pos.x += box->width();
+        else
+          frame.pos.y += box->depth();
+      }
+    }
+    else if (node->is<Kern>())
+    {
+      (horizontal ? frame.pos.x : frame.pos.y) += static_cast<const Kern*>(node)->space();
+    }
+    else if (node->is<Glue>())
+    {
+      const Glue* glue = static_cast<const Glue*>(node);
+      float& coord = horizontal ? frame.pos.x : frame.pos.y;
+
+      coord += glue->space();
+
+      if (frame.box->glueRatio() < 0.f)
+      {
+        if (frame.box->glueOrder() == glue->shrinkOrder())
+          coord += frame.box->glueRatio() * glue->shrink();
+      }
+      else
+      {
+        if (frame.box->glueOrder() == glue->stretchOrder())
+          coord += frame.box->glueRatio() * glue->stretch();
+      }
+    }
+  }
+}
+
+} // namespace details
+
+/*!
+ * \fn void traverse(Reader&& reader, const Box* layout, Pos pos)
+ * \brief Non-recursive equivalent of read()
+ *
+ * The reader is called with raw pointers, i.e. \c{reader(const Box*, Pos)} 
+ * and \c{reader(const Rule*, Pos)}, in the same order and with the same 
+ * positions as read() would. 
+ * If the reader returns a bool, the traversal stops as soon as it returns 
+ * PartialLayoutReader::Done.
+ */
+template<typename Reader>
+void traverse(Reader&& reader, const Box* layout, Pos pos)
+{
+  using Partial = typename std::is_same<std::result_of_t<Reader&(const Box*, Pos)>, bool>::type;
+  details::traverse(reader, layout, pos, Partial{});
+}
+
+template<typename Reader>
+void traverse(Reader&& reader, const Box* layout)
+{
+  traverse(std::forward<Reader>(reader), layout, Pos{ 0.f, layout->height() });
+}
+
 } // namespace tex
 
 #endif // LIBTYPESET_LAYOUTREADER_H
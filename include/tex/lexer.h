@@ -42,19 +42,26 @@ private:
   State m_state;
   std::string m_csbuffer;
   std::vector<Token> m_tokens;
-  
-  // @TODO:
-  // add std::string charbuf in which the control sequence are saved;
-  // use some kind of std::map to avoid duplication of the cs in the charbuf 
-  // as they are likely to be used several time.
-  // the size of charbuf is reserved at construction time & must be large enough
-  // for all the control seq that will be parsed
+
+  static const size_t MaxScanStops = 8;
+
+  struct Classes
+  {
+    CatCodeTable catcodes;
+    std::array<bool, 256> stops;
+    std::array<char, MaxScanStops> scan_stops;
+    size_t scan_stop_count = 0;
+    bool scan = false;
+  };
+
+  Classes m_classes;
 
 public:
 
   Lexer()
   {
    m_state.catcodes = DefaultCatCodes;
+   classify();
   }
 
   ~Lexer() = default;
@@ -70,8 +77,14 @@ public:
   CharCategory category(char c) const { return catcodes().at(static_cast<unsigned char>(c)); }
 
   void write(char c);
+  void write(const char* data, size_t n);
+  void write(const std::string& str) { write(str.data(), str.size()); }
 
 protected:
+  void classify();
+  size_t scan(const char* data, size_t n) const;
+  void produceRun(const char* data, size_t n);
+
   void parseCS(char c, CharCategory cc);
   void parseCOM(char c, CharCategory cc);
   void produce(char c, CharCategory cc);
@@ -139,8 +152,7 @@ inline void Lexer::write(char c)
   {
     if (s == LexerState::StateN)
     {
-      m_csbuffer = "par";
-      produceCSToken();
+      m_tokens.push_back(Token{ ControlSequenceToken{ CsTable::Par } });
     }
     else if (s == LexerState::StateM)
     {
@@ -231,7 +243,7 @@ inline void Lexer::produce(char c, CharCategory cc)
 
 inline void Lexer::produceCSToken()
 {
-  m_tokens.push_back(Token{ m_csbuffer });
+  m_tokens.push_back(Token{ ControlSequenceToken{ CsTable::global().intern(m_csbuffer) } });
 }
 
 inline void Lexer::produceParamToken(char c)
@@ -0,0 +1,138 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_LEXERTHREAD_H
+#define LIBTYPESET_LEXERTHREAD_H
+
+#include "tex/inputsource.h"
+#include "tex/lexer.h"
+#include "tex/spscqueue.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace tex
+{
+
+namespace parsing
+{
+
+/*!
+ * \class LexerThread
+ * \brief runs a Lexer ahead of its consumer on a separate thread
+ *
+ * The lexer thread reads the input line by line and pushes the tokens,
+ * together with the position of their line, into a bounded SpscQueue
+ * from which read() pops them.
+ *
+ * The lines whose tokens may not have been read yet are kept, together
+ * with the state of the lexer at their start, so that the tokens lexed
+ * ahead can be discarded when the catcodes change.
+ * setCatcodes() implements this resynchronization: it parks the lexer
+ * thread, drops the queue, lexes again (with the old catcodes) the line
+ * of the last token that was read to find the first character that was
+ * not part of a read token, and resumes lexing from that character with
+ * the new catcodes.
+ * As in TeX, the character that ends a control word is not part of it
+ * and is therefore lexed with the new catcodes.
+ *
+ * Both threads spin for a short while when the queue is full (or empty)
+ * and then sleep until the other side has made enough room (or pushed a
+ * line of tokens), so that neither of them busy-waits for long when one
+ * is much slower than the other; producerSleeps() and consumerSleeps()
+ * count how many times they did.
+ *
+ * read() and setCatcodes() must be called from a single thread.
+ * Errors of the lexer thread (e.g. an invalid character) are rethrown by
+ * read() once the tokens that precede them have been read.
+ */
+class LIBTYPESET_API LexerThread
+{
+public:
+  LexerThread(std::unique_ptr<InputSource> input, const Lexer::CatCodeTable& catcodes = Lexer::DefaultCatCodes, size_t capacity = DefaultCapacity);
+  LexerThread(const LexerThread&) = delete;
+  ~LexerThread();
+
+  static const size_t DefaultCapacity = 4096;
+
+  struct Item
+  {
+    Token token;
+    uint32_t line = 0;
+    uint32_t column = 0;
+  };
+
+  bool read(Item& item);
+
+  const Lexer::CatCodeTable& catcodes() const { return m_catcodes; }
+  void setCatcodes(const Lexer::CatCodeTable& catcodes);
+
+  size_t producerSleeps() const { return m_producer_sleeps.load(std::memory_order_relaxed); }
+  size_t consumerSleeps() const { return m_consumer_sleeps.load(std::memory_order_relaxed); }
+
+  LexerThread& operator=(const LexerThread&) = delete;
+
+protected:
+  struct Line
+  {
+    size_t offset;
+    size_t size;
+    LexerState state;
+    size_t line;
+    size_t column;
+    uint64_t first_token;
+    uint64_t end_token;
+  };
+
+  void run();
+  bool step();
+  bool readLine();
+  void trim();
+  void resync(const Lexer::CatCodeTable& catcodes);
+  void waitForRoom();
+  void waitForTokens();
+  void wakeProducer();
+  void wakeConsumer();
+
+private:
+  std::unique_ptr<InputSource> m_input;
+  SpscQueue<Item> m_queue;
+  Lexer::CatCodeTable m_catcodes;
+  uint64_t m_read = 0;
+  std::atomic<uint64_t> m_consumed;
+  /* Lexer thread */
+  Lexer m_lexer;
+  std::string m_history;
+  size_t m_history_offset = 0;
+  size_t m_lex_offset = 0;
+  size_t m_line = 0;
+  size_t m_column = 0;
+  std::deque<Line> m_lines;
+  uint64_t m_produced = 0;
+  /* Synchronization */
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::atomic<bool> m_pause;
+  std::atomic<bool> m_stop;
+  std::atomic<bool> m_finished;
+  std::atomic<bool> m_producer_waiting;
+  std::atomic<bool> m_consumer_waiting;
+  std::atomic<size_t> m_producer_sleeps;
+  std::atomic<size_t> m_consumer_sleeps;
+  bool m_parked = false;
+  std::exception_ptr m_error;
+  std::thread m_thread;
+};
+
+} // namespace parsing
+
+} // namespace tex
+
+#endif // LIBTYPESET_LEXERTHREAD_H
@@ -0,0 +1,50 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_MAPPEDFILE_H
+#define LIBTYPESET_MAPPEDFILE_H
+
+#include "tex/defs.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace tex
+{
+
+/*!
+ * \class MappedFile
+ * \brief a read-only memory mapping of a file
+ *
+ * The constructor throws std::runtime_error if the file cannot be opened.
+ */
+class LIBTYPESET_API MappedFile
+{
+public:
+  MappedFile() = default;
+  explicit MappedFile(const std::string& path);
+  MappedFile(const MappedFile&) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  ~MappedFile();
+
+  bool isOpen() const { return m_open; }
+
+  const uint8_t* data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+  void close();
+
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+private:
+  const uint8_t* m_data = nullptr;
+  size_t m_size = 0;
+  bool m_open = false;
+};
+
+} // namespace tex
+
+#endif // LIBTYPESET_MAPPEDFILE_H
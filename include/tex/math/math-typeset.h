@@ -34,6 +34,7 @@ class LIBTYPESET_API MathTypesetter
 private:
   std::shared_ptr<TypesetEngine> m_engine;
   std::array<MathFont, 16> m_fonts;
+  mutable std::array<std::array<ResolvedFontMetrics, 3>, 16> m_metrics;
   int m_relpenalty = 500;
   int m_binoppenalty = 700;
   bool m_insert_penalties = true;
@@ -68,8 +69,11 @@ private:
 
   Font getFont(int fam) const;
   Font getFont(int fam, math::Style style) const;
-  FontMetrics getMetrics(int fam) const;
-  FontMetrics getMetrics(int fam, math::Style style) const;
+  void inheritFonts(const MathTypesetter& parent);
+  static int sizeIndex(math::Style style);
+  void resolveMetrics();
+  const ResolvedFontMetrics& getMetrics(int fam) const;
+  const ResolvedFontMetrics& getMetrics(int fam, math::Style style) const;
 
   template<size_t I>
   float sigma() const;
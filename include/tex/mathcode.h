@@ -20,6 +20,7 @@ private:
 public:
   explicit MathCode(int val);
 
+  int value() const { return m_value; }
   int c() const;
   int f() const;
   int a() const;
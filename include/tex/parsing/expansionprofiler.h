@@ -0,0 +1,106 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_PARSING_EXPANSIONPROFILER_H
+#define LIBTYPESET_PARSING_EXPANSIONPROFILER_H
+
+#include "tex/cstable.h"
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace tex
+{
+
+namespace parsing
+{
+
+/*!
+ * \class ExpansionProfiler
+ * \brief collects statistics about macro expansion
+ *
+ * The Preprocessor reports its events to the profiler when the library is
+ * built with LIBTYPESET_EXPANSION_PROFILER defined (ENABLE_EXPANSION_PROFILER
+ * in CMake); otherwise, no profiling code is compiled in the Preprocessor.
+ *
+ * Each expansion opens an input level that lasts until its tokens have all
+ * been read, as in TeX: a macro that ends the expansion of another one is
+ * therefore not nested inside it.
+ * The tokens read at each level are counted per stack of macros, which
+ * gives the samples of the folded-stack output.
+ */
+class LIBTYPESET_API ExpansionProfiler
+{
+public:
+  ExpansionProfiler();
+
+  struct MacroStats
+  {
+    CsId cs = CsTable::Invalid;
+    size_t invocations = 0;
+    size_t tokens = 0;
+    std::chrono::nanoseconds match_time{ 0 };
+    size_t max_depth = 0;
+  };
+
+  enum Primitive
+  {
+    Csname,
+    Expandafter,
+    Ifbr,
+    PrimitiveCount,
+  };
+
+  void expand(CsId cs, size_t tokens);
+  void insert(size_t tokens);
+  void consume(size_t tokens);
+  void match(CsId cs, std::chrono::nanoseconds time);
+  void primitive(Primitive p);
+
+  size_t depth() const { return m_frames.size(); }
+  size_t maxDepth() const { return m_max_depth; }
+  size_t primitiveCount(Primitive p) const { return m_primitives[p]; }
+
+  const MacroStats* stats(CsId cs) const;
+  std::vector<MacroStats> report() const;
+
+  void writeReport(std::ostream& out) const;
+  void writeFoldedStacks(std::ostream& out) const;
+
+  void clear();
+
+protected:
+  MacroStats& statsOf(CsId cs);
+  size_t child(size_t node, CsId cs);
+
+private:
+  struct Node
+  {
+    CsId cs;
+    size_t parent;
+    size_t samples;
+  };
+
+  struct Frame
+  {
+    size_t node;
+    size_t remaining;
+  };
+
+  std::vector<MacroStats> m_stats;
+  std::vector<Node> m_nodes;
+  std::unordered_map<uint64_t, size_t> m_children;
+  std::vector<Frame> m_frames;
+  size_t m_max_depth = 0;
+  size_t m_primitives[PrimitiveCount];
+};
+
+} // namespace parsing
+
+} // namespace tex
+
+#endif // LIBTYPESET_PARSING_EXPANSIONPROFILER_H
@@ -7,6 +7,12 @@
 
 #include "tex/parsing/preprocessor.h"
 
+#include "tex/lexer.h"
+#include "tex/mappedfile.h"
+#include "tex/mathcode.h"
+
+#include <ostream>
+
 namespace tex
 {
 
@@ -17,6 +23,75 @@ class LIBTYPESET_API Format
 {
 public:
   static std::vector<Macro> parse(const std::string& src);
+  static void dump(const std::string& src, std::ostream& out);
+};
+
+/*!
+ * \class FormatImage
+ * \brief a precompiled format, read from a binary image
+ *
+ * The image holds the macro definitions of a format together with its
+ * catcode and math code tables. It is versioned and laid out so that it
+ * can be used directly from a memory-mapped file: loading it only checks
+ * the header and the bounds of the sections.
+ *
+ * Control sequences are stored as indices into the name table of the image
+ * and interned in the global CsTable only when needed; macros are
+ * materialized the first time they are looked up, through an index of
+ * their names stored in the image.
+ *
+ * The lookup caches are not synchronized: each thread should open its own
+ * image, which is cheap since the pages of the file are shared.
+ */
+class LIBTYPESET_API FormatImage
+{
+public:
+  explicit FormatImage(const std::string& path);
+  explicit FormatImage(std::vector<uint8_t> data);
+  FormatImage(const FormatImage&) = delete;
+  ~FormatImage();
+
+  static const uint32_t Version = 1;
+
+  static void dump(std::ostream& out, const std::vector<Macro>& macros,
+    const Lexer::CatCodeTable& catcodes = Lexer::DefaultCatCodes,
+    const MathCode::Table& mathcodes = MathCode::DefaultTable);
+
+  size_t size() const;
+
+  Lexer::CatCodeTable catcodes() const;
+  MathCode::Table mathcodes() const;
+
+  const Macro* find(CsId cs) const;
+  Macro macro(size_t index) const;
+  std::vector<Macro> macros() const;
+
+  FormatImage& operator=(const FormatImage&) = delete;
+
+protected:
+  struct Header;
+  struct MacroRecord;
+  struct TokenRecord;
+
+  void load(const uint8_t* data, size_t size);
+  size_t lookup(const std::string& name) const;
+  CsId controlSequence(uint32_t name) const;
+  Token token(const TokenRecord& record) const;
+
+private:
+  MappedFile m_file;
+  std::vector<uint8_t> m_buffer;
+  const Header* m_header = nullptr;
+  const uint8_t* m_catcodes = nullptr;
+  const int32_t* m_mathcodes = nullptr;
+  const uint32_t* m_name_offsets = nullptr;
+  const char* m_strings = nullptr;
+  const MacroRecord* m_macro_records = nullptr;
+  const uint32_t* m_index = nullptr;
+  const TokenRecord* m_tokens = nullptr;
+  mutable std::vector<CsId> m_names;
+  mutable std::vector<int32_t> m_lookup;
+  mutable std::vector<std::unique_ptr<Macro>> m_macros;
 };
 
 } // namespace parsing
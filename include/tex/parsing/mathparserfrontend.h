@@ -7,6 +7,7 @@
 
 #include "tex/parsing/mathparser.h"
 
+#include "tex/cstable.h"
 #include "tex/mathcode.h"
 
 namespace tex
@@ -37,12 +38,13 @@ public:
     SCRIPTSCRIPTSTYLE,
   };
 
-  static const std::map<std::string, CS>& csmap();
+  static const CsMap<CS>& csmap();
   static CS cs(const std::string& name);
 
-  static const std::map<std::string, std::pair<int, MathCode>>& symbolsmap();
+  static const CsMap<std::pair<int, MathCode>>& symbolsmap();
 
   void writeControlSequence(CS cs);
+  void writeControlSequence(CsId csname);
   void writeControlSequence(const std::string& csname);
 
   void writeChar(char c);
@@ -7,8 +7,13 @@
 
 #include "tex/tokstream.h"
 
-#include <list>
-#include <map>
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+#include "tex/parsing/expansionprofiler.h"
+#endif
+
+#include <array>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 namespace tex
@@ -17,6 +22,25 @@ namespace tex
 namespace parsing
 {
 
+/*!
+ * \struct TokenSpan
+ * \brief a range of tokens, given by its offset and length in a token list
+ */
+struct TokenSpan
+{
+  uint32_t offset = 0;
+  uint32_t length = 0;
+};
+
+/*!
+ * \class Macro
+ * \brief a macro definition
+ *
+ * The parameter text is compiled on construction into a short program that 
+ * alternates literal runs, which must be matched exactly, and argument slots.
+ * The replacement text is compiled into runs of literal tokens and 
+ * references to the arguments.
+ */
 class LIBTYPESET_API Macro
 {
 public:
@@ -24,13 +48,42 @@ public:
   Macro(const Macro&) = default;
   Macro(Macro&&) = default;
 
-  Macro(std::string cs, std::vector<Token>&& repl);
-  Macro(std::string cs, std::vector<Token>&& param, std::vector<Token>&& repl);
+  Macro(CsId cs, std::vector<Token>&& repl);
+  Macro(CsId cs, std::vector<Token>&& param, std::vector<Token>&& repl);
+  Macro(const std::string& cs, std::vector<Token>&& repl);
+  Macro(const std::string& cs, std::vector<Token>&& param, std::vector<Token>&& repl);
 
+  CsId controlSequenceId() const;
   const std::string& controlSequence() const;
   const std::vector<Token>& parameterText() const;
   const std::vector<Token>& replacementText() const;
 
+  struct Instruction
+  {
+    enum Opcode : uint8_t
+    {
+      MatchLiteral,
+      ReadUndelimited,
+      ReadDelimited,
+    };
+
+    Opcode opcode = MatchLiteral;
+    uint8_t param = 0;
+    uint32_t index = 0;
+    uint32_t count = 0;
+    Token delimiter;
+  };
+
+  struct Segment
+  {
+    int param = -1;
+    uint32_t index = 0;
+    uint32_t count = 0;
+  };
+
+  const std::vector<Instruction>& parameterProgram() const;
+  const std::vector<Segment>& replacementProgram() const;
+
   struct MatchResult
   {
     enum ResultCode
@@ -51,14 +104,131 @@ public:
 
   std::vector<Token> expand(const std::array<std::vector<Token>, 9>& arguments) const;
   void expand(const std::array<std::vector<Token>, 9> & arguments, std::vector<Token>& output, std::vector<Token>::iterator output_it) const;
+  void expand(const std::array<std::vector<Token>, 9>& arguments, TokenInput& input) const;
+
+  template<typename Source>
+  void substitute(const std::array<TokenSpan, 9>& arguments, const Source& source, std::vector<Token>& output) const;
 
   Macro& operator=(const Macro&) = default;
   Macro& operator=(Macro&&) = default;
 
+protected:
+  void compile();
+
 private:
-  std::string m_ctrl_seq;
+  CsId m_ctrl_seq = CsTable::Invalid;
   std::vector<Token> m_param_text;
   std::vector<Token> m_repl_text;
+  std::vector<Instruction> m_param_program;
+  std::vector<Segment> m_repl_program;
+};
+
+/*!
+ * \class MacroMatcher
+ * \brief matches the arguments of a macro against its parameter text
+ *
+ * Tokens are written one at a time, so that a match can be suspended when 
+ * the input runs out and resumed when more tokens are available.
+ * Arguments are not copied: they are recorded as spans whose offsets count 
+ * the tokens written since reset().
+ */
+class LIBTYPESET_API MacroMatcher
+{
+public:
+  MacroMatcher() = default;
+
+  enum Status
+  {
+    NeedMore,
+    Matched,
+    Failed,
+  };
+
+  void reset(const Macro* m);
+  Status write(const Token& tok);
+
+  const Macro* macro() const { return m_macro; }
+  Status status() const { return m_status; }
+  size_t size() const { return m_pos; }
+  const std::array<TokenSpan, 9>& arguments() const { return m_arguments; }
+
+protected:
+  void next();
+
+private:
+  const Macro* m_macro = nullptr;
+  Status m_status = Failed;
+  size_t m_pc = 0;
+  uint32_t m_pos = 0;
+  uint32_t m_start = 0;
+  uint32_t m_progress = 0;
+  int m_depth = 0;
+  std::array<TokenSpan, 9> m_arguments;
+};
+
+class FormatImage;
+
+/*!
+ * \class MacroTable
+ * \brief the macro definitions of a preprocessor, with TeX's grouping rules
+ *
+ * Definitions are stored in a single open-addressing hash table keyed by 
+ * the id of the control sequence, so that lookups do not depend on the 
+ * group nesting.
+ * The first time a macro is (re)defined inside a group, its previous 
+ * definition is pushed on a save stack; endGroup() restores the saved 
+ * definitions, so that entering and leaving a group costs only what was 
+ * redefined inside it.
+ *
+ * A FormatImage can be set as the base level of the table: control 
+ * sequences that are not defined in the table are then looked up in the 
+ * image, so that the macros of a format are only materialized when used.
+ * size() and macros() do not account for the macros of the image.
+ */
+class LIBTYPESET_API MacroTable
+{
+public:
+  MacroTable();
+  MacroTable(const MacroTable&) = delete;
+  MacroTable(MacroTable&&) = default;
+  ~MacroTable();
+
+  const Macro* find(CsId cs) const;
+  void define(Macro m);
+
+  void beginGroup();
+  void endGroup();
+  size_t level() const { return m_groups.size(); }
+
+  size_t size() const { return m_size; }
+  size_t saveStackSize() const { return m_save_stack.size(); }
+  std::vector<const Macro*> macros() const;
+
+  const std::shared_ptr<const FormatImage>& format() const { return m_format; }
+  void setFormat(std::shared_ptr<const FormatImage> image);
+
+  MacroTable& operator=(const MacroTable&) = delete;
+  MacroTable& operator=(MacroTable&&) = default;
+
+protected:
+  struct Slot
+  {
+    CsId cs = CsTable::Invalid;
+    size_t level = 0;
+    std::unique_ptr<Macro> macro;
+  };
+
+  size_t home(CsId cs) const;
+  size_t probe(CsId cs) const;
+  void erase(size_t index);
+  void rehash(size_t capacity);
+
+private:
+  std::vector<Slot> m_slots;
+  size_t m_size = 0;
+  std::vector<Slot> m_save_stack;
+  std::vector<size_t> m_groups;
+  std::shared_ptr<const FormatImage> m_format;
 };
 
 } // namespace parsing
@@ -76,7 +246,7 @@ namespace preprocessor
 
 struct MacroDefinitionData
 {
-  std::string csname;
+  CsId csname = CsTable::Invalid;
   int parameter_index = 1;
   std::vector<Token> parameter_text;
   int brace_nesting = 0;
@@ -85,11 +255,8 @@ struct MacroDefinitionData
 
 struct MacroExpansionData
 {
-  const Macro* def = nullptr;
-  size_t pattern_index = 0;
-  size_t current_arg_index = 0;
-  int current_arg_brace_nesting = 0;
-  std::array<std::vector<Token>, 9> arguments;
+  MacroMatcher matcher;
+  std::vector<Token> tokens;
 };
 
 struct Branching
@@ -116,7 +283,7 @@ class LIBTYPESET_API Preprocessor
 {
 public:
   bool br = false;
-  std::vector<Token> input;
+  TokenInput input;
   std::vector<Token> output;
 
 public:
@@ -125,11 +292,6 @@ public:
   Preprocessor(Preprocessor&&) = delete;
   ~Preprocessor() = default;
 
-  struct Definitions
-  {
-    std::map<std::string, Macro> macros;
-  };
-
   typedef std::array<std::vector<Token>, 9> Arguments;
 
   void beginGroup();
@@ -162,11 +324,6 @@ public:
       RM_ReadingMacroName,
       RM_ReadingMacroParameterText,
       RM_ReadingMacroReplacementText,
-      /* Expanding Macro */
-      EXPM_MatchingMacroParameterText,
-      EXPM_ReadingDelimitedMacroArgument,
-      EXPM_ReadingUndelimitedMacroArgument,
-      EXPM_ReadingBracedDelimitedMacroArgument,
       /* expandafter */
       EXPAFTER_ReadingCs,
       EXPAFTER_ExpandingCs,
@@ -198,10 +355,17 @@ public:
 
   const State& state() const;
 
+  const Macro* find(CsId cs) const;
   const Macro* find(const std::string& cs) const;
   void define(Macro m);
+  void loadFormat(std::shared_ptr<const FormatImage> image);
+
+  const MacroTable& macros() const;
 
-  const std::list<Definitions>& macros() const;
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+  ExpansionProfiler& profiler() { return m_profiler; }
+  const ExpansionProfiler& profiler() const { return m_profiler; }
+#endif // defined(LIBTYPESET_EXPANSION_PROFILER)
 
   Preprocessor& operator=(const Preprocessor&) = delete;
 
@@ -213,14 +377,12 @@ protected:
 
   void process(Token& tok);
 
-  void processControlSeq(const std::string& cs);
+  void processControlSeq(CsId cs);
 
   void readMacro(Token& tok);
 
   void expandMacro(Token& tok);
 
-  void updateExpandMacroState();
-
   void branch(Token& tok);
 
   void formCs(Token& tok);
@@ -228,8 +390,13 @@ protected:
   void expandafter(Token& tok);
 
 private:
-  std::list<Definitions> m_defs;
+  MacroTable m_macros;
   State m_state;
+  MacroMatcher m_matcher;
+  std::vector<Token> m_expansion;
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+  ExpansionProfiler m_profiler;
+#endif // defined(LIBTYPESET_EXPANSION_PROFILER)
 };
 
 } // namespace parsing
@@ -242,26 +409,43 @@ namespace tex
 namespace parsing
 {
 
-inline Macro::Macro(std::string cs, std::vector<Token>&& repl)
-  : m_ctrl_seq(std::move(cs)),
+inline Macro::Macro(CsId cs, std::vector<Token>&& repl)
+  : m_ctrl_seq(cs),
   m_repl_text(std::move(repl))
 {
-
+  compile();
 }
 
-inline Macro::Macro(std::string cs, std::vector<Token>&& param, std::vector<Token>&& repl)
-  : m_ctrl_seq(std::move(cs))
+inline Macro::Macro(CsId cs, std::vector<Token>&& param, std::vector<Token>&& repl)
+  : m_ctrl_seq(cs)
   , m_param_text(std::move(param))
   , m_repl_text(std::move(repl))
 {
+  compile();
+}
+
+inline Macro::Macro(const std::string& cs, std::vector<Token>&& repl)
+  : Macro(CsTable::global().intern(cs), std::move(repl))
+{
 
 }
 
-inline const std::string& Macro::controlSequence() const
+inline Macro::Macro(const std::string& cs, std::vector<Token>&& param, std::vector<Token>&& repl)
+  : Macro(CsTable::global().intern(cs), std::move(param), std::move(repl))
+{
+
+}
+
+inline CsId Macro::controlSequenceId() const
 {
   return m_ctrl_seq;
 }
 
+inline const std::string& Macro::controlSequence() const
+{
+  return CsTable::global().name(m_ctrl_seq);
+}
+
 inline const std::vector<Token>& Macro::parameterText() const
 {
   return m_param_text;
@@ -272,14 +456,50 @@ inline const std::vector<Token>& Macro::replacementText() const
   return m_repl_text;
 }
 
+inline const std::vector<Macro::Instruction>& Macro::parameterProgram() const
+{
+  return m_param_program;
+}
+
+inline const std::vector<Macro::Segment>& Macro::replacementProgram() const
+{
+  return m_repl_program;
+}
+
+/*!
+ * \fn void substitute(const std::array<TokenSpan, 9>& arguments, const Source& source, std::vector<Token>& output) const
+ * \brief appends the expansion of the macro to \a output
+ *
+ * The arguments are spans of \a source, which must be callable with the 
+ * index of a token and return that token.
+ */
+template<typename Source>
+inline void Macro::substitute(const std::array<TokenSpan, 9>& arguments, const Source& source, std::vector<Token>& output) const
+{
+  for (const Segment& seg : m_repl_program)
+  {
+    if (seg.param < 0)
+    {
+      output.insert(output.end(), m_repl_text.begin() + seg.index, m_repl_text.begin() + seg.index + seg.count);
+    }
+    else
+    {
+      const TokenSpan& arg = arguments[seg.param];
+
+      for (uint32_t i(0); i < arg.length; ++i)
+        output.push_back(source(arg.offset + i));
+    }
+  }
+}
+
 inline void Preprocessor::beginGroup()
 {
-  m_defs.push_front(Definitions{});
+  m_macros.beginGroup();
 }
 
 inline void Preprocessor::endGroup()
 {
-  m_defs.pop_front();
+  m_macros.endGroup();
 }
 
 inline void Preprocessor::write(Token t)
@@ -295,9 +515,9 @@ inline const Preprocessor::State& Preprocessor::state() const
   return m_state;
 }
 
-inline const std::list<Preprocessor::Definitions>& Preprocessor::macros() const
+inline const MacroTable& Preprocessor::macros() const
 {
-  return m_defs;
+  return m_macros;
 }
 
 } // namespace parsing
@@ -0,0 +1,101 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_PDFWRITER_H
+#define LIBTYPESET_PDFWRITER_H
+
+#include "tex/glyphrun.h"
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace tex
+{
+
+/*!
+ * \class PdfWriter
+ * \brief streams layouts as a PDF document
+ *
+ * Each page is written, together with its content stream, as soon as 
+ * writePage() is called; only the xref table, the list of pages and the 
+ * font table are kept until finish() writes the document catalog.
+ * One layout unit is one PostScript point.
+ *
+ * Fonts are simple (one byte per glyph) Type1 fonts referenced by name, 
+ * so only the characters 0 to 255 can be written: writePage() throws for 
+ * any other character. The widths of the fonts are taken from the 
+ * character boxes, as well as the bounding box, ascent and descent of 
+ * their font descriptors; the stem width, which font metrics do not 
+ * provide, is estimated.
+ */
+class LIBTYPESET_API PdfWriter
+{
+public:
+  PdfWriter(std::ostream& out, float pageWidth, float pageHeight);
+  PdfWriter(const PdfWriter&) = delete;
+  ~PdfWriter() = default;
+
+  static bool supportsCompression();
+  void setCompression(bool on);
+  bool compression() const { return m_compress; }
+
+  void setFont(Font f, const std::string& basefont, float size, float italicAngle = 0.f);
+
+  void writePage(const Box& page);
+  void writePage(const Box& page, Pos pos);
+
+  size_t pageCount() const { return m_pages.size(); }
+  uint64_t bytesWritten() const { return m_offset; }
+
+  void finish();
+
+  PdfWriter& operator=(const PdfWriter&) = delete;
+
+protected:
+  void writeRun(const GlyphRun& run);
+  void writeFont(size_t index);
+  void writeRule(const Rule& rule, Pos pos);
+
+  void write(const std::string& str);
+  uint32_t newObject();
+  void beginObject(uint32_t obj);
+
+private:
+  friend struct PdfPageWriter;
+
+  struct FontInfo
+  {
+    std::string basefont;
+    float size = 10.f;
+    float italic_angle = 0.f;
+    uint32_t object = 0;
+    bool used_on_page = false;
+    std::array<float, 256> widths;
+    float max_width = 0.f;
+    float max_height = 0.f;
+    float max_depth = 0.f;
+  };
+
+  FontInfo& fontInfo(Font f);
+
+private:
+  std::ostream& m_out;
+  uint64_t m_offset = 0;
+  float m_page_width;
+  float m_page_height;
+  bool m_compress = false;
+  bool m_finished = false;
+  std::vector<uint64_t> m_xref;
+  std::vector<uint32_t> m_pages;
+  std::vector<FontInfo> m_fonts;
+  std::string m_content;
+  GlyphRunBuilder m_builder;
+};
+
+} // namespace tex
+
+#endif // LIBTYPESET_PDFWRITER_H
@@ -0,0 +1,69 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_SFCODETABLE_H
+#define LIBTYPESET_SFCODETABLE_H
+
+#include "tex/unicode.h"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace tex
+{
+
+/*!
+ * \class SfcodeTable
+ * \brief maps characters to their space factor code
+ *
+ * Tables hold few distinct codes, so characters are mapped to a bucket, 
+ * i.e. an index into the list of distinct codes: through a flat array 
+ * for the Basic Multilingual Plane, through a hash table for the rest 
+ * of Unicode. Bucket 0 always holds the code 1000.
+ * Data that depends on the space factor (e.g. the interword glue of a 
+ * font) can then be precomputed per bucket.
+ */
+class LIBTYPESET_API SfcodeTable
+{
+public:
+  SfcodeTable();
+  SfcodeTable(const SfcodeTable&) = default;
+  SfcodeTable(SfcodeTable&&) = default;
+  ~SfcodeTable() = default;
+
+  static const size_t MaxBuckets = 256;
+
+  static const std::shared_ptr<const SfcodeTable>& frenchspacing();
+  static const std::shared_ptr<const SfcodeTable>& nonfrenchspacing();
+
+  int get(Character c) const { return m_values[bucket(c)]; }
+  void set(Character c, int code);
+
+  size_t bucket(Character c) const;
+  size_t bucketCount() const { return m_values.size(); }
+  int value(size_t bucket) const { return m_values[bucket]; }
+
+  SfcodeTable& operator=(const SfcodeTable&) = default;
+  SfcodeTable& operator=(SfcodeTable&&) = default;
+
+private:
+  std::vector<uint8_t> m_bmp;
+  std::unordered_map<Character, uint8_t> m_others;
+  std::vector<int> m_values;
+};
+
+inline size_t SfcodeTable::bucket(Character c) const
+{
+  if (static_cast<unsigned>(c) < 0x10000)
+    return m_bmp[c];
+
+  auto it = m_others.find(c);
+  return it != m_others.end() ? it->second : 0;
+}
+
+} // namespace tex
+
+#endif // LIBTYPESET_SFCODETABLE_H
@@ -0,0 +1,220 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_SFNTFILE_H
+#define LIBTYPESET_SFNTFILE_H
+
+#include "tex/boxmetrics.h"
+#include "tex/fontdimen.h"
+#include "tex/mappedfile.h"
+#include "tex/unicode.h"
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace tex
+{
+
+namespace sfnt
+{
+
+inline constexpr uint32_t tag(char a, char b, char c, char d)
+{
+  return (uint32_t(uint8_t(a)) << 24) | (uint32_t(uint8_t(b)) << 16) | (uint32_t(uint8_t(c)) << 8) | uint32_t(uint8_t(d));
+}
+
+struct GlyphBounds
+{
+  int16_t xMin;
+  int16_t yMin;
+  int16_t xMax;
+  int16_t yMax;
+};
+
+// In the order of the MathConstants table
+enum class MathConstant
+{
+  ScriptPercentScaleDown,
+  ScriptScriptPercentScaleDown,
+  DelimitedSubFormulaMinHeight,
+  DisplayOperatorMinHeight,
+  MathLeading,
+  AxisHeight,
+  AccentBaseHeight,
+  FlattenedAccentBaseHeight,
+  SubscriptShiftDown,
+  SubscriptTopMax,
+  SubscriptBaselineDropMin,
+  SuperscriptShiftUp,
+  SuperscriptShiftUpCramped,
+  SuperscriptBottomMin,
+  SuperscriptBaselineDropMax,
+  SubSuperscriptGapMin,
+  SuperscriptBottomMaxWithSubscript,
+  SpaceAfterScript,
+  UpperLimitGapMin,
+  UpperLimitBaselineRiseMin,
+  LowerLimitGapMin,
+  LowerLimitBaselineDropMin,
+  StackTopShiftUp,
+  StackTopDisplayStyleShiftUp,
+  StackBottomShiftDown,
+  StackBottomDisplayStyleShiftDown,
+  StackGapMin,
+  StackDisplayStyleGapMin,
+  StretchStackTopShiftUp,
+  StretchStackBottomShiftDown,
+  StretchStackGapAboveMin,
+  StretchStackGapBelowMin,
+  FractionNumeratorShiftUp,
+  FractionNumeratorDisplayStyleShiftUp,
+  FractionDenominatorShiftDown,
+  FractionDenominatorDisplayStyleShiftDown,
+  FractionNumeratorGapMin,
+  FractionNumDisplayStyleGapMin,
+  FractionRuleThickness,
+  FractionDenominatorGapMin,
+  FractionDenomDisplayStyleGapMin,
+  SkewedFractionHorizontalGap,
+  SkewedFractionVerticalGap,
+  OverbarVerticalGap,
+  OverbarRuleThickness,
+  OverbarExtraAscender,
+  UnderbarVerticalGap,
+  UnderbarRuleThickness,
+  UnderbarExtraDescender,
+  RadicalVerticalGap,
+  RadicalDisplayStyleVerticalGap,
+  RadicalRuleThickness,
+  RadicalExtraAscender,
+  RadicalKernBeforeDegree,
+  RadicalKernAfterDegree,
+  RadicalDegreeBottomRaisePercent,
+};
+
+} // namespace sfnt
+
+/*!
+ * \class SfntFile
+ * \brief a reader for the metrics of OpenType and TrueType fonts
+ *
+ * Only the tables needed for typesetting are read: \c head, \c hhea,
+ * \c maxp, \c hmtx, \c cmap (formats 4 and 12), \c loca and \c glyf for
+ * the glyph bounds, \c kern (format 0) and the pair adjustments of the
+ * \c GPOS lookups of the \c kern feature, \c OS/2, \c post and the
+ * constants of the \c MATH table.
+ *
+ * Tables are located when the file is loaded and read in place.
+ * The character map and the kerning pairs are indexed on first use,
+ * after which all lookups are done in constant time.
+ * Values are returned in font design units unless a size is given.
+ *
+ * The kerning of a pair comes from the first subtable of the \c kern
+ * lookups, in lookup order, that applies to it; as in shapers, the
+ * \c kern table is ignored when \c GPOS has a \c kern feature.
+ *
+ * Fonts with CFF outlines have no \c glyf table; the ascender and
+ * descender of the font are used as the bounds of all their glyphs.
+ */
+class LIBTYPESET_API SfntFile
+{
+public:
+  explicit SfntFile(const std::string& path);
+  SfntFile(const uint8_t* data, size_t size);
+  SfntFile(const SfntFile&) = delete;
+  ~SfntFile();
+
+  const uint8_t* data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+  bool hasTable(uint32_t tag) const;
+
+  int unitsPerEm() const { return m_units_per_em; }
+  int ascender() const { return m_ascender; }
+  int descender() const { return m_descender; }
+  int xHeight() const { return m_x_height; }
+  float italicAngle() const { return m_italic_angle; }
+  size_t glyphCount() const { return m_glyph_count; }
+
+  uint16_t glyphIndex(Character c) const;
+  int advance(uint16_t glyph) const;
+  sfnt::GlyphBounds bounds(uint16_t glyph) const;
+  int kerning(uint16_t left, uint16_t right) const;
+
+  bool hasMath() const { return m_math_constants != 0; }
+  int mathConstant(sfnt::MathConstant c) const;
+
+  BoxMetrics metrics(Character c, float size) const;
+  float kerning(Character left, Character right, float size) const;
+  FontDimen fontdimen(float size) const;
+
+  SfntFile& operator=(const SfntFile&) = delete;
+
+protected:
+  struct Table
+  {
+    uint32_t tag;
+    uint32_t offset;
+    uint32_t length;
+  };
+
+  struct PairKerning
+  {
+    int16_t value;
+    size_t subtable;
+  };
+
+  struct ClassKerning
+  {
+    size_t subtable;
+    std::vector<uint16_t> first_classes;
+    std::vector<uint16_t> second_classes;
+    uint16_t class2_count;
+    std::vector<int16_t> values;
+  };
+
+  void load(const uint8_t* data, size_t size);
+  const Table* table(uint32_t tag) const;
+
+  void buildCharacterMap() const;
+  void readCmap4(size_t offset) const;
+  void readCmap12(size_t offset) const;
+
+  void buildKerning() const;
+  void readKernTable() const;
+  bool readGposTable() const;
+  void readPairPos(size_t offset, size_t subtable) const;
+
+private:
+  MappedFile m_file;
+  const uint8_t* m_data = nullptr;
+  size_t m_size = 0;
+  std::vector<Table> m_tables;
+  int m_units_per_em = 1000;
+  int m_ascender = 0;
+  int m_descender = 0;
+  int m_x_height = 0;
+  float m_italic_angle = 0.f;
+  size_t m_glyph_count = 0;
+  size_t m_hmetrics_count = 0;
+  size_t m_hmtx = 0;
+  size_t m_loca = 0;
+  bool m_long_loca = false;
+  size_t m_glyf = 0;
+  size_t m_glyf_length = 0;
+  size_t m_math_constants = 0;
+
+  mutable std::once_flag m_cmap_flag;
+  mutable std::vector<uint16_t> m_bmp;
+  mutable std::unordered_map<Character, uint16_t> m_supplementary;
+
+  mutable std::once_flag m_kerning_flag;
+  mutable std::unordered_map<uint32_t, PairKerning> m_pair_kerning;
+  mutable std::vector<ClassKerning> m_class_kerning;
+};
+
+} // namespace tex
+
+#endif // LIBTYPESET_SFNTFILE_H
@@ -0,0 +1,136 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_SPSCQUEUE_H
+#define LIBTYPESET_SPSCQUEUE_H
+
+#include "tex/defs.h"
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+namespace tex
+{
+
+/*!
+ * \class SpscQueue
+ * \brief a bounded lock-free queue with a single producer and a single consumer
+ *
+ * The elements are stored in a ring buffer whose capacity is a power of 2.
+ * Each side owns one index and only reads the other one, with
+ * acquire/release ordering; a copy of the other index is cached so that
+ * the shared cache line is only read when the queue looks full (or empty).
+ * Neither push() nor pop() ever blocks.
+ */
+template<typename T>
+class SpscQueue
+{
+public:
+  explicit SpscQueue(size_t capacity);
+  SpscQueue(const SpscQueue&) = delete;
+
+  size_t capacity() const { return m_buffer.size(); }
+  size_t size() const;
+  bool empty() const { return size() == 0; }
+
+  bool push(const T& value);
+  bool pop(T& value);
+
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+private:
+  std::vector<T> m_buffer;
+  size_t m_mask;
+  // written by the consumer
+  alignas(64) std::atomic<size_t> m_head;
+  size_t m_cached_tail = 0;
+  // written by the producer
+  alignas(64) std::atomic<size_t> m_tail;
+  size_t m_cached_head = 0;
+};
+
+template<typename T>
+inline SpscQueue<T>::SpscQueue(size_t capacity)
+  : m_head(0),
+    m_tail(0)
+{
+  if (capacity == 0)
+    throw std::runtime_error{ "SpscQueue: capacity must be positive" };
+
+  size_t size = 1;
+
+  while (size < capacity)
+    size *= 2;
+
+  m_buffer.resize(size);
+  m_mask = size - 1;
+}
+
+/*!
+ * \fn size_t size() const
+ * \brief returns the number of values in the queue
+ *
+ * The result is only a snapshot if the other side is using the queue.
+ */
+template<typename T>
+inline size_t SpscQueue<T>::size() const
+{
+  const size_t head = m_head.load(std::memory_order_acquire);
+  const size_t tail = m_tail.load(std::memory_order_acquire);
+  return tail - head;
+}
+
+/*!
+ * \fn bool push(const T& value)
+ * \brief appends a value, returns false if the queue is full
+ *
+ * Must only be called by the producer.
+ */
+template<typename T>
+inline bool SpscQueue<T>::push(const T& value)
+{
+  const size_t tail = m_tail.load(std::memory_order_relaxed);
+
+  if (tail - m_cached_head == m_buffer.size())
+  {
+    m_cached_head = m_head.load(std::memory_order_acquire);
+
+    if (tail - m_cached_head == m_buffer.size())
+      return false;
+  }
+
+  m_buffer[tail & m_mask] = value;
+  m_tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+/*!
+ * \fn bool pop(T& value)
+ * \brief removes the oldest value, returns false if the queue is empty
+ *
+ * Must only be called by the consumer.
+ */
+template<typename T>
+inline bool SpscQueue<T>::pop(T& value)
+{
+  const size_t head = m_head.load(std::memory_order_relaxed);
+
+  if (head == m_cached_tail)
+  {
+    m_cached_tail = m_tail.load(std::memory_order_acquire);
+
+    if (head == m_cached_tail)
+      return false;
+  }
+
+  value = m_buffer[head & m_mask];
+  m_head.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+} // namespace tex
+
+#endif // LIBTYPESET_SPSCQUEUE_H
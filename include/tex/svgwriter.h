@@ -0,0 +1,76 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_SVGWRITER_H
+#define LIBTYPESET_SVGWRITER_H
+
+#include "tex/glyphrun.h"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace tex
+{
+
+/*!
+ * \class SvgWriter
+ * \brief streams layouts as an SVG document
+ *
+ * Pages are stacked vertically and written as soon as writePage() is called;
+ * nothing but the font table is kept from one page to the next.
+ * Glyph runs are written as \c{<text>} elements and rules as \c{<rect>} 
+ * elements. Each font gets a CSS class that is declared the first time 
+ * the font is used.
+ * Font codes below 0x20, which XML does not allow, are written in the 
+ * private use area at U+F000 + code.
+ */
+class LIBTYPESET_API SvgWriter
+{
+public:
+  SvgWriter(std::ostream& out, float pageWidth, float pageHeight, size_t pageCount = 1);
+  SvgWriter(const SvgWriter&) = delete;
+  ~SvgWriter() = default;
+
+  void setFont(Font f, const std::string& family, float size);
+
+  void writePage(const Box& page);
+  void writePage(const Box& page, Pos pos);
+
+  size_t pageCount() const { return m_page_count; }
+
+  void finish();
+
+  SvgWriter& operator=(const SvgWriter&) = delete;
+
+protected:
+  void writeFont(Font f);
+  void writeRun(const GlyphRun& run);
+  void writeRule(const Rule& rule, Pos pos);
+
+private:
+  friend struct SvgPageWriter;
+
+  struct FontInfo
+  {
+    std::string family;
+    float size = 10.f;
+    bool written = false;
+  };
+
+  FontInfo& fontInfo(Font f);
+
+private:
+  std::ostream& m_out;
+  float m_page_width;
+  float m_page_height;
+  size_t m_page_count = 0;
+  bool m_finished = false;
+  std::vector<FontInfo> m_fonts;
+  GlyphRunBuilder m_builder;
+};
+
+} // namespace tex
+
+#endif // LIBTYPESET_SVGWRITER_H
@@ -5,11 +5,12 @@
 #ifndef LIBTYPESET_TOKEN_H
 #define LIBTYPESET_TOKEN_H
 
-#include "tex/defs.h"
+#include "tex/cstable.h"
 
 #include <array>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 
 namespace tex
 {
@@ -17,7 +18,7 @@ namespace tex
 namespace parsing
 {
 
-enum class CharCategory {
+enum class CharCategory : uint8_t {
   Escape = 0,
   GroupBegin = 1,
   GroupEnd = 2,
@@ -36,7 +37,7 @@ enum class CharCategory {
   Invalid = 15,
 };
 
-enum class TokenType {
+enum class TokenType : uint8_t {
   CharacterToken,
   ControlSequenceToken,
   ParameterToken,
@@ -58,36 +59,39 @@ inline bool operator!=(const CharacterToken& lhs, const CharacterToken& rhs)
   return !(lhs == rhs);
 }
 
+struct ControlSequenceToken
+{
+  CsId id = CsTable::Invalid;
+};
+
+/*!
+ * \class Token
+ * \brief a character, control sequence or parameter token
+ *
+ * Control sequences are stored as their id in the global CsTable, 
+ * which makes tokens trivially copyable 8-byte values.
+ */
 class LIBTYPESET_API Token
 {
 private:
 
-  // C++17: use std::variant
   union Data
   {
     CharacterToken character_token;
-    std::string control_sequence;
+    CsId control_sequence;
     int parameter_number;
 
-    Data() { new (&character_token) CharacterToken;  }
-    ~Data() { }
+    Data() : character_token() { }
   };
 
-  TokenType m_type = TokenType::CharacterToken;
   Data m_data;
-  
-  // TODO: avoid std::string, use string_view
-  // 3 fields: string_view & TokenType & CharCategory
-  // if tokentype is chartok or paramtok, string_view size is 1
-  // use the constexpr char literal "123456789" & "abcdefghij" (all ascii chars)
+  TokenType m_type = TokenType::CharacterToken;
 
 public:
   Token() = default;
-  Token(const Token& other);
-  Token(Token&& other);
-  ~Token();
 
   Token(const CharacterToken& ctok);
+  Token(const ControlSequenceToken& cstok);
   explicit Token(const std::string& cseq);
   explicit Token(int param_num);
 
@@ -97,77 +101,31 @@ public:
   bool isParameterToken() const { return type() == TokenType::ParameterToken; }
 
   const CharacterToken& characterToken() const;
+  CsId controlSequenceId() const;
   const std::string& controlSequence() const;
   int parameterNumber() const;
 
-  Token& operator=(const Token& other);
-  Token& operator=(Token&& other);
-
   bool operator==(CharCategory cc) const;
   bool operator!=(CharCategory cc) const;
+  bool operator==(CsTable::Builtin cs) const;
+  bool operator!=(CsTable::Builtin cs) const;
 };
 
-inline Token::~Token()
-{
-  if (isControlSequence())
-  {
-    using Str = std::string;
-    (&m_data.control_sequence)->~Str();
-  }
-  else if(isCharacterToken())
-  {
-    (&m_data.character_token)->~CharacterToken();
-  }
-}
-
-inline Token::Token(const Token& other)
-{
-  if (other.isControlSequence())
-  {
-    m_type = TokenType::ControlSequenceToken;
-    (&m_data.character_token)->~CharacterToken();
-    new (&m_data.control_sequence) std::string(other.controlSequence());
-  }
-  else if (other.isParameterToken())
-  {
-    m_type = TokenType::ParameterToken;
-    m_data.parameter_number = other.parameterNumber();
-  }
-  else
-  {
-    m_data.character_token = other.characterToken();
-  }
-}
-
-inline Token::Token(Token&& other)
+inline Token::Token(const CharacterToken& ctok)
 {
-  if (other.isControlSequence())
-  {
-    m_type = TokenType::ControlSequenceToken;
-    (&m_data.character_token)->~CharacterToken();
-    new (&m_data.control_sequence) std::string(std::move(other.m_data.control_sequence));
-  }
-  else if (other.isParameterToken())
-  {
-    m_type = TokenType::ParameterToken;
-    m_data.parameter_number = other.parameterNumber();
-  }
-  else
-  {
-    m_data.character_token = other.characterToken();
-  }
+  m_data.character_token = ctok;
 }
 
-inline Token::Token(const CharacterToken& ctok)
+inline Token::Token(const ControlSequenceToken& cstok)
+  : m_type(TokenType::ControlSequenceToken)
 {
-  m_data.character_token = ctok;
+  m_data.control_sequence = cstok.id;
 }
 
 inline Token::Token(const std::string& cseq)
-  : m_type(TokenType::ControlSequenceToken)
+  : Token(ControlSequenceToken{ CsTable::global().intern(cseq) })
 {
-  (&m_data.character_token)->~CharacterToken();
-  new (&m_data.control_sequence) std::string(cseq);
+
 }
 
 inline Token::Token(int param_num)
@@ -181,174 +139,46 @@ inline const CharacterToken& Token::characterToken() const
   return m_data.character_token;
 }
 
-inline const std::string& Token::controlSequence() const
+inline CsId Token::controlSequenceId() const
 {
   return m_data.control_sequence;
 }
 
+inline const std::string& Token::controlSequence() const
+{
+  return CsTable::global().name(m_data.control_sequence);
+}
+
 inline int Token::parameterNumber() const
 {
   return m_data.parameter_number;
 }
 
-
-inline Token& Token::operator=(const Token& other)
+inline bool Token::operator==(CharCategory cc) const
 {
-  if (isControlSequence())
-  {
-    if (other.isControlSequence())
-    {
-      m_data.control_sequence = other.controlSequence();
-    }
-    else 
-    {
-      using Str = std::string;
-      (&m_data.control_sequence)->~Str();
-
-      if (other.isParameterToken())
-      {
-        m_data.parameter_number = other.parameterNumber();
-        m_type = TokenType::ParameterToken;
-      }
-      else
-      {
-        new (&m_data.character_token) CharacterToken(other.characterToken());
-        m_type = TokenType::CharacterToken;
-      }
-    }
-  }
-  else if (isParameterToken())
-  {
-    if (other.isParameterToken())
-    {
-      m_data.parameter_number = other.parameterNumber();
-    }
-    else
-    {
-      if (other.isControlSequence())
-      {
-        new (&m_data.control_sequence) std::string(other.controlSequence());
-        m_type = TokenType::ControlSequenceToken;
-      }
-      else
-      {
-        new (&m_data.character_token) CharacterToken(other.characterToken());
-        m_type = TokenType::CharacterToken;
-      }
-    }
-  }
-  else
-  {
-    if (other.isCharacterToken())
-    {
-      m_data.character_token = other.characterToken();
-    }
-    else
-    {
-      (&m_data.character_token)->~CharacterToken();
-
-      if (other.isControlSequence())
-      {
-        new (&m_data.control_sequence) std::string(other.controlSequence());
-        m_type = TokenType::ControlSequenceToken;
-      }
-      else
-      {
-        m_data.parameter_number = other.parameterNumber();
-        m_type = TokenType::ParameterToken;
-      }
-    }
-  }
-
-  return *this;
+  return isCharacterToken() && characterToken().category == cc;
 }
 
-inline Token& Token::operator=(Token&& other)
+inline bool Token::operator!=(CharCategory cc) const
 {
-  if (isControlSequence())
-  {
-    if (other.isControlSequence())
-    {
-      m_data.control_sequence = std::move(other.m_data.control_sequence);
-    }
-    else
-    {
-      using Str = std::string;
-      (&m_data.control_sequence)->~Str();
-
-      if (other.isParameterToken())
-      {
-        m_data.parameter_number = other.parameterNumber();
-        m_type = TokenType::ParameterToken;
-      }
-      else
-      {
-        new (&m_data.character_token) CharacterToken(other.characterToken());
-        m_type = TokenType::CharacterToken;
-      }
-    }
-  }
-  else if (isParameterToken())
-  {
-    if (other.isParameterToken())
-    {
-      m_data.parameter_number = other.parameterNumber();
-    }
-    else
-    {
-      if (other.isControlSequence())
-      {
-        new (&m_data.control_sequence) std::string(std::move(other.m_data.control_sequence));
-        m_type = TokenType::ControlSequenceToken;
-      }
-      else
-      {
-        new (&m_data.character_token) CharacterToken(other.characterToken());
-        m_type = TokenType::CharacterToken;
-      }
-    }
-  }
-  else
-  {
-    if (other.isCharacterToken())
-    {
-      m_data.character_token = other.characterToken();
-    }
-    else
-    {
-      (&m_data.character_token)->~CharacterToken();
-
-      if (other.isControlSequence())
-      {
-        new (&m_data.control_sequence) std::string(std::move(other.m_data.control_sequence));
-        m_type = TokenType::ControlSequenceToken;
-      }
-      else
-      {
-        m_data.parameter_number = other.parameterNumber();
-        m_type = TokenType::ParameterToken;
-      }
-    }
-  }
-
-  return *this;
+  return !(*this == cc);
 }
 
-inline bool Token::operator==(CharCategory cc) const
+inline bool Token::operator==(CsTable::Builtin cs) const
 {
-  return isCharacterToken() && characterToken().category == cc;
+  return isControlSequence() && controlSequenceId() == cs;
 }
 
-inline bool Token::operator!=(CharCategory cc) const
+inline bool Token::operator!=(CsTable::Builtin cs) const
 {
-  return !(*this == cc);
+  return !(*this == cs);
 }
 
 inline bool operator==(const Token& lhs, const Token& rhs)
 {
   return lhs.type() == rhs.type()
     && (lhs.type() == TokenType::CharacterToken ? lhs.characterToken() == rhs.characterToken() : true)
-    && (lhs.type() == TokenType::ControlSequenceToken ? lhs.controlSequence() == rhs.controlSequence() : true)
+    && (lhs.type() == TokenType::ControlSequenceToken ? lhs.controlSequenceId() == rhs.controlSequenceId() : true)
     && (lhs.type() == TokenType::ParameterToken ? lhs.parameterNumber() == rhs.parameterNumber() : true);
 }
 
@@ -357,6 +187,9 @@ inline bool operator!=(const Token& lhs, const Token& rhs)
   return !(lhs == rhs);
 }
 
+static_assert(sizeof(Token) == 8, "Token should be 8 bytes");
+static_assert(std::is_trivially_copyable<Token>::value, "Token should be trivially copyable");
+
 } // namespace parsing
 
 } // namespace tex
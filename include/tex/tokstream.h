@@ -7,6 +7,7 @@
 
 #include "tex/token.h"
 
+#include <iterator>
 #include <vector>
 
 namespace tex
@@ -47,6 +48,110 @@ inline void write(Token&& tok, std::vector<Token>& out)
   out.push_back(std::move(tok));
 }
 
+/*!
+ * \class TokenInput
+ * \brief a list of pending tokens that can be extended at both ends
+ *
+ * As with TeX's input stack, the tokens inserted at the front (e.g. the 
+ * expansion of a macro) are read before the rest of the input.
+ * They are kept in reverse order at the back of a vector, while tokens 
+ * appended at the end are queued in another one; inserting a list of 
+ * tokens is linear in its size and reading a token takes constant time, 
+ * independently of the number of pending tokens.
+ */
+class TokenInput
+{
+public:
+  TokenInput() = default;
+
+  bool empty() const { return m_stack.empty() && m_head == m_queue.size(); }
+  size_t size() const { return m_stack.size() + (m_queue.size() - m_head); }
+
+  const Token& front() const;
+  const Token& peek(size_t n) const;
+  Token read();
+  void discard(size_t n);
+
+  void push_back(const Token& tok);
+  void push_front(const Token& tok);
+
+  template<typename Iterator>
+  void push_front(Iterator begin, Iterator end);
+
+  void clear();
+
+private:
+  std::vector<Token> m_stack;
+  std::vector<Token> m_queue;
+  size_t m_head = 0;
+};
+
+inline const Token& TokenInput::front() const
+{
+  return m_stack.empty() ? m_queue[m_head] : m_stack.back();
+}
+
+inline const Token& TokenInput::peek(size_t n) const
+{
+  return n < m_stack.size() ? m_stack[m_stack.size() - 1 - n] : m_queue[m_head + n - m_stack.size()];
+}
+
+inline Token TokenInput::read()
+{
+  if (!m_stack.empty())
+  {
+    Token t = m_stack.back();
+    m_stack.pop_back();
+    return t;
+  }
+
+  Token t = m_queue[m_head++];
+
+  if (m_head == m_queue.size())
+  {
+    m_queue.clear();
+    m_head = 0;
+  }
+
+  return t;
+}
+
+inline void TokenInput::discard(size_t n)
+{
+  const size_t k = n < m_stack.size() ? n : m_stack.size();
+  m_stack.resize(m_stack.size() - k);
+  m_head += n - k;
+
+  if (m_head == m_queue.size())
+  {
+    m_queue.clear();
+    m_head = 0;
+  }
+}
+
+inline void TokenInput::push_back(const Token& tok)
+{
+  m_queue.push_back(tok);
+}
+
+inline void TokenInput::push_front(const Token& tok)
+{
+  m_stack.push_back(tok);
+}
+
+template<typename Iterator>
+inline void TokenInput::push_front(Iterator begin, Iterator end)
+{
+  m_stack.insert(m_stack.end(), std::reverse_iterator<Iterator>(end), std::reverse_iterator<Iterator>(begin));
+}
+
+inline void TokenInput::clear()
+{
+  m_stack.clear();
+  m_queue.clear();
+  m_head = 0;
+}
+
 } // namespace parsing
 
 } // namespace tex
@@ -16,6 +16,9 @@ namespace math
 class Style;
 } // namespace math
 
+class DelimiterBuilder;
+class GlyphMetricsCache;
+
 class LIBTYPESET_API TypesetEngine
 {
 public:
@@ -25,13 +28,30 @@ public:
   virtual std::shared_ptr<tex::FontMetricsProvider> metrics() const = 0;
 
   virtual std::shared_ptr<tex::Box> typeset(tex::Character c, tex::Font font) = 0;
+  virtual std::shared_ptr<tex::Box> typeset(tex::Character c, tex::Font font, const BoxMetrics& metrics);
   virtual std::shared_ptr<tex::Box> typeset(const std::string& text, tex::Font font) = 0;
   virtual std::shared_ptr<tex::Box> typeset(const std::shared_ptr<tex::Symbol> & symbol, tex::Font font) = 0;
   virtual std::shared_ptr<tex::Box> typesetRadicalSign(float minTotalHeight) = 0;
   virtual std::shared_ptr<tex::Box> typesetDelimiter(const std::shared_ptr<tex::Symbol> & symbol, float minTotalHeight) = 0;
   virtual std::shared_ptr<tex::Box> typesetLargeOp(const std::shared_ptr<tex::Symbol> & symbol) = 0;
 
+  std::shared_ptr<tex::Box> characterBox(tex::Character c, tex::Font font);
+
+  const std::shared_ptr<GlyphMetricsCache>& glyphMetrics();
+  void invalidateGlyphMetrics();
+  void invalidateGlyphMetrics(Font font);
+
+  const std::shared_ptr<DelimiterBuilder>& delimiters();
+
   FontMetricsProvider & operator=(const FontMetricsProvider &) = delete;
+
+protected:
+  void setCustomCharacterBoxes(bool on);
+
+private:
+  bool m_custom_character_boxes = false;
+  std::shared_ptr<GlyphMetricsCache> m_glyph_metrics;
+  std::shared_ptr<DelimiterBuilder> m_delimiters;
 };
 
 class LIBTYPESET_API Options
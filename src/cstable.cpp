@@ -0,0 +1,90 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/cstable.h"
+
+namespace tex
+{
+
+namespace parsing
+{
+
+const CsId CsTable::Invalid;
+const size_t CsTable::SegmentSize;
+const size_t CsTable::MaxSegments;
+
+CsTable::CsTable()
+  : m_size(0)
+{
+  for (std::atomic<Segment*>& s : m_segments)
+    s.store(nullptr, std::memory_order_relaxed);
+
+  // In the order of CsTable::Builtin
+  for (const char* name : { "par", "def", "csname", "endcsname", "expandafter", "ifbr", "else", "fi" })
+    intern(name);
+}
+
+CsTable::~CsTable()
+{
+  for (std::atomic<Segment*>& s : m_segments)
+    delete s.load(std::memory_order_relaxed);
+}
+
+CsTable& CsTable::global()
+{
+  static CsTable instance;
+  return instance;
+}
+
+/*!
+ * \fn CsId intern(const std::string& name)
+ * \brief returns the id of a control sequence, attributing one if needed
+ */
+CsId CsTable::intern(const std::string& name)
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  auto it = m_ids.find(name);
+
+  if (it != m_ids.end())
+    return it->second;
+
+  const size_t id = m_size.load(std::memory_order_relaxed);
+
+  if (id >= SegmentSize * MaxSegments)
+    throw std::runtime_error{ "CsTable::intern(): too many control sequences" };
+
+  std::atomic<Segment*>& slot = m_segments[id / SegmentSize];
+  Segment* segment = slot.load(std::memory_order_relaxed);
+
+  if (segment == nullptr)
+  {
+    segment = new Segment;
+    slot.store(segment, std::memory_order_release);
+  }
+
+  segment->names[id % SegmentSize] = name;
+
+  // the name must be visible before its id
+  m_size.store(id + 1, std::memory_order_release);
+
+  m_ids[name] = static_cast<CsId>(id);
+  return static_cast<CsId>(id);
+}
+
+/*!
+ * \fn CsId find(const std::string& name) const
+ * \brief returns the id of a control sequence, or Invalid if it was never interned
+ */
+CsId CsTable::find(const std::string& name) const
+{
+  std::lock_guard<std::mutex> lock{ m_mutex };
+
+  auto it = m_ids.find(name);
+  return it != m_ids.end() ? it->second : Invalid;
+}
+
+} // namespace parsing
+
+} // namespace tex
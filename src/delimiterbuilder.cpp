@@ -0,0 +1,217 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/delimiterbuilder.h"
+
+#include "tex/glyphmetricscache.h"
+#include "tex/hbox.h"
+#include "tex/typeset.h"
+#include "tex/vbox.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace tex
+{
+
+bool DelimiterBuilder::Key::operator==(const Key& other) const
+{
+  return small_font == other.small_font && small_char == other.small_char
+    && large_font == other.large_font && large_char == other.large_char
+    && height == other.height;
+}
+
+size_t DelimiterBuilder::KeyHash::operator()(const Key& k) const
+{
+  size_t h = static_cast<uint32_t>(k.height);
+  h = h * 31 + static_cast<uint32_t>(k.small_char);
+  h = h * 31 + static_cast<uint32_t>(k.small_font);
+  h = h * 31 + static_cast<uint32_t>(k.large_char);
+  h = h * 31 + static_cast<uint32_t>(k.large_font);
+  return h;
+}
+
+DelimiterBuilder::DelimiterBuilder(TypesetEngine& engine)
+  : m_engine(engine),
+    m_quantum(1.f / 16.f)
+{
+
+}
+
+DelimiterBuilder::~DelimiterBuilder()
+{
+
+}
+
+/*!
+ * \fn void setQuantum(float q)
+ * \brief sets the granularity of the heights of cached delimiters
+ *
+ * Requested heights are rounded up to a multiple of \a q, so a delimiter 
+ * is never shorter than requested. This clears the cache.
+ */
+void DelimiterBuilder::setQuantum(float q)
+{
+  if (!(q > 0.f))
+    throw std::runtime_error{ "DelimiterBuilder::setQuantum(): quantum must be positive" };
+
+  m_quantum = q;
+  clear();
+}
+
+/*!
+ * \fn std::shared_ptr<Box> build(Variant small, Variant large, float minTotalHeight)
+ * \brief returns a delimiter whose total height is at least \a minTotalHeight
+ *
+ * Variants with a negative font are ignored. If no variant is tall enough, 
+ * the tallest one is used; if there is none, an empty box is returned.
+ */
+std::shared_ptr<Box> DelimiterBuilder::build(Variant small, Variant large, float minTotalHeight)
+{
+  const float steps = std::ceil(minTotalHeight / m_quantum);
+  const int32_t height = steps <= 0.f ? 0 : steps >= float(INT32_MAX) ? INT32_MAX : static_cast<int32_t>(steps);
+
+  const Key key{ small.font.id(), small.character, large.font.id(), large.character, height };
+
+  auto it = m_cache.find(key);
+
+  if (it != m_cache.end())
+    return it->second;
+
+  std::shared_ptr<Box> result = search(small, large, height * m_quantum);
+  m_cache.emplace(key, result);
+  return result;
+}
+
+std::shared_ptr<Box> DelimiterBuilder::build(Variant v, float minTotalHeight)
+{
+  return build(v, Variant{ Font(-1), 0 }, minTotalHeight);
+}
+
+void DelimiterBuilder::clear()
+{
+  m_cache.clear();
+}
+
+// Based on TeX's var_delimiter (§706)
+std::shared_ptr<Box> DelimiterBuilder::search(Variant small, Variant large, float minTotalHeight)
+{
+  GlyphMetricsCache& metrics = *m_engine.glyphMetrics();
+
+  Font best_font{ -1 };
+  Character best_char = 0;
+  float best_total = -1.f;
+
+  for (const Variant& v : { small, large })
+  {
+    if (v.font.id() < 0)
+      continue;
+
+    Character c = v.character;
+
+    // A successor chain has at most 256 elements; guards against cycles
+    for (int n(0); n < 256 && c >= 0 && metrics.hasChar(v.font, c); ++n)
+    {
+      ExtensibleRecipe recipe;
+
+      if (metrics.extensible(v.font, c, recipe))
+        return extensible(v.font, recipe, minTotalHeight);
+
+      const BoxMetrics& m = metrics.glyph(c, v.font);
+      const float total = m.height + m.depth;
+
+      if (total > best_total)
+      {
+        best_font = v.font;
+        best_char = c;
+        best_total = total;
+      }
+
+      if (total >= minTotalHeight)
+        return glyph(c, v.font);
+
+      c = metrics.successor(v.font, c);
+    }
+  }
+
+  if (best_font.id() < 0)
+    return tex::hbox({});
+
+  return glyph(best_char, best_font);
+}
+
+// Based on TeX's §713: pieces are stacked from top to bottom, 
+// repeating the extender until the desired height is reached.
+std::shared_ptr<Box> DelimiterBuilder::extensible(Font font, const ExtensibleRecipe& recipe, float minTotalHeight)
+{
+  GlyphMetricsCache& metrics = *m_engine.glyphMetrics();
+
+  auto total_height = [&metrics, font](Character c) -> float {
+    const BoxMetrics& m = metrics.glyph(c, font);
+    return m.height + m.depth;
+  };
+
+  const float u = total_height(recipe.rep);
+  float w = 0.f;
+
+  if (recipe.top != 0)
+    w += total_height(recipe.top);
+  if (recipe.mid != 0)
+    w += total_height(recipe.mid);
+  if (recipe.bot != 0)
+    w += total_height(recipe.bot);
+
+  int n = 0;
+
+  if (u > 0.f)
+  {
+    while (w < minTotalHeight)
+    {
+      w += u;
+      ++n;
+
+      if (recipe.mid != 0)
+        w += u;
+    }
+  }
+
+  List list;
+
+  if (recipe.top != 0)
+    list.push_back(glyph(recipe.top, font));
+
+  for (int i(0); i < n; ++i)
+    list.push_back(glyph(recipe.rep, font));
+
+  if (recipe.mid != 0)
+  {
+    list.push_back(glyph(recipe.mid, font));
+
+    for (int i(0); i < n; ++i)
+      list.push_back(glyph(recipe.rep, font));
+  }
+
+  if (recipe.bot != 0)
+    list.push_back(glyph(recipe.bot, font));
+
+  if (list.empty())
+    return tex::hbox({});
+
+  const float top_height = std::static_pointer_cast<Box>(list.front())->height();
+  auto result = tex::vbox(std::move(list));
+
+  // As in TeX, the baseline of the delimiter is the one of its top piece
+  VBoxEditor editor{ *result };
+  editor.changeHeight(top_height);
+  editor.done();
+
+  return result;
+}
+
+std::shared_ptr<Box> DelimiterBuilder::glyph(Character c, Font font)
+{
+  return m_engine.typeset(c, font, m_engine.glyphMetrics()->glyph(c, font));
+}
+
+} // namespace tex
@@ -0,0 +1,463 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/dviwriter.h"
+
+#include "tex/hbox.h"
+#include "tex/kern.h"
+#include "tex/rule.h"
+#include "tex/vbox.h"
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+#include <stdexcept>
+
+namespace tex
+{
+
+namespace dvi
+{
+
+enum Opcode : uint8_t
+{
+  set1 = 128,
+  set_rule = 132,
+  put_rule = 137,
+  bop = 139,
+  eop = 140,
+  push = 141,
+  pop = 142,
+  right1 = 143,
+  w0 = 147,
+  w1 = 148,
+  x0 = 152,
+  x1 = 153,
+  down1 = 157,
+  y0 = 161,
+  y1 = 162,
+  z0 = 166,
+  z1 = 167,
+  fnt_num_0 = 171,
+  fnt1 = 235,
+  fnt_def1 = 243,
+  pre = 247,
+  post = 248,
+  post_post = 249,
+};
+
+// Numerator and denominator of the DVI unit: 1sp = 2^-16 pt, 
+// 1pt = 1/72.27 in, 1 in = 2.54 cm = 2.54e7 * 10^-7 m.
+const uint32_t num = 25400000;
+const uint32_t den = 473628672;
+const uint32_t version = 2;
+
+} // namespace dvi
+
+static int signed_size(int32_t value)
+{
+  if (value >= -0x80 && value < 0x80)
+    return 1;
+  else if (value >= -0x8000 && value < 0x8000)
+    return 2;
+  else if (value >= -0x800000 && value < 0x800000)
+    return 3;
+  else
+    return 4;
+}
+
+static int unsigned_size(uint32_t value)
+{
+  if (value < 0x100)
+    return 1;
+  else if (value < 0x10000)
+    return 2;
+  else if (value < 0x1000000)
+    return 3;
+  else
+    return 4;
+}
+
+DviWriter::DviWriter(std::ostream& out, const std::string& comment)
+  : m_out(out)
+{
+  const size_t k = std::min<size_t>(comment.size(), 255);
+
+  writeByte(dvi::pre);
+  writeByte(dvi::version);
+  writeUnsigned(dvi::num, 4);
+  writeUnsigned(dvi::den, 4);
+  writeUnsigned(1000, 4);
+  writeByte(static_cast<uint8_t>(k));
+
+  for (size_t i(0); i < k; ++i)
+    writeByte(static_cast<uint8_t>(comment[i]));
+}
+
+void DviWriter::setFont(Font f, const std::string& name, float size, float designSize, uint32_t checksum)
+{
+  if (f.id() < 0)
+    throw std::runtime_error{ "DviWriter::setFont(): invalid font" };
+
+  if (static_cast<size_t>(f.id()) >= m_fonts.size())
+    m_fonts.resize(f.id() + 1);
+
+  FontInfo& info = m_fonts[f.id()];
+
+  if (info.defined)
+    throw std::runtime_error{ "DviWriter::setFont(): font already in use" };
+
+  info.name = name;
+  info.size = scaled(size);
+  info.design_size = scaled(designSize);
+  info.checksum = checksum;
+}
+
+void DviWriter::setFont(Font f, const std::string& name, float size)
+{
+  setFont(f, name, size, size);
+}
+
+void DviWriter::writePage(const Box& page)
+{
+  if (m_finished)
+    throw std::runtime_error{ "DviWriter::writePage(): document is finished" };
+
+  const int64_t bop = static_cast<int64_t>(m_offset);
+
+  writeByte(dvi::bop);
+  writeSigned(static_cast<int32_t>(m_page_count + 1), 4);
+
+  for (int i(1); i < 10; ++i)
+    writeSigned(0, 4);
+
+  writeSigned(static_cast<int32_t>(m_last_bop), 4);
+  m_last_bop = bop;
+
+  m_state = State();
+  m_current_font = -1;
+
+  outputBox(&page, false, 0, scaled(page.height()));
+  outputLists();
+
+  writeByte(dvi::eop);
+
+  m_max_height = std::max(m_max_height, scaled(page.totalHeight()));
+  m_max_width = std::max(m_max_width, scaled(page.width()));
+  ++m_page_count;
+}
+
+void DviWriter::finish()
+{
+  if (m_finished)
+    return;
+
+  const uint64_t post = m_offset;
+
+  writeByte(dvi::post);
+  writeSigned(static_cast<int32_t>(m_last_bop), 4);
+  writeUnsigned(dvi::num, 4);
+  writeUnsigned(dvi::den, 4);
+  writeUnsigned(1000, 4);
+  writeSigned(m_max_height, 4);
+  writeSigned(m_max_width, 4);
+  writeUnsigned(static_cast<uint32_t>(m_max_push), 2);
+  writeUnsigned(static_cast<uint32_t>(m_page_count), 2);
+
+  for (size_t k(0); k < m_fonts.size(); ++k)
+  {
+    if (m_fonts[k].defined)
+      writeFontDef(static_cast<int>(k));
+  }
+
+  writeByte(dvi::post_post);
+  writeUnsigned(static_cast<uint32_t>(post), 4);
+  writeByte(dvi::version);
+
+  // The file ends with four to seven 223's, making its size a multiple of 4
+  writeUnsigned(0xDFDFDFDF, 4);
+
+  while (m_offset % 4 != 0)
+    writeByte(223);
+
+  m_out.flush();
+  m_finished = true;
+}
+
+int32_t DviWriter::scaled(float x)
+{
+  return static_cast<int32_t>(std::lround(x * 65536.f));
+}
+
+void DviWriter::outputBox(const Box* box, bool horizontal, int32_t h, int32_t v)
+{
+  if (box->isCharacterBox())
+  {
+    const CharacterBox* cbox = static_cast<const CharacterBox*>(box);
+    selectFont(cbox->font());
+    moveTo(h, v);
+    setChar(cbox->character());
+    m_state.h += scaled(cbox->width());
+  }
+  else if (box->is<Rule>())
+  {
+    const int32_t height = scaled(box->height()) + scaled(box->depth());
+    const int32_t width = scaled(box->width());
+
+    if (height > 0 && width > 0)
+    {
+      moveTo(h, v + scaled(box->depth()));
+      setRule(height, width, horizontal);
+    }
+  }
+  else if (box->isListBox())
+  {
+    const ListBox* listbox = static_cast<const ListBox*>(box);
+
+    if (listbox->list().empty())
+      return;
+
+    Frame frame;
+    frame.box = listbox;
+    frame.current = listbox->list().begin();
+    frame.end = listbox->list().end();
+    frame.h = h;
+    frame.v = listbox->isVBox() ? v - scaled(listbox->height()) : v;
+    frame.pushed = !m_frames.empty();
+    frame.saved = m_state;
+
+    if (frame.pushed)
+      push();
+
+    m_frames.push_back(frame);
+  }
+}
+
+void DviWriter::outputLists()
+{
+  while (!m_frames.empty())
+  {
+    Frame& frame = m_frames.back();
+
+    if (frame.current == frame.end)
+    {
+      if (frame.pushed)
+      {
+        pop();
+        m_state = frame.saved;
+      }
+
+      m_frames.pop_back();
+      continue;
+    }
+
+    const Node* node = (frame.current++)->get();
+    const bool horizontal = frame.box->isHBox();
+
+    if (node->isBox())
+    {
+      const Box* box = static_cast<const Box*>(node);
+      const int32_t shift = box->isListBox() ? scaled(static_cast<const ListBox*>(box)->shiftAmount()) : 0;
+
+      // frame may be invalidated by outputBox()
+      if (horizontal)
+      {
+        const int32_t h = frame.h;
+        frame.h += scaled(box->width());
+        outputBox(box, true, h, frame.v + shift);
+      }
+      else
+      {
+        frame.v += scaled(box->height());
+        const int32_t v = frame.v;
+        frame.v += scaled(box->depth());
+        outputBox(box, false, frame.h + shift, v);
+      }
+    }
+    else if (node->is<Kern>())
+    {
+      (horizontal ? frame.h : frame.v) += scaled(static_cast<const Kern*>(node)->space());
+    }
+    else if (node->is<Glue>())
+    {
+      const Glue* glue = static_cast<const Glue*>(node);
+      float amount = glue->space();
+
+      if (frame.box->glueRatio() < 0.f)
+      {
+        if (frame.box->glueOrder() == glue->shrinkOrder())
+          amount += frame.box->glueRatio() * glue->shrink();
+      }
+      else
+      {
+        if (frame.box->glueOrder() == glue->stretchOrder())
+          amount += frame.box->glueRatio() * glue->stretch();
+      }
+
+      (horizontal ? frame.h : frame.v) += scaled(amount);
+    }
+  }
+}
+
+void DviWriter::selectFont(Font f)
+{
+  const int k = f.id();
+
+  if (k == m_current_font)
+    return;
+
+  if (k < 0)
+    throw std::runtime_error{ "DviWriter: invalid font" };
+
+  if (static_cast<size_t>(k) >= m_fonts.size())
+    m_fonts.resize(k + 1);
+
+  FontInfo& info = m_fonts[k];
+
+  if (!info.defined)
+  {
+    if (info.name.empty())
+      info.name = "font" + std::to_string(k);
+
+    if (info.size == 0)
+      info.size = info.design_size = scaled(10.f);
+
+    writeFontDef(k);
+    info.defined = true;
+  }
+
+  if (k < 64)
+  {
+    writeByte(static_cast<uint8_t>(dvi::fnt_num_0 + k));
+  }
+  else
+  {
+    const int n = unsigned_size(static_cast<uint32_t>(k));
+    writeByte(static_cast<uint8_t>(dvi::fnt1 + n - 1));
+    writeUnsigned(static_cast<uint32_t>(k), n);
+  }
+
+  m_current_font = k;
+}
+
+void DviWriter::setChar(Character c)
+{
+  if (c >= 0 && c < 128)
+  {
+    writeByte(static_cast<uint8_t>(c));
+  }
+  else
+  {
+    const int n = unsigned_size(static_cast<uint32_t>(c));
+    writeByte(static_cast<uint8_t>(dvi::set1 + n - 1));
+    writeUnsigned(static_cast<uint32_t>(c), n);
+  }
+}
+
+void DviWriter::setRule(int32_t height, int32_t width, bool advance)
+{
+  writeByte(advance ? dvi::set_rule : dvi::put_rule);
+  writeSigned(height, 4);
+  writeSigned(width, 4);
+
+  if (advance)
+    m_state.h += width;
+}
+
+void DviWriter::moveTo(int32_t h, int32_t v)
+{
+  if (h != m_state.h)
+  {
+    writeMove(dvi::w0, dvi::x0, h - m_state.h, m_state.wx, m_state.wx_lru);
+    m_state.h = h;
+  }
+
+  if (v != m_state.v)
+  {
+    writeMove(dvi::y0, dvi::z0, v - m_state.v, m_state.yz, m_state.yz_lru);
+    m_state.v = v;
+  }
+}
+
+void DviWriter::push()
+{
+  writeByte(dvi::push);
+  m_max_push = std::max(m_max_push, ++m_push_depth);
+}
+
+void DviWriter::pop()
+{
+  writeByte(dvi::pop);
+  --m_push_depth;
+}
+
+void DviWriter::writeFontDef(int k)
+{
+  const FontInfo& info = m_fonts[k];
+  const int n = unsigned_size(static_cast<uint32_t>(k));
+
+  writeByte(static_cast<uint8_t>(dvi::fnt_def1 + n - 1));
+  writeUnsigned(static_cast<uint32_t>(k), n);
+  writeUnsigned(info.checksum, 4);
+  writeSigned(info.size, 4);
+  writeSigned(info.design_size, 4);
+  writeByte(0);
+
+  const size_t l = std::min<size_t>(info.name.size(), 255);
+  writeByte(static_cast<uint8_t>(l));
+
+  for (size_t i(0); i < l; ++i)
+    writeByte(static_cast<uint8_t>(info.name[i]));
+}
+
+void DviWriter::writeByte(uint8_t b)
+{
+  m_out.put(static_cast<char>(b));
+  ++m_offset;
+}
+
+void DviWriter::writeSigned(int32_t value, int bytes)
+{
+  writeUnsigned(static_cast<uint32_t>(value), bytes);
+}
+
+void DviWriter::writeUnsigned(uint32_t value, int bytes)
+{
+  for (int i(bytes - 1); i >= 0; --i)
+    writeByte(static_cast<uint8_t>((value >> (8 * i)) & 0xFF));
+}
+
+void DviWriter::writeCommand(uint8_t base, int32_t value)
+{
+  const int n = signed_size(value);
+  writeByte(static_cast<uint8_t>(base + n - 1));
+  writeSigned(value, n);
+}
+
+// Movements reuse a register when the amount was recently used, otherwise
+// the amount is loaded into the least recently used of the two registers.
+// Since w<n> and x<n> are as long as right<n>, loading a register never 
+// costs more than a plain move.
+void DviWriter::writeMove(uint8_t w0, uint8_t x0, int32_t delta, int32_t regs[2], int& lru)
+{
+  if (delta == regs[0])
+  {
+    writeByte(w0);
+    lru = 1;
+  }
+  else if (delta == regs[1])
+  {
+    writeByte(x0);
+    lru = 0;
+  }
+  else
+  {
+    const int r = lru;
+    regs[r] = delta;
+    writeCommand((r == 0 ? w0 : x0) + 1, delta);
+    lru = 1 - r;
+  }
+}
+
+} // namespace tex
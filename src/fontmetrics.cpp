@@ -4,12 +4,57 @@
 
 #include "tex/fontmetrics.h"
 
+#include <stdexcept>
+
 namespace tex
 {
 
-int FontMetricsProvider::sfcode(tex::Character c)
+constexpr Character LigKern::Boundary;
+
+/*!
+ * \fn void setSfcodes(std::shared_ptr<const SfcodeTable> table)
+ * \brief replaces the space factor codes
+ *
+ * Codes are read without any virtual call, so that switching between 
+ * e.g. \c{\frenchspacing} and \c{\nonfrenchspacing} is done by swapping 
+ * tables. By default, every character has code 1000.
+ */
+void FontMetricsProvider::setSfcodes(std::shared_ptr<const SfcodeTable> table)
+{
+  if (table == nullptr)
+    throw std::runtime_error{ "FontMetricsProvider::setSfcodes(): null table" };
+
+  m_sfcodes = std::move(table);
+}
+
+LigKern FontMetricsProvider::ligKern(Font /* font */, Character /* left */, Character /* right */)
+{
+  return LigKern{};
+}
+
+bool FontMetricsProvider::hasChar(Font /* font */, Character /* c */)
 {
-  return 1000;
+  return true;
+}
+
+/*!
+ * \fn Character successor(Font font, Character c)
+ * \brief returns the next larger variant of a character, or -1
+ */
+Character FontMetricsProvider::successor(Font /* font */, Character /* c */)
+{
+  return -1;
+}
+
+/*!
+ * \fn bool extensible(Font font, Character c, ExtensibleRecipe& recipe)
+ * \brief returns whether a character is built from pieces
+ *
+ * If it is, its recipe is written in \a recipe.
+ */
+bool FontMetricsProvider::extensible(Font /* font */, Character /* c */, ExtensibleRecipe& /* recipe */)
+{
+  return false;
 }
 
 float FontMetricsProvider::slantPerPt(Font font)
@@ -153,6 +198,27 @@ float FontMetricsProvider::bigOpSpacing5(Font font)
   return fontdimen(font).big_op_spacing5;
 }
 
+ResolvedFontMetrics::ResolvedFontMetrics()
+  : m_font(-1),
+    m_fontdimen{}
+{
+
+}
+
+ResolvedFontMetrics::ResolvedFontMetrics(Font font, const FontDimen& fontdimen)
+  : m_font(font),
+    m_fontdimen(fontdimen)
+{
+
+}
+
+ResolvedFontMetrics::ResolvedFontMetrics(const FontMetrics& metrics)
+  : m_font(metrics.font()),
+    m_fontdimen(metrics.fontdimen())
+{
+
+}
+
 FontMetrics::FontMetrics(Font font, std::shared_ptr<FontMetricsProvider> mp)
   : mFont(font)
   , mMetricsProvider(mp)
@@ -0,0 +1,136 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/glyphmetricscache.h"
+
+#include <stdexcept>
+
+namespace tex
+{
+
+GlyphMetricsCache::GlyphMetricsCache(std::shared_ptr<FontMetricsProvider> provider)
+  : m_provider(std::move(provider))
+{
+  if (m_provider == nullptr)
+    throw std::runtime_error{ "GlyphMetricsCache: null metrics provider" };
+
+  FontMetricsProvider::setSfcodes(m_provider->sfcodes());
+}
+
+GlyphMetricsCache::~GlyphMetricsCache()
+{
+
+}
+
+BoxMetrics GlyphMetricsCache::metrics(Character c, Font font)
+{
+  return glyph(c, font);
+}
+
+BoxMetrics GlyphMetricsCache::metrics(const std::shared_ptr<Symbol>& symbol, Font font)
+{
+  if (symbol != nullptr && symbol->isMathSymbol())
+    return glyph(static_cast<const MathSymbol*>(symbol.get())->character(), font);
+
+  return m_provider->metrics(symbol, font);
+}
+
+float GlyphMetricsCache::italicCorrection(const std::shared_ptr<Symbol>& symbol, Font font)
+{
+  return m_provider->italicCorrection(symbol, font);
+}
+
+void GlyphMetricsCache::setSfcodes(std::shared_ptr<const SfcodeTable> table)
+{
+  m_provider->setSfcodes(table);
+  FontMetricsProvider::setSfcodes(std::move(table));
+
+  for (const std::unique_ptr<FontEntry>& e : m_fonts)
+  {
+    if (e != nullptr)
+      e->interword.clear();
+  }
+}
+
+LigKern GlyphMetricsCache::ligKern(Font font, Character left, Character right)
+{
+  return m_provider->ligKern(font, left, right);
+}
+
+bool GlyphMetricsCache::hasChar(Font font, Character c)
+{
+  return m_provider->hasChar(font, c);
+}
+
+Character GlyphMetricsCache::successor(Font font, Character c)
+{
+  return m_provider->successor(font, c);
+}
+
+bool GlyphMetricsCache::extensible(Font font, Character c, ExtensibleRecipe& recipe)
+{
+  return m_provider->extensible(font, c, recipe);
+}
+
+const FontDimen& GlyphMetricsCache::fontdimen(Font font)
+{
+  FontEntry* e = entry(font);
+
+  if (!e->has_fontdimen)
+  {
+    e->fontdimen = m_provider->fontdimen(font);
+    e->has_fontdimen = true;
+  }
+
+  return e->fontdimen;
+}
+
+void GlyphMetricsCache::invalidate()
+{
+  m_fonts.clear();
+  FontMetricsProvider::setSfcodes(m_provider->sfcodes());
+}
+
+void GlyphMetricsCache::invalidate(Font font)
+{
+  if (font.id() >= 0 && static_cast<size_t>(font.id()) < m_fonts.size())
+    m_fonts[font.id()].reset();
+}
+
+void GlyphMetricsCache::buildInterwordGlue(FontEntry& e, Font font)
+{
+  const FontDimen& fd = fontdimen(font);
+  const SfcodeTable& table = *sfcodes();
+
+  e.interword.resize(table.bucketCount());
+
+  for (size_t i(0); i < table.bucketCount(); ++i)
+  {
+    // A code of 0 leaves the space factor unchanged, it is never used here
+    const float f = table.value(i) > 0 ? table.value(i) / 1000.f : 1.f;
+
+    InterwordGlue& g = e.interword[i];
+    g.space = fd.interword_space + (f >= 2.f ? fd.extra_space : 0.f);
+    g.stretch = fd.interword_stretch * f;
+    g.shrink = fd.interword_shrink / f;
+  }
+}
+
+GlyphMetricsCache::FontEntry* GlyphMetricsCache::entry(Font font)
+{
+  if (font.id() < 0)
+    throw std::runtime_error{ "GlyphMetricsCache: invalid font" };
+
+  if (static_cast<size_t>(font.id()) >= m_fonts.size())
+    m_fonts.resize(font.id() + 1);
+
+  std::unique_ptr<FontEntry>& e = m_fonts[font.id()];
+
+  if (e == nullptr)
+    e.reset(new FontEntry);
+
+  return e.get();
+}
+
+} // namespace tex
@@ -0,0 +1,144 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/glyphrun.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace tex
+{
+
+float GlyphRun::width() const
+{
+  return std::accumulate(advances.begin(), advances.end(), 0.f);
+}
+
+void GlyphRun::clear()
+{
+  glyphs.clear();
+  advances.clear();
+}
+
+bool GlyphRunBuilder::accepts(const CharacterBox& box, Pos pos) const
+{
+  return m_run.empty() || (box.font() == m_run.font && pos.y == m_run.origin.y);
+}
+
+void GlyphRunBuilder::push_back(const CharacterBox& box, Pos pos)
+{
+  if (m_run.empty())
+  {
+    m_run.font = box.font();
+    m_run.origin = pos;
+  }
+  else
+  {
+    m_run.advances.back() = pos.x - m_last_x;
+  }
+
+  m_run.glyphs.push_back(box.character());
+  m_run.advances.push_back(box.width());
+  m_last_x = pos.x;
+}
+
+GlyphRun GlyphRunBuilder::take()
+{
+  GlyphRun result = std::move(m_run);
+  m_run = GlyphRun();
+  return result;
+}
+
+void GlyphRunBuilder::clear()
+{
+  m_run.clear();
+}
+
+struct GlyphRunCollector
+{
+  GlyphRunList& list;
+  GlyphRunBuilder& builder;
+
+  void operator()(const Box* box, Pos pos)
+  {
+    if (!box->isCharacterBox())
+      return;
+
+    const CharacterBox& cbox = *static_cast<const CharacterBox*>(box);
+
+    if (!builder.accepts(cbox, pos))
+      list.push_back(builder.take());
+
+    builder.push_back(cbox, pos);
+  }
+
+  void operator()(const Rule*, Pos)
+  {
+
+  }
+};
+
+GlyphRunList::GlyphRunList(const Box& layout)
+  : GlyphRunList(layout, Pos{ 0.f, layout.height() })
+{
+
+}
+
+GlyphRunList::GlyphRunList(const Box& layout, Pos pos)
+{
+  GlyphRunBuilder builder;
+  tex::traverse(GlyphRunCollector{ *this, builder }, &layout, pos);
+
+  if (!builder.empty())
+    push_back(builder.take());
+}
+
+const GlyphRunList::FontBucket* GlyphRunList::bucket(Font f) const
+{
+  auto it = std::find_if(m_buckets.begin(), m_buckets.end(), [f](const FontBucket& b) {
+    return b.font == f;
+    });
+
+  return it != m_buckets.end() ? &(*it) : nullptr;
+}
+
+size_t GlyphRunList::glyphCount() const
+{
+  size_t n = 0;
+
+  for (const GlyphRun& r : m_runs)
+    n += r.size();
+
+  return n;
+}
+
+void GlyphRunList::push_back(GlyphRun run)
+{
+  // Documents use a handful of fonts, a linear search is faster 
+  // than any map here.
+  auto it = std::find_if(m_buckets.begin(), m_buckets.end(), [&run](const FontBucket& b) {
+    return b.font == run.font;
+    });
+
+  if (it == m_buckets.end())
+  {
+    m_buckets.push_back(FontBucket{ run.font, {} });
+    it = m_buckets.end() - 1;
+  }
+
+  it->runs.push_back(m_runs.size());
+  m_runs.push_back(std::move(run));
+}
+
+GlyphRunList glyph_runs(const Box& layout)
+{
+  return GlyphRunList(layout);
+}
+
+GlyphRunList glyph_runs(const Box& layout, Pos pos)
+{
+  return GlyphRunList(layout, pos);
+}
+
+} // namespace tex
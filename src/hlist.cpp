@@ -5,6 +5,7 @@
 #include "tex/hlist.h"
 
 #include "tex/glue.h"
+#include "tex/glyphmetricscache.h"
 #include "tex/kern.h"
 #include "tex/typeset.h"
 
@@ -14,6 +15,8 @@
 namespace tex
 {
 
+const int HListBuilder::LigStackCapacity;
+
 HListBuilder::HListBuilder(std::shared_ptr<TypesetEngine> e, tex::Font f)
   : typeset(e),
     font(f)
@@ -23,27 +26,69 @@ HListBuilder::HListBuilder(std::shared_ptr<TypesetEngine> e, tex::Font f)
 
 void HListBuilder::push_back(tex::Character c)
 {
-  auto box = typeset->typeset(c, font);
-  result.push_back(box);
+  if (m_in_word && font != m_word_font)
+    flush();
+
+  if (!m_in_word)
+  {
+    m_in_word = true;
+    m_word_font = font;
+    m_cur_l = LigKern::Boundary;
+  }
 
-  int g = typeset->metrics()->sfcode(c);
+  m_lig_stack[m_lig_stack_size++] = c;
+  ligkern();
+
+  // Based on TeX's §1034
+  const SfcodeTable& sfcodes = *typeset->glyphMetrics()->sfcodes();
+  const size_t bucket = sfcodes.bucket(c);
+  const int g = sfcodes.value(bucket);
 
   if (g != 0)
   {
     if (spacefactor < 1000 && g > 1000)
+    {
       spacefactor = 1000;
-    spacefactor = g;
+      m_spacefactor_bucket = 0;
+    }
+    else
+    {
+      spacefactor = g;
+      m_spacefactor_bucket = bucket;
+    }
   }
 }
 
+/*!
+ * \fn void push_back_interword_glue()
+ * \brief appends the interword glue of the current font
+ *
+ * The glue is read from the table of the font precomputed for the 
+ * current space factor, unless \c spacefactor was changed by hand 
+ * to a code that is not in the table.
+ */
 void HListBuilder::push_back_interword_glue()
 {
-  float space = typeset->metrics()->interwordSpace(font);
-  float stretch = typeset->metrics()->interwordStretch(font);
-  float shrink = typeset->metrics()->interwordShrink(font);
+  flush();
+
+  GlyphMetricsCache& cache = *typeset->glyphMetrics();
+  const SfcodeTable& sfcodes = *cache.sfcodes();
+
+  if (m_spacefactor_bucket < sfcodes.bucketCount() && sfcodes.value(m_spacefactor_bucket) == spacefactor)
+  {
+    const InterwordGlue& g = cache.interwordGlue(font, m_spacefactor_bucket);
+    push_back(tex::glue(g.space, Stretch(g.stretch), Shrink(g.shrink)));
+    return;
+  }
+
+  const FontDimen& fontdimen = cache.fontdimen(font);
+
+  float space = fontdimen.interword_space;
+  float stretch = fontdimen.interword_stretch;
+  float shrink = fontdimen.interword_shrink;
 
   if (spacefactor >= 2000)
-    space += typeset->metrics()->extraSpace(font);
+    space += fontdimen.extra_space;
 
   stretch *= (spacefactor / 1000.f);
   shrink *= (1000.f / spacefactor);
@@ -53,18 +98,116 @@ void HListBuilder::push_back_interword_glue()
 
 void HListBuilder::push_back(std::shared_ptr<tex::Box> b)
 {
+  flush();
   result.push_back(b);
   spacefactor = 1000;
+  m_spacefactor_bucket = 0;
 }
 
 void HListBuilder::push_back(std::shared_ptr<tex::Glue> g)
 {
+  flush();
   result.push_back(g);
 }
 
 void HListBuilder::push_back(std::shared_ptr<tex::Kern> k)
 {
+  flush();
   result.push_back(k);
 }
 
+/*!
+ * \fn void flush()
+ * \brief ends the current word
+ *
+ * The lig/kern program is run a last time against the right boundary 
+ * of the word and all pending characters are appended to the list.
+ */
+void HListBuilder::flush()
+{
+  if (!m_in_word)
+    return;
+
+  m_lig_stack[m_lig_stack_size++] = LigKern::Boundary;
+  ligkern();
+  emit(m_cur_l);
+
+  m_in_word = false;
+}
+
+// Based on TeX's main loop (§1034-§1040): m_cur_l is the character on 
+// the left, the top of the stack is the one on the right. 
+// Characters are appended to the list once nothing can change them anymore.
+void HListBuilder::ligkern()
+{
+  GlyphMetricsCache& cache = *typeset->glyphMetrics();
+
+  // guards against fonts whose ligatures form a cycle
+  int ligatures = 0;
+
+  while (m_lig_stack_size > 0)
+  {
+    const Character cur_r = m_lig_stack[m_lig_stack_size - 1];
+    LigKern lk = cache.ligKern(m_word_font, m_cur_l, cur_r);
+
+    if (lk.kind == LigKern::Ligature && (++ligatures > 256 || ((lk.op & 3) == 3 && m_lig_stack_size == LigStackCapacity)))
+      lk.kind = LigKern::None;
+
+    if (lk.kind == LigKern::None)
+    {
+      emit(m_cur_l);
+      m_cur_l = pop();
+    }
+    else if (lk.kind == LigKern::Kern)
+    {
+      emit(m_cur_l);
+      result.push_back(tex::kern(lk.kern));
+      m_cur_l = pop();
+    }
+    else
+    {
+      switch (lk.op)
+      {
+      case 1: // =:|
+      case 5: // =:|>
+        m_cur_l = lk.ligature;
+        break;
+      case 2: // |=:
+      case 6: // |=:>
+        m_lig_stack[m_lig_stack_size - 1] = lk.ligature;
+        break;
+      case 3: // |=:|
+      case 7: // |=:|>
+      case 11: // |=:|>>
+        m_lig_stack[m_lig_stack_size++] = lk.ligature;
+        break;
+      default: // =:
+        m_cur_l = lk.ligature;
+        pop();
+        break;
+      }
+
+      for (int skip(lk.op >> 2); skip > 0 && m_lig_stack_size > 0; --skip)
+      {
+        emit(m_cur_l);
+        m_cur_l = pop();
+      }
+    }
+  }
+}
+
+void HListBuilder::emit(tex::Character c)
+{
+  if (c == LigKern::Boundary)
+    return;
+
+  result.push_back(typeset->characterBox(c, m_word_font));
+}
+
+tex::Character HListBuilder::pop()
+{
+  assert(m_lig_stack_size > 0);
+  return m_lig_stack[--m_lig_stack_size];
+}
+
 } // namespace tex
@@ -0,0 +1,162 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/incrementallexer.h"
+
+#include <algorithm>
+
+namespace tex
+{
+
+namespace parsing
+{
+
+IncrementalLexer::IncrementalLexer(const Lexer::CatCodeTable& catcodes)
+  : m_catcodes(catcodes)
+{
+  m_checkpoints.push_back(Checkpoint{ 0, LexerState::StateN, m_catcodes_version, 0 });
+}
+
+/*!
+ * \fn Change setCatcodes(const Lexer::CatCodeTable& catcodes)
+ * \brief changes the catcodes and lexes the whole text again
+ *
+ * The checkpoints recorded with the previous table are invalidated by
+ * the new version number.
+ */
+IncrementalLexer::Change IncrementalLexer::setCatcodes(const Lexer::CatCodeTable& catcodes)
+{
+  m_catcodes = catcodes;
+  m_catcodes_version += 1;
+  return setText(std::move(m_text));
+}
+
+IncrementalLexer::Change IncrementalLexer::setText(std::string text)
+{
+  m_text = std::move(text);
+  m_tokens.clear();
+  m_checkpoints.assign(1, Checkpoint{ 0, LexerState::StateN, m_catcodes_version, 0 });
+  return relex(0, m_text.size(), 0);
+}
+
+/*!
+ * \fn Change replace(size_t offset, size_t length, const std::string& text)
+ * \brief replaces length characters at the given offset and updates the tokens
+ *
+ * The returned Change gives the range of tokens that was replaced and the
+ * number of lines that were lexed.
+ * If the lexer throws, the text and the tokens are left unchanged.
+ */
+IncrementalLexer::Change IncrementalLexer::replace(size_t offset, size_t length, const std::string& text)
+{
+  if (offset > m_text.size())
+    throw std::runtime_error{ "IncrementalLexer: offset out of range" };
+
+  length = std::min(length, m_text.size() - offset);
+
+  auto it = std::upper_bound(m_checkpoints.begin(), m_checkpoints.end(), offset, [](size_t off, const Checkpoint& cp) {
+    return off < cp.offset;
+    });
+
+  const size_t first = static_cast<size_t>(std::distance(m_checkpoints.begin(), it)) - 1;
+  const std::string removed = m_text.substr(offset, length);
+
+  m_text.replace(offset, length, text);
+
+  try
+  {
+    return relex(first, offset + text.size(), static_cast<ptrdiff_t>(text.size()) - static_cast<ptrdiff_t>(length));
+  }
+  catch (...)
+  {
+    m_text.replace(offset, text.size(), removed);
+    throw;
+  }
+}
+
+/*!
+ * \fn Change relex(size_t first, size_t edit_end, ptrdiff_t delta)
+ * \brief lexes the text from the given checkpoint until it converges with the previous run
+ *
+ * The checkpoints from first onwards still refer to the text before the
+ * edit, which ends at edit_end in the new text and shifted the rest of
+ * the text by delta characters.
+ */
+IncrementalLexer::Change IncrementalLexer::relex(size_t first, size_t edit_end, ptrdiff_t delta)
+{
+  const Checkpoint start = m_checkpoints.at(first);
+
+  Lexer lexer;
+  lexer.catcodes() = m_catcodes;
+  lexer.state() = start.state;
+
+  std::vector<Checkpoint> checkpoints{ start };
+  size_t converged = m_checkpoints.size();
+  size_t next = first;
+  size_t offset = start.offset;
+  size_t lines = 0;
+
+  while (offset < m_text.size())
+  {
+    const size_t newline = m_text.find('\n', offset);
+    const size_t end = newline == std::string::npos ? m_text.size() : newline + 1;
+
+    lexer.write(m_text.data() + offset, end - offset);
+    offset = end;
+    lines += 1;
+
+    if (newline == std::string::npos)
+      break;
+
+    const LexerState s = lexer.state();
+
+    if (s == LexerState::StateCS || s == LexerState::StateP)
+      continue;
+
+    if (offset >= edit_end)
+    {
+      const size_t old_offset = static_cast<size_t>(static_cast<ptrdiff_t>(offset) - delta);
+
+      while (next < m_checkpoints.size() && m_checkpoints[next].offset < old_offset)
+        ++next;
+
+      if (next < m_checkpoints.size() && m_checkpoints[next].offset == old_offset
+        && m_checkpoints[next].state == s && m_checkpoints[next].catcodes_version == m_catcodes_version)
+      {
+        converged = next;
+        break;
+      }
+    }
+
+    checkpoints.push_back(Checkpoint{ offset, s, m_catcodes_version, start.token + lexer.output().size() });
+  }
+
+  std::vector<Token>& produced = lexer.output();
+
+  Change change;
+  change.token = start.token;
+  change.removed = (converged < m_checkpoints.size() ? m_checkpoints[converged].token : m_tokens.size()) - start.token;
+  change.inserted = produced.size();
+  change.lines = lines;
+
+  m_tokens.erase(m_tokens.begin() + change.token, m_tokens.begin() + change.token + change.removed);
+  m_tokens.insert(m_tokens.begin() + change.token, produced.begin(), produced.end());
+
+  const ptrdiff_t token_delta = static_cast<ptrdiff_t>(change.inserted) - static_cast<ptrdiff_t>(change.removed);
+
+  for (size_t i(converged); i < m_checkpoints.size(); ++i)
+  {
+    m_checkpoints[i].offset = static_cast<size_t>(static_cast<ptrdiff_t>(m_checkpoints[i].offset) + delta);
+    m_checkpoints[i].token = static_cast<size_t>(static_cast<ptrdiff_t>(m_checkpoints[i].token) + token_delta);
+  }
+
+  m_checkpoints.erase(m_checkpoints.begin() + first, m_checkpoints.begin() + converged);
+  m_checkpoints.insert(m_checkpoints.begin() + first, checkpoints.begin(), checkpoints.end());
+
+  return change;
+}
+
+} // namespace parsing
+
+} // namespace tex
@@ -0,0 +1,196 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/inputsource.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace tex
+{
+
+namespace parsing
+{
+
+const size_t InputSource::DefaultChunkSize;
+
+InputSource::~InputSource()
+{
+
+}
+
+/*!
+ * \fn bool atEnd()
+ * \brief returns whether all the characters have been read
+ */
+bool InputSource::atEnd()
+{
+  return m_pos == m_size && !refill();
+}
+
+/*!
+ * \fn size_t read(const char*& data)
+ * \brief reads the next characters up to and including the next end of line
+ *
+ * Returns the number of characters read, and 0 at the end of the input.
+ * Lines that span several chunks are returned in several parts.
+ * \a data remains valid until the next call.
+ */
+size_t InputSource::read(const char*& data)
+{
+  if (atEnd())
+    return 0;
+
+  data = m_chunk + m_pos;
+
+  const size_t available = m_size - m_pos;
+  const char* eol = static_cast<const char*>(std::memchr(data, '\n', available));
+  const size_t n = eol != nullptr ? static_cast<size_t>(eol - data) + 1 : available;
+
+  m_pos += n;
+
+  if (eol != nullptr)
+  {
+    ++m_line;
+    m_column = 0;
+  }
+  else
+  {
+    m_column += n;
+  }
+
+  return n;
+}
+
+bool InputSource::refill()
+{
+  const char* data = nullptr;
+  size_t size = 0;
+
+  for (;;)
+  {
+    if (!fetch(data, size))
+    {
+      m_chunk = nullptr;
+      m_size = m_pos = 0;
+      return false;
+    }
+
+    // second half of a CRLF pair
+    if (m_pending_cr && size > 0)
+    {
+      m_pending_cr = false;
+
+      if (data[0] == '\n')
+      {
+        ++data;
+        --size;
+      }
+    }
+
+    if (size > 0)
+      break;
+  }
+
+  if (std::memchr(data, '\r', size) == nullptr)
+  {
+    m_chunk = data;
+    m_size = size;
+  }
+  else
+  {
+    normalize(data, size);
+  }
+
+  m_pos = 0;
+  return true;
+}
+
+void InputSource::normalize(const char* data, size_t size)
+{
+  m_buffer.resize(size);
+
+  char* out = m_buffer.data();
+
+  for (size_t i(0); i < size; ++i)
+  {
+    if (data[i] != '\r')
+    {
+      *(out++) = data[i];
+      continue;
+    }
+
+    *(out++) = '\n';
+
+    if (i + 1 == size)
+      m_pending_cr = true;
+    else if (data[i + 1] == '\n')
+      ++i;
+  }
+
+  m_chunk = m_buffer.data();
+  m_size = static_cast<size_t>(out - m_buffer.data());
+}
+
+StringInputSource::StringInputSource(std::string text, size_t chunk_size)
+  : m_text(std::move(text)),
+    m_chunk_size(chunk_size)
+{
+  if (chunk_size == 0)
+    throw std::runtime_error{ "StringInputSource: chunk size must be positive" };
+}
+
+bool StringInputSource::fetch(const char*& data, size_t& size)
+{
+  if (m_offset == m_text.size())
+    return false;
+
+  data = m_text.data() + m_offset;
+  size = std::min(m_chunk_size, m_text.size() - m_offset);
+  m_offset += size;
+  return true;
+}
+
+MappedInputSource::MappedInputSource(const std::string& path, size_t chunk_size)
+  : m_file(path),
+    m_chunk_size(chunk_size)
+{
+  if (chunk_size == 0)
+    throw std::runtime_error{ "MappedInputSource: chunk size must be positive" };
+}
+
+bool MappedInputSource::fetch(const char*& data, size_t& size)
+{
+  if (m_offset == m_file.size())
+    return false;
+
+  data = reinterpret_cast<const char*>(m_file.data()) + m_offset;
+  size = std::min(m_chunk_size, m_file.size() - m_offset);
+  m_offset += size;
+  return true;
+}
+
+StreamInputSource::StreamInputSource(std::istream& stream, size_t chunk_size)
+  : m_stream(stream),
+    m_chunk(chunk_size)
+{
+  if (chunk_size == 0)
+    throw std::runtime_error{ "StreamInputSource: chunk size must be positive" };
+}
+
+bool StreamInputSource::fetch(const char*& data, size_t& size)
+{
+  if (!m_stream)
+    return false;
+
+  m_stream.read(m_chunk.data(), static_cast<std::streamsize>(m_chunk.size()));
+  size = static_cast<size_t>(m_stream.gcount());
+  data = m_chunk.data();
+  return size > 0;
+}
+
+} // namespace parsing
+
+} // namespace tex
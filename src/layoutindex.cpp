@@ -0,0 +1,182 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/layoutindex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace tex
+{
+
+const size_t LayoutIndex::NodeCapacity;
+
+Rect united(const Rect& a, const Rect& b)
+{
+  const float left = std::min(a.left(), b.left());
+  const float top = std::min(a.top(), b.top());
+  const float right = std::max(a.right(), b.right());
+  const float bottom = std::max(a.bottom(), b.bottom());
+  return Rect{ left, top, right - left, bottom - top };
+}
+
+static Rect box_rect(const Box& box, Pos pos)
+{
+  Rect r{ pos.x, pos.y - box.height(), box.width(), box.totalHeight() };
+
+  if (r.width < 0.f)
+  {
+    r.x += r.width;
+    r.width = -r.width;
+  }
+
+  if (r.height < 0.f)
+  {
+    r.y += r.height;
+    r.height = -r.height;
+  }
+
+  return r;
+}
+
+struct LayoutIndexCollector
+{
+  std::vector<LayoutIndex::Entry>& entries;
+
+  void operator()(const std::shared_ptr<Box>& box, Pos pos)
+  {
+    entries.push_back(LayoutIndex::Entry{ box, pos, box_rect(*box, pos) });
+  }
+};
+
+// Sort-Tile-Recursive ordering: items are sorted by the x-coordinate of
+// their center, cut into vertical slices, and each slice is sorted by the
+// y-coordinate of their center.
+template<typename T, typename GetRect>
+static void str_sort(T* items, size_t n, GetRect&& get_rect)
+{
+  const size_t node_count = (n + LayoutIndex::NodeCapacity - 1) / LayoutIndex::NodeCapacity;
+  const size_t slice_count = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(node_count))));
+  const size_t slice_size = slice_count * LayoutIndex::NodeCapacity;
+
+  std::sort(items, items + n, [&get_rect](const T& a, const T& b) {
+    const Rect& ra = get_rect(a);
+    const Rect& rb = get_rect(b);
+    return 2.f * ra.x + ra.width < 2.f * rb.x + rb.width;
+    });
+
+  for (size_t i(0); i < n; i += slice_size)
+  {
+    std::sort(items + i, items + std::min(i + slice_size, n), [&get_rect](const T& a, const T& b) {
+      const Rect& ra = get_rect(a);
+      const Rect& rb = get_rect(b);
+      return 2.f * ra.y + ra.height < 2.f * rb.y + rb.height;
+      });
+  }
+}
+
+LayoutIndex::LayoutIndex(const std::shared_ptr<Box>& layout)
+  : LayoutIndex(layout, Pos{ 0.f, layout->height() })
+{
+
+}
+
+LayoutIndex::LayoutIndex(const std::shared_ptr<Box>& layout, Pos pos)
+{
+  LayoutIndexCollector collector{ m_entries };
+  tex::read(collector, layout, pos);
+  build();
+}
+
+const Rect& LayoutIndex::bounds() const
+{
+  static const Rect empty_rect{ 0.f, 0.f, 0.f, 0.f };
+  return m_nodes.empty() ? empty_rect : m_nodes.back().bounds;
+}
+
+std::vector<const LayoutIndex::Entry*> LayoutIndex::query(const Rect& rect) const
+{
+  std::vector<const Entry*> result;
+
+  query(rect, [&result](const Entry& e) {
+    result.push_back(&e);
+    });
+
+  std::sort(result.begin(), result.end());
+
+  return result;
+}
+
+const LayoutIndex::Entry* LayoutIndex::hitTest(Pos p) const
+{
+  const Entry* result = nullptr;
+
+  query(Rect{ p.x, p.y, 0.f, 0.f }, [&result](const Entry& e) {
+    if (result == nullptr || &e > result)
+      result = &e;
+    });
+
+  return result;
+}
+
+void LayoutIndex::build()
+{
+  m_items.resize(m_entries.size());
+  std::iota(m_items.begin(), m_items.end(), 0);
+  m_nodes.clear();
+
+  if (m_entries.empty())
+  {
+    m_leaf_count = 0;
+    return;
+  }
+
+  str_sort(m_items.data(), m_items.size(), [this](uint32_t i) -> const Rect& {
+    return m_entries[i].rect;
+    });
+
+  for (size_t i(0); i < m_items.size(); i += NodeCapacity)
+  {
+    TreeNode node;
+    node.first = static_cast<uint32_t>(i);
+    node.count = static_cast<uint32_t>(std::min(NodeCapacity, m_items.size() - i));
+    node.bounds = m_entries[m_items[i]].rect;
+
+    for (uint32_t j(node.first + 1); j < node.first + node.count; ++j)
+      node.bounds = united(node.bounds, m_entries[m_items[j]].rect);
+
+    m_nodes.push_back(node);
+  }
+
+  m_leaf_count = m_nodes.size();
+
+  size_t level_begin = 0;
+  size_t level_end = m_nodes.size();
+
+  while (level_end - level_begin > 1)
+  {
+    str_sort(m_nodes.data() + level_begin, level_end - level_begin, [](const TreeNode& n) -> const Rect& {
+      return n.bounds;
+      });
+
+    for (size_t i(level_begin); i < level_end; i += NodeCapacity)
+    {
+      TreeNode node;
+      node.first = static_cast<uint32_t>(i);
+      node.count = static_cast<uint32_t>(std::min(NodeCapacity, level_end - i));
+      node.bounds = m_nodes[i].bounds;
+
+      for (uint32_t j(node.first + 1); j < node.first + node.count; ++j)
+        node.bounds = united(node.bounds, m_nodes[j].bounds);
+
+      m_nodes.push_back(node);
+    }
+
+    level_begin = level_end;
+    level_end = m_nodes.size();
+  }
+}
+
+} // namespace tex
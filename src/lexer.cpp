@@ -4,6 +4,15 @@
 
 #include "tex/lexer.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LIBTYPESET_LEXER_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 namespace tex
 {
 
@@ -269,6 +278,191 @@ const Lexer::CatCodeTable Lexer::DefaultCatCodes = {
   CharCategory::Other,
 };
 
+const size_t Lexer::MaxScanStops;
+
+// Categories that the state machine must handle one character at a time
+static bool is_stop(CharCategory cc)
+{
+  switch (cc)
+  {
+  case CharCategory::Escape:
+  case CharCategory::EndOfLine:
+  case CharCategory::Parameter:
+  case CharCategory::Comment:
+  case CharCategory::Invalid:
+    return true;
+  default:
+    return false;
+  }
+}
+
+#if defined(LIBTYPESET_LEXER_SSE2)
+
+inline static int first_bit(int mask)
+{
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanForward(&index, static_cast<unsigned long>(mask));
+  return static_cast<int>(index);
+#else
+  return __builtin_ctz(static_cast<unsigned>(mask));
+#endif
+}
+
+#endif // defined(LIBTYPESET_LEXER_SSE2)
+
+/*!
+ * \fn void classify()
+ * \brief prepares the tables used by write(const char*, size_t) for the current catcodes
+ *
+ * Blocks of 16 characters can be scanned with SSE2 when the printable 
+ * ASCII characters of the stop categories (escape, end of line, parameter, 
+ * comment and invalid) are few enough to be compared one by one; control 
+ * and non-ASCII characters always go through the lookup table.
+ */
+void Lexer::classify()
+{
+  m_classes.catcodes = catcodes();
+  m_classes.scan_stop_count = 0;
+  m_classes.scan = true;
+
+  for (size_t i(0); i < 256; ++i)
+  {
+    m_classes.stops[i] = is_stop(m_classes.catcodes[i]);
+
+    if (m_classes.stops[i] && i >= 0x20 && i < 0x80)
+    {
+      if (m_classes.scan_stop_count == MaxScanStops)
+        m_classes.scan = false;
+      else
+        m_classes.scan_stops[m_classes.scan_stop_count++] = static_cast<char>(i);
+    }
+  }
+}
+
+/*!
+ * \fn size_t scan(const char* data, size_t n) const
+ * \brief returns the number of characters before the first one of a stop category
+ */
+size_t Lexer::scan(const char* data, size_t n) const
+{
+  size_t i = 0;
+
+  while (i < n)
+  {
+#if defined(LIBTYPESET_LEXER_SSE2)
+    if (m_classes.scan)
+    {
+      // bytes below 0x20 or above 0x7F compare as less than 0x20
+      const __m128i space = _mm_set1_epi8(0x20);
+
+      while (i + 16 <= n)
+      {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i hits = _mm_cmplt_epi8(block, space);
+
+        for (size_t j(0); j < m_classes.scan_stop_count; ++j)
+          hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, _mm_set1_epi8(m_classes.scan_stops[j])));
+
+        const int mask = _mm_movemask_epi8(hits);
+
+        if (mask == 0)
+        {
+          i += 16;
+        }
+        else
+        {
+          i += first_bit(mask);
+          break;
+        }
+      }
+
+      if (i == n)
+        break;
+    }
+#endif // defined(LIBTYPESET_LEXER_SSE2)
+
+    if (m_classes.stops[static_cast<unsigned char>(data[i])])
+      break;
+
+    ++i;
+  }
+
+  return i;
+}
+
+/*!
+ * \fn void produceRun(const char* data, size_t n)
+ * \brief produces the tokens of characters that contain no stop category
+ */
+void Lexer::produceRun(const char* data, size_t n)
+{
+  const size_t first = m_tokens.size();
+  m_tokens.resize(first + n);
+
+  Token* out = m_tokens.data() + first;
+  LexerState s = state();
+
+  for (size_t i(0); i < n; ++i)
+  {
+    const char c = data[i];
+    const CharCategory cc = m_state.catcodes[static_cast<unsigned char>(c)];
+
+    if (cc == CharCategory::Space)
+    {
+      if (s == LexerState::StateM)
+      {
+        *(out++) = Token{ CharacterToken{ ' ', CharCategory::Space } };
+        s = LexerState::StateS;
+      }
+    }
+    else if (cc != CharCategory::Ignored)
+    {
+      *(out++) = Token{ CharacterToken{ c, cc } };
+      s = LexerState::StateM;
+    }
+  }
+
+  m_tokens.resize(static_cast<size_t>(out - m_tokens.data()));
+  state() = s;
+}
+
+/*!
+ * \fn void write(const char* data, size_t n)
+ * \brief writes several characters at once
+ *
+ * This produces the same tokens as writing the characters one by one, 
+ * but runs of characters that do not change the state of the lexer 
+ * are located in blocks and their tokens produced in a single loop.
+ * The catcodes may be changed between two calls.
+ */
+void Lexer::write(const char* data, size_t n)
+{
+  if (m_classes.catcodes != catcodes())
+    classify();
+
+  const char* const end = data + n;
+
+  while (data != end)
+  {
+    const LexerState s = state();
+
+    if (s == LexerState::StateN || s == LexerState::StateM || s == LexerState::StateS)
+    {
+      const size_t len = scan(data, static_cast<size_t>(end - data));
+
+      if (len > 0)
+      {
+        produceRun(data, len);
+        data += len;
+        continue;
+      }
+    }
+
+    write(*(data++));
+  }
+}
+
 } // namespace parsing
 
 } // namespace tex
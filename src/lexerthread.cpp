@@ -0,0 +1,457 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/lexerthread.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace tex
+{
+
+namespace parsing
+{
+
+const size_t LexerThread::DefaultCapacity;
+
+// Number of failed attempts spent spinning, then yielding, before a 
+// thread sleeps on the condition variable
+static const size_t BusySpins = 64;
+static const size_t YieldSpins = 128;
+
+// The consumer checks whether the producer sleeps every WakeInterval tokens
+static const uint64_t WakeInterval = 64;
+
+LexerThread::LexerThread(std::unique_ptr<InputSource> input, const Lexer::CatCodeTable& catcodes, size_t capacity)
+  : m_input(std::move(input)),
+    m_queue(capacity),
+    m_catcodes(catcodes),
+    m_consumed(0),
+    m_pause(false),
+    m_stop(false),
+    m_finished(false),
+    m_producer_waiting(false),
+    m_consumer_waiting(false),
+    m_producer_sleeps(0),
+    m_consumer_sleeps(0)
+{
+  m_lexer.catcodes() = catcodes;
+  m_thread = std::thread(&LexerThread::run, this);
+}
+
+LexerThread::~LexerThread()
+{
+  {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    m_stop = true;
+  }
+
+  m_cv.notify_all();
+  m_thread.join();
+}
+
+/*!
+ * \fn bool read(Item& item)
+ * \brief reads the next token, waiting for the lexer thread if needed
+ *
+ * Returns false at the end of the input.
+ */
+bool LexerThread::read(Item& item)
+{
+  for (size_t spins(0);; ++spins)
+  {
+    if (m_queue.pop(item))
+    {
+      m_consumed.store(++m_read, std::memory_order_release);
+
+      if (m_read % WakeInterval == 0)
+        wakeProducer();
+
+      return true;
+    }
+
+    if (m_finished.load(std::memory_order_acquire))
+    {
+      // the last tokens may have been pushed just before
+      if (m_queue.pop(item))
+      {
+        m_consumed.store(++m_read, std::memory_order_release);
+        return true;
+      }
+
+      if (m_error)
+        std::rethrow_exception(m_error);
+
+      return false;
+    }
+
+    wakeProducer();
+
+    if (spins >= YieldSpins)
+      waitForTokens();
+    else if (spins >= BusySpins)
+      std::this_thread::yield();
+  }
+}
+
+/*!
+ * \fn void setCatcodes(const Lexer::CatCodeTable& catcodes)
+ * \brief changes the catcodes used for the characters that follow the last token read
+ *
+ * The tokens that were lexed ahead are discarded.
+ */
+void LexerThread::setCatcodes(const Lexer::CatCodeTable& catcodes)
+{
+  if (catcodes == m_catcodes)
+    return;
+
+  {
+    std::unique_lock<std::mutex> lock{ m_mutex };
+    m_pause = true;
+    m_cv.notify_all();
+    m_cv.wait(lock, [this]() { return m_parked; });
+  }
+
+  // the lexer thread is parked and does not touch its state
+  resync(catcodes);
+  m_catcodes = catcodes;
+
+  {
+    std::lock_guard<std::mutex> lock{ m_mutex };
+    m_pause = false;
+  }
+
+  m_cv.notify_all();
+}
+
+void LexerThread::run()
+{
+  for (;;)
+  {
+    const bool idle = m_finished.load(std::memory_order_relaxed);
+
+    if (idle || m_pause.load(std::memory_order_acquire) || m_stop.load(std::memory_order_acquire))
+    {
+      std::unique_lock<std::mutex> lock{ m_mutex };
+      m_cv.wait(lock, [this]() { return m_stop || m_pause || !m_finished; });
+
+      if (m_pause && !m_stop)
+      {
+        m_parked = true;
+        m_cv.notify_all();
+        m_cv.wait(lock, [this]() { return m_stop || !m_pause; });
+        m_parked = false;
+      }
+
+      if (m_stop)
+        return;
+
+      if (m_finished)
+        continue;
+    }
+
+    try
+    {
+      if (!step())
+        m_finished.store(true, std::memory_order_release);
+    }
+    catch (...)
+    {
+      m_error = std::current_exception();
+      m_finished.store(true, std::memory_order_release);
+    }
+
+    if (m_finished.load(std::memory_order_relaxed))
+    {
+      {
+        std::lock_guard<std::mutex> lock{ m_mutex };
+      }
+
+      m_cv.notify_all();
+    }
+  }
+}
+
+// Lexes the next line, returns false at the end of the input
+bool LexerThread::step()
+{
+  if (m_lex_offset == m_history_offset + m_history.size() && !readLine())
+    return false;
+
+  const char* text = m_history.data() + (m_lex_offset - m_history_offset);
+  const size_t available = m_history_offset + m_history.size() - m_lex_offset;
+  const char* eol = static_cast<const char*>(std::memchr(text, '\n', available));
+
+  Line l;
+  l.offset = m_lex_offset;
+  l.size = eol != nullptr ? static_cast<size_t>(eol - text) + 1 : available;
+  l.state = m_lexer.state();
+  l.line = m_line;
+  l.column = m_column;
+  l.first_token = m_produced;
+
+  std::exception_ptr error;
+
+  try
+  {
+    m_lexer.write(text, l.size);
+  }
+  catch (...)
+  {
+    error = std::current_exception();
+  }
+
+  l.end_token = m_produced + m_lexer.output().size();
+  m_lines.push_back(l);
+  m_lex_offset += l.size;
+
+  if (eol != nullptr)
+  {
+    m_line += 1;
+    m_column = 0;
+  }
+  else
+  {
+    m_column += l.size;
+  }
+
+  Item item;
+  item.line = static_cast<uint32_t>(l.line);
+  item.column = static_cast<uint32_t>(l.column);
+
+  for (const Token& t : m_lexer.output())
+  {
+    item.token = t;
+
+    for (size_t spins(0); !m_queue.push(item); ++spins)
+    {
+      // the tokens are discarded by setCatcodes()
+      if (m_pause.load(std::memory_order_acquire) || m_stop.load(std::memory_order_acquire))
+      {
+        m_lexer.output().clear();
+        return true;
+      }
+
+      if (spins >= YieldSpins)
+        waitForRoom();
+      else if (spins >= BusySpins)
+        std::this_thread::yield();
+    }
+
+    ++m_produced;
+  }
+
+  m_lexer.output().clear();
+  wakeConsumer();
+
+  if (error)
+    std::rethrow_exception(error);
+
+  trim();
+  return true;
+}
+
+/*
+ * Sleeping uses m_mutex and m_cv. Each side publishes that it sleeps in
+ * a flag that the other side reads after its last push (or pop); the 
+ * sequentially consistent fences make sure that either the sleeper sees 
+ * the new state of the queue or the other side sees the flag.
+ */
+
+// Producer side: sleeps until the queue is at most half full
+void LexerThread::waitForRoom()
+{
+  wakeConsumer();
+
+  std::unique_lock<std::mutex> lock{ m_mutex };
+  m_producer_sleeps.fetch_add(1, std::memory_order_relaxed);
+  m_producer_waiting.store(true, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  m_cv.wait(lock, [this]() {
+    return m_stop || m_pause || m_queue.size() <= m_queue.capacity() / 2;
+    });
+
+  m_producer_waiting.store(false, std::memory_order_relaxed);
+}
+
+// Consumer side: sleeps until the queue is not empty or the input has ended
+void LexerThread::waitForTokens()
+{
+  std::unique_lock<std::mutex> lock{ m_mutex };
+  m_consumer_sleeps.fetch_add(1, std::memory_order_relaxed);
+  m_consumer_waiting.store(true, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  m_cv.wait(lock, [this]() {
+    return !m_queue.empty() || m_finished.load(std::memory_order_acquire);
+    });
+
+  m_consumer_waiting.store(false, std::memory_order_relaxed);
+}
+
+void LexerThread::wakeProducer()
+{
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  if (m_producer_waiting.load(std::memory_order_relaxed) && m_queue.size() <= m_queue.capacity() / 2)
+  {
+    {
+      std::lock_guard<std::mutex> lock{ m_mutex };
+    }
+
+    m_cv.notify_all();
+  }
+}
+
+void LexerThread::wakeConsumer()
+{
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+
+  if (m_consumer_waiting.load(std::memory_order_relaxed))
+  {
+    {
+      std::lock_guard<std::mutex> lock{ m_mutex };
+    }
+
+    m_cv.notify_all();
+  }
+}
+
+// Appends the next line of the input to the history
+bool LexerThread::readLine()
+{
+  bool result = false;
+
+  while (!m_input->atEnd())
+  {
+    const char* data = nullptr;
+    const size_t n = m_input->read(data);
+    m_history.append(data, n);
+    result = true;
+
+    if (data[n - 1] == '\n')
+      break;
+  }
+
+  return result;
+}
+
+// Forgets the lines whose tokens have all been read, except the line of 
+// the last token read
+void LexerThread::trim()
+{
+  const uint64_t consumed = m_consumed.load(std::memory_order_acquire);
+
+  while (!m_lines.empty() && m_lines.front().end_token < consumed)
+    m_lines.pop_front();
+
+  const size_t keep = m_lines.empty() ? m_lex_offset : m_lines.front().offset;
+  const size_t unused = keep - m_history_offset;
+
+  if (unused > 64 * 1024 && unused > m_history.size() / 2)
+  {
+    m_history.erase(0, unused);
+    m_history_offset = keep;
+  }
+}
+
+void LexerThread::resync(const Lexer::CatCodeTable& catcodes)
+{
+  Item discarded;
+
+  while (m_queue.pop(discarded));
+
+  m_lexer.output().clear();
+  m_error = nullptr;
+  m_finished.store(false, std::memory_order_relaxed);
+
+  const uint64_t k = m_read;
+  auto it = m_lines.begin();
+
+  if (k > 0)
+  {
+    while (it != m_lines.end() && !(it->first_token < k && k <= it->end_token))
+      ++it;
+
+    if (it == m_lines.end())
+      throw std::logic_error{ "LexerThread: the line of the last token read was lost" };
+  }
+
+  LexerState state = m_lexer.state();
+  size_t resume = 0;
+
+  if (it == m_lines.end())
+  {
+    // nothing was lexed yet
+  }
+  else if (k == it->first_token)
+  {
+    state = it->state;
+    m_lex_offset = it->offset;
+  }
+  else
+  {
+    // Lex the line again, with the old catcodes, until the last token read
+    Lexer lexer;
+    lexer.catcodes() = m_lexer.catcodes();
+    lexer.state() = it->state;
+
+    const char* text = m_history.data() + (it->offset - m_history_offset);
+    const size_t count = static_cast<size_t>(k - it->first_token);
+    bool word = false;
+
+    for (;;)
+    {
+      if (resume == it->size)
+        throw std::logic_error{ "LexerThread: the last token read was not found" };
+
+      const char c = text[resume];
+      const CharCategory cc = lexer.category(c);
+      const LexerState before = lexer.state();
+      const bool ends_word = word && cc != CharCategory::Letter && cc != CharCategory::EndOfLine;
+      const size_t produced = lexer.output().size();
+
+      lexer.write(c);
+      word = before == LexerState::StateCS && cc == CharCategory::Letter;
+
+      if (lexer.output().size() >= count)
+      {
+        if (ends_word && produced + 1 == count)
+        {
+          // the character that ended the control word was not read
+          state = LexerState::StateS;
+        }
+        else
+        {
+          state = lexer.state();
+          resume += 1;
+        }
+
+        break;
+      }
+
+      resume += 1;
+    }
+
+    m_lex_offset = it->offset + resume;
+  }
+
+  if (it != m_lines.end())
+  {
+    m_line = it->line;
+    m_column = it->column + resume;
+    m_lines.erase(it, m_lines.end());
+  }
+
+  m_produced = k;
+
+  m_lexer = Lexer();
+  m_lexer.catcodes() = catcodes;
+  m_lexer.state() = state;
+}
+
+} // namespace parsing
+
+} // namespace tex
@@ -0,0 +1,157 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/mappedfile.h"
+
+#include <stdexcept>
+#include <utility>
+
+#if defined(WIN32) || defined(_WIN32)
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <Windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+namespace tex
+{
+
+#if defined(WIN32) || defined(_WIN32)
+
+static const uint8_t* map_file(const std::string& path, size_t& size)
+{
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+  if (file == INVALID_HANDLE_VALUE)
+    throw std::runtime_error{ "could not open " + path };
+
+  LARGE_INTEGER file_size;
+
+  if (!GetFileSizeEx(file, &file_size))
+  {
+    CloseHandle(file);
+    throw std::runtime_error{ "could not read size of " + path };
+  }
+
+  size = static_cast<size_t>(file_size.QuadPart);
+
+  if (size == 0)
+  {
+    CloseHandle(file);
+    return nullptr;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+
+  if (mapping == nullptr)
+    throw std::runtime_error{ "could not map " + path };
+
+  // The view keeps the mapping alive
+  void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+
+  if (data == nullptr)
+    throw std::runtime_error{ "could not map " + path };
+
+  return static_cast<const uint8_t*>(data);
+}
+
+static void unmap_file(const uint8_t* data, size_t /* size */)
+{
+  UnmapViewOfFile(data);
+}
+
+#else
+
+static const uint8_t* map_file(const std::string& path, size_t& size)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+
+  if (fd == -1)
+    throw std::runtime_error{ "could not open " + path };
+
+  struct stat st;
+
+  if (fstat(fd, &st) == -1)
+  {
+    ::close(fd);
+    throw std::runtime_error{ "could not read size of " + path };
+  }
+
+  size = static_cast<size_t>(st.st_size);
+
+  if (size == 0)
+  {
+    ::close(fd);
+    return nullptr;
+  }
+
+  // The mapping stays valid after the descriptor is closed
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+
+  if (data == MAP_FAILED)
+    throw std::runtime_error{ "could not map " + path };
+
+  return static_cast<const uint8_t*>(data);
+}
+
+static void unmap_file(const uint8_t* data, size_t size)
+{
+  munmap(const_cast<uint8_t*>(data), size);
+}
+
+#endif
+
+MappedFile::MappedFile(const std::string& path)
+{
+  m_data = map_file(path, m_size);
+  m_open = true;
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+  : m_data(other.m_data),
+    m_size(other.m_size),
+    m_open(other.m_open)
+{
+  other.m_data = nullptr;
+  other.m_size = 0;
+  other.m_open = false;
+}
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+void MappedFile::close()
+{
+  if (m_data != nullptr)
+    unmap_file(m_data, m_size);
+
+  m_data = nullptr;
+  m_size = 0;
+  m_open = false;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+  if (this != &other)
+  {
+    close();
+    std::swap(m_data, other.m_data);
+    std::swap(m_size, other.m_size);
+    std::swap(m_open, other.m_open);
+  }
+
+  return *this;
+}
+
+} // namespace tex
@@ -5,6 +5,7 @@
 #include "tex/math/math-typeset.h"
 
 #include "tex/glue.h"
+#include "tex/glyphmetricscache.h"
 #include "tex/hbox.h"
 #include "tex/kern.h"
 #include "tex/penalty.h"
@@ -118,6 +119,7 @@ std::shared_ptr<TypesetEngine> MathTypesetter::sharedEngine() const
 void MathTypesetter::setFonts(const std::array<MathFont, 16>& fonts)
 {
   m_fonts = fonts;
+  resolveMetrics();
 
   auto strut = mathstrut();
 
@@ -125,6 +127,14 @@ void MathTypesetter::setFonts(const std::array<MathFont, 16>& fonts)
   m_lineskip = tex::glue(0.1f * strut->totalHeight());
 }
 
+void MathTypesetter::inheritFonts(const MathTypesetter& parent)
+{
+  m_fonts = parent.m_fonts;
+  m_metrics = parent.m_metrics;
+  m_baselineskip = parent.m_baselineskip;
+  m_lineskip = parent.m_lineskip;
+}
+
 int MathTypesetter::relpenalty() const
 {
   return m_relpenalty;
@@ -207,28 +217,72 @@ Font MathTypesetter::getFont(int fam) const
 
 Font MathTypesetter::getFont(int fam, math::Style style) const
 {
-  if (style <= math::Style::SS)
+  switch (sizeIndex(style))
   {
+  case 2:
     return m_fonts[fam].scriptscriptfont;
-  }
-  else if (style <= math::Style::S)
-  {
+  case 1:
     return m_fonts[fam].scriptfont;
+  default:
+    return m_fonts[fam].textfont;
   }
+}
+
+int MathTypesetter::sizeIndex(math::Style style)
+{
+  if (style <= math::Style::SS)
+    return 2;
+  else if (style <= math::Style::S)
+    return 1;
   else
+    return 0;
+}
+
+// Fonts that cannot be resolved yet (e.g. not loaded, which providers 
+// report with std::out_of_range) are retried the first time they are used.
+void MathTypesetter::resolveMetrics()
+{
+  FontMetricsProvider& provider = *engine().glyphMetrics();
+
+  for (size_t fam(0); fam < m_fonts.size(); ++fam)
   {
-    return m_fonts[fam].textfont;
+    const Font fonts[3] = { m_fonts[fam].textfont, m_fonts[fam].scriptfont, m_fonts[fam].scriptscriptfont };
+
+    for (size_t i(0); i < 3; ++i)
+    {
+      m_metrics[fam][i] = ResolvedFontMetrics{};
+
+      if (fonts[i].id() < 0)
+        continue;
+
+      try
+      {
+        m_metrics[fam][i] = ResolvedFontMetrics{ fonts[i], provider.fontdimen(fonts[i]) };
+      }
+      catch (const std::out_of_range&)
+      {
+        // not loaded yet
+      }
+    }
   }
 }
 
-FontMetrics MathTypesetter::getMetrics(int fam) const
+const ResolvedFontMetrics& MathTypesetter::getMetrics(int fam) const
 {
-  return FontMetrics{ getFont(fam), engine().metrics() };
+  return getMetrics(fam, m_current_style);
 }
 
-FontMetrics MathTypesetter::getMetrics(int fam, math::Style style) const
+const ResolvedFontMetrics& MathTypesetter::getMetrics(int fam, math::Style style) const
 {
-  return FontMetrics{ getFont(fam, style), engine().metrics() };
+  ResolvedFontMetrics& result = m_metrics[fam][sizeIndex(style)];
+
+  if (!result.isValid())
+  {
+    const Font f = getFont(fam, style);
+    result = ResolvedFontMetrics{ f, engine().glyphMetrics()->fontdimen(f) };
+  }
+
+  return result;
 }
 
 std::shared_ptr<Box> MathTypesetter::nullbox()
@@ -239,7 +293,7 @@ std::shared_ptr<Box> MathTypesetter::nullbox()
 
 std::shared_ptr<Box> MathTypesetter::typeset(std::shared_ptr<MathSymbol> symbol)
 {
-  return engine().typeset(symbol, getFont(symbol->family()));
+  return engine().characterBox(symbol->character(), getFont(symbol->family()));
 }
 
 std::shared_ptr<Box> MathTypesetter::typesetDelimiter(const std::shared_ptr<Symbol>& ms, float minTotalHeight)
@@ -288,7 +342,7 @@ std::shared_ptr<Box> MathTypesetter::boxit(std::shared_ptr<Node> node)
   {
     MathList mlist = cast<MathListNode>(node)->list();
     MathTypesetter typesetter{ sharedEngine() };
-    typesetter.setFonts(m_fonts);
+    typesetter.inheritFonts(*this);
     List hlist = typesetter.mlist2hlist(std::move(mlist), m_current_style);
     return tex::hbox(std::move(hlist));
   }
@@ -311,7 +365,7 @@ std::shared_ptr<HBox> MathTypesetter::boxit(MathList mlist)
 std::shared_ptr<HBox> MathTypesetter::boxit(MathList mlist, math::Style s)
 {
   MathTypesetter typesetter{ sharedEngine() };
-  typesetter.setFonts(m_fonts);
+  typesetter.inheritFonts(*this);
 
   List hlist = typesetter.mlist2hlist(std::move(mlist), s);
   return tex::hbox(std::move(hlist));
@@ -329,7 +383,7 @@ std::shared_ptr<Box> MathTypesetter::mathstrut()
 {
   static const auto leftpar = std::make_shared<tex::MathSymbol>('(', math::Atom::Open, 3);
 
-  BoxMetrics metrics = getMetrics(XiFamily, math::Style::D).metrics(leftpar);
+  BoxMetrics metrics = engine().glyphMetrics()->metrics(leftpar, getFont(XiFamily, math::Style::D));
   metrics.width = 0.f;
 
   return std::make_shared<VBox>(metrics);
@@ -573,7 +627,7 @@ void MathTypesetter::rule13_opatom(MathList& mlist, MathList::iterator& current)
     auto mathsymbol = cast<MathSymbol>(atom->nucleus());
 
     auto x = engine().typesetLargeOp(mathsymbol);
-    delta = getMetrics(mathsymbol->family()).italicCorrection(mathsymbol);
+    delta = engine().glyphMetrics()->italicCorrection(mathsymbol, getFont(mathsymbol->family()));
     const float a = getMetrics(SigmaFamily).axisHeight();
     auto boxed_x = tex::hbox({ x });
     boxed_x->setShiftAmount(0.5f * (x->height() - x->depth()) - a);
@@ -0,0 +1,212 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/parsing/expansionprofiler.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <string>
+
+namespace tex
+{
+
+namespace parsing
+{
+
+ExpansionProfiler::ExpansionProfiler()
+{
+  clear();
+}
+
+/*!
+ * \fn void expand(CsId cs, size_t tokens)
+ * \brief records the expansion of a macro into the given number of tokens
+ *
+ * The tokens are expected to have been inserted at the front of the input.
+ */
+void ExpansionProfiler::expand(CsId cs, size_t tokens)
+{
+  MacroStats& s = statsOf(cs);
+  s.invocations += 1;
+  s.tokens += tokens;
+
+  const size_t parent = m_frames.empty() ? 0 : m_frames.back().node;
+
+  if (tokens > 0)
+    m_frames.push_back(Frame{ child(parent, cs), tokens });
+
+  const size_t depth = tokens > 0 ? m_frames.size() : m_frames.size() + 1;
+  s.max_depth = std::max(s.max_depth, depth);
+  m_max_depth = std::max(m_max_depth, depth);
+}
+
+/*!
+ * \fn void insert(size_t tokens)
+ * \brief records tokens inserted at the front of the input by something else than a macro
+ *
+ * The tokens belong to the current input level.
+ */
+void ExpansionProfiler::insert(size_t tokens)
+{
+  if (!m_frames.empty())
+    m_frames.back().remaining += tokens;
+}
+
+/*!
+ * \fn void consume(size_t tokens)
+ * \brief records tokens read from the input
+ */
+void ExpansionProfiler::consume(size_t tokens)
+{
+  while (tokens > 0 && !m_frames.empty())
+  {
+    Frame& f = m_frames.back();
+    const size_t n = std::min(tokens, f.remaining);
+
+    m_nodes[f.node].samples += n;
+    f.remaining -= n;
+    tokens -= n;
+
+    if (f.remaining == 0)
+      m_frames.pop_back();
+  }
+}
+
+void ExpansionProfiler::match(CsId cs, std::chrono::nanoseconds time)
+{
+  statsOf(cs).match_time += time;
+}
+
+void ExpansionProfiler::primitive(Primitive p)
+{
+  m_primitives[p] += 1;
+}
+
+const ExpansionProfiler::MacroStats* ExpansionProfiler::stats(CsId cs) const
+{
+  if (cs >= m_stats.size() || m_stats[cs].cs == CsTable::Invalid)
+    return nullptr;
+
+  return &m_stats[cs];
+}
+
+/*!
+ * \fn std::vector<MacroStats> report() const
+ * \brief returns the statistics of the expanded macros
+ *
+ * Macros are sorted by decreasing number of produced tokens, then by
+ * decreasing number of invocations.
+ */
+std::vector<ExpansionProfiler::MacroStats> ExpansionProfiler::report() const
+{
+  std::vector<MacroStats> result;
+
+  for (const MacroStats& s : m_stats)
+  {
+    if (s.cs != CsTable::Invalid)
+      result.push_back(s);
+  }
+
+  std::sort(result.begin(), result.end(), [](const MacroStats& a, const MacroStats& b) {
+    if (a.tokens != b.tokens)
+      return a.tokens > b.tokens;
+    else if (a.invocations != b.invocations)
+      return a.invocations > b.invocations;
+    else
+      return CsTable::global().name(a.cs) < CsTable::global().name(b.cs);
+    });
+
+  return result;
+}
+
+void ExpansionProfiler::writeReport(std::ostream& out) const
+{
+  out << std::left << std::setw(24) << "macro"
+    << std::right << std::setw(12) << "calls"
+    << std::setw(12) << "tokens"
+    << std::setw(14) << "match (us)"
+    << std::setw(8) << "depth" << "\n";
+
+  for (const MacroStats& s : report())
+  {
+    out << std::left << std::setw(24) << ("\\" + CsTable::global().name(s.cs))
+      << std::right << std::setw(12) << s.invocations
+      << std::setw(12) << s.tokens
+      << std::setw(14) << std::chrono::duration_cast<std::chrono::microseconds>(s.match_time).count()
+      << std::setw(8) << s.max_depth << "\n";
+  }
+
+  out << "\n";
+  out << "\\csname: " << m_primitives[Csname] << "\n";
+  out << "\\expandafter: " << m_primitives[Expandafter] << "\n";
+  out << "\\ifbr: " << m_primitives[Ifbr] << "\n";
+  out << "max depth: " << m_max_depth << "\n";
+}
+
+/*!
+ * \fn void writeFoldedStacks(std::ostream& out) const
+ * \brief writes the samples in the folded-stack format used by flame graph tools
+ *
+ * Each line holds a stack of macros, outermost first and separated by
+ * semicolons, followed by the number of tokens read while that stack
+ * was active.
+ */
+void ExpansionProfiler::writeFoldedStacks(std::ostream& out) const
+{
+  std::vector<std::string> lines;
+
+  for (size_t i(1); i < m_nodes.size(); ++i)
+  {
+    if (m_nodes[i].samples == 0)
+      continue;
+
+    std::string stack;
+
+    for (size_t n = i; n != 0; n = m_nodes[n].parent)
+      stack = CsTable::global().name(m_nodes[n].cs) + (stack.empty() ? "" : ";") + stack;
+
+    lines.push_back(stack + " " + std::to_string(m_nodes[i].samples));
+  }
+
+  std::sort(lines.begin(), lines.end());
+
+  for (const std::string& l : lines)
+    out << l << "\n";
+}
+
+void ExpansionProfiler::clear()
+{
+  m_stats.clear();
+  m_nodes.assign(1, Node{ CsTable::Invalid, 0, 0 });
+  m_children.clear();
+  m_frames.clear();
+  m_max_depth = 0;
+  std::fill(std::begin(m_primitives), std::end(m_primitives), size_t(0));
+}
+
+ExpansionProfiler::MacroStats& ExpansionProfiler::statsOf(CsId cs)
+{
+  if (cs >= m_stats.size())
+    m_stats.resize(cs + 1);
+
+  m_stats[cs].cs = cs;
+  return m_stats[cs];
+}
+
+size_t ExpansionProfiler::child(size_t node, CsId cs)
+{
+  const uint64_t key = (static_cast<uint64_t>(node) << 32) | cs;
+  auto it = m_children.find(key);
+
+  if (it != m_children.end())
+    return it->second;
+
+  m_nodes.push_back(Node{ cs, node, 0 });
+  m_children[key] = m_nodes.size() - 1;
+  return m_nodes.size() - 1;
+}
+
+} // namespace parsing
+
+} // namespace tex
@@ -7,7 +7,11 @@
 #include "tex/lexer.h"
 #include "tex/parsing/preprocessor.h"
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
 
 namespace tex
 {
@@ -20,10 +24,7 @@ std::vector<Macro> Format::parse(const std::string& src)
   parsing::Lexer lex;
   lex.catcodes()['@'] = parsing::CharCategory::Letter; // \makeatletter
 
-  for (char c : src)
-  {
-    lex.write(c);
-  }
+  lex.write(src);
 
   parsing::Preprocessor preproc;
 
@@ -34,17 +35,457 @@ std::vector<Macro> Format::parse(const std::string& src)
 
   std::vector<Macro> result;
 
-  for (const auto& blocks : preproc.macros())
+  for (const Macro* m : preproc.macros().macros())
   {
-    for (const auto& e : blocks.macros)
+    result.push_back(*m);
+  }
+
+  std::sort(result.begin(), result.end(), [](const Macro& a, const Macro& b) {
+    return a.controlSequence() < b.controlSequence();
+    });
+
+  return result;
+}
+
+/*!
+ * \fn void dump(const std::string& src, std::ostream& out)
+ * \brief parses a format and writes its binary image
+ */
+void Format::dump(const std::string& src, std::ostream& out)
+{
+  FormatImage::dump(out, parse(src));
+}
+
+/*
+ * Layout of an image, in native byte order; all sections start on a 
+ * 4-byte boundary:
+ * - the header;
+ * - the catcode table (256 bytes) and the math code table (256 int32);
+ * - the name table: name_count + 1 offsets into the string data, 
+ *   followed by the string data;
+ * - the macro records;
+ * - the name index: index_size slots (a power of 2) holding the index of 
+ *   a macro plus one, or 0, probed linearly from the hash of the name;
+ * - the token records.
+ */
+
+struct FormatImage::Header
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t name_count;
+  uint32_t string_size;
+  uint32_t macro_count;
+  uint32_t index_size;
+  uint32_t token_count;
+};
+
+struct FormatImage::MacroRecord
+{
+  uint32_t name;
+  uint32_t param_offset;
+  uint32_t param_size;
+  uint32_t repl_offset;
+  uint32_t repl_size;
+};
+
+struct FormatImage::TokenRecord
+{
+  uint32_t value;
+  uint8_t type;
+  uint8_t category;
+  uint16_t reserved;
+};
+
+const uint32_t FormatImage::Version;
+
+static const char FormatMagic[4] = { 'T', 'X', 'F', 'M' };
+static const uint32_t FormatByteOrder = 0x01020304;
+
+static const int32_t LookupUnknown = -2;
+static const int32_t LookupAbsent = -1;
+
+static uint32_t name_hash(const char* str, size_t len)
+{
+  // FNV-1a
+  uint32_t h = 2166136261u;
+
+  for (size_t i(0); i < len; ++i)
+  {
+    h ^= static_cast<uint8_t>(str[i]);
+    h *= 16777619u;
+  }
+
+  return h;
+}
+
+static size_t aligned(size_t n)
+{
+  return (n + 3) & ~size_t(3);
+}
+
+template<typename T>
+static void write_array(std::ostream& out, const T* data, size_t n)
+{
+  out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(n * sizeof(T)));
+}
+
+static void write_padding(std::ostream& out, size_t n)
+{
+  static const char zeros[4] = { 0, 0, 0, 0 };
+  out.write(zeros, static_cast<std::streamsize>(aligned(n) - n));
+}
+
+FormatImage::FormatImage(const std::string& path)
+  : m_file(path)
+{
+  load(m_file.data(), m_file.size());
+}
+
+FormatImage::FormatImage(std::vector<uint8_t> data)
+  : m_buffer(std::move(data))
+{
+  load(m_buffer.data(), m_buffer.size());
+}
+
+FormatImage::~FormatImage()
+{
+
+}
+
+/*!
+ * \fn void dump(std::ostream& out, const std::vector<Macro>& macros, const Lexer::CatCodeTable& catcodes, const MathCode::Table& mathcodes)
+ * \brief writes the binary image of a format
+ */
+void FormatImage::dump(std::ostream& out, const std::vector<Macro>& macros, const Lexer::CatCodeTable& catcodes, const MathCode::Table& mathcodes)
+{
+  std::unordered_map<CsId, uint32_t> name_ids;
+  std::vector<uint32_t> name_offsets{ 0 };
+  std::string strings;
+
+  auto name_id = [&](CsId cs) -> uint32_t {
+    auto it = name_ids.find(cs);
+
+    if (it != name_ids.end())
+      return it->second;
+
+    const uint32_t id = static_cast<uint32_t>(name_ids.size());
+    name_ids[cs] = id;
+    strings += CsTable::global().name(cs);
+    name_offsets.push_back(static_cast<uint32_t>(strings.size()));
+    return id;
+  };
+
+  std::vector<MacroRecord> records;
+  std::vector<TokenRecord> tokens;
+
+  auto write_tokens = [&](const std::vector<Token>& toks) {
+    for (const Token& t : toks)
     {
-      result.push_back(e.second);
+      TokenRecord r{ 0, static_cast<uint8_t>(t.type()), 0, 0 };
+
+      if (t.isCharacterToken())
+      {
+        r.value = static_cast<uint8_t>(t.characterToken().value);
+        r.category = static_cast<uint8_t>(t.characterToken().category);
+      }
+      else if (t.isControlSequence())
+      {
+        r.value = name_id(t.controlSequenceId());
+      }
+      else
+      {
+        r.value = static_cast<uint32_t>(t.parameterNumber());
+      }
+
+      tokens.push_back(r);
     }
+  };
+
+  for (const Macro& m : macros)
+  {
+    MacroRecord r;
+    r.name = name_id(m.controlSequenceId());
+    r.param_offset = static_cast<uint32_t>(tokens.size());
+    r.param_size = static_cast<uint32_t>(m.parameterText().size());
+    write_tokens(m.parameterText());
+    r.repl_offset = static_cast<uint32_t>(tokens.size());
+    r.repl_size = static_cast<uint32_t>(m.replacementText().size());
+    write_tokens(m.replacementText());
+    records.push_back(r);
+  }
+
+  uint32_t index_size = 1;
+
+  while (index_size < 2 * records.size())
+    index_size *= 2;
+
+  std::vector<uint32_t> index(index_size, 0);
+
+  for (size_t i(0); i < records.size(); ++i)
+  {
+    const char* name = strings.data() + name_offsets[records[i].name];
+    const size_t len = name_offsets[records[i].name + 1] - name_offsets[records[i].name];
+    uint32_t slot = name_hash(name, len) & (index_size - 1);
+
+    while (index[slot] != 0)
+      slot = (slot + 1) & (index_size - 1);
+
+    index[slot] = static_cast<uint32_t>(i + 1);
+  }
+
+  Header header;
+  std::memcpy(header.magic, FormatMagic, sizeof(FormatMagic));
+  header.version = Version;
+  header.byte_order = FormatByteOrder;
+  header.name_count = static_cast<uint32_t>(name_ids.size());
+  header.string_size = static_cast<uint32_t>(strings.size());
+  header.macro_count = static_cast<uint32_t>(records.size());
+  header.index_size = index_size;
+  header.token_count = static_cast<uint32_t>(tokens.size());
+
+  std::array<int32_t, 256> mathcode_values;
+
+  for (size_t i(0); i < mathcodes.size(); ++i)
+    mathcode_values[i] = mathcodes[i].value();
+
+  write_array(out, &header, 1);
+  write_array(out, catcodes.data(), catcodes.size());
+  write_array(out, mathcode_values.data(), mathcode_values.size());
+  write_array(out, name_offsets.data(), name_offsets.size());
+  write_array(out, strings.data(), strings.size());
+  write_padding(out, strings.size());
+  write_array(out, records.data(), records.size());
+  write_array(out, index.data(), index.size());
+  write_array(out, tokens.data(), tokens.size());
+
+  if (!out)
+    throw std::runtime_error{ "FormatImage::dump(): could not write the image" };
+}
+
+void FormatImage::load(const uint8_t* data, size_t size)
+{
+  size_t offset = 0;
+
+  auto section = [&](size_t bytes) -> const uint8_t* {
+    if (size - offset < bytes)
+      throw std::runtime_error{ "FormatImage: truncated image" };
+
+    const uint8_t* result = data + offset;
+    offset += aligned(bytes);
+    return result;
+  };
+
+  m_header = reinterpret_cast<const Header*>(section(sizeof(Header)));
+
+  if (std::memcmp(m_header->magic, FormatMagic, sizeof(FormatMagic)) != 0)
+    throw std::runtime_error{ "FormatImage: not a format image" };
+
+  if (m_header->byte_order != FormatByteOrder)
+    throw std::runtime_error{ "FormatImage: the image was written with another byte order" };
+
+  if (m_header->version != Version)
+    throw std::runtime_error{ "FormatImage: unsupported version" };
+
+  if (m_header->index_size == 0 || (m_header->index_size & (m_header->index_size - 1)) != 0)
+    throw std::runtime_error{ "FormatImage: corrupted index" };
+
+  m_catcodes = section(256);
+  m_mathcodes = reinterpret_cast<const int32_t*>(section(256 * sizeof(int32_t)));
+  m_name_offsets = reinterpret_cast<const uint32_t*>(section((size_t(m_header->name_count) + 1) * sizeof(uint32_t)));
+  m_strings = reinterpret_cast<const char*>(section(m_header->string_size));
+  m_macro_records = reinterpret_cast<const MacroRecord*>(section(size_t(m_header->macro_count) * sizeof(MacroRecord)));
+  m_index = reinterpret_cast<const uint32_t*>(section(size_t(m_header->index_size) * sizeof(uint32_t)));
+  m_tokens = reinterpret_cast<const TokenRecord*>(section(size_t(m_header->token_count) * sizeof(TokenRecord)));
+
+  if (m_name_offsets[m_header->name_count] != m_header->string_size)
+    throw std::runtime_error{ "FormatImage: corrupted name table" };
+
+  m_names.assign(m_header->name_count, CsTable::Invalid);
+  m_macros.resize(m_header->macro_count);
+}
+
+/*!
+ * \fn size_t size() const
+ * \brief returns the number of macros in the image
+ */
+size_t FormatImage::size() const
+{
+  return m_header->macro_count;
+}
+
+Lexer::CatCodeTable FormatImage::catcodes() const
+{
+  Lexer::CatCodeTable result;
+
+  for (size_t i(0); i < result.size(); ++i)
+    result[i] = static_cast<CharCategory>(m_catcodes[i]);
+
+  return result;
+}
+
+MathCode::Table FormatImage::mathcodes() const
+{
+  MathCode::Table result = MathCode::DefaultTable;
+
+  for (size_t i(0); i < result.size(); ++i)
+    result[i] = MathCode(m_mathcodes[i]);
+
+  return result;
+}
+
+/*!
+ * \fn const Macro* find(CsId cs) const
+ * \brief returns the definition of a control sequence, or nullptr
+ *
+ * The macro is materialized on first use; both positive and negative 
+ * results are cached by id.
+ */
+const Macro* FormatImage::find(CsId cs) const
+{
+  if (cs == CsTable::Invalid)
+    return nullptr;
+
+  if (cs >= m_lookup.size())
+    m_lookup.resize(std::max(size_t(cs) + 1, CsTable::global().size()), LookupUnknown);
+
+  int32_t& entry = m_lookup[cs];
+
+  if (entry == LookupUnknown)
+  {
+    const size_t index = lookup(CsTable::global().name(cs));
+    entry = index == size() ? LookupAbsent : static_cast<int32_t>(index);
   }
 
+  if (entry == LookupAbsent)
+    return nullptr;
+
+  std::unique_ptr<Macro>& m = m_macros[entry];
+
+  if (m == nullptr)
+    m.reset(new Macro(macro(entry)));
+
+  return m.get();
+}
+
+/*!
+ * \fn Macro macro(size_t index) const
+ * \brief materializes the macro at the given index in the image
+ */
+Macro FormatImage::macro(size_t index) const
+{
+  const MacroRecord& r = m_macro_records[index];
+
+  if (r.name >= m_header->name_count
+    || r.param_offset > m_header->token_count || m_header->token_count - r.param_offset < r.param_size
+    || r.repl_offset > m_header->token_count || m_header->token_count - r.repl_offset < r.repl_size)
+    throw std::runtime_error{ "FormatImage: corrupted macro record" };
+
+  std::vector<Token> param;
+  param.reserve(r.param_size);
+
+  for (uint32_t i(0); i < r.param_size; ++i)
+    param.push_back(token(m_tokens[r.param_offset + i]));
+
+  std::vector<Token> repl;
+  repl.reserve(r.repl_size);
+
+  for (uint32_t i(0); i < r.repl_size; ++i)
+    repl.push_back(token(m_tokens[r.repl_offset + i]));
+
+  return Macro{ controlSequence(r.name), std::move(param), std::move(repl) };
+}
+
+std::vector<Macro> FormatImage::macros() const
+{
+  std::vector<Macro> result;
+  result.reserve(size());
+
+  for (size_t i(0); i < size(); ++i)
+    result.push_back(macro(i));
+
   return result;
 }
 
+// Returns the index of the macro with the given name, or size()
+size_t FormatImage::lookup(const std::string& name) const
+{
+  const uint32_t mask = m_header->index_size - 1;
+  uint32_t slot = name_hash(name.data(), name.size()) & mask;
+
+  for (uint32_t n(0); n <= mask && m_index[slot] != 0; ++n)
+  {
+    const uint32_t index = m_index[slot] - 1;
+
+    if (index < size())
+    {
+      const uint32_t id = m_macro_records[index].name;
+
+      if (id < m_header->name_count)
+      {
+        const uint32_t begin = m_name_offsets[id];
+        const uint32_t end = m_name_offsets[id + 1];
+
+        if (begin <= end && end <= m_header->string_size && end - begin == name.size()
+          && std::memcmp(m_strings + begin, name.data(), name.size()) == 0)
+          return index;
+      }
+    }
+
+    slot = (slot + 1) & mask;
+  }
+
+  return size();
+}
+
+CsId FormatImage::controlSequence(uint32_t name) const
+{
+  if (name >= m_header->name_count)
+    throw std::runtime_error{ "FormatImage: corrupted token" };
+
+  CsId& cs = m_names[name];
+
+  if (cs == CsTable::Invalid)
+  {
+    const uint32_t begin = m_name_offsets[name];
+    const uint32_t end = m_name_offsets[name + 1];
+
+    if (begin > end || end > m_header->string_size)
+      throw std::runtime_error{ "FormatImage: corrupted name table" };
+
+    cs = CsTable::global().intern(std::string(m_strings + begin, m_strings + end));
+  }
+
+  return cs;
+}
+
+Token FormatImage::token(const TokenRecord& record) const
+{
+  switch (static_cast<TokenType>(record.type))
+  {
+  case TokenType::CharacterToken:
+  {
+    if (record.category > static_cast<uint8_t>(CharCategory::Invalid))
+      throw std::runtime_error{ "FormatImage: corrupted token" };
+
+    CharacterToken ctok;
+    ctok.value = static_cast<char>(record.value);
+    ctok.category = static_cast<CharCategory>(record.category);
+    return Token{ ctok };
+  }
+  case TokenType::ControlSequenceToken:
+    return Token{ ControlSequenceToken{ controlSequence(record.value) } };
+  case TokenType::ParameterToken:
+    if (record.value < 1 || record.value > 9)
+      throw std::runtime_error{ "FormatImage: corrupted token" };
+
+    return Token{ static_cast<int>(record.value) };
+  default:
+    throw std::runtime_error{ "FormatImage: corrupted token" };
+  }
+}
+
 } // namespace parsing
 
 } // namespace tex
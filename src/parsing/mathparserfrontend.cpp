@@ -32,9 +32,9 @@ int MathParserFrontend::fam() const
   return m_fam;
 }
 
-const std::map<std::string, MathParserFrontend::CS>& MathParserFrontend::csmap()
+const CsMap<MathParserFrontend::CS>& MathParserFrontend::csmap()
 {
-  static const std::map<std::string, MathParserFrontend::CS> map = {
+  static const CsMap<MathParserFrontend::CS> map = {
     {"left", CS::LEFT},
     {"right", CS::RIGHT},
     {"over", CS::OVER},
@@ -50,9 +50,9 @@ const std::map<std::string, MathParserFrontend::CS>& MathParserFrontend::csmap()
   return map;
 }
 
-const std::map<std::string, std::pair<int, MathCode>>& MathParserFrontend::symbolsmap()
+const CsMap<std::pair<int, MathCode>>& MathParserFrontend::symbolsmap()
 {
-  static const std::map<std::string, std::pair<int, MathCode>> map = {
+  static const CsMap<std::pair<int, MathCode>> map = {
      /* Greek  letters */
      {"alpha",           {tex::mathchars::GREEK_SMALL_LETTER_ALPHA,       MathCode(0x10B)}},
      {"beta",            {tex::mathchars::GREEK_SMALL_LETTER_BETA,        MathCode(0x010C)}},
@@ -203,12 +203,12 @@ const std::map<std::string, std::pair<int, MathCode>>& MathParserFrontend::symbo
 
 MathParserFrontend::CS MathParserFrontend::cs(const std::string& name)
 {
-  auto it = csmap().find(name);
+  const CS* cs = csmap().find(name);
 
-  if (it == csmap().end())
+  if (cs == nullptr)
     throw std::runtime_error{ "Unknown control sequence" };
 
-  return it->second;
+  return *cs;
 }
 
 void MathParserFrontend::writeControlSequence(CS cs)
@@ -240,25 +240,34 @@ void MathParserFrontend::writeControlSequence(CS cs)
   }
 }
 
-void MathParserFrontend::writeControlSequence(const std::string& csname)
+void MathParserFrontend::writeControlSequence(CsId csname)
 {
-  auto it = csmap().find(csname);
+  const CS* cs = csmap().find(csname);
 
-  if (it != csmap().end())
+  if (cs != nullptr)
   {
-    writeControlSequence(it->second);
+    writeControlSequence(*cs);
   }
   else
   {
-    auto char_it = symbolsmap().find(csname);
+    const std::pair<int, MathCode>* symbol = symbolsmap().find(csname);
 
-    if(char_it == symbolsmap().end())
+    if(symbol == nullptr)
       throw std::runtime_error{ "Unknown control sequence" };
 
-    return writeMathChar(char_it->second.first, char_it->second.second);
+    return writeMathChar(symbol->first, symbol->second);
   }
 }
 
+void MathParserFrontend::writeControlSequence(const std::string& csname)
+{
+  // the maps intern their names on construction
+  csmap();
+  symbolsmap();
+
+  writeControlSequence(CsTable::global().find(csname));
+}
+
 void MathParserFrontend::writeChar(char c)
 {
   MathCode mc = m_mathcode_table[static_cast<uint8_t>(c)];
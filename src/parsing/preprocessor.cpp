@@ -4,8 +4,15 @@
 
 #include "tex/parsing/preprocessor.h"
 
+#include "tex/parsing/format.h"
+
 #include <cassert>
 #include <numeric>
+#include <stdexcept>
+
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+#include <chrono>
+#endif
 
 namespace tex
 {
@@ -13,208 +20,447 @@ namespace tex
 namespace parsing
 {
 
-struct Matcher
+/*!
+ * \fn void compile()
+ * \brief compiles the parameter text and the replacement text
+ *
+ * An argument followed by another argument or ending the parameter text is 
+ * undelimited; otherwise, it is delimited by the token that follows it and 
+ * the rest of the delimiter is matched as a literal run.
+ */
+void Macro::compile()
 {
-  const std::vector<Token>& input;
-  const std::vector<Token>& pattern;
-  Macro::MatchResult result;
-
-  size_t pattern_index = 0;
+  m_param_program.clear();
+  m_repl_program.clear();
 
-  bool read_undelimited_arg()
+  for (size_t i(0); i < m_param_text.size();)
   {
-    const int param_num = pattern.at(pattern_index++).parameterNumber() - 1;
+    Instruction ins;
 
-    if (input.at(result.size).isCharacterToken() && input.at(result.size).characterToken().category == CharCategory::Space)
+    if (m_param_text[i].isParameterToken())
     {
-      ++result.size;
+      ins.param = static_cast<uint8_t>(m_param_text[i].parameterNumber() - 1);
 
-      if (result.size == input.size())
+      if (i + 1 == m_param_text.size() || m_param_text[i + 1].isParameterToken())
       {
-        result.result = Macro::MatchResult::PartialMatch;
-        return false;
+        ins.opcode = Instruction::ReadUndelimited;
+        i += 1;
+      }
+      else
+      {
+        ins.opcode = Instruction::ReadDelimited;
+        ins.delimiter = m_param_text[i + 1];
+        i += 2;
       }
     }
-
-    if (input.at(result.size).isControlSequence())
-    {
-      result.arguments[param_num] = { input.at(result.size++) };
-      return true;
-    }
-
-    assert(input.at(result.size).isCharacterToken());
-
-    if (input.at(result.size).characterToken().category == CharCategory::GroupBegin)
+    else
     {
-      int brace_depth = 1;
-      const size_t start_index = result.size;
+      ins.opcode = Instruction::MatchLiteral;
+      ins.index = static_cast<uint32_t>(i);
 
-      ++result.size;
+      while (i < m_param_text.size() && !m_param_text[i].isParameterToken())
+        ++i;
 
-      while (result.size < input.size() && brace_depth != 0)
-      {
-        if (input.at(result.size).isCharacterToken())
-        {
-          if (input.at(result.size).characterToken().category == CharCategory::GroupBegin)
-          {
-            brace_depth += 1;
-          }
-          else if (input.at(result.size).characterToken().category == CharCategory::GroupEnd)
-          {
-            brace_depth -= 1;
-          }
-        }
+      ins.count = static_cast<uint32_t>(i - ins.index);
+    }
 
-        ++result.size;
-      }
+    m_param_program.push_back(ins);
+  }
 
-      if (brace_depth != 0)
-      {
-        result.result = Macro::MatchResult::PartialMatch;
-        return false;
-      }
+  for (size_t i(0); i < m_repl_text.size();)
+  {
+    Segment seg;
 
-      result.arguments[param_num] = std::vector<Token>(input.begin() + start_index + 1, input.begin() + result.size - 1);
-      return true;
+    if (m_repl_text[i].isParameterToken())
+    {
+      seg.param = m_repl_text[i].parameterNumber() - 1;
+      i += 1;
     }
     else
     {
-      result.arguments[param_num] = { input.at(result.size++) };
-      return true;
+      seg.index = static_cast<uint32_t>(i);
+
+      while (i < m_repl_text.size() && !m_repl_text[i].isParameterToken())
+        ++i;
+
+      seg.count = static_cast<uint32_t>(i - seg.index);
     }
+
+    m_repl_program.push_back(seg);
+  }
+}
+
+Macro::MatchResult Macro::match(const std::vector<Token>& text) const
+{
+  MacroMatcher matcher;
+  matcher.reset(this);
+
+  for (size_t i(0); i < text.size() && matcher.status() == MacroMatcher::NeedMore; ++i)
+    matcher.write(text[i]);
+
+  MatchResult result;
+
+  switch (matcher.status())
+  {
+  case MacroMatcher::NeedMore:
+    result.result = MatchResult::PartialMatch;
+    break;
+  case MacroMatcher::Matched:
+    result.result = MatchResult::CompleteMatch;
+    break;
+  default:
+    result.result = MatchResult::NoMatch;
+    break;
   }
 
-  bool read_delimited_arg()
+  result.size = matcher.size();
+
+  for (size_t i(0); i < result.arguments.size(); ++i)
   {
-    const int param_num = pattern.at(pattern_index++).parameterNumber() - 1;
-    const Token delimiter = pattern.at(pattern_index);
+    const TokenSpan& arg = matcher.arguments()[i];
+    result.arguments[i].assign(text.begin() + arg.offset, text.begin() + arg.offset + arg.length);
+  }
+
+  return result;
+}
 
-    int brace_depth = 0;
-    const size_t start_index = result.size;
+std::vector<Token> Macro::expand(const std::array<std::vector<Token>, 9>& arguments) const
+{
+  std::vector<Token> result;
+  result.reserve(replacementText().size() + std::accumulate(arguments.begin(), arguments.end(), size_t(0), [](size_t n, const std::vector<Token>& arg) -> size_t {
+    return n + arg.size();
+    }));
 
-    while (result.size < input.size() && (input.at(result.size) != delimiter || brace_depth != 0))
+  expand(arguments, result, result.end());
+
+  return result;
+}
+
+void Macro::expand(const std::array<std::vector<Token>, 9>& arguments, std::vector<Token>& output, std::vector<Token>::iterator output_it) const
+{
+  std::vector<Token> repl = replacementText();
+
+  for (auto it = repl.begin(); it != repl.end();)
+  {
+    if (it->isParameterToken())
     {
-      if (input.at(result.size).isCharacterToken())
-      {
-        if (input.at(result.size).characterToken().category == CharCategory::GroupBegin)
-        {
-          brace_depth++;
-        }
-        else if (input.at(result.size).characterToken().category == CharCategory::GroupEnd)
-        {
-          brace_depth--;
-        }
-      }
-      else if (input.at(result.size).isControlSequence())
-      {
-        if (input.at(result.size).controlSequence() == "par")
-        {
-          result.result = Macro::MatchResult::NoMatch;
-          return false;
-        }
-      }
+      const int param_num = it->parameterNumber();
 
-      ++result.size;
+      it = repl.erase(it);
+      it = repl.insert(it, arguments.at(param_num-1).begin(), arguments.at(param_num - 1).end());
+      it += arguments.at(param_num - 1).size();
     }
-
-    if (result.size == input.size())
+    else
     {
-      result.result = Macro::MatchResult::PartialMatch;
-      return false;
+      ++it;
     }
-
-    result.arguments[param_num] = std::vector<Token>(input.begin() + start_index, input.begin() + result.size);
-    return true;
   }
 
-  bool read_arg()
+  output.insert(output_it, repl.begin(), repl.end());
+}
+
+/*!
+ * \fn void expand(const std::array<std::vector<Token>, 9>& arguments, TokenInput& input) const
+ * \brief inserts the expansion of the macro at the front of the input
+ */
+void Macro::expand(const std::array<std::vector<Token>, 9>& arguments, TokenInput& input) const
+{
+  const std::vector<Token>& repl = replacementText();
+
+  for (auto it = repl.rbegin(); it != repl.rend(); ++it)
   {
-    if (pattern_index == pattern.size() - 1 || pattern.at(pattern_index + 1).isParameterToken())
+    if (it->isParameterToken())
     {
-      return read_undelimited_arg();
+      const std::vector<Token>& arg = arguments.at(it->parameterNumber() - 1);
+      input.push_front(arg.begin(), arg.end());
     }
     else
     {
-      return read_delimited_arg();
+      input.push_front(*it);
     }
   }
+}
 
-  Macro::MatchResult match()
+void MacroMatcher::reset(const Macro* m)
+{
+  m_macro = m;
+  m_pc = 0;
+  m_pos = 0;
+  m_start = 0;
+  m_progress = 0;
+  m_depth = 0;
+  m_arguments.fill(TokenSpan());
+  m_status = m->parameterProgram().empty() ? Matched : NeedMore;
+}
+
+/*!
+ * \fn Status write(const Token& tok)
+ * \brief feeds the next token of the input to the matcher
+ *
+ * As in TeX, spaces are skipped before an undelimited argument and the 
+ * outer braces of a braced argument are not part of the argument.
+ * A delimited argument ends on the first token of its delimiter at brace 
+ * depth 0 and cannot contain \par nor an unbalanced '}'.
+ */
+MacroMatcher::Status MacroMatcher::write(const Token& tok)
+{
+  if (m_status != NeedMore)
+    return m_status;
+
+  const Macro::Instruction& ins = m_macro->parameterProgram()[m_pc];
+  const uint32_t pos = m_pos++;
+
+  switch (ins.opcode)
+  {
+  case Macro::Instruction::MatchLiteral:
   {
-    while (pattern_index < pattern.size())
+    if (tok != m_macro->parameterText()[ins.index + m_progress])
+      return m_status = Failed;
+
+    if (++m_progress == ins.count)
+      next();
+  }
+  break;
+  case Macro::Instruction::ReadUndelimited:
+  {
+    if (m_depth == 0)
     {
-      if (result.size == input.size())
+      if (tok == CharCategory::Space)
       {
-        result.result = Macro::MatchResult::PartialMatch;
-        return result;
+        break;
       }
-
-      const Token& pat_tok = pattern.at(pattern_index);
-
-      if (pat_tok.isCharacterToken() || pat_tok.isControlSequence())
+      else if (tok == CharCategory::GroupBegin)
       {
-        if (input.at(result.size) != pattern.at(pattern_index))
-        {
-          result.result = Macro::MatchResult::NoMatch;
-          return result;
-        }
-
-        ++result.size;
-        ++pattern_index;
+        m_depth = 1;
+        m_start = m_pos;
       }
       else
       {
-        if (!read_arg())
-        {
-          return result;
-        }
+        m_arguments[ins.param] = { pos, 1 };
+        next();
       }
     }
-
-    result.result = Macro::MatchResult::CompleteMatch;
-    return result;
+    else if (tok == CharCategory::GroupBegin)
+    {
+      ++m_depth;
+    }
+    else if (tok == CharCategory::GroupEnd && --m_depth == 0)
+    {
+      m_arguments[ins.param] = { m_start, pos - m_start };
+      next();
+    }
+  }
+  break;
+  case Macro::Instruction::ReadDelimited:
+  {
+    if (m_depth == 0 && tok == ins.delimiter)
+    {
+      m_arguments[ins.param] = { m_start, pos - m_start };
+      next();
+    }
+    else if (tok == CharCategory::GroupBegin)
+    {
+      ++m_depth;
+    }
+    else if (tok == CharCategory::GroupEnd)
+    {
+      if (m_depth-- == 0)
+        return m_status = Failed;
+    }
+    else if (tok == CsTable::Par)
+    {
+      return m_status = Failed;
+    }
+  }
+  break;
   }
-};
 
-Macro::MatchResult Macro::match(const std::vector<Token>& text) const
+  return m_status;
+}
+
+void MacroMatcher::next()
 {
-  Matcher matcher{ text, parameterText() };
-  return matcher.match();
+  m_progress = 0;
+  m_depth = 0;
+  m_start = m_pos;
+
+  if (++m_pc == m_macro->parameterProgram().size())
+    m_status = Matched;
 }
 
-std::vector<Token> Macro::expand(const std::array<std::vector<Token>, 9>& arguments) const
+MacroTable::MacroTable()
 {
-  std::vector<Token> result;
-  result.reserve(replacementText().size() + std::accumulate(arguments.begin(), arguments.end(), size_t(0), [](size_t n, const std::vector<Token>& arg) -> size_t {
-    return n + arg.size();
-    }));
+  rehash(64);
+}
 
-  expand(arguments, result, result.end());
+MacroTable::~MacroTable()
+{
 
-  return result;
 }
 
-void Macro::expand(const std::array<std::vector<Token>, 9>& arguments, std::vector<Token>& output, std::vector<Token>::iterator output_it) const
+const Macro* MacroTable::find(CsId cs) const
 {
-  std::vector<Token> repl = replacementText();
+  const Slot& slot = m_slots[probe(cs)];
 
-  for (auto it = repl.begin(); it != repl.end();)
+  if (slot.cs == cs)
+    return slot.macro.get();
+
+  return m_format != nullptr ? m_format->find(cs) : nullptr;
+}
+
+/*!
+ * \fn void define(Macro m)
+ * \brief defines a macro in the current group
+ */
+void MacroTable::define(Macro m)
+{
+  const CsId cs = m.controlSequenceId();
+
+  if (2 * (m_size + 1) > m_slots.size())
+    rehash(2 * m_slots.size());
+
+  Slot& slot = m_slots[probe(cs)];
+
+  if (slot.cs != cs)
   {
-    if (it->isParameterToken())
+    if (level() > 0)
     {
-      const int param_num = it->parameterNumber();
+      m_save_stack.emplace_back();
+      m_save_stack.back().cs = cs;
+    }
 
-      it = repl.erase(it);
-      it = repl.insert(it, arguments.at(param_num-1).begin(), arguments.at(param_num - 1).end());
-      it += arguments.at(param_num - 1).size();
+    slot.cs = cs;
+    ++m_size;
+  }
+  else if (slot.level != level())
+  {
+    m_save_stack.emplace_back();
+    m_save_stack.back().cs = cs;
+    m_save_stack.back().level = slot.level;
+    m_save_stack.back().macro = std::move(slot.macro);
+  }
+
+  slot.level = level();
+  slot.macro.reset(new Macro(std::move(m)));
+}
+
+/*!
+ * \fn void setFormat(std::shared_ptr<const FormatImage> image)
+ * \brief sets the precompiled format that provides the base definitions
+ */
+void MacroTable::setFormat(std::shared_ptr<const FormatImage> image)
+{
+  m_format = std::move(image);
+}
+
+void MacroTable::beginGroup()
+{
+  m_groups.push_back(m_save_stack.size());
+}
+
+/*!
+ * \fn void endGroup()
+ * \brief restores the definitions that were saved since the matching beginGroup()
+ */
+void MacroTable::endGroup()
+{
+  if (m_groups.empty())
+    throw std::runtime_error{ "MacroTable::endGroup(): no group to end" };
+
+  const size_t start = m_groups.back();
+  m_groups.pop_back();
+
+  while (m_save_stack.size() > start)
+  {
+    Slot& saved = m_save_stack.back();
+    const size_t index = probe(saved.cs);
+
+    if (saved.macro == nullptr)
+    {
+      erase(index);
     }
     else
     {
-      ++it;
+      m_slots[index].level = saved.level;
+      m_slots[index].macro = std::move(saved.macro);
     }
+
+    m_save_stack.pop_back();
   }
+}
 
-  output.insert(output_it, repl.begin(), repl.end());
+std::vector<const Macro*> MacroTable::macros() const
+{
+  std::vector<const Macro*> result;
+  result.reserve(m_size);
+
+  for (const Slot& slot : m_slots)
+  {
+    if (slot.cs != CsTable::Invalid)
+      result.push_back(slot.macro.get());
+  }
+
+  return result;
+}
+
+inline size_t MacroTable::home(CsId cs) const
+{
+  // Fibonacci hashing, the capacity is a power of 2
+  return static_cast<size_t>(static_cast<uint32_t>(cs * 2654435769u)) & (m_slots.size() - 1);
+}
+
+// Returns the slot of a control sequence, or the empty slot where it would go
+size_t MacroTable::probe(CsId cs) const
+{
+  const size_t mask = m_slots.size() - 1;
+  size_t index = home(cs);
+
+  while (m_slots[index].cs != cs && m_slots[index].cs != CsTable::Invalid)
+    index = (index + 1) & mask;
+
+  return index;
+}
+
+// Backward-shift deletion: the entries that follow in the same cluster 
+// are moved back so that no tombstone is needed
+void MacroTable::erase(size_t index)
+{
+  const size_t mask = m_slots.size() - 1;
+  size_t next = index;
+
+  for (;;)
+  {
+    next = (next + 1) & mask;
+
+    if (m_slots[next].cs == CsTable::Invalid)
+      break;
+
+    const size_t h = home(m_slots[next].cs);
+    const bool stays = index <= next ? (index < h && h <= next) : (index < h || h <= next);
+
+    if (!stays)
+    {
+      m_slots[index] = std::move(m_slots[next]);
+      index = next;
+    }
+  }
+
+  m_slots[index].cs = CsTable::Invalid;
+  m_slots[index].level = 0;
+  m_slots[index].macro.reset();
+  --m_size;
+}
+
+void MacroTable::rehash(size_t capacity)
+{
+  std::vector<Slot> slots{ std::move(m_slots) };
+  m_slots = std::vector<Slot>(capacity);
+
+  for (Slot& slot : slots)
+  {
+    if (slot.cs != CsTable::Invalid)
+      m_slots[probe(slot.cs)] = std::move(slot);
+  }
 }
 
 Preprocessor::State::Frame::Frame(Frame&& f)
@@ -261,7 +507,6 @@ Preprocessor::State::Frame::Frame(Preprocessor::State::FrameType ft)
     macro_definition = new preprocessor::MacroDefinitionData;
     break;
   case ExpandingMacro:
-    subtype = EXPM_MatchingMacroParameterText;
     macro_expansion = new preprocessor::MacroExpansionData;
     break;
   case Branching:
@@ -304,7 +549,6 @@ Preprocessor::State::Frame::~Frame()
 Preprocessor::Preprocessor()
 {
   m_state.frames.emplace_back(State::Idle);
-  m_defs.push_front(Definitions{});
 }
 
 void Preprocessor::advance()
@@ -312,7 +556,12 @@ void Preprocessor::advance()
   if (input.empty())
     return;
 
-  Token tok = parsing::read(input);
+  Token tok = input.read();
+
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+  m_profiler.consume(1);
+#endif // defined(LIBTYPESET_EXPANSION_PROFILER)
+
   process(tok);
 }
 
@@ -328,7 +577,11 @@ void Preprocessor::leave()
   if (m_state.frames.back().type == State::ExpandingAfter
     && m_state.frames.back().subtype == State::EXPAFTER_InsertingCs)
   {
-    input.insert(input.begin(), m_state.frames.back().expandafter->cs);
+    input.push_front(m_state.frames.back().expandafter->cs);
+
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+    m_profiler.insert(1);
+#endif // defined(LIBTYPESET_EXPANSION_PROFILER)
 
     leave();
   }
@@ -339,24 +592,32 @@ Preprocessor::State::Frame& Preprocessor::currentFrame()
   return m_state.frames.back();
 }
 
-const Macro* Preprocessor::find(const std::string& cs) const
+const Macro* Preprocessor::find(CsId cs) const
 {
-  for (const auto& defscope : m_defs)
-  {
-    auto it = defscope.macros.find(cs);
-
-    if (it != defscope.macros.end())
-    {
-      return &(it->second);
-    }
-  }
+  return m_macros.find(cs);
+}
 
-  return nullptr;
+const Macro* Preprocessor::find(const std::string& cs) const
+{
+  const CsId id = CsTable::global().find(cs);
+  return id == CsTable::Invalid ? nullptr : find(id);
 }
 
 void Preprocessor::define(Macro m)
 {
-  m_defs.front().macros[m.controlSequence()] = std::move(m);
+  m_macros.define(std::move(m));
+}
+
+/*!
+ * \fn void loadFormat(std::shared_ptr<const FormatImage> image)
+ * \brief uses the macros of a precompiled format
+ *
+ * The macros of the image are materialized when first expanded; 
+ * definitions made with define() or \def take precedence over them.
+ */
+void Preprocessor::loadFormat(std::shared_ptr<const FormatImage> image)
+{
+  m_macros.setFormat(std::move(image));
 }
 
 void Preprocessor::process(Token& tok)
@@ -381,7 +642,7 @@ void Preprocessor::process(Token& tok)
     }
     else if (tok.isControlSequence())
     {
-      processControlSeq(tok.controlSequence());
+      processControlSeq(tok.controlSequenceId());
     }
     else
     {
@@ -392,47 +653,102 @@ void Preprocessor::process(Token& tok)
   }
 }
 
-void Preprocessor::processControlSeq(const std::string& cs)
+void Preprocessor::processControlSeq(CsId cs)
 {
-  if (cs == "def")
+  switch (cs)
   {
+  case CsTable::Def:
     enter(State::ReadingMacro);
-  }
-  else if (cs == "ifbr")
-  {
+    break;
+  case CsTable::Ifbr:
     enter(State::Branching);
     currentFrame().branching->success = br;
-  }
-  else if (cs == "csname")
-  {
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+    m_profiler.primitive(ExpansionProfiler::Ifbr);
+#endif // defined(LIBTYPESET_EXPANSION_PROFILER)
+    break;
+  case CsTable::Csname:
     enter(State::FormingCS);
-  }
-  else if (cs == "expandafter")
-  {
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+    m_profiler.primitive(ExpansionProfiler::Csname);
+#endif // defined(LIBTYPESET_EXPANSION_PROFILER)
+    break;
+  case CsTable::Expandafter:
     enter(State::ExpandingAfter);
-  }
-  else
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+    m_profiler.primitive(ExpansionProfiler::Expandafter);
+#endif // defined(LIBTYPESET_EXPANSION_PROFILER)
+    break;
+  default:
   {
     const Macro* m = find(cs);
 
     if (m == nullptr)
     {
-      parsing::write(Token{ cs }, output);
+      parsing::write(Token{ ControlSequenceToken{ cs } }, output);
     }
     else
     {
       if (m->parameterText().empty())
       {
-        m->expand({}, input, input.begin());
+        m->expand({}, input);
+
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+        m_profiler.expand(cs, m->replacementText().size());
+#endif // defined(LIBTYPESET_EXPANSION_PROFILER)
+
+        return;
       }
-      else
+
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+      const auto match_start = std::chrono::steady_clock::now();
+#endif // defined(LIBTYPESET_EXPANSION_PROFILER)
+
+      // Match the arguments in place when they are already in the input
+      m_matcher.reset(m);
+
+      for (size_t i(0); i < input.size() && m_matcher.status() == MacroMatcher::NeedMore; ++i)
+        m_matcher.write(input.peek(i));
+
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+      m_profiler.match(cs, std::chrono::steady_clock::now() - match_start);
+#endif // defined(LIBTYPESET_EXPANSION_PROFILER)
+
+      if (m_matcher.status() == MacroMatcher::Failed)
+        throw std::runtime_error{ "Use of macro does not match its definition" };
+
+      if (m_matcher.status() == MacroMatcher::Matched)
       {
-        enter(State::ExpandingMacro);
-        currentFrame().macro_expansion->def = m;
-        updateExpandMacroState();
+        m_expansion.clear();
+        m->substitute(m_matcher.arguments(), [this](size_t i) -> const Token& { return input.peek(i); }, m_expansion);
+        input.discard(m_matcher.size());
+        input.push_front(m_expansion.begin(), m_expansion.end());
+
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+        m_profiler.consume(m_matcher.size());
+        m_profiler.expand(cs, m_expansion.size());
+#endif // defined(LIBTYPESET_EXPANSION_PROFILER)
+
+        return;
       }
+
+      // Otherwise, keep matching as the tokens are written
+      enter(State::ExpandingMacro);
+      auto& macro_expansion = *(currentFrame().macro_expansion);
+      macro_expansion.matcher = m_matcher;
+
+      for (size_t i(0); i < input.size(); ++i)
+        macro_expansion.tokens.push_back(input.peek(i));
+
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+      m_profiler.consume(input.size());
+#endif // defined(LIBTYPESET_EXPANSION_PROFILER)
+
+      input.clear();
     }
   }
+  break;
+  }
 }
 
 void Preprocessor::readMacro(Token& tok)
@@ -447,7 +763,7 @@ void Preprocessor::readMacro(Token& tok)
     if (!tok.isControlSequence())
       throw std::runtime_error{ "Expected control sequence name after \\def" };
 
-    macro_definition.csname = tok.controlSequence();
+    macro_definition.csname = tok.controlSequenceId();
     frame.subtype = State::RM_ReadingMacroParameterText;
   }
   break;
@@ -483,8 +799,8 @@ void Preprocessor::readMacro(Token& tok)
       {
         if (macro_definition.brace_nesting == 0)
         {
-          Macro mdef{ std::move(macro_definition.csname), std::move(macro_definition.parameter_text), std::move(macro_definition.replacement_text) };
-          m_defs.front().macros[mdef.controlSequence()] = std::move(mdef);
+          Macro mdef{ macro_definition.csname, std::move(macro_definition.parameter_text), std::move(macro_definition.replacement_text) };
+          m_macros.define(std::move(mdef));
           leave();
         }
         else
@@ -510,168 +826,60 @@ void Preprocessor::readMacro(Token& tok)
   }
 }
 
-void Preprocessor::updateExpandMacroState()
-{
-  State::Frame& frame = currentFrame();
-  auto& macro_expansion = *(frame.macro_expansion);
-
-  const std::vector<Token>& fullpat = macro_expansion.def->parameterText();
-
-  if (macro_expansion.pattern_index == fullpat.size())
-    return;
-
-  if (fullpat.at(macro_expansion.pattern_index).isParameterToken())
-  {
-    macro_expansion.current_arg_brace_nesting = 0;
-
-    if (macro_expansion.pattern_index == fullpat.size() - 1 || fullpat.at(macro_expansion.pattern_index + 1).isParameterToken())
-    {
-      frame.subtype = State::EXPM_ReadingUndelimitedMacroArgument;
-    }
-    else
-    {
-      frame.subtype = State::EXPM_ReadingDelimitedMacroArgument;
-    }
-  }
-  else
-  {
-    frame.subtype = State::EXPM_MatchingMacroParameterText;
-  }
-}
-
 void Preprocessor::expandMacro(Token& tok)
 {
-  State::Frame& frame = currentFrame();
-  auto& macro_expansion = *(frame.macro_expansion);
-
-  auto advance_pattern = [this, &macro_expansion]() {
+  auto& macro_expansion = *(currentFrame().macro_expansion);
 
-    macro_expansion.pattern_index++;
-    updateExpandMacroState();
+  macro_expansion.tokens.push_back(tok);
 
-  };
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+  const auto match_start = std::chrono::steady_clock::now();
+  macro_expansion.matcher.write(tok);
+  m_profiler.match(macro_expansion.matcher.macro()->controlSequenceId(), std::chrono::steady_clock::now() - match_start);
+#else
+  macro_expansion.matcher.write(tok);
+#endif // defined(LIBTYPESET_EXPANSION_PROFILER)
 
-  switch (frame.subtype)
+  switch (macro_expansion.matcher.status())
   {
-  case State::EXPM_MatchingMacroParameterText:
-  {
-    const Token& pat = macro_expansion.def->parameterText().at(macro_expansion.pattern_index);
-
-    if (tok != pat)
-      throw std::runtime_error{ "Use of macro does not match its definition" };
-
-    advance_pattern();
-  }
-  break;
-  case State::EXPM_ReadingDelimitedMacroArgument:
+  case MacroMatcher::Failed:
+    throw std::runtime_error{ "Use of macro does not match its definition" };
+  case MacroMatcher::Matched:
   {
-    const Token& delimiter_pat = macro_expansion.def->parameterText().at(macro_expansion.pattern_index + 1);
+    const std::vector<Token>& tokens = macro_expansion.tokens;
+    m_expansion.clear();
+    macro_expansion.matcher.macro()->substitute(macro_expansion.matcher.arguments(), [&tokens](size_t i) -> const Token& { return tokens[i]; }, m_expansion);
+    input.push_front(m_expansion.begin(), m_expansion.end());
 
-    if (tok == delimiter_pat && macro_expansion.current_arg_brace_nesting == 0)
-    {
-      macro_expansion.pattern_index++;
-      macro_expansion.current_arg_index++;
-      frame.subtype = State::EXPM_MatchingMacroParameterText;
-      advance_pattern();
-    }
-    else
-    {
-      macro_expansion.arguments[macro_expansion.current_arg_index].push_back(tok);
-
-      if (tok.isCharacterToken())
-      {
-        if (tok.characterToken().value == '{')
-        {
-          macro_expansion.current_arg_brace_nesting++;
-        }
-        else if (tok.characterToken().value == '}')
-        {
-          if (macro_expansion.current_arg_brace_nesting == 0)
-            throw std::runtime_error{ "Invalid nesting of '{' and '}' in delimited macro argument" };
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+    m_profiler.expand(macro_expansion.matcher.macro()->controlSequenceId(), m_expansion.size());
+#endif // defined(LIBTYPESET_EXPANSION_PROFILER)
 
-          macro_expansion.current_arg_brace_nesting--;
-        }
-      }
-    }
-  }
-  break;
-  case State::EXPM_ReadingUndelimitedMacroArgument:
-  {
-    std::vector<Token>& current_arg_content = macro_expansion.arguments[macro_expansion.current_arg_index];
-
-    assert(current_arg_content.empty());
-
-    if (tok.isControlSequence() || (tok != CharCategory::GroupBegin && tok != CharCategory::Space))
-    {
-      current_arg_content.push_back(tok);
-      macro_expansion.current_arg_index++;
-      advance_pattern();
-    }
-    else
-    {
-      if (tok == CharCategory::GroupBegin)
-      {
-        frame.subtype = State::EXPM_ReadingBracedDelimitedMacroArgument;
-        assert(macro_expansion.current_arg_brace_nesting == 0);
-      }
-    }
-  }
-  break;
-  case State::EXPM_ReadingBracedDelimitedMacroArgument:
-  {
-    std::vector<Token>& current_arg_content = macro_expansion.arguments[macro_expansion.current_arg_index];
-
-    if (tok == CharCategory::GroupBegin)
-    {
-      macro_expansion.current_arg_brace_nesting++;
-      current_arg_content.push_back(tok);
-    }
-    else if (tok == CharCategory::GroupEnd)
-    {
-      if (macro_expansion.current_arg_brace_nesting == 0)
-      {
-        macro_expansion.current_arg_index++;
-        advance_pattern();
-      }
-      else
-      {
-        macro_expansion.current_arg_brace_nesting--;
-        current_arg_content.push_back(tok);
-      }
-    }
-    else
-    {
-      current_arg_content.push_back(tok);
-    }
+    leave();
   }
   break;
   default:
-    assert(false);
     break;
   }
-
-  if (macro_expansion.pattern_index == macro_expansion.def->parameterText().size())
-  {
-    // Done!
-    macro_expansion.def->expand(macro_expansion.arguments, input, input.begin());
-    leave();
-  }
 }
 
 inline static bool is_if(const Token& tok)
 {
-  return tok.isControlSequence() && tok.controlSequence().length() >= 2
-    && tok.controlSequence().at(0) == 'i' && tok.controlSequence().at(1) == 'f';
+  if (!tok.isControlSequence())
+    return false;
+
+  const std::string& name = tok.controlSequence();
+  return name.length() >= 2 && name.at(0) == 'i' && name.at(1) == 'f';
 }
 
 inline static bool is_else(const Token& tok)
 {
-  return tok.isControlSequence() && tok.controlSequence() == "else";
+  return tok == CsTable::Else;
 }
 
 inline static bool is_fi(const Token& tok)
 {
-  return tok.isControlSequence() && tok.controlSequence() == "fi";
+  return tok == CsTable::Fi;
 }
 
 void Preprocessor::branch(Token& tok)
@@ -695,7 +903,11 @@ void Preprocessor::branch(Token& tok)
   {
     if (branching.if_nesting == 0)
     {
-      input.insert(input.begin(), branching.successful_branch.begin(), branching.successful_branch.end());
+      input.push_front(branching.successful_branch.begin(), branching.successful_branch.end());
+
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+      m_profiler.insert(branching.successful_branch.size());
+#endif // defined(LIBTYPESET_EXPANSION_PROFILER)
       leave();
       return;
     }
@@ -718,10 +930,14 @@ void Preprocessor::formCs(Token& tok)
 
   if (tok.isControlSequence())
   {
-    if (tok.controlSequence() != "endcsname")
+    if (tok != CsTable::Endcsname)
       throw std::runtime_error{ "Bad csname" };
 
-    input.insert(input.begin(), Token{ std::move(csname.name) });
+    input.push_front(Token{ csname.name });
+
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+    m_profiler.insert(1);
+#endif // defined(LIBTYPESET_EXPANSION_PROFILER)
     leave();
   }
   else
@@ -753,7 +969,7 @@ void Preprocessor::expandafter(Token& tok)
 
     currentFrame().subtype = State::EXPAFTER_InsertingCs;
 
-    processControlSeq(tok.controlSequence());
+    processControlSeq(tok.controlSequenceId());
 
     if (state().frames.size() == framecount)
     {
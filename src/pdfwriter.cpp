@@ -0,0 +1,394 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/pdfwriter.h"
+
+#include "tex/rule.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ostream>
+#include <stdexcept>
+
+#if defined(LIBTYPESET_HAS_ZLIB)
+#include <zlib.h>
+#endif
+
+namespace tex
+{
+
+static void append_number(std::string& out, float x)
+{
+  char buffer[32];
+  int n = std::snprintf(buffer, sizeof(buffer), "%.3f", x);
+
+  while (n > 0 && buffer[n - 1] == '0')
+    --n;
+
+  if (n > 0 && buffer[n - 1] == '.')
+    --n;
+
+  if (n == 2 && buffer[0] == '-' && buffer[1] == '0')
+    out.push_back('0');
+  else
+    out.append(buffer, n);
+}
+
+static void append_glyph(std::string& out, Character c)
+{
+  // Simple fonts use one byte per glyph
+  const char byte = static_cast<char>(c);
+
+  if (byte == '(' || byte == ')' || byte == '\\')
+    out.push_back('\\');
+
+  out.push_back(byte);
+}
+
+struct PdfPageWriter
+{
+  PdfWriter& writer;
+
+  void operator()(const Box* box, Pos pos)
+  {
+    if (!box->isCharacterBox())
+      return;
+
+    const CharacterBox& cbox = *static_cast<const CharacterBox*>(box);
+
+    if (cbox.character() < 0 || cbox.character() >= 256)
+      throw std::runtime_error{ "PdfWriter: character cannot be written with a simple font" };
+
+    PdfWriter::FontInfo& info = writer.fontInfo(cbox.font());
+    info.used_on_page = true;
+
+    if (info.object == 0)
+      info.object = writer.newObject();
+
+    if (info.widths[cbox.character()] < 0.f)
+    {
+      info.widths[cbox.character()] = cbox.width();
+      info.max_width = std::max(info.max_width, cbox.width());
+      info.max_height = std::max(info.max_height, cbox.height());
+      info.max_depth = std::max(info.max_depth, cbox.depth());
+    }
+
+    if (!writer.m_builder.accepts(cbox, pos))
+    {
+      writer.writeRun(writer.m_builder.run());
+      writer.m_builder.clear();
+    }
+
+    writer.m_builder.push_back(cbox, pos);
+  }
+
+  void operator()(const Rule* rule, Pos pos)
+  {
+    writer.writeRule(*rule, pos);
+  }
+};
+
+PdfWriter::PdfWriter(std::ostream& out, float pageWidth, float pageHeight)
+  : m_out(out),
+    m_page_width(pageWidth),
+    m_page_height(pageHeight)
+{
+  m_xref.push_back(0);
+
+  newObject(); // catalog
+  newObject(); // page tree
+
+  write("%PDF-1.4\n%\xE2\xE3\xCF\xD3\n");
+}
+
+bool PdfWriter::supportsCompression()
+{
+#if defined(LIBTYPESET_HAS_ZLIB)
+  return true;
+#else
+  return false;
+#endif
+}
+
+void PdfWriter::setCompression(bool on)
+{
+  if (on && !supportsCompression())
+    throw std::runtime_error{ "PdfWriter::setCompression(): library was built without zlib" };
+
+  m_compress = on;
+}
+
+void PdfWriter::setFont(Font f, const std::string& basefont, float size, float italicAngle)
+{
+  FontInfo& info = fontInfo(f);
+  info.basefont = basefont;
+  info.size = size;
+  info.italic_angle = italicAngle;
+}
+
+void PdfWriter::writePage(const Box& page)
+{
+  writePage(page, Pos{ 0.f, page.height() });
+}
+
+void PdfWriter::writePage(const Box& page, Pos pos)
+{
+  if (m_finished)
+    throw std::runtime_error{ "PdfWriter::writePage(): document is finished" };
+
+  m_content.clear();
+
+  tex::traverse(PdfPageWriter{ *this }, &page, pos);
+
+  if (!m_builder.empty())
+  {
+    writeRun(m_builder.run());
+    m_builder.clear();
+  }
+
+  const uint32_t contents = newObject();
+  beginObject(contents);
+
+  std::string dict = "<< /Length ";
+
+#if defined(LIBTYPESET_HAS_ZLIB)
+  if (m_compress)
+  {
+    std::string compressed;
+    uLongf size = compressBound(static_cast<uLong>(m_content.size()));
+    compressed.resize(size);
+
+    if (compress2(reinterpret_cast<Bytef*>(&compressed[0]), &size, reinterpret_cast<const Bytef*>(m_content.data()), static_cast<uLong>(m_content.size()), Z_DEFAULT_COMPRESSION) != Z_OK)
+      throw std::runtime_error{ "PdfWriter::writePage(): compression failed" };
+
+    compressed.resize(size);
+    m_content.swap(compressed);
+    dict += std::to_string(m_content.size()) + " /Filter /FlateDecode";
+  }
+  else
+#endif
+  {
+    dict += std::to_string(m_content.size());
+  }
+
+  write(dict + " >>\nstream\n");
+  write(m_content);
+  write("\nendstream\nendobj\n");
+
+  const uint32_t obj = newObject();
+  beginObject(obj);
+
+  std::string str = "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 ";
+  append_number(str, m_page_width);
+  str += " ";
+  append_number(str, m_page_height);
+  str += "] /Contents " + std::to_string(contents) + " 0 R /Resources << /Font <<";
+
+  for (size_t i(0); i < m_fonts.size(); ++i)
+  {
+    if (!m_fonts[i].used_on_page)
+      continue;
+
+    str += " /F" + std::to_string(i) + " " + std::to_string(m_fonts[i].object) + " 0 R";
+    m_fonts[i].used_on_page = false;
+  }
+
+  str += " >> >> >>\nendobj\n";
+  write(str);
+
+  m_pages.push_back(obj);
+}
+
+void PdfWriter::finish()
+{
+  if (m_finished)
+    return;
+
+  for (size_t i(0); i < m_fonts.size(); ++i)
+  {
+    if (m_fonts[i].object != 0)
+      writeFont(i);
+  }
+
+  beginObject(2);
+
+  {
+    std::string str = "<< /Type /Pages /Kids [";
+
+    for (size_t i(0); i < m_pages.size(); ++i)
+    {
+      if (i > 0)
+        str += " ";
+
+      str += std::to_string(m_pages[i]) + " 0 R";
+    }
+
+    str += "] /Count " + std::to_string(m_pages.size()) + " >>\nendobj\n";
+    write(str);
+  }
+
+  beginObject(1);
+  write("<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+
+  const uint64_t startxref = m_offset;
+
+  write("xref\n0 " + std::to_string(m_xref.size()) + "\n0000000000 65535 f \n");
+
+  for (size_t i(1); i < m_xref.size(); ++i)
+  {
+    char entry[32];
+    std::snprintf(entry, sizeof(entry), "%010llu 00000 n \n", static_cast<unsigned long long>(m_xref[i]));
+    write(entry);
+  }
+
+  write("trailer\n<< /Size " + std::to_string(m_xref.size()) + " /Root 1 0 R >>\nstartxref\n" + std::to_string(startxref) + "\n%%EOF\n");
+
+  m_out.flush();
+  m_finished = true;
+}
+
+/*!
+ * \fn void writeFont(size_t index)
+ * \brief writes the font dictionary of a font and its font descriptor
+ *
+ * Every font that is not one of the standard 14 fonts needs a descriptor.
+ * Its metrics are those of the characters that were written, in glyph 
+ * space units (1/1000 of the font size). The font is flagged as symbolic
+ * since the encodings of TeX fonts are not the standard Latin one.
+ */
+void PdfWriter::writeFont(size_t index)
+{
+  const FontInfo& info = m_fonts[index];
+  const std::string name = info.basefont.empty() ? "F" + std::to_string(index) : info.basefont;
+  const float scale = 1000.f / info.size;
+
+  size_t first = 0;
+  while (first < 255 && info.widths[first] < 0.f)
+    ++first;
+
+  size_t last = 255;
+  while (last > first && info.widths[last] < 0.f)
+    --last;
+
+  const uint32_t descriptor = newObject();
+
+  beginObject(info.object);
+
+  std::string str = "<< /Type /Font /Subtype /Type1 /BaseFont /" + name;
+  str += " /FirstChar " + std::to_string(first) + " /LastChar " + std::to_string(last) + " /Widths [";
+
+  for (size_t c(first); c <= last; ++c)
+  {
+    if (c != first)
+      str += " ";
+
+    append_number(str, info.widths[c] < 0.f ? 0.f : info.widths[c] * scale);
+  }
+
+  str += "] /FontDescriptor " + std::to_string(descriptor) + " 0 R >>\nendobj\n";
+  write(str);
+
+  beginObject(descriptor);
+
+  str = "<< /Type /FontDescriptor /FontName /" + name + " /Flags 4 /FontBBox [0 ";
+  append_number(str, -info.max_depth * scale);
+  str += " ";
+  append_number(str, info.max_width * scale);
+  str += " ";
+  append_number(str, info.max_height * scale);
+  str += "] /ItalicAngle ";
+  append_number(str, info.italic_angle);
+  str += " /Ascent ";
+  append_number(str, info.max_height * scale);
+  str += " /Descent ";
+  append_number(str, -info.max_depth * scale);
+  str += " /CapHeight ";
+  append_number(str, info.max_height * scale);
+  // A regular weight: font metrics have no stem width
+  str += " /StemV 80 >>\nendobj\n";
+  write(str);
+}
+
+void PdfWriter::writeRun(const GlyphRun& run)
+{
+  const FontInfo& info = fontInfo(run.font);
+
+  m_content += "BT /F" + std::to_string(run.font.id()) + " ";
+  append_number(m_content, info.size);
+  m_content += " Tf ";
+  append_number(m_content, run.origin.x);
+  m_content += " ";
+  append_number(m_content, m_page_height - run.origin.y);
+  m_content += " Td [(";
+
+  for (size_t i(0); i < run.size(); ++i)
+  {
+    const Character c = run.glyphs[i];
+    append_glyph(m_content, c);
+
+    if (i + 1 == run.size())
+      break;
+
+    // The viewer advances by the width declared in the font dictionary,
+    // any difference with the layout is a displacement in the TJ array.
+    const float width = info.widths[c] >= 0.f ? info.widths[c] : 0.f;
+    const float adjustment = (width - run.advances[i]) * 1000.f / info.size;
+
+    if (std::abs(adjustment) >= 0.001f)
+    {
+      m_content += ") ";
+      append_number(m_content, adjustment);
+      m_content += " (";
+    }
+  }
+
+  m_content += ")] TJ ET\n";
+}
+
+void PdfWriter::writeRule(const Rule& rule, Pos pos)
+{
+  append_number(m_content, pos.x);
+  m_content += " ";
+  append_number(m_content, m_page_height - pos.y - rule.depth());
+  m_content += " ";
+  append_number(m_content, rule.width());
+  m_content += " ";
+  append_number(m_content, rule.totalHeight());
+  m_content += " re f\n";
+}
+
+void PdfWriter::write(const std::string& str)
+{
+  m_out.write(str.data(), str.size());
+  m_offset += str.size();
+}
+
+uint32_t PdfWriter::newObject()
+{
+  m_xref.push_back(0);
+  return static_cast<uint32_t>(m_xref.size() - 1);
+}
+
+void PdfWriter::beginObject(uint32_t obj)
+{
+  m_xref[obj] = m_offset;
+  write(std::to_string(obj) + " 0 obj\n");
+}
+
+PdfWriter::FontInfo& PdfWriter::fontInfo(Font f)
+{
+  if (f.id() < 0)
+    throw std::runtime_error{ "PdfWriter: invalid font" };
+
+  while (static_cast<size_t>(f.id()) >= m_fonts.size())
+  {
+    m_fonts.emplace_back();
+    m_fonts.back().widths.fill(-1.f);
+  }
+
+  return m_fonts[f.id()];
+}
+
+} // namespace tex
@@ -0,0 +1,77 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/sfcodetable.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace tex
+{
+
+const size_t SfcodeTable::MaxBuckets;
+
+SfcodeTable::SfcodeTable()
+  : m_bmp(0x10000, 0),
+    m_values{ 1000 }
+{
+
+}
+
+/*!
+ * \fn const std::shared_ptr<const SfcodeTable>& frenchspacing()
+ * \brief returns a table in which every character has code 1000
+ */
+const std::shared_ptr<const SfcodeTable>& SfcodeTable::frenchspacing()
+{
+  static const std::shared_ptr<const SfcodeTable> instance = std::make_shared<SfcodeTable>();
+  return instance;
+}
+
+/*!
+ * \fn const std::shared_ptr<const SfcodeTable>& nonfrenchspacing()
+ * \brief returns the codes set by plain TeX's \c{\nonfrenchspacing}
+ */
+const std::shared_ptr<const SfcodeTable>& SfcodeTable::nonfrenchspacing()
+{
+  static const std::shared_ptr<const SfcodeTable> instance = []() {
+    auto table = std::make_shared<SfcodeTable>();
+    table->set('.', 3000);
+    table->set('?', 3000);
+    table->set('!', 3000);
+    table->set(':', 2000);
+    table->set(';', 1500);
+    table->set(',', 1250);
+    return table;
+  }();
+
+  return instance;
+}
+
+void SfcodeTable::set(Character c, int code)
+{
+  if (c < 0 || code < 0 || code > 32767)
+    throw std::runtime_error{ "SfcodeTable::set(): invalid character or code" };
+
+  auto it = std::find(m_values.begin(), m_values.end(), code);
+
+  if (it == m_values.end())
+  {
+    if (m_values.size() == MaxBuckets)
+      throw std::runtime_error{ "SfcodeTable::set(): too many distinct codes" };
+
+    it = m_values.insert(m_values.end(), code);
+  }
+
+  const uint8_t b = static_cast<uint8_t>(it - m_values.begin());
+
+  if (c < 0x10000)
+    m_bmp[c] = b;
+  else if (b == 0)
+    m_others.erase(c);
+  else
+    m_others[c] = b;
+}
+
+} // namespace tex
@@ -0,0 +1,700 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/sfntfile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace tex
+{
+
+static void sfnt_check(bool cond, const char* what)
+{
+  if (!cond)
+    throw std::runtime_error{ std::string("invalid font file: ") + what };
+}
+
+namespace
+{
+
+// Bounds-checked big-endian reads
+struct Reader
+{
+  const uint8_t* data;
+  size_t size;
+
+  uint8_t u8(size_t offset) const
+  {
+    sfnt_check(offset < size, "read out of bounds");
+    return data[offset];
+  }
+
+  uint16_t u16(size_t offset) const
+  {
+    sfnt_check(offset + 2 <= size, "read out of bounds");
+    return static_cast<uint16_t>((data[offset] << 8) | data[offset + 1]);
+  }
+
+  int16_t i16(size_t offset) const
+  {
+    return static_cast<int16_t>(u16(offset));
+  }
+
+  uint32_t u32(size_t offset) const
+  {
+    sfnt_check(offset + 4 <= size, "read out of bounds");
+    return (uint32_t(data[offset]) << 24) | (uint32_t(data[offset + 1]) << 16) | (uint32_t(data[offset + 2]) << 8) | uint32_t(data[offset + 3]);
+  }
+};
+
+int popcount16(uint16_t v)
+{
+  int n = 0;
+
+  for (; v != 0; v &= v - 1)
+    ++n;
+
+  return n;
+}
+
+// Offset of the XAdvance field in a ValueRecord, or -1
+int xadvance_offset(uint16_t format)
+{
+  if (!(format & 0x0004))
+    return -1;
+
+  return 2 * popcount16(format & 0x0003);
+}
+
+uint32_t pair_key(uint16_t left, uint16_t right)
+{
+  return (uint32_t(left) << 16) | right;
+}
+
+} // namespace
+
+SfntFile::SfntFile(const std::string& path)
+  : m_file(path)
+{
+  load(m_file.data(), m_file.size());
+}
+
+SfntFile::SfntFile(const uint8_t* data, size_t size)
+{
+  load(data, size);
+}
+
+SfntFile::~SfntFile()
+{
+
+}
+
+void SfntFile::load(const uint8_t* data, size_t size)
+{
+  sfnt_check(data != nullptr && size >= 12, "file is too short");
+
+  m_data = data;
+  m_size = size;
+
+  const Reader r{ data, size };
+
+  const uint32_t version = r.u32(0);
+  sfnt_check(version == 0x00010000 || version == sfnt::tag('O', 'T', 'T', 'O') || version == sfnt::tag('t', 'r', 'u', 'e'), "unsupported sfnt version");
+
+  const uint16_t num_tables = r.u16(4);
+
+  for (size_t i(0); i < num_tables; ++i)
+  {
+    const size_t record = 12 + 16 * i;
+    Table t{ r.u32(record), r.u32(record + 8), r.u32(record + 12) };
+    sfnt_check(static_cast<size_t>(t.offset) + t.length <= size, "table out of bounds");
+    m_tables.push_back(t);
+  }
+
+  const Table* head = table(sfnt::tag('h', 'e', 'a', 'd'));
+  const Table* hhea = table(sfnt::tag('h', 'h', 'e', 'a'));
+  const Table* maxp = table(sfnt::tag('m', 'a', 'x', 'p'));
+  const Table* hmtx = table(sfnt::tag('h', 'm', 't', 'x'));
+  sfnt_check(head && hhea && maxp && hmtx, "missing required table");
+  sfnt_check(head->length >= 54 && hhea->length >= 36 && maxp->length >= 6, "required table is too short");
+
+  m_units_per_em = r.u16(head->offset + 18);
+  sfnt_check(m_units_per_em > 0, "invalid unitsPerEm");
+  m_long_loca = r.i16(head->offset + 50) != 0;
+
+  m_ascender = r.i16(hhea->offset + 4);
+  m_descender = r.i16(hhea->offset + 6);
+  m_hmetrics_count = r.u16(hhea->offset + 34);
+  m_glyph_count = r.u16(maxp->offset + 4);
+
+  sfnt_check(m_hmetrics_count > 0 && m_hmetrics_count <= m_glyph_count, "invalid numberOfHMetrics");
+  sfnt_check(hmtx->length >= 4 * m_hmetrics_count, "hmtx table is too short");
+  m_hmtx = hmtx->offset;
+
+  const Table* loca = table(sfnt::tag('l', 'o', 'c', 'a'));
+  const Table* glyf = table(sfnt::tag('g', 'l', 'y', 'f'));
+
+  if (loca && glyf)
+  {
+    sfnt_check(loca->length >= (m_long_loca ? 4 : 2) * (m_glyph_count + 1), "loca table is too short");
+    m_loca = loca->offset;
+    m_glyf = glyf->offset;
+    m_glyf_length = glyf->length;
+  }
+
+  if (const Table* os2 = table(sfnt::tag('O', 'S', '/', '2')))
+  {
+    if (os2->length >= 88 && r.u16(os2->offset) >= 2)
+      m_x_height = r.i16(os2->offset + 86);
+  }
+
+  if (const Table* post = table(sfnt::tag('p', 'o', 's', 't')))
+  {
+    if (post->length >= 8)
+      m_italic_angle = static_cast<int32_t>(r.u32(post->offset + 4)) / 65536.f;
+  }
+
+  if (const Table* math = table(sfnt::tag('M', 'A', 'T', 'H')))
+  {
+    if (math->length >= 10)
+    {
+      const size_t constants = math->offset + r.u16(math->offset + 4);
+      sfnt_check(constants + 214 <= static_cast<size_t>(math->offset) + math->length, "MATH constants out of bounds");
+      m_math_constants = constants;
+    }
+  }
+}
+
+const SfntFile::Table* SfntFile::table(uint32_t tag) const
+{
+  for (const Table& t : m_tables)
+  {
+    if (t.tag == tag)
+      return &t;
+  }
+
+  return nullptr;
+}
+
+bool SfntFile::hasTable(uint32_t tag) const
+{
+  return table(tag) != nullptr;
+}
+
+uint16_t SfntFile::glyphIndex(Character c) const
+{
+  std::call_once(m_cmap_flag, [this]() { buildCharacterMap(); });
+
+  if (c < 0)
+    return 0;
+
+  if (c < 0x10000)
+    return m_bmp[c];
+
+  auto it = m_supplementary.find(c);
+  return it != m_supplementary.end() ? it->second : 0;
+}
+
+int SfntFile::advance(uint16_t glyph) const
+{
+  const Reader r{ m_data, m_size };
+  const size_t i = std::min<size_t>(glyph, m_hmetrics_count - 1);
+  return r.u16(m_hmtx + 4 * i);
+}
+
+sfnt::GlyphBounds SfntFile::bounds(uint16_t glyph) const
+{
+  if (m_glyf == 0 || glyph >= m_glyph_count)
+    return sfnt::GlyphBounds{ 0, static_cast<int16_t>(m_descender), 0, static_cast<int16_t>(m_ascender) };
+
+  const Reader r{ m_data, m_size };
+
+  const size_t begin = m_long_loca ? r.u32(m_loca + 4 * glyph) : 2 * size_t(r.u16(m_loca + 2 * glyph));
+  const size_t end = m_long_loca ? r.u32(m_loca + 4 * glyph + 4) : 2 * size_t(r.u16(m_loca + 2 * glyph + 2));
+
+  if (end <= begin)
+    return sfnt::GlyphBounds{ 0, 0, 0, 0 };
+
+  sfnt_check(begin + 10 <= m_glyf_length, "glyph out of bounds");
+
+  const size_t g = m_glyf + begin;
+  return sfnt::GlyphBounds{ r.i16(g + 2), r.i16(g + 4), r.i16(g + 6), r.i16(g + 8) };
+}
+
+int SfntFile::kerning(uint16_t left, uint16_t right) const
+{
+  std::call_once(m_kerning_flag, [this]() { buildKerning(); });
+
+  auto it = m_pair_kerning.find(pair_key(left, right));
+  const size_t pair_subtable = it != m_pair_kerning.end() ? it->second.subtable : size_t(-1);
+
+  // Class subtables are sorted; only those before the pair can override it
+  for (const ClassKerning& k : m_class_kerning)
+  {
+    if (k.subtable > pair_subtable)
+      break;
+
+    if (left >= k.first_classes.size() || k.first_classes[left] == 0xFFFF)
+      continue;
+
+    const uint16_t c2 = right < k.second_classes.size() ? k.second_classes[right] : 0;
+    return k.values[k.first_classes[left] * size_t(k.class2_count) + c2];
+  }
+
+  return it != m_pair_kerning.end() ? it->second.value : 0;
+}
+
+int SfntFile::mathConstant(sfnt::MathConstant c) const
+{
+  if (!hasMath())
+    return 0;
+
+  const Reader r{ m_data, m_size };
+  const int n = static_cast<int>(c);
+
+  if (n < 2)
+    return r.i16(m_math_constants + 2 * n);
+  else if (n < 4)
+    return r.u16(m_math_constants + 2 * n);
+  else if (c == sfnt::MathConstant::RadicalDegreeBottomRaisePercent)
+    return r.i16(m_math_constants + 8 + 4 * 51);
+  else
+    return r.i16(m_math_constants + 8 + 4 * (n - 4));
+}
+
+BoxMetrics SfntFile::metrics(Character c, float size) const
+{
+  const uint16_t g = glyphIndex(c);
+  const float scale = size / m_units_per_em;
+  const sfnt::GlyphBounds b = bounds(g);
+
+  // As in TFM files, glyphs that do not cross the baseline have no depth or no height
+  return BoxMetrics{ std::max(scale * b.yMax, 0.f), std::max(-scale * b.yMin, 0.f), scale * advance(g) };
+}
+
+float SfntFile::kerning(Character left, Character right, float size) const
+{
+  return size * kerning(glyphIndex(left), glyphIndex(right)) / m_units_per_em;
+}
+
+/*!
+ * \fn FontDimen fontdimen(float size) const
+ * \brief returns the font parameters at the given size
+ *
+ * Interword glue follows the width of the space character, with the
+ * stretch and shrink conventionally used for OpenType fonts.
+ * Math parameters come from the MATH table, when the font has one.
+ */
+FontDimen SfntFile::fontdimen(float size) const
+{
+  using sfnt::MathConstant;
+
+  const float scale = size / m_units_per_em;
+  auto math = [this, scale](MathConstant c) -> float {
+    return scale * mathConstant(c);
+  };
+
+  FontDimen result{};
+
+  result.slant_per_pt = -std::tan(m_italic_angle * 3.14159265f / 180.f);
+  result.interword_space = scale * advance(glyphIndex(' '));
+  result.interword_stretch = result.interword_space / 2.f;
+  result.interword_shrink = result.interword_space / 3.f;
+  result.x_height = scale * m_x_height;
+  result.quad = size;
+  result.extra_space = result.interword_space / 3.f;
+
+  if (!hasMath())
+    return result;
+
+  result.num1 = math(MathConstant::FractionNumeratorDisplayStyleShiftUp);
+  result.num2 = math(MathConstant::FractionNumeratorShiftUp);
+  result.num3 = math(MathConstant::StackTopShiftUp);
+  result.denom1 = math(MathConstant::FractionDenominatorDisplayStyleShiftDown);
+  result.denom2 = math(MathConstant::FractionDenominatorShiftDown);
+  result.sup1 = math(MathConstant::SuperscriptShiftUp);
+  result.sup2 = math(MathConstant::SuperscriptShiftUp);
+  result.sup3 = math(MathConstant::SuperscriptShiftUpCramped);
+  result.sub1 = math(MathConstant::SubscriptShiftDown);
+  result.sub2 = math(MathConstant::SubscriptShiftDown);
+  result.sup_drop = math(MathConstant::SuperscriptBaselineDropMax);
+  result.sub_drop = math(MathConstant::SubscriptBaselineDropMin);
+  result.delim1 = math(MathConstant::DisplayOperatorMinHeight);
+  result.delim2 = math(MathConstant::DelimitedSubFormulaMinHeight);
+  result.axis_height = math(MathConstant::AxisHeight);
+  result.default_rule_thickness = math(MathConstant::FractionRuleThickness);
+  result.big_op_spacing1 = math(MathConstant::UpperLimitGapMin);
+  result.big_op_spacing2 = math(MathConstant::LowerLimitGapMin);
+  result.big_op_spacing3 = math(MathConstant::UpperLimitBaselineRiseMin);
+  result.big_op_spacing4 = math(MathConstant::LowerLimitBaselineDropMin);
+  result.big_op_spacing5 = 0.f;
+
+  return result;
+}
+
+// The preferred subtable is a Unicode format 12 subtable, then a
+// Unicode BMP format 4 subtable.
+void SfntFile::buildCharacterMap() const
+{
+  m_bmp.assign(0x10000, 0);
+
+  const Table* cmap = table(sfnt::tag('c', 'm', 'a', 'p'));
+
+  if (!cmap)
+    return;
+
+  const Reader r{ m_data, m_size };
+  const uint16_t count = r.u16(cmap->offset + 2);
+
+  size_t format4 = 0;
+  size_t format12 = 0;
+
+  for (size_t i(0); i < count; ++i)
+  {
+    const size_t record = cmap->offset + 4 + 8 * i;
+    const uint16_t platform = r.u16(record);
+    const uint16_t encoding = r.u16(record + 2);
+    const size_t offset = cmap->offset + r.u32(record + 4);
+    const bool unicode = platform == 0 || (platform == 3 && (encoding == 1 || encoding == 10));
+
+    if (!unicode)
+      continue;
+
+    const uint16_t format = r.u16(offset);
+
+    if (format == 12 && format12 == 0)
+      format12 = offset;
+    else if (format == 4 && format4 == 0)
+      format4 = offset;
+  }
+
+  if (format12 != 0)
+    readCmap12(format12);
+  else if (format4 != 0)
+    readCmap4(format4);
+}
+
+void SfntFile::readCmap4(size_t offset) const
+{
+  const Reader r{ m_data, m_size };
+  const size_t seg_count = r.u16(offset + 6) / 2;
+  const size_t end_codes = offset + 14;
+  const size_t start_codes = end_codes + 2 * seg_count + 2;
+  const size_t deltas = start_codes + 2 * seg_count;
+  const size_t range_offsets = deltas + 2 * seg_count;
+
+  for (size_t i(0); i < seg_count; ++i)
+  {
+    const uint32_t end = r.u16(end_codes + 2 * i);
+    const uint32_t start = r.u16(start_codes + 2 * i);
+    const uint16_t delta = r.u16(deltas + 2 * i);
+    const uint16_t range_offset = r.u16(range_offsets + 2 * i);
+
+    for (uint32_t c(start); c <= end && c != 0xFFFF; ++c)
+    {
+      uint16_t g = 0;
+
+      if (range_offset == 0)
+      {
+        g = static_cast<uint16_t>(c + delta);
+      }
+      else
+      {
+        g = r.u16(range_offsets + 2 * i + range_offset + 2 * (c - start));
+
+        if (g != 0)
+          g = static_cast<uint16_t>(g + delta);
+      }
+
+      m_bmp[c] = g < m_glyph_count ? g : 0;
+    }
+  }
+}
+
+void SfntFile::readCmap12(size_t offset) const
+{
+  const Reader r{ m_data, m_size };
+  const uint32_t group_count = r.u32(offset + 12);
+
+  for (size_t i(0); i < group_count; ++i)
+  {
+    const size_t group = offset + 16 + 12 * i;
+    const uint32_t start = r.u32(group);
+    const uint32_t end = std::min<uint32_t>(r.u32(group + 4), 0x10FFFF);
+    const uint32_t glyph = r.u32(group + 8);
+
+    for (uint32_t c(start); c <= end; ++c)
+    {
+      const uint32_t g = glyph + (c - start);
+
+      if (g >= m_glyph_count)
+        break;
+
+      if (c < 0x10000)
+        m_bmp[c] = static_cast<uint16_t>(g);
+      else
+        m_supplementary[static_cast<Character>(c)] = static_cast<uint16_t>(g);
+    }
+  }
+}
+
+void SfntFile::buildKerning() const
+{
+  if (!readGposTable())
+    readKernTable();
+}
+
+void SfntFile::readKernTable() const
+{
+  const Table* kern = table(sfnt::tag('k', 'e', 'r', 'n'));
+
+  if (!kern || kern->length < 4)
+    return;
+
+  const Reader r{ m_data, m_size };
+
+  if (r.u16(kern->offset) != 0)
+    return; // Apple's kern table
+
+  const uint16_t count = r.u16(kern->offset + 2);
+  size_t subtable = kern->offset + 4;
+
+  for (size_t i(0); i < count; ++i)
+  {
+    const uint16_t length = r.u16(subtable + 2);
+    const uint16_t coverage = r.u16(subtable + 4);
+    const bool horizontal = coverage & 0x1;
+    const bool minimum = coverage & 0x2;
+    const bool cross_stream = coverage & 0x4;
+
+    if ((coverage >> 8) == 0 && horizontal && !minimum && !cross_stream)
+    {
+      const uint16_t pairs = r.u16(subtable + 6);
+
+      for (size_t j(0); j < pairs; ++j)
+      {
+        const size_t p = subtable + 14 + 6 * j;
+        m_pair_kerning.emplace(pair_key(r.u16(p), r.u16(p + 2)), PairKerning{ r.i16(p + 4), 0 });
+      }
+    }
+
+    sfnt_check(length >= 6, "invalid kern subtable");
+    subtable += length;
+  }
+}
+
+/*!
+ * \fn bool readGposTable() const
+ * \brief reads the pair adjustments of the lookups of the kern feature
+ *
+ * Subtables are numbered in the order in which a shaper would try them.
+ * Returns whether the table has a kern feature.
+ */
+bool SfntFile::readGposTable() const
+{
+  const Table* gpos = table(sfnt::tag('G', 'P', 'O', 'S'));
+
+  if (!gpos || gpos->length < 10)
+    return false;
+
+  const Reader r{ m_data, m_size };
+  const size_t features = gpos->offset + r.u16(gpos->offset + 6);
+  const size_t lookups = gpos->offset + r.u16(gpos->offset + 8);
+
+  std::vector<uint16_t> lookup_indices;
+  bool has_kern = false;
+
+  const uint16_t feature_count = r.u16(features);
+
+  for (size_t i(0); i < feature_count; ++i)
+  {
+    const size_t record = features + 2 + 6 * i;
+
+    if (r.u32(record) != sfnt::tag('k', 'e', 'r', 'n'))
+      continue;
+
+    has_kern = true;
+    const size_t feature = features + r.u16(record + 4);
+    const uint16_t index_count = r.u16(feature + 2);
+
+    for (size_t j(0); j < index_count; ++j)
+      lookup_indices.push_back(r.u16(feature + 4 + 2 * j));
+  }
+
+  std::sort(lookup_indices.begin(), lookup_indices.end());
+  lookup_indices.erase(std::unique(lookup_indices.begin(), lookup_indices.end()), lookup_indices.end());
+
+  const uint16_t lookup_count = r.u16(lookups);
+  size_t subtable_index = 0;
+
+  for (uint16_t index : lookup_indices)
+  {
+    if (index >= lookup_count)
+      continue;
+
+    const size_t lookup = lookups + r.u16(lookups + 2 + 2 * index);
+    const uint16_t type = r.u16(lookup);
+    const uint16_t subtable_count = r.u16(lookup + 4);
+
+    for (size_t j(0); j < subtable_count; ++j)
+    {
+      size_t subtable = lookup + r.u16(lookup + 6 + 2 * j);
+
+      if (type == 9)
+      {
+        if (r.u16(subtable + 2) != 2)
+          continue;
+
+        subtable += r.u32(subtable + 4);
+      }
+      else if (type != 2)
+      {
+        continue;
+      }
+
+      readPairPos(subtable, subtable_index++);
+    }
+  }
+
+  return has_kern;
+}
+
+static std::vector<uint16_t> read_coverage(const Reader& r, size_t offset, size_t glyph_count)
+{
+  std::vector<uint16_t> result(glyph_count, 0xFFFF);
+  const uint16_t format = r.u16(offset);
+  const uint16_t count = r.u16(offset + 2);
+
+  for (size_t i(0); i < count; ++i)
+  {
+    if (format == 1)
+    {
+      const uint16_t g = r.u16(offset + 4 + 2 * i);
+
+      if (g < glyph_count)
+        result[g] = static_cast<uint16_t>(i);
+    }
+    else if (format == 2)
+    {
+      const size_t range = offset + 4 + 6 * i;
+      const uint16_t start = r.u16(range);
+      const uint16_t end = r.u16(range + 2);
+      const uint16_t index = r.u16(range + 4);
+
+      for (uint32_t g(start); g <= end && g < glyph_count; ++g)
+        result[g] = static_cast<uint16_t>(index + g - start);
+    }
+  }
+
+  return result;
+}
+
+static std::vector<uint16_t> read_classdef(const Reader& r, size_t offset, size_t glyph_count)
+{
+  std::vector<uint16_t> result(glyph_count, 0);
+  const uint16_t format = r.u16(offset);
+
+  if (format == 1)
+  {
+    const uint16_t start = r.u16(offset + 2);
+    const uint16_t count = r.u16(offset + 4);
+
+    for (size_t i(0); i < count && start + i < glyph_count; ++i)
+      result[start + i] = r.u16(offset + 6 + 2 * i);
+  }
+  else if (format == 2)
+  {
+    const uint16_t count = r.u16(offset + 2);
+
+    for (size_t i(0); i < count; ++i)
+    {
+      const size_t range = offset + 4 + 6 * i;
+      const uint16_t start = r.u16(range);
+      const uint16_t end = r.u16(range + 2);
+      const uint16_t c = r.u16(range + 4);
+
+      for (uint32_t g(start); g <= end && g < glyph_count; ++g)
+        result[g] = c;
+    }
+  }
+
+  return result;
+}
+
+void SfntFile::readPairPos(size_t offset, size_t subtable) const
+{
+  const Reader r{ m_data, m_size };
+
+  const uint16_t format = r.u16(offset);
+  const std::vector<uint16_t> coverage = read_coverage(r, offset + r.u16(offset + 2), m_glyph_count);
+  const uint16_t value_format1 = r.u16(offset + 4);
+  const uint16_t value_format2 = r.u16(offset + 6);
+  const int xadvance = xadvance_offset(value_format1);
+  const size_t size1 = 2 * popcount16(value_format1);
+  const size_t size2 = 2 * popcount16(value_format2);
+
+  if (format == 1)
+  {
+    const uint16_t pair_set_count = r.u16(offset + 8);
+
+    for (size_t g(0); g < coverage.size(); ++g)
+    {
+      if (coverage[g] == 0xFFFF || coverage[g] >= pair_set_count)
+        continue;
+
+      const size_t pair_set = offset + r.u16(offset + 10 + 2 * coverage[g]);
+      const uint16_t count = r.u16(pair_set);
+
+      for (size_t i(0); i < count; ++i)
+      {
+        const size_t record = pair_set + 2 + i * (2 + size1 + size2);
+        const int16_t value = xadvance < 0 ? 0 : r.i16(record + 2 + xadvance);
+        m_pair_kerning.emplace(pair_key(static_cast<uint16_t>(g), r.u16(record)), PairKerning{ value, subtable });
+      }
+    }
+  }
+  else if (format == 2)
+  {
+    ClassKerning k;
+    k.subtable = subtable;
+    k.first_classes = read_classdef(r, offset + r.u16(offset + 8), m_glyph_count);
+    k.second_classes = read_classdef(r, offset + r.u16(offset + 10), m_glyph_count);
+    const uint16_t class1_count = r.u16(offset + 12);
+    k.class2_count = r.u16(offset + 14);
+
+    if (class1_count == 0 || k.class2_count == 0)
+      return;
+
+    k.values.resize(size_t(class1_count) * k.class2_count, 0);
+
+    for (size_t c1(0); c1 < class1_count; ++c1)
+    {
+      for (size_t c2(0); c2 < k.class2_count; ++c2)
+      {
+        const size_t record = offset + 16 + (c1 * k.class2_count + c2) * (size1 + size2);
+        k.values[c1 * k.class2_count + c2] = xadvance < 0 ? 0 : r.i16(record + xadvance);
+      }
+    }
+
+    // Glyphs that are not covered do not use this subtable
+    for (size_t g(0); g < m_glyph_count; ++g)
+    {
+      if (coverage[g] == 0xFFFF || k.first_classes[g] >= class1_count)
+        k.first_classes[g] = 0xFFFF;
+    }
+
+    // Classes out of range (in a malformed font) are mapped to class 0
+    for (uint16_t& c : k.second_classes)
+    {
+      if (c >= k.class2_count)
+        c = 0;
+    }
+
+    m_class_kerning.push_back(std::move(k));
+  }
+}
+
+} // namespace tex
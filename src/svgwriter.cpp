@@ -0,0 +1,271 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/svgwriter.h"
+
+#include "tex/rule.h"
+
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <stdexcept>
+
+namespace tex
+{
+
+// Writes a number with at most three decimals and without trailing zeros.
+static void write_number(std::ostream& out, float x)
+{
+  char buffer[32];
+  int n = std::snprintf(buffer, sizeof(buffer), "%.3f", x);
+
+  while (n > 0 && buffer[n - 1] == '0')
+    --n;
+
+  if (n > 0 && buffer[n - 1] == '.')
+    --n;
+
+  if (n == 2 && buffer[0] == '-' && buffer[1] == '0')
+    out.write("0", 1);
+  else
+    out.write(buffer, n);
+}
+
+static void write_reference(std::ostream& out, Character c)
+{
+  char buffer[16];
+  const int n = std::snprintf(buffer, sizeof(buffer), "&#x%X;", static_cast<unsigned>(c));
+  out.write(buffer, n);
+}
+
+// XML 1.0 forbids most control characters, even as character references.
+// Font codes below 0x20 (e.g. the ligatures of the TeX text fonts) are 
+// therefore moved to the private use area, at U+F000 + code; tab, line 
+// feed and carriage return are allowed but written as references so that 
+// they are not taken for white space.
+static void write_escaped(std::ostream& out, Character c)
+{
+  switch (c)
+  {
+  case '&':
+    out << "&amp;";
+    break;
+  case '<':
+    out << "&lt;";
+    break;
+  case '>':
+    out << "&gt;";
+    break;
+  case '\t':
+  case '\n':
+  case '\r':
+    write_reference(out, c);
+    break;
+  default:
+    if (c >= 0 && c < 0x20)
+      write_reference(out, 0xF000 + c);
+    else if (c < 0 || (c >= 0xD800 && c <= 0xDFFF) || c == 0xFFFE || c == 0xFFFF || c > 0x10FFFF)
+      write_reference(out, 0xFFFD);
+    else
+      out << Utf8Char(c).data();
+    break;
+  }
+}
+
+// Writes a quoted CSS string, escaped for the content of a <style> element.
+static void write_css_string(std::ostream& out, const std::string& str)
+{
+  out << "\"";
+
+  for (char c : str)
+  {
+    const unsigned char uc = static_cast<unsigned char>(c);
+
+    if (c == '"' || c == '\\')
+      out << "\\" << c;
+    else if (uc < 0x20 || uc == 0x7F)
+      out << "\\" << std::hex << static_cast<unsigned>(uc) << std::dec << " ";
+    else if (c == '&')
+      out << "&amp;";
+    else if (c == '<')
+      out << "&lt;";
+    else if (c == '>')
+      out << "&gt;";
+    else
+      out << c;
+  }
+
+  out << "\"";
+}
+
+struct SvgPageWriter
+{
+  SvgWriter& writer;
+
+  void operator()(const Box* box, Pos pos)
+  {
+    if (!box->isCharacterBox())
+      return;
+
+    const CharacterBox& cbox = *static_cast<const CharacterBox*>(box);
+
+    if (!writer.m_builder.accepts(cbox, pos))
+    {
+      writer.writeRun(writer.m_builder.run());
+      writer.m_builder.clear();
+    }
+
+    writer.m_builder.push_back(cbox, pos);
+  }
+
+  void operator()(const Rule* rule, Pos pos)
+  {
+    writer.writeRule(*rule, pos);
+  }
+};
+
+SvgWriter::SvgWriter(std::ostream& out, float pageWidth, float pageHeight, size_t pageCount)
+  : m_out(out),
+    m_page_width(pageWidth),
+    m_page_height(pageHeight)
+{
+  m_out << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"";
+  write_number(m_out, m_page_width);
+  m_out << "\" height=\"";
+  write_number(m_out, m_page_height * pageCount);
+  m_out << "\" viewBox=\"0 0 ";
+  write_number(m_out, m_page_width);
+  m_out << " ";
+  write_number(m_out, m_page_height * pageCount);
+  m_out << "\">\n";
+}
+
+void SvgWriter::setFont(Font f, const std::string& family, float size)
+{
+  FontInfo& info = fontInfo(f);
+
+  if (info.written)
+    throw std::runtime_error{ "SvgWriter::setFont(): font already in use" };
+
+  info.family = family;
+  info.size = size;
+}
+
+void SvgWriter::writePage(const Box& page)
+{
+  writePage(page, Pos{ 0.f, page.height() });
+}
+
+void SvgWriter::writePage(const Box& page, Pos pos)
+{
+  if (m_finished)
+    throw std::runtime_error{ "SvgWriter::writePage(): document is finished" };
+
+  m_out << "<g id=\"page" << (m_page_count + 1) << "\"";
+
+  if (m_page_count > 0)
+  {
+    m_out << " transform=\"translate(0 ";
+    write_number(m_out, m_page_count * m_page_height);
+    m_out << ")\"";
+  }
+
+  m_out << ">\n";
+
+  tex::traverse(SvgPageWriter{ *this }, &page, pos);
+
+  if (!m_builder.empty())
+  {
+    writeRun(m_builder.run());
+    m_builder.clear();
+  }
+
+  m_out << "</g>\n";
+
+  ++m_page_count;
+}
+
+void SvgWriter::finish()
+{
+  if (m_finished)
+    return;
+
+  m_out << "</svg>\n";
+  m_out.flush();
+  m_finished = true;
+}
+
+void SvgWriter::writeFont(Font f)
+{
+  FontInfo& info = fontInfo(f);
+
+  if (info.written)
+    return;
+
+  m_out << "<style>.f" << f.id() << "{font-family:";
+
+  if (info.family.empty())
+    write_css_string(m_out, "font" + std::to_string(f.id()));
+  else
+    write_css_string(m_out, info.family);
+
+  m_out << ";font-size:";
+  write_number(m_out, info.size);
+  m_out << "px}</style>\n";
+
+  info.written = true;
+}
+
+void SvgWriter::writeRun(const GlyphRun& run)
+{
+  writeFont(run.font);
+
+  m_out << "<text class=\"f" << run.font.id() << "\" x=\"";
+
+  float x = run.origin.x;
+
+  for (size_t i(0); i < run.size(); ++i)
+  {
+    if (i > 0)
+      m_out << " ";
+
+    write_number(m_out, x);
+    x += run.advances[i];
+  }
+
+  m_out << "\" y=\"";
+  write_number(m_out, run.origin.y);
+  m_out << "\">";
+
+  for (Character c : run.glyphs)
+    write_escaped(m_out, c);
+
+  m_out << "</text>\n";
+}
+
+void SvgWriter::writeRule(const Rule& rule, Pos pos)
+{
+  m_out << "<rect x=\"";
+  write_number(m_out, pos.x);
+  m_out << "\" y=\"";
+  write_number(m_out, pos.y - rule.height());
+  m_out << "\" width=\"";
+  write_number(m_out, rule.width());
+  m_out << "\" height=\"";
+  write_number(m_out, rule.totalHeight());
+  m_out << "\"/>\n";
+}
+
+SvgWriter::FontInfo& SvgWriter::fontInfo(Font f)
+{
+  if (f.id() < 0)
+    throw std::runtime_error{ "SvgWriter: invalid font" };
+
+  if (static_cast<size_t>(f.id()) >= m_fonts.size())
+    m_fonts.resize(f.id() + 1);
+
+  return m_fonts[f.id()];
+}
+
+} // namespace tex
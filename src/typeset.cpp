@@ -4,11 +4,94 @@
 
 #include "tex/typeset.h"
 
+#include "tex/charbox.h"
+#include "tex/delimiterbuilder.h"
+#include "tex/glyphmetricscache.h"
 #include "tex/math/style.h"
 
 namespace tex
 {
 
+std::shared_ptr<Box> TypesetEngine::typeset(Character c, Font font, const BoxMetrics& metrics)
+{
+  return std::make_shared<CharacterBox>(c, font, metrics);
+}
+
+/*!
+ * \fn std::shared_ptr<Box> characterBox(Character c, Font font)
+ * \brief typesets a character with the metrics of the glyph cache
+ *
+ * This is the non-virtual path used for every character of a paragraph 
+ * or of a formula: unless the engine builds its own kind of boxes (see 
+ * setCustomCharacterBoxes()), a CharacterBox is created directly.
+ */
+std::shared_ptr<Box> TypesetEngine::characterBox(Character c, Font font)
+{
+  const BoxMetrics& metrics = glyphMetrics()->glyph(c, font);
+
+  if (m_custom_character_boxes)
+    return typeset(c, font, metrics);
+
+  return std::make_shared<CharacterBox>(c, font, metrics);
+}
+
+/*!
+ * \fn void setCustomCharacterBoxes(bool on)
+ * \brief makes characterBox() call typeset(Character, Font, const BoxMetrics&)
+ *
+ * Engines that override that function must turn this on.
+ */
+void TypesetEngine::setCustomCharacterBoxes(bool on)
+{
+  m_custom_character_boxes = on;
+}
+
+const std::shared_ptr<GlyphMetricsCache>& TypesetEngine::glyphMetrics()
+{
+  if (m_glyph_metrics == nullptr)
+    m_glyph_metrics = std::make_shared<GlyphMetricsCache>(metrics());
+
+  return m_glyph_metrics;
+}
+
+/*!
+ * \fn void invalidateGlyphMetrics()
+ * \brief discards all cached metrics and delimiters
+ *
+ * This must be called after fonts were reloaded or if metrics() starts 
+ * returning another provider.
+ */
+void TypesetEngine::invalidateGlyphMetrics()
+{
+  m_glyph_metrics.reset();
+
+  if (m_delimiters != nullptr)
+    m_delimiters->clear();
+}
+
+void TypesetEngine::invalidateGlyphMetrics(Font font)
+{
+  if (m_glyph_metrics != nullptr)
+    m_glyph_metrics->invalidate(font);
+
+  if (m_delimiters != nullptr)
+    m_delimiters->clear();
+}
+
+/*!
+ * \fn const std::shared_ptr<DelimiterBuilder>& delimiters()
+ * \brief returns the builder of delimiters of the engine
+ *
+ * Its cache is cleared together with the glyph metrics.
+ */
+const std::shared_ptr<DelimiterBuilder>& TypesetEngine::delimiters()
+{
+  if (m_delimiters == nullptr)
+    m_delimiters = std::make_shared<DelimiterBuilder>(*this);
+
+  return m_delimiters;
+}
+
 Options::Options(const std::shared_ptr<TypesetEngine> & engine)
   : mEngine(engine)
   , mMathStyle(math::Style::T.id())
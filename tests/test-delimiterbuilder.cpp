@@ -0,0 +1,193 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the typeset project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "catch.hpp"
+
+#include "test-typeset.h"
+
+#include "tex/delimiterbuilder.h"
+#include "tex/vbox.h"
+
+#include <map>
+
+namespace
+{
+
+// '(' -> 0x100 -> 0x101 (extensible), '|' has no successor
+class DelimiterFontMetricsProvider : public TestFontMetricsProvider
+{
+public:
+  int metrics_calls = 0;
+  std::map<tex::Character, tex::BoxMetrics> chars;
+
+  DelimiterFontMetricsProvider()
+  {
+    chars['('] = tex::BoxMetrics{ 0.75f, 0.25f, 0.4f };
+    chars['|'] = tex::BoxMetrics{ 0.75f, 0.25f, 0.2f };
+    chars[0x100] = tex::BoxMetrics{ 1.f, 1.f, 0.5f };
+    chars[0x101] = tex::BoxMetrics{ 1.f, 2.f, 0.6f };
+
+    for (tex::Character c : { 0x110, 0x111, 0x112, 0x113 })
+      chars[c] = tex::BoxMetrics{ 0.5f, 0.5f, 0.6f };
+  }
+
+  tex::BoxMetrics metrics(tex::Character c, tex::Font /* font */) override
+  {
+    ++metrics_calls;
+    return chars.at(c);
+  }
+
+  using TestFontMetricsProvider::metrics;
+
+  bool hasChar(tex::Font /* font */, tex::Character c) override
+  {
+    return chars.find(c) != chars.end();
+  }
+
+  tex::Character successor(tex::Font /* font */, tex::Character c) override
+  {
+    return c == '(' ? 0x100 : c == 0x100 ? 0x101 : -1;
+  }
+
+  bool extensible(tex::Font /* font */, tex::Character c, tex::ExtensibleRecipe& recipe) override
+  {
+    if (c != 0x101)
+      return false;
+
+    recipe.top = 0x110;
+    recipe.mid = 0x111;
+    recipe.bot = 0x112;
+    recipe.rep = 0x113;
+    return true;
+  }
+};
+
+class DelimiterTypesetEngine : public TestTypesetEngine
+{
+public:
+  std::shared_ptr<DelimiterFontMetricsProvider> provider = std::make_shared<DelimiterFontMetricsProvider>();
+
+  std::shared_ptr<tex::FontMetricsProvider> metrics() const override
+  {
+    return provider;
+  }
+};
+
+std::string text(const std::shared_ptr<tex::Box>& box)
+{
+  return static_cast<const TestBox&>(*box).m_text;
+}
+
+std::string text(tex::Character c)
+{
+  return tex::Utf8Char{ c }.data();
+}
+
+} // namespace
+
+TEST_CASE("The DelimiterBuilder searches successors and extensible recipes", "[delimiters]")
+{
+  using namespace tex;
+
+  DelimiterTypesetEngine engine;
+  DelimiterBuilder& builder = *engine.delimiters();
+  const DelimiterBuilder::Variant paren{ Font(0), '(' };
+
+  REQUIRE(text(builder.build(paren, 0.5f)) == "(");
+  REQUIRE(text(builder.build(paren, 1.f)) == "(");
+  REQUIRE(text(builder.build(paren, 1.5f)) == text(0x100));
+
+  auto huge = builder.build(paren, 10.f);
+  REQUIRE(huge->isVBox());
+  const List& pieces = std::static_pointer_cast<VBox>(huge)->list();
+  REQUIRE(pieces.size() == 11);
+  REQUIRE(text(std::static_pointer_cast<Box>(pieces.front())) == text(0x110));
+  REQUIRE(text(std::static_pointer_cast<Box>(*std::next(pieces.begin(), 5))) == text(0x111));
+  REQUIRE(text(std::static_pointer_cast<Box>(pieces.back())) == text(0x112));
+  REQUIRE(huge->height() == Approx(0.5f));
+  REQUIRE(huge->totalHeight() == Approx(11.f));
+
+  // The tallest variant is used when none is tall enough
+  REQUIRE(text(builder.build(DelimiterBuilder::Variant{ Font(0), '|' }, 5.f)) == "|");
+
+  // Falls back to the large variant
+  auto large = builder.build(DelimiterBuilder::Variant{ Font(0), '|' }, DelimiterBuilder::Variant{ Font(1), 0x100 }, 1.5f);
+  REQUIRE(text(large) == text(0x100));
+
+  auto none = builder.build(DelimiterBuilder::Variant{ Font(-1), '(' }, 5.f);
+  REQUIRE(none->isHBox());
+  REQUIRE(none->totalHeight() == 0.f);
+}
+
+TEST_CASE("The DelimiterBuilder caches delimiters by size", "[delimiters]")
+{
+  using namespace tex;
+
+  DelimiterTypesetEngine engine;
+  DelimiterBuilder& builder = *engine.delimiters();
+  const DelimiterBuilder::Variant paren{ Font(0), '(' };
+
+  auto a = builder.build(paren, 10.f);
+  const int calls = engine.provider->metrics_calls;
+
+  REQUIRE(builder.build(paren, 10.f) == a);
+  REQUIRE(builder.build(paren, 10.f - builder.quantum() / 2.f) == a);
+  REQUIRE(engine.provider->metrics_calls == calls);
+  REQUIRE(builder.cacheSize() == 1);
+
+  auto b = builder.build(paren, 20.f);
+  REQUIRE(b != a);
+  REQUIRE(builder.build(DelimiterBuilder::Variant{ Font(1), '(' }, 10.f) != a);
+  REQUIRE(builder.cacheSize() == 3);
+
+  builder.setQuantum(1.f);
+  REQUIRE(builder.cacheSize() == 0);
+  REQUIRE(builder.build(paren, 10.2f) == builder.build(paren, 10.9f));
+  REQUIRE(builder.build(paren, 10.2f) != builder.build(paren, 9.9f));
+  REQUIRE_THROWS(builder.setQuantum(0.f));
+
+  engine.invalidateGlyphMetrics();
+  REQUIRE(builder.cacheSize() == 0);
+  REQUIRE(builder.build(paren, 10.f) != a);
+}
+
+TEST_CASE("The DelimiterBuilder never returns a delimiter that is too short", "[delimiters]")
+{
+  using namespace tex;
+
+  DelimiterTypesetEngine engine;
+  DelimiterBuilder& builder = *engine.delimiters();
+  const DelimiterBuilder::Variant paren{ Font(0), '(' };
+
+  // '(' is exactly 1 high; the request falls between two quanta
+  const float just_above = 1.f + builder.quantum() / 4.f;
+  auto next = builder.build(paren, just_above);
+  REQUIRE(text(next) == text(0x100));
+  REQUIRE(next->totalHeight() >= just_above);
+
+  auto huge = builder.build(paren, 11.f + builder.quantum() / 4.f);
+  REQUIRE(huge->isVBox());
+  REQUIRE(huge->totalHeight() >= 11.f + builder.quantum() / 4.f);
+
+  REQUIRE(text(builder.build(paren, 1.f)) == "(");
+}
+
+TEST_CASE("Repeated delimiters are built once", "[!benchmark][delimiters]")
+{
+  using namespace tex;
+
+  DelimiterTypesetEngine engine;
+  const DelimiterBuilder::Variant paren{ Font(0), '(' };
+
+  BENCHMARK("uncached")
+  {
+    engine.delimiters()->clear();
+    return engine.delimiters()->build(paren, 30.f);
+  };
+
+  BENCHMARK("cached")
+  {
+    return engine.delimiters()->build(paren, 30.f);
+  };
+}
@@ -0,0 +1,266 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the typeset project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "catch.hpp"
+
+#include "test-typeset.h"
+
+#include "tex/dviwriter.h"
+
+#include "tex/hbox.h"
+#include "tex/vbox.h"
+#include "tex/glue.h"
+#include "tex/kern.h"
+#include "tex/layoutreader.h"
+#include "tex/rule.h"
+
+#include <map>
+#include <sstream>
+#include <tuple>
+
+namespace
+{
+
+using DviGlyph = std::tuple<int, tex::Character, int32_t, int32_t>;
+
+// A minimal DVI interpreter that records where glyphs and rules are drawn
+struct DviReader
+{
+  const std::string& data;
+  size_t pos = 0;
+
+  std::vector<DviGlyph> glyphs;
+  std::vector<std::tuple<int32_t, int32_t, int32_t, int32_t>> rules;
+  std::map<int, std::string> fonts;
+  std::map<uint8_t, size_t> opcodes;
+  size_t pages = 0;
+
+  explicit DviReader(const std::string& str) : data(str) { }
+
+  uint32_t u(int n)
+  {
+    uint32_t r = 0;
+    while (n-- > 0)
+      r = (r << 8) | static_cast<uint8_t>(data.at(pos++));
+    return r;
+  }
+
+  int32_t s(int n)
+  {
+    uint32_t r = u(n);
+    if (n < 4 && (r & (1u << (8 * n - 1))))
+      r |= ~0u << (8 * n);
+    return static_cast<int32_t>(r);
+  }
+
+  void fontdef(int k)
+  {
+    pos += 12;
+    const int a = u(1), l = u(1);
+    fonts[k] = data.substr(pos + a, l);
+    pos += a + l;
+  }
+
+  void run()
+  {
+    REQUIRE(u(1) == 247);
+    REQUIRE(u(1) == 2);
+    pos += 12;
+    pos += u(1);
+
+    struct State { int32_t h, v, w, x, y, z; };
+    State st{};
+    std::vector<State> stack;
+    int f = -1;
+
+    for (;;)
+    {
+      const uint8_t op = u(1);
+      ++opcodes[op];
+
+      if (op < 128 || (op >= 128 && op <= 131))
+      {
+        const tex::Character c = op < 128 ? op : u(op - 127);
+        glyphs.emplace_back(f, c, st.h, st.v);
+        st.h += 5 * 65536; // all test glyphs are 5pt wide
+      }
+      else if (op == 132 || op == 137)
+      {
+        const int32_t a = s(4), b = s(4);
+        rules.emplace_back(st.h, st.v, a, b);
+        if (op == 132)
+          st.h += b;
+      }
+      else if (op == 139)
+      {
+        pos += 44;
+        st = State{};
+        f = -1;
+        ++pages;
+      }
+      else if (op == 140) {}
+      else if (op == 141) stack.push_back(st);
+      else if (op == 142) { st = stack.back(); stack.pop_back(); }
+      else if (op >= 143 && op <= 146) st.h += s(op - 142);
+      else if (op == 147) st.h += st.w;
+      else if (op >= 148 && op <= 151) st.h += (st.w = s(op - 147));
+      else if (op == 152) st.h += st.x;
+      else if (op >= 153 && op <= 156) st.h += (st.x = s(op - 152));
+      else if (op >= 157 && op <= 160) st.v += s(op - 156);
+      else if (op == 161) st.v += st.y;
+      else if (op >= 162 && op <= 165) st.v += (st.y = s(op - 161));
+      else if (op == 166) st.v += st.z;
+      else if (op >= 167 && op <= 170) st.v += (st.z = s(op - 166));
+      else if (op >= 171 && op <= 234) f = op - 171;
+      else if (op >= 235 && op <= 238) f = u(op - 234);
+      else if (op >= 243 && op <= 246) fontdef(u(op - 242));
+      else if (op == 248) break;
+      else FAIL("unexpected opcode " << int(op));
+
+      REQUIRE(stack.size() < 100);
+    }
+  }
+};
+
+struct GlyphCollector
+{
+  std::vector<DviGlyph>& glyphs;
+
+  void operator()(const tex::Box* box, tex::Pos pos)
+  {
+    if (box->isCharacterBox())
+    {
+      auto cbox = static_cast<const tex::CharacterBox*>(box);
+      glyphs.emplace_back(cbox->font().id(), cbox->character(), tex::DviWriter::scaled(pos.x), tex::DviWriter::scaled(pos.y));
+    }
+  }
+
+  void operator()(const tex::Rule*, tex::Pos) { }
+};
+
+} // namespace
+
+static std::shared_ptr<tex::VBox> dvi_page()
+{
+  using namespace tex;
+
+  auto fraction = vbox({ test_word("1", 2), hrule(5.f, 0.5f, 0.5f), test_word("2", 2) });
+  fraction->setShiftAmount(-3.f);
+
+  List lines;
+
+  for (int i(0); i < 10; ++i)
+  {
+    List line;
+    test_word(line, "the", 1);
+    line.push_back(glue(3.33f, Shrink(1.f), Stretch(2.f)));
+    test_word(line, "quick", 1);
+    line.push_back(glue(3.33f, Shrink(1.f), Stretch(2.f)));
+    test_word(line, "fox", 1);
+    line.push_back(kern(1.f));
+    line.push_back(fraction);
+    line.push_back(glue(3.33f, Shrink(1.f), Stretch(2.f)));
+    test_word(line, "\xE9t\xE9", 70);
+    lines.push_back(hbox(std::move(line), 100.f));
+    lines.push_back(glue(12.f));
+  }
+
+  lines.push_back(hrule(100.f, 0.4f));
+
+  return vbox(std::move(lines));
+}
+
+TEST_CASE("DviWriter places glyphs where the layout puts them", "[dviwriter]")
+{
+  using namespace tex;
+
+  std::ostringstream out;
+  DviWriter writer{ out, "typeset test" };
+  writer.setFont(Font(1), "cmr10", 10.f);
+  writer.setFont(Font(2), "cmmi10", 10.f, 10.f, 0x12345678);
+
+  auto page = dvi_page();
+  writer.writePage(*page);
+  writer.writePage(*page);
+  writer.finish();
+
+  REQUIRE(writer.pageCount() == 2);
+
+  const std::string dvi = out.str();
+  REQUIRE(dvi.size() % 4 == 0);
+  REQUIRE(dvi.size() == writer.bytesWritten());
+
+  DviReader reader{ dvi };
+  reader.run();
+
+  REQUIRE(reader.pages == 2);
+  REQUIRE(reader.fonts[1] == "cmr10");
+  REQUIRE(reader.fonts[2] == "cmmi10");
+  REQUIRE(reader.fonts[70] == "font70");
+
+  std::vector<DviGlyph> expected;
+  tex::traverse(GlyphCollector{ expected }, page.get());
+  REQUIRE(expected.size() == 160);
+
+  std::vector<DviGlyph> first_page{ reader.glyphs.begin(), reader.glyphs.begin() + expected.size() };
+  REQUIRE(first_page == expected);
+
+  // 10 fraction bars and the final rule, twice
+  REQUIRE(reader.rules.size() == 22);
+  REQUIRE(std::get<3>(reader.rules.back()) == DviWriter::scaled(100.f));
+
+  // interword spaces are repeated and must use the registers
+  REQUIRE(reader.opcodes[147] + reader.opcodes[152] >= 20);
+  REQUIRE(reader.opcodes[143] + reader.opcodes[144] + reader.opcodes[145] + reader.opcodes[146] == 0);
+  REQUIRE(reader.opcodes[141] == reader.opcodes[142]);
+}
+
+TEST_CASE("DviWriter writes a valid postamble", "[dviwriter]")
+{
+  using namespace tex;
+
+  std::ostringstream out;
+  DviWriter writer{ out };
+  auto page = dvi_page();
+
+  for (int i(0); i < 3; ++i)
+    writer.writePage(*page);
+
+  writer.finish();
+
+  const std::string dvi = out.str();
+
+  size_t end = dvi.size();
+  while (static_cast<uint8_t>(dvi[end - 1]) == 223)
+    --end;
+
+  REQUIRE(dvi.size() - end >= 4);
+  REQUIRE(dvi[end - 1] == 2);
+
+  DviReader reader{ dvi };
+  reader.pos = end - 5;
+  const size_t post = reader.u(4);
+  REQUIRE(static_cast<uint8_t>(dvi[post]) == 248);
+
+  reader.pos = post + 1;
+  size_t bop = reader.u(4);
+  size_t pages = 0;
+
+  while (bop != 0xFFFFFFFF)
+  {
+    REQUIRE(static_cast<uint8_t>(dvi[bop]) == 139);
+    reader.pos = bop + 1;
+    REQUIRE(reader.s(4) == static_cast<int32_t>(3 - pages));
+    reader.pos = bop + 41;
+    bop = reader.u(4);
+    ++pages;
+  }
+
+  REQUIRE(pages == 3);
+
+  reader.pos = post + 21;
+  REQUIRE(reader.u(4) == static_cast<uint32_t>(DviWriter::scaled(page->width())));
+  REQUIRE(reader.u(2) == 3); // max stack depth
+  REQUIRE(reader.u(2) == 3);
+}
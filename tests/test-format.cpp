@@ -6,6 +6,11 @@
 
 #include "tex/parsing/format.h"
 
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
 using namespace tex;
 
 TEST_CASE("A simple format can be parsed", "[format]")
@@ -37,3 +42,181 @@ TEST_CASE("A simple format can be parsed", "[format]")
  REQUIRE(end.parameterText().size() == 1);
  REQUIRE(end.replacementText().size() == 6);
 }
+
+static std::string letters(size_t n)
+{
+  std::string result;
+
+  do
+  {
+    result += static_cast<char>('a' + n % 26);
+    n /= 26;
+  } while (n != 0);
+
+  return result;
+}
+
+static std::string generated_format(size_t n)
+{
+  std::string src = "\\def\\greet#1{Hello #1!}\n";
+
+  for (size_t i(0); i < n; ++i)
+  {
+    const std::string name = "macro@" + letters(i);
+    src += "\\def\\" + name + "#1.#2{\\csname " + name + "\\endcsname{#2}#1}\n";
+  }
+
+  return src;
+}
+
+static std::vector<uint8_t> dump_format(const std::string& src)
+{
+  std::ostringstream out;
+  parsing::Format::dump(src, out);
+  const std::string bytes = out.str();
+  return std::vector<uint8_t>(bytes.begin(), bytes.end());
+}
+
+TEST_CASE("A format can be dumped and loaded", "[format]")
+{
+  using namespace parsing;
+
+  const std::string src = generated_format(50);
+  std::vector<Macro> expected = Format::parse(src);
+
+  FormatImage image{ dump_format(src) };
+
+  REQUIRE(image.size() == expected.size());
+  REQUIRE(image.catcodes() == Lexer::DefaultCatCodes);
+  REQUIRE(image.mathcodes().at('a').value() == MathCode::DefaultTable.at('a').value());
+
+  std::vector<Macro> loaded = image.macros();
+
+  for (size_t i(0); i < loaded.size(); ++i)
+  {
+    REQUIRE(loaded.at(i).controlSequence() == expected.at(i).controlSequence());
+    REQUIRE(loaded.at(i).parameterText() == expected.at(i).parameterText());
+    REQUIRE(loaded.at(i).replacementText() == expected.at(i).replacementText());
+  }
+
+  const Macro* m = image.find(CsTable::global().intern("macro@h"));
+  REQUIRE(m != nullptr);
+  REQUIRE(m->controlSequence() == "macro@h");
+  REQUIRE(m->replacementText().size() == 13);
+  REQUIRE(image.find(CsTable::global().intern("macro@h")) == m);
+  REQUIRE(image.find(CsTable::global().intern("undefined@macro")) == nullptr);
+}
+
+TEST_CASE("The preprocessor expands the macros of a format image", "[format]")
+{
+  using namespace parsing;
+
+  const std::string path = "test-format.fmt";
+
+  {
+    std::ofstream out{ path, std::ios::binary };
+    Format::dump(generated_format(10), out);
+  }
+
+  auto image = std::make_shared<FormatImage>(path);
+
+  Preprocessor preproc;
+  preproc.loadFormat(image);
+
+  auto run = [&preproc](const std::string& text) {
+    Lexer lex;
+    lex.write(text);
+
+    for (const Token& t : lex.output())
+      preproc.write(t);
+
+    while (!preproc.input.empty())
+      preproc.advance();
+
+    std::vector<Token> result;
+    std::swap(result, preproc.output);
+    return result;
+  };
+
+  auto tokenize = [](const std::string& text) {
+    Lexer lex;
+    lex.write(text);
+    return lex.output();
+  };
+
+  REQUIRE(run("\\greet{world}") == tokenize("Hello world!"));
+
+  preproc.beginGroup();
+  REQUIRE(run("\\def\\greet#1{Bye #1!}\\greet{world}") == tokenize("Bye world!"));
+  preproc.endGroup();
+
+  REQUIRE(run("\\greet{world}") == tokenize("Hello world!"));
+  REQUIRE(preproc.macros().size() == 0);
+
+  image.reset();
+  preproc.loadFormat(nullptr);
+  std::remove(path.c_str());
+
+  std::vector<uint8_t> bytes = dump_format(generated_format(10));
+
+  REQUIRE_THROWS(FormatImage{ std::vector<uint8_t>(bytes.begin(), bytes.begin() + 64) });
+
+  std::vector<uint8_t> bad_magic = bytes;
+  bad_magic[0] = 'X';
+  REQUIRE_THROWS(FormatImage{ bad_magic });
+
+  std::vector<uint8_t> bad_version = bytes;
+  bad_version[4] += 1;
+  REQUIRE_THROWS(FormatImage{ bad_version });
+}
+
+TEST_CASE("Corrupted tokens of a format image are rejected", "[format]")
+{
+  using namespace parsing;
+
+  const std::vector<uint8_t> bytes = dump_format("\\def\\greet#1{Hello #1!}\n");
+  REQUIRE(FormatImage{ bytes }.macros().size() == 1);
+
+  // Token records come last: { value, type, category, reserved }
+  auto corrupt = [&bytes](TokenType type, size_t field, uint32_t value) {
+    std::vector<uint8_t> result = bytes;
+
+    for (size_t offset(result.size() - 8); ; offset -= 8)
+    {
+      if (result[offset + 4] == static_cast<uint8_t>(type))
+      {
+        if (field == 0)
+          std::memcpy(result.data() + offset, &value, sizeof(value));
+        else
+          result[offset + field] = static_cast<uint8_t>(value);
+
+        return result;
+      }
+    }
+  };
+
+  REQUIRE_THROWS(FormatImage{ corrupt(TokenType::ParameterToken, 0, 0) }.macros());
+  REQUIRE_THROWS(FormatImage{ corrupt(TokenType::ParameterToken, 0, 10) }.macros());
+  REQUIRE_THROWS(FormatImage{ corrupt(TokenType::CharacterToken, 5, 16) }.macros());
+  REQUIRE(FormatImage{ corrupt(TokenType::ParameterToken, 0, 1) }.macros().size() == 1);
+}
+
+TEST_CASE("Loading a large format", "[!benchmark][format]")
+{
+  using namespace parsing;
+
+  const std::string src = generated_format(5000);
+  const std::vector<uint8_t> bytes = dump_format(src);
+  const CsId greet = CsTable::global().intern("greet");
+
+  BENCHMARK("parse")
+  {
+    return Format::parse(src).size();
+  };
+
+  BENCHMARK("load image")
+  {
+    FormatImage image{ bytes };
+    return image.find(greet);
+  };
+}
@@ -0,0 +1,248 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the typeset project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "catch.hpp"
+
+#include "test-tfm.h"
+#include "test-typeset.h"
+
+#include "tex/glyphmetricscache.h"
+#include "tex/headless/typeset-engine.h"
+#include "tex/hlist.h"
+#include "tex/math/atom.h"
+#include "tex/math/math-typeset.h"
+
+#include <cstdio>
+#include <fstream>
+
+namespace
+{
+
+class CountingFontMetricsProvider : public TestFontMetricsProvider
+{
+public:
+  int metrics_calls = 0;
+  int fontdimen_calls = 0;
+
+  CountingFontMetricsProvider()
+  {
+    auto sfcodes = std::make_shared<tex::SfcodeTable>();
+    sfcodes->set('.', 3000);
+    setSfcodes(sfcodes);
+  }
+
+  tex::BoxMetrics metrics(tex::Character c, tex::Font font) override
+  {
+    ++metrics_calls;
+    return tex::BoxMetrics{ 1.f, 0.f, static_cast<float>(c) + font.id() };
+  }
+
+  using TestFontMetricsProvider::metrics;
+
+  const tex::FontDimen& fontdimen(tex::Font f) override
+  {
+    ++fontdimen_calls;
+    return TestFontMetricsProvider::fontdimen(f);
+  }
+};
+
+class CountingTypesetEngine : public TestTypesetEngine
+{
+public:
+  std::shared_ptr<CountingFontMetricsProvider> provider = std::make_shared<CountingFontMetricsProvider>();
+
+  std::shared_ptr<tex::FontMetricsProvider> metrics() const override
+  {
+    return provider;
+  }
+};
+
+class PlainCountingTypesetEngine : public CountingTypesetEngine
+{
+public:
+  PlainCountingTypesetEngine()
+  {
+    setCustomCharacterBoxes(false);
+  }
+};
+
+} // namespace
+
+TEST_CASE("The glyph metrics cache queries the provider once per glyph", "[glyphmetricscache]")
+{
+  using namespace tex;
+
+  auto provider = std::make_shared<CountingFontMetricsProvider>();
+  GlyphMetricsCache cache{ provider };
+
+  REQUIRE(cache.metrics('a', Font(0)).width == 'a');
+  REQUIRE(cache.glyph('a', Font(0)).width == 'a');
+  REQUIRE(cache.glyph('a', Font(2)).width == 'a' + 2);
+  REQUIRE(provider->metrics_calls == 2);
+
+  // outside of Latin-1
+  REQUIRE(cache.glyph(0x3B1, Font(0)).width == 0x3B1);
+  REQUIRE(cache.glyph(0x3B1, Font(0)).width == 0x3B1);
+  REQUIRE(provider->metrics_calls == 3);
+
+  REQUIRE(cache.sfcode('.') == 3000);
+  REQUIRE(cache.sfcode('.') == 3000);
+  REQUIRE(cache.sfcode(0x2026) == 1000);
+  REQUIRE(cache.sfcodes() == provider->sfcodes());
+
+  REQUIRE(cache.fontdimen(Font(0)).quad == 3.f);
+  REQUIRE(cache.quad(Font(0)) == 3.f);
+  REQUIRE(provider->fontdimen_calls == 1);
+
+  cache.invalidate(Font(2));
+  cache.glyph('a', Font(0));
+  cache.glyph('a', Font(2));
+  REQUIRE(provider->metrics_calls == 4);
+
+  cache.invalidate();
+  cache.glyph('a', Font(0));
+  cache.glyph(0x3B1, Font(0));
+  REQUIRE(provider->metrics_calls == 6);
+
+  REQUIRE_THROWS(cache.glyph('a', Font(-1)));
+}
+
+TEST_CASE("HListBuilder reads its metrics from the engine cache", "[glyphmetricscache]")
+{
+  using namespace tex;
+
+  auto engine = std::make_shared<CountingTypesetEngine>();
+  HListBuilder builder{ engine };
+
+  const std::string text = "aaa. aaa.";
+
+  for (char c : text)
+  {
+    if (c == ' ')
+      builder.push_back_interword_glue();
+    else
+      builder.push_back(c);
+  }
+
+  builder.flush();
+
+  REQUIRE(builder.result.size() == text.size());
+  REQUIRE(builder.result.front()->as<Box>().width() == 'a');
+  REQUIRE(engine->provider->metrics_calls == 2);
+  REQUIRE(engine->provider->fontdimen_calls == 1);
+
+  // the space after a period gets the extra space
+  REQUIRE((*std::next(builder.result.begin(), 4))->as<Glue>().space() == 2.f);
+
+  engine->invalidateGlyphMetrics();
+  builder.push_back('a');
+  builder.flush();
+  REQUIRE(engine->provider->metrics_calls == 3);
+}
+
+TEST_CASE("Characters and math symbols are typeset from the engine cache", "[glyphmetricscache]")
+{
+  using namespace tex;
+
+  auto engine = std::make_shared<PlainCountingTypesetEngine>();
+
+  std::shared_ptr<Box> box = engine->characterBox('a', Font(1));
+  REQUIRE(box->isCharacterBox());
+  REQUIRE(box->width() == 'a' + 1);
+
+  auto symbol = std::make_shared<MathSymbol>('x', math::Atom::Ord, 0);
+  REQUIRE(engine->glyphMetrics()->metrics(symbol, Font(1)).width == 'x' + 1);
+  REQUIRE(engine->provider->metrics_calls == 2);
+
+  std::array<MathFont, 16> fonts;
+  for (int i(0); i < 16; ++i)
+    fonts[i] = MathFont{ Font(3 * i), Font(3 * i + 1), Font(3 * i + 2) };
+
+  MathTypesetter typesetter{ engine };
+  typesetter.setFonts(fonts);
+  engine->provider->metrics_calls = 0;
+
+  MathList mlist;
+  for (int i(0); i < 3; ++i)
+    mlist.push_back(math::Atom::create<math::Atom::Ord>(std::make_shared<MathSymbol>('y', math::Atom::Ord, 1), nullptr, nullptr));
+
+  List hlist = typesetter.mlist2hlist(std::move(mlist), math::Style::T);
+
+  REQUIRE(hlist.size() == 3);
+  REQUIRE(hlist.front()->as<Box>().isCharacterBox());
+  REQUIRE(engine->provider->metrics_calls == 1);
+}
+
+TEST_CASE("Reloading a font invalidates its cached metrics", "[glyphmetricscache]")
+{
+  using namespace tex;
+
+  const std::string path = "test-glyphmetricscache-font.tfm";
+
+  auto write_font = [&path](double width) {
+    TfmBuilder builder;
+    builder.addChar('x', width, 0.5, 0.0);
+    builder.params = { 0.0, 0.333, 0.166, 0.111, 0.43, 1.0, 0.111 };
+    const std::vector<uint8_t> bytes = builder.build();
+    std::ofstream out{ path, std::ios::binary };
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  };
+
+  write_font(0.5);
+
+  {
+    auto engine = std::make_shared<headless::TypesetEngine>();
+    const Font f = engine->loadFont(path, 10.f);
+
+    HListBuilder builder{ engine, f };
+    builder.push_back('x');
+    builder.push_back_interword_glue();
+    REQUIRE(builder.result.front()->as<Box>().width() == Approx(5.f));
+    REQUIRE(builder.result.back()->as<Glue>().space() == Approx(3.33f));
+
+    write_font(0.8);
+    engine->reloadFont(path);
+
+    builder.push_back('x');
+    builder.flush();
+    REQUIRE(builder.result.back()->as<Box>().width() == Approx(8.f));
+    REQUIRE(engine->glyphMetrics()->glyph('x', f).width == Approx(8.f));
+  }
+
+  std::remove(path.c_str());
+}
+
+TEST_CASE("Benchmark glyph metrics lookups", "[!benchmark][glyphmetricscache]")
+{
+  using namespace tex;
+
+  auto engine = std::make_shared<headless::TypesetEngine>();
+  TfmBuilder b;
+  for (int c(32); c < 128; ++c)
+    b.addChar(c, 0.5, 0.7, 0.1);
+  b.params = { 0.0, 0.333, 0.166, 0.111, 0.43, 1.0, 0.111 };
+  const std::vector<uint8_t> bytes = b.build();
+  const Font f = engine->addFont("bench", std::make_shared<TfmFile>(bytes.data(), bytes.size()), 10.f);
+
+  std::string text;
+  for (int i(0); i < 2000; ++i)
+    text += "The quick brown fox jumps over the lazy dog. ";
+
+  BENCHMARK("provider")
+  {
+    float w = 0.f;
+    for (char c : text)
+      w += engine->metrics()->metrics(c, f).width;
+    return w;
+  };
+
+  BENCHMARK("cache")
+  {
+    GlyphMetricsCache& cache = *engine->glyphMetrics();
+    float w = 0.f;
+    for (char c : text)
+      w += cache.glyph(c, f).width;
+    return w;
+  };
+}
@@ -0,0 +1,85 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the typeset project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "catch.hpp"
+
+#include "test-typeset.h"
+
+#include "tex/glyphrun.h"
+
+#include "tex/hbox.h"
+#include "tex/vbox.h"
+#include "tex/glue.h"
+#include "tex/kern.h"
+#include "tex/rule.h"
+
+static const tex::BoxMetrics glyph_metrics{ 2.f, 1.f, 2.f };
+
+static std::shared_ptr<tex::Box> char_box(tex::Character c, int font)
+{
+  return std::make_shared<tex::CharacterBox>(c, tex::Font(font), glyph_metrics);
+}
+
+TEST_CASE("Glyphs are grouped by font and baseline", "[glyphrun]")
+{
+  using namespace tex;
+
+  auto x_sub = hbox({ char_box('i', 2) });
+  x_sub->setShiftAmount(1.f);
+
+  auto line1 = hbox({ test_word("ab", 1, glyph_metrics), glue(3.f), kern(-0.5f), test_word("cd", 1, glyph_metrics), char_box('x', 2), x_sub, hrule(1.f, 1.f), test_word("e", 1, glyph_metrics) });
+  auto line2 = hbox({ test_word("fg", 1, glyph_metrics) });
+  auto page = vbox({ line1, line2 });
+
+  GlyphRunList list{ *page };
+
+  REQUIRE(list.glyphCount() == 9);
+  REQUIRE(list.runs().size() == 5);
+
+  const GlyphRun& first = list.runs().at(0);
+  REQUIRE(first.font == Font(1));
+  REQUIRE(first.glyphs == std::vector<Character>{ 'a', 'b', 'c', 'd' });
+  REQUIRE(first.advances == std::vector<float>{ 2.f, 4.5f, 2.f, 2.f });
+  REQUIRE(first.origin.x == 0.f);
+  REQUIRE(first.origin.y == line1->height());
+  REQUIRE(first.width() == 10.5f);
+
+  const GlyphRun& subscript = list.runs().at(2);
+  REQUIRE(subscript.glyphs == std::vector<Character>{ 'i' });
+  REQUIRE(subscript.origin.y == first.origin.y + 1.f);
+
+  const GlyphRun& last = list.runs().at(4);
+  REQUIRE(last.glyphs == std::vector<Character>{ 'f', 'g' });
+  REQUIRE(last.origin.y == first.origin.y + line1->depth() + line2->height());
+
+  REQUIRE(list.buckets().size() == 2);
+  REQUIRE(list.bucket(Font(1))->runs == std::vector<size_t>{ 0, 3, 4 });
+  REQUIRE(list.bucket(Font(2))->runs == std::vector<size_t>{ 1, 2 });
+  REQUIRE(list.bucket(Font(3)) == nullptr);
+}
+
+TEST_CASE("GlyphRunBuilder can be reused", "[glyphrun]")
+{
+  using namespace tex;
+
+  CharacterBox a{ 'a', Font(1), BoxMetrics{ 2.f, 1.f, 2.f } };
+  CharacterBox b{ 'b', Font(2), BoxMetrics{ 2.f, 1.f, 3.f } };
+
+  GlyphRunBuilder builder;
+  REQUIRE(builder.empty());
+
+  builder.push_back(a, Pos{ 1.f, 5.f });
+  REQUIRE(builder.accepts(a, Pos{ 10.f, 5.f }));
+  REQUIRE(!builder.accepts(a, Pos{ 10.f, 6.f }));
+  REQUIRE(!builder.accepts(b, Pos{ 10.f, 5.f }));
+
+  GlyphRun run = builder.take();
+  REQUIRE(builder.empty());
+  REQUIRE(run.origin.x == 1.f);
+  REQUIRE(run.advances == std::vector<float>{ 2.f });
+
+  builder.push_back(b, Pos{ 0.f, 0.f });
+  REQUIRE(builder.run().font == Font(2));
+  REQUIRE(builder.run().width() == 3.f);
+}
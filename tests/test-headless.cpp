@@ -0,0 +1,319 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the typeset project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "catch.hpp"
+
+#include "test-tfm.h"
+
+#include "tex/headless/typeset-engine.h"
+
+#include "tex/charbox.h"
+#include "tex/hbox.h"
+#include "tex/vbox.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+namespace
+{
+
+using tex::tfm::Tag;
+
+std::shared_ptr<tex::TfmFile> make_tfm(const TfmBuilder& builder)
+{
+  static std::vector<std::vector<uint8_t>> storage;
+  storage.push_back(builder.build());
+  return std::make_shared<tex::TfmFile>(storage.back().data(), storage.back().size());
+}
+
+std::shared_ptr<tex::TfmFile> roman()
+{
+  TfmBuilder b;
+  b.addChar('(', 0.4, 0.75, 0.25);
+  b.addChar('a', 0.5, 0.45, 0.0);
+  b.addChar('b', 0.55, 0.7, 0.0);
+  b.params = { 0.0, 0.333, 0.166, 0.111, 0.43, 1.0, 0.111 };
+  return make_tfm(b);
+}
+
+std::shared_ptr<tex::TfmFile> symbols()
+{
+  TfmBuilder b;
+  b.addChar(0x70, 0.8, 0.04, 0.96); // \surd
+  b.params.resize(22, 0.1);
+  b.params[21] = 0.25; // axis height
+  return make_tfm(b);
+}
+
+std::shared_ptr<tex::TfmFile> extension()
+{
+  TfmBuilder b;
+  b.addChar(0x00, 0.45, 0.04, 1.16, 0.0, Tag::CharList, 0x10);
+  b.addChar(0x10, 0.6, 0.04, 1.76, 0.0, Tag::CharList, 0x20);
+  b.addChar(0x20, 0.9, 0.04, 2.96, 0.0, Tag::Extensible, 0);
+  b.addChar(0x30, 0.9, 0.04, 0.96); // top
+  b.addChar(0x40, 0.9, 0.04, 0.96); // bot
+  b.addChar(0x42, 0.9, 0.0, 0.5); // rep
+  b.addChar(0x50, 1.0, 0.0, 1.0, 0.0, Tag::CharList, 0x58); // \sum
+  b.addChar(0x58, 1.4, 0.0, 1.4);
+  b.addChar(0x70, 1.0, 0.04, 1.16, 0.0, Tag::CharList, 0x71);
+  b.addChar(0x71, 1.0, 0.04, 1.76, 0.0, Tag::Extensible, 1);
+  b.addChar(0x74, 1.0, 0.0, 1.0); // bottom of the radical
+  b.addChar(0x75, 0.5, 0.0, 0.5); // extender
+  b.addChar(0x76, 0.5, 0.04, 0.56); // top
+  b.extensibles = { { 0x30, 0, 0x40, 0x42 }, { 0x76, 0, 0x74, 0x75 } };
+  b.params = { 0.0, 0.0, 0.0, 0.0, 0.43, 1.0, 0.0, 0.04, 0.11, 0.16, 0.2, 0.6, 0.1 };
+  return make_tfm(b);
+}
+
+std::shared_ptr<tex::headless::TypesetEngine> make_engine()
+{
+  using namespace tex;
+
+  auto engine = std::make_shared<headless::TypesetEngine>();
+  auto r = roman(), s = symbols(), x = extension();
+
+  const Font cmr10 = engine->addFont("cmr10", r, 10.f);
+  const Font cmr7 = engine->addFont("cmr7", r, 7.f);
+  const Font cmsy10 = engine->addFont("cmsy10", s, 10.f);
+  const Font cmex10 = engine->addFont("cmex10", x, 10.f);
+
+  engine->setMathFont(0, cmr10, cmr7, cmr7);
+  engine->setMathFont(2, cmsy10, cmsy10, cmsy10);
+  engine->setMathFont(3, cmex10, cmex10, cmex10);
+
+  return engine;
+}
+
+const tex::CharacterBox& as_char(const std::shared_ptr<tex::Box>& box)
+{
+  REQUIRE(box->isCharacterBox());
+  return *std::static_pointer_cast<tex::CharacterBox>(box);
+}
+
+} // namespace
+
+TEST_CASE("The headless engine takes its metrics from TFM files", "[headless]")
+{
+  using namespace tex;
+
+  auto engine = make_engine();
+  const Font cmr10 = engine->mathfonts()[0].textfont;
+  const Font cmr7 = engine->mathfonts()[0].scriptfont;
+  const Font cmsy10 = engine->mathfonts()[2].textfont;
+  const Font cmex10 = engine->mathfonts()[3].textfont;
+  auto metrics = engine->metrics();
+
+  REQUIRE(metrics->quad(cmr10) == Approx(10.f));
+  REQUIRE(metrics->quad(cmr7) == Approx(7.f));
+  REQUIRE(metrics->interwordSpace(cmr10) == Approx(3.33f));
+  REQUIRE(metrics->axisHeight(cmsy10) == Approx(2.5f));
+  REQUIRE(metrics->defaultRuleThickness(cmex10) == Approx(0.4f));
+
+  const CharacterBox& a = as_char(engine->typeset('a', cmr7));
+  REQUIRE(a.character() == 'a');
+  REQUIRE(a.font() == cmr7);
+  REQUIRE(a.width() == Approx(3.5f));
+  REQUIRE(a.height() == Approx(3.15f));
+
+  auto word = engine->typeset("ab", cmr10);
+  REQUIRE(word->isHBox());
+  REQUIRE(word->width() == Approx(10.5f));
+  REQUIRE(word->height() == Approx(7.f));
+}
+
+TEST_CASE("The headless engine searches delimiters through successors", "[headless]")
+{
+  using namespace tex;
+
+  auto engine = make_engine();
+  const Font cmr10 = engine->mathfonts()[0].textfont;
+  const Font cmex10 = engine->mathfonts()[3].textfont;
+  auto paren = std::make_shared<MathSymbol>('(', 4, 0);
+
+  const CharacterBox& small = as_char(engine->typesetDelimiter(paren, 5.f));
+  REQUIRE(small.character() == '(');
+  REQUIRE(small.font() == cmr10);
+
+  const CharacterBox& big = as_char(engine->typesetDelimiter(paren, 11.f));
+  REQUIRE(big.character() == 0x00);
+  REQUIRE(big.font() == cmex10);
+
+  const CharacterBox& bigger = as_char(engine->typesetDelimiter(paren, 17.f));
+  REQUIRE(bigger.character() == 0x10);
+
+  auto huge = engine->typesetDelimiter(paren, 29.f);
+  REQUIRE(huge->isVBox());
+  const List& pieces = std::static_pointer_cast<VBox>(huge)->list();
+  REQUIRE(pieces.size() == 4);
+  REQUIRE(as_char(std::static_pointer_cast<Box>(pieces.front())).character() == 0x30);
+  REQUIRE(as_char(std::static_pointer_cast<Box>(pieces.back())).character() == 0x40);
+  REQUIRE(huge->height() == Approx(0.4f));
+  REQUIRE(huge->totalHeight() == Approx(30.f).margin(1e-3));
+}
+
+TEST_CASE("The headless engine builds radical signs and large operators", "[headless]")
+{
+  using namespace tex;
+
+  auto engine = make_engine();
+  const Font cmsy10 = engine->mathfonts()[2].textfont;
+  const Font cmex10 = engine->mathfonts()[3].textfont;
+
+  const CharacterBox& small = as_char(engine->typesetRadicalSign(8.f));
+  REQUIRE(small.character() == 0x70);
+  REQUIRE(small.font() == cmsy10);
+
+  const CharacterBox& large = as_char(engine->typesetRadicalSign(11.f));
+  REQUIRE(large.character() == 0x70);
+  REQUIRE(large.font() == cmex10);
+
+  auto radical = engine->typesetRadicalSign(40.f);
+  REQUIRE(radical->isVBox());
+  REQUIRE(radical->height() == Approx(0.4f));
+  REQUIRE(radical->totalHeight() >= 40.f);
+  REQUIRE(radical->totalHeight() < 45.f);
+
+  auto sum = std::make_shared<MathSymbol>(0x50, 1, 3);
+  REQUIRE(as_char(engine->typesetLargeOp(sum)).character() == 0x58);
+}
+
+TEST_CASE("The headless engine loads TFM files from disk", "[headless]")
+{
+  using namespace tex;
+
+  TfmBuilder builder;
+  builder.addChar('x', 0.5, 0.5, 0.0);
+  const std::vector<uint8_t> bytes = builder.build();
+  const std::string path = "test-headless-font.tfm";
+
+  {
+    std::ofstream out{ path, std::ios::binary };
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  }
+
+  {
+    headless::TypesetEngine engine;
+    const Font f = engine.loadFont(path, 12.f);
+    const Font g = engine.loadFont(path, 6.f);
+    REQUIRE(f != g);
+    REQUIRE(engine.tfmMetrics()->font(f).file == engine.tfmMetrics()->font(g).file);
+    REQUIRE(engine.typeset('x', g)->width() == Approx(3.f));
+  }
+
+  std::remove(path.c_str());
+}
+
+TEST_CASE("Engines share the fonts of the registry", "[headless]")
+{
+  using namespace tex;
+
+  auto r = roman();
+
+  headless::TypesetEngine a;
+  headless::TypesetEngine b;
+
+  const Font fa = a.addFont("cmr10", r, 10.f);
+  const Font fb = b.addFont("cmr10", r, 10.f);
+  REQUIRE(fa == fb);
+  REQUIRE(b.addFont("cmr10", r, 12.f) != fa);
+  REQUIRE(&a.tfmMetrics()->font(fa) == &b.tfmMetrics()->font(fb));
+
+  auto registry = std::make_shared<headless::FontRegistry>();
+  headless::TypesetEngine c{ std::make_shared<headless::TfmFontMetricsProvider>(registry) };
+  REQUIRE(c.addFont("cmr10", r, 10.f) == Font(0));
+  REQUIRE(registry->size() == 1);
+  REQUIRE_THROWS(registry->font(Font(1)));
+}
+
+TEST_CASE("Fonts can be read while others are published", "[headless]")
+{
+  using namespace tex;
+
+  auto registry = std::make_shared<headless::FontRegistry>();
+  auto r = roman();
+  const size_t count = 3 * headless::FontRegistry::SegmentSize;
+
+  std::atomic<bool> failed{ false };
+
+  std::thread writer{ [&]() {
+    for (size_t i(0); i < count; ++i)
+      registry->add("cmr", r, static_cast<float>(i + 1));
+  } };
+
+  std::vector<std::thread> readers;
+
+  for (int t(0); t < 4; ++t)
+  {
+    readers.emplace_back([&]() {
+      while (registry->size() < count)
+      {
+        const size_t n = registry->size();
+
+        for (size_t i(0); i < n; ++i)
+        {
+          if (registry->font(Font(static_cast<int>(i))).size != static_cast<float>(i + 1))
+            failed = true;
+        }
+      }
+    });
+  }
+
+  writer.join();
+
+  for (std::thread& t : readers)
+    t.join();
+
+  REQUIRE(!failed);
+  REQUIRE(registry->size() == count);
+}
+
+TEST_CASE("Reloading a file keeps the ids of its fonts", "[headless]")
+{
+  using namespace tex;
+
+  TfmBuilder builder;
+  builder.addChar('x', 0.5, 0.5, 0.0);
+  const std::vector<uint8_t> bytes = builder.build();
+  const std::string path = "test-headless-reload.tfm";
+
+  {
+    std::ofstream out{ path, std::ios::binary };
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  }
+
+  {
+    auto registry = std::make_shared<headless::FontRegistry>();
+    const Font f = registry->add("x10", registry->loadFile(path), 10.f);
+    const Font g = registry->add("x12", registry->loadFile(path), 12.f);
+
+    for (size_t i(1); i <= 3; ++i)
+    {
+      const headless::TfmFont& before = registry->font(f);
+      const std::vector<Font> reloaded = registry->reload(path);
+
+      REQUIRE(reloaded.size() == 2);
+      REQUIRE(std::find(reloaded.begin(), reloaded.end(), f) != reloaded.end());
+      REQUIRE(registry->size() == 2);
+      REQUIRE(registry->retiredCount() == 2 * i);
+      REQUIRE(&registry->font(f) != &before);
+      REQUIRE(before.size == 10.f);
+      REQUIRE(registry->font(f).size == 10.f);
+      REQUIRE(registry->font(g).size == 12.f);
+      REQUIRE(registry->font(f).file == registry->font(g).file);
+      REQUIRE(registry->add("x10", registry->loadFile(path), 10.f) == f);
+    }
+
+    registry->reclaim();
+
+    REQUIRE(registry->retiredCount() == 0);
+    REQUIRE(registry->font(f).name == "x10");
+    REQUIRE(registry->font(g).fontdimen.quad == registry->font(f).fontdimen.quad * 1.2f);
+  }
+
+  std::remove(path.c_str());
+}
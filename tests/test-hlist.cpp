@@ -0,0 +1,275 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the typeset project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "catch.hpp"
+
+#include "test-tfm.h"
+
+#include "tex/headless/typeset-engine.h"
+
+#include "tex/charbox.h"
+#include "tex/glue.h"
+#include "tex/glyphmetricscache.h"
+#include "tex/hlist.h"
+#include "tex/kern.h"
+
+namespace
+{
+
+using tex::tfm::Tag;
+
+std::vector<uint8_t> ligkern_font()
+{
+  TfmBuilder b;
+
+  for (char c : std::string("ilqrstuvxyzAV"))
+    b.addChar(c, 0.5, 0.7, 0.0);
+
+  b.addChar(0x0B, 0.6, 0.7, 0.0, 0.0, Tag::LigKern, 4); // ff
+  b.addChar(0x0C, 0.55, 0.7, 0.0); // fi
+  b.addChar(0x0D, 0.55, 0.7, 0.0); // fl
+  b.addChar(0x0E, 0.8, 0.7, 0.0); // ffi
+  b.addChar('-', 0.3, 0.2, 0.0, 0.0, Tag::LigKern, 6);
+  b.addChar(0x7B, 0.5, 0.2, 0.0, 0.0, Tag::LigKern, 7); // en dash
+  b.addChar(0x7C, 1.0, 0.2, 0.0); // em dash
+  b.addChar('f', 0.3, 0.7, 0.0, 0.0, Tag::LigKern, 1);
+  b.addChar('A', 0.7, 0.7, 0.0, 0.0, Tag::LigKern, 5);
+  b.addChar('x', 0.5, 0.4, 0.0, 0.0, Tag::LigKern, 8);
+  b.addChar('p', 0.5, 0.4, 0.2, 0.0, Tag::LigKern, 10);
+  b.addChar('r', 0.4, 0.4, 0.0, 0.0, Tag::LigKern, 14);
+
+  b.ligkern = {
+    { 255, ' ', 0, 0 }, // right boundary char
+    { 0, 'i', 0, 0x0C }, // f i =: fi
+    { 0, 'l', 0, 0x0D }, // f l =: fl
+    { 128, 'f', 0, 0x0B }, // f f =: ff
+    { 128, 'i', 0, 0x0E }, // ff i =: ffi
+    { 128, 'V', 128, 0 }, // A V kern
+    { 128, '-', 0, 0x7B }, // - - =: en dash
+    { 128, '-', 0, 0x7C }, // en dash - =: em dash
+    { 128, ' ', 128, 1 }, // x followed by the right boundary: kern
+    { 128, 'x', 2, 'z' }, // left boundary followed by x: |=: z
+    { 0, 'q', 3, 'r' }, // p q |=:| r
+    { 0, 's', 7, 'r' }, // p s |=:|> r
+    { 0, 't', 11, 'r' }, // p t |=:|>> r
+    { 128, 'u', 6, 'v' }, // p u |=:> v
+    { 0, 's', 128, 2 }, // r s kern
+    { 128, 't', 128, 2 }, // r t kern
+    { 255, 0, 0, 9 }, // left boundary program
+  };
+
+  b.kerns = { -0.1, 0.05, 0.2 };
+  b.params = { 0.0, 0.333, 0.166, 0.111, 0.43, 1.0, 0.111 };
+
+  return b.build();
+}
+
+struct LigKernEngine
+{
+  std::vector<uint8_t> bytes = ligkern_font();
+  std::shared_ptr<tex::headless::TypesetEngine> engine = std::make_shared<tex::headless::TypesetEngine>();
+  tex::Font font = engine->addFont("ligkern", std::make_shared<tex::TfmFile>(bytes.data(), bytes.size()), 10.f);
+};
+
+// Characters are written as is, kerns as '|' and glues as ' '
+std::string describe(const tex::List& list)
+{
+  std::string result;
+
+  for (const auto& node : list)
+  {
+    if (node->is<tex::CharacterBox>())
+      result.push_back(static_cast<char>(node->as<tex::CharacterBox>().character()));
+    else if (node->isKern())
+      result.push_back('|');
+    else if (node->isGlue())
+      result.push_back(' ');
+    else
+      result.push_back('?');
+  }
+
+  return result;
+}
+
+std::string build(const LigKernEngine& e, const std::string& text)
+{
+  tex::HListBuilder builder{ e.engine, e.font };
+
+  for (char c : text)
+  {
+    if (c == ' ')
+      builder.push_back_interword_glue();
+    else
+      builder.push_back(c);
+  }
+
+  builder.flush();
+  return describe(builder.result);
+}
+
+} // namespace
+
+TEST_CASE("HListBuilder forms ligatures", "[hlist]")
+{
+  LigKernEngine e;
+
+  REQUIRE(build(e, "fi") == "\x0C");
+  REQUIRE(build(e, "fl fi") == "\x0D \x0C");
+  REQUIRE(build(e, "ff") == "\x0B");
+  REQUIRE(build(e, "ffi") == "\x0E");
+  REQUIRE(build(e, "fff") == "\x0B" "f");
+  REQUIRE(build(e, "f-") == "f-");
+  REQUIRE(build(e, "--") == "\x7B");
+  REQUIRE(build(e, "---") == "\x7C");
+}
+
+TEST_CASE("HListBuilder inserts kerns", "[hlist]")
+{
+  using namespace tex;
+
+  LigKernEngine e;
+
+  HListBuilder builder{ e.engine, e.font };
+  builder.push_back('A');
+  builder.push_back('V');
+  builder.flush();
+
+  REQUIRE(describe(builder.result) == "A|V");
+  REQUIRE(std::next(builder.result.begin())->get()->as<Kern>().space() == Approx(-1.f));
+
+  REQUIRE(build(e, "AVA V") == "A|VA V");
+}
+
+TEST_CASE("HListBuilder handles the boundary characters", "[hlist]")
+{
+  LigKernEngine e;
+
+  // left boundary: a word starting with x starts with z instead
+  REQUIRE(build(e, "x") == "z");
+  REQUIRE(build(e, "ix") == "ix|");
+  REQUIRE(build(e, "ix ix") == "ix| ix|");
+
+  // right boundary: only at the end of a word
+  REQUIRE(build(e, "ixi") == "ixi");
+}
+
+TEST_CASE("HListBuilder supports all ligature operations", "[hlist]")
+{
+  LigKernEngine e;
+
+  REQUIRE(build(e, "pq") == "prq");   // |=:|
+  REQUIRE(build(e, "ps") == "pr|s");  // |=:|>, r s is looked up
+  REQUIRE(build(e, "pt") == "prt");   // |=:|>>, r t is skipped
+  REQUIRE(build(e, "pu") == "pv");    // |=:>
+  REQUIRE(build(e, "pfi") == "p\x0C");
+}
+
+TEST_CASE("HListBuilder delays the end of the current word", "[hlist]")
+{
+  using namespace tex;
+
+  LigKernEngine e;
+  HListBuilder builder{ e.engine, e.font };
+
+  builder.push_back('i');
+  builder.push_back('f');
+  REQUIRE(describe(builder.result) == "i");
+
+  builder.push_back('i');
+  REQUIRE(describe(builder.result) == "i");
+
+  builder.push_back(tex::glue(1.f));
+  REQUIRE(describe(builder.result) == "i\x0C ");
+
+  // changing the font ends the word
+  builder.push_back('f');
+  builder.font = e.engine->addFont("other", e.engine->tfmMetrics()->font(e.font).file, 5.f);
+  builder.push_back('i');
+  builder.flush();
+  REQUIRE(describe(builder.result) == "i\x0C fi");
+  REQUIRE(builder.result.back()->as<Box>().width() == Approx(2.5f));
+}
+
+TEST_CASE("HListBuilder applies the space factor codes", "[hlist]")
+{
+  using namespace tex;
+
+  LigKernEngine e;
+
+  auto sfcodes = std::make_shared<SfcodeTable>();
+  sfcodes->set('i', 3000);
+  sfcodes->set('l', 1500);
+  sfcodes->set('A', 999);
+  e.engine->glyphMetrics()->setSfcodes(sfcodes);
+  REQUIRE(e.engine->metrics()->sfcode('i') == 3000);
+
+  HListBuilder builder{ e.engine, e.font };
+
+  auto space_after = [&builder](const std::string& word) -> const Glue& {
+    for (char c : word)
+      builder.push_back(c);
+
+    builder.push_back_interword_glue();
+    return builder.result.back()->as<Glue>();
+  };
+
+  const Glue& after_i = space_after("i");
+  REQUIRE(after_i.space() == Approx(4.44f));
+  REQUIRE(after_i.stretch() == Approx(4.98f));
+  REQUIRE(after_i.shrink() == Approx(0.37f));
+
+  const Glue& after_l = space_after("l");
+  REQUIRE(after_l.space() == Approx(3.33f));
+  REQUIRE(after_l.stretch() == Approx(2.49f));
+  REQUIRE(after_l.shrink() == Approx(0.74f));
+
+  // As in TeX, a code above 1000 after a code below 1000 gives 1000
+  const Glue& after_Ai = space_after("Ai");
+  REQUIRE(after_Ai.space() == Approx(3.33f));
+  REQUIRE(after_Ai.stretch() == Approx(1.66f));
+
+  // A space factor that is not in the table
+  builder.spacefactor = 2500;
+  builder.push_back_interword_glue();
+  REQUIRE(builder.result.back()->as<Glue>().space() == Approx(4.44f));
+  REQUIRE(builder.result.back()->as<Glue>().stretch() == Approx(4.15f));
+
+  e.engine->glyphMetrics()->setSfcodes(SfcodeTable::frenchspacing());
+  const Glue& french = space_after("i");
+  REQUIRE(french.space() == Approx(3.33f));
+  REQUIRE(french.shrink() == Approx(1.11f));
+}
+
+TEST_CASE("SfcodeTable maps characters to buckets", "[hlist]")
+{
+  using namespace tex;
+
+  SfcodeTable table;
+  REQUIRE(table.bucketCount() == 1);
+  REQUIRE(table.get('.') == 1000);
+  REQUIRE(table.get(0x1F600) == 1000);
+  REQUIRE(table.get(-1) == 1000);
+
+  table.set('.', 3000);
+  table.set('?', 3000);
+  table.set(0x1F600, 0);
+  REQUIRE(table.bucketCount() == 3);
+  REQUIRE(table.bucket('.') == table.bucket('?'));
+  REQUIRE(table.get('?') == 3000);
+  REQUIRE(table.get(0x1F600) == 0);
+
+  table.set(0x1F600, 1000);
+  REQUIRE(table.bucket(0x1F600) == 0);
+
+  REQUIRE_THROWS(table.set('a', 40000));
+
+  for (int i(0); i < 253; ++i)
+    table.set('a', 2 + i);
+
+  REQUIRE(table.bucketCount() == SfcodeTable::MaxBuckets);
+  REQUIRE_THROWS(table.set('b', 500));
+
+  REQUIRE(SfcodeTable::nonfrenchspacing()->get(',') == 1250);
+  REQUIRE(SfcodeTable::frenchspacing()->get(',') == 1000);
+}
@@ -0,0 +1,119 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the typeset project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "catch.hpp"
+
+#include "tex/inputsource.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+static std::vector<std::string> read_all(tex::parsing::InputSource& input)
+{
+  std::vector<std::string> result;
+  const char* data = nullptr;
+
+  for (size_t n = input.read(data); n != 0; n = input.read(data))
+    result.emplace_back(data, n);
+
+  return result;
+}
+
+static std::string join(const std::vector<std::string>& parts)
+{
+  std::string result;
+
+  for (const std::string& p : parts)
+    result += p;
+
+  return result;
+}
+
+TEST_CASE("InputSource normalizes the ends of line", "[inputsource]")
+{
+  using namespace tex;
+
+  const std::string text = "ab\r\ncd\re\n\r\r\nf";
+
+  for (size_t chunk_size : { 1, 2, 3, 5, 64 })
+  {
+    parsing::StringInputSource input{ text, chunk_size };
+    REQUIRE(join(read_all(input)) == "ab\ncd\ne\n\n\nf");
+    REQUIRE(input.atEnd());
+  }
+
+  parsing::StringInputSource input{ text };
+  REQUIRE(read_all(input) == std::vector<std::string>{ "ab\n", "cd\n", "e\n", "\n", "\n", "f" });
+
+  parsing::StringInputSource empty{ "" };
+  REQUIRE(empty.atEnd());
+  REQUIRE(read_all(empty).empty());
+
+  REQUIRE_THROWS(parsing::StringInputSource{ text, 0 });
+}
+
+TEST_CASE("InputSource tracks lines and columns", "[inputsource]")
+{
+  using namespace tex;
+
+  parsing::StringInputSource input{ "Hello\r\nWorld!\nA very long line", 8 };
+  const char* data = nullptr;
+
+  REQUIRE(input.read(data) == 6);
+  REQUIRE(input.line() == 1);
+  REQUIRE(input.column() == 0);
+
+  // end of the first chunk
+  REQUIRE(input.read(data) == 1);
+  REQUIRE(*data == 'W');
+  REQUIRE(input.line() == 1);
+  REQUIRE(input.column() == 1);
+
+  REQUIRE(input.read(data) == 6);
+  REQUIRE(std::string(data, 6) == "orld!\n");
+  REQUIRE(input.line() == 2);
+  REQUIRE(input.column() == 0);
+
+  read_all(input);
+  REQUIRE(input.line() == 2);
+  REQUIRE(input.column() == 16);
+}
+
+TEST_CASE("InputSource can read files and streams", "[inputsource]")
+{
+  using namespace tex;
+
+  std::string text;
+
+  for (int i(0); i < 1000; ++i)
+    text += "Line " + std::to_string(i) + "\r\n";
+
+  std::string expected = text;
+  expected.erase(std::remove(expected.begin(), expected.end(), '\r'), expected.end());
+
+  {
+    std::istringstream stream{ text };
+    parsing::StreamInputSource input{ stream, 7 };
+    REQUIRE(join(read_all(input)) == expected);
+    REQUIRE(input.line() == 1000);
+  }
+
+  const std::string path = "test-inputsource.tex";
+
+  {
+    std::ofstream out{ path, std::ios::binary };
+    out << text;
+  }
+
+  {
+    parsing::MappedInputSource input{ path, 100 };
+    REQUIRE(join(read_all(input)) == expected);
+  }
+
+  std::remove(path.c_str());
+
+  REQUIRE_THROWS(parsing::MappedInputSource{ "does-not-exist.tex" });
+}
@@ -0,0 +1,94 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the typeset project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "catch.hpp"
+
+#include "test-typeset.h"
+
+#include "tex/layoutindex.h"
+
+static std::shared_ptr<tex::HBox> make_line(size_t n)
+{
+  tex::List list;
+
+  for (size_t i(0); i < n; ++i)
+    list.push_back(std::make_shared<TestBox>(tex::BoxMetrics{ 2.f, 1.f, 2.f }));
+
+  return tex::hbox(std::move(list));
+}
+
+TEST_CASE("A LayoutIndex can be queried and hit-tested", "[layoutindex]")
+{
+  using namespace tex;
+
+  auto line1 = make_line(3);
+  auto line2 = make_line(3);
+  auto page = vbox({ line1, kern(5.f), line2 });
+
+  LayoutIndex index{ page };
+
+  REQUIRE(index.size() == 9);
+  REQUIRE(index.bounds().top() == 0.f);
+  REQUIRE(index.bounds().bottom() == 11.f);
+  REQUIRE(index.bounds().right() == 6.f);
+
+  std::vector<const LayoutIndex::Entry*> result = index.query(Rect{ 0.f, 0.f, 100.f, 4.f });
+  REQUIRE(result.size() == 5);
+  REQUIRE(result.at(0)->box == page);
+  REQUIRE(result.at(1)->box == line1);
+  REQUIRE(result.at(2)->box == line1->list().front());
+  REQUIRE(result.at(2)->pos.y == 2.f);
+
+  result = index.query(Rect{ 3.f, 9.f, 0.5f, 0.5f });
+  REQUIRE(result.size() == 3);
+  REQUIRE(result.back()->box == *std::next(line2->list().begin()));
+  REQUIRE(result.back()->pos.x == 2.f);
+  REQUIRE(result.back()->pos.y == 10.f);
+
+  const LayoutIndex::Entry* hit = index.hitTest(Pos{ 2.f, 1.f });
+  REQUIRE(hit != nullptr);
+  REQUIRE(hit->box == *std::next(line1->list().begin()));
+
+  REQUIRE(index.hitTest(Pos{ 3.f, 5.f })->box == page);
+  REQUIRE(index.hitTest(Pos{ 50.f, 50.f }) == nullptr);
+}
+
+TEST_CASE("LayoutIndex queries match a linear scan", "[layoutindex]")
+{
+  using namespace tex;
+
+  List lines;
+  size_t count = 1;
+
+  for (size_t i(0); i < 500; ++i)
+  {
+    lines.push_back(make_line(20 + i % 7));
+    lines.push_back(glue(1.f));
+    count += 1 + 20 + i % 7;
+  }
+
+  LayoutIndex index{ vbox(std::move(lines)) };
+
+  REQUIRE(index.size() == count);
+
+  const Rect areas[] = {
+    Rect{ 5.f, 100.f, 10.f, 30.f },
+    Rect{ -5.f, -5.f, 1000.f, 10000.f },
+    Rect{ 30.f, 1200.f, 1.f, 1.f },
+    Rect{ 100.f, 100.f, 10.f, 10.f },
+  };
+
+  for (const Rect& r : areas)
+  {
+    std::vector<const LayoutIndex::Entry*> expected;
+
+    for (const LayoutIndex::Entry& e : index.entries())
+    {
+      if (e.rect.intersects(r))
+        expected.push_back(&e);
+    }
+
+    REQUIRE(index.query(r) == expected);
+  }
+}
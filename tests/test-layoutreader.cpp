@@ -0,0 +1,174 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the typeset project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "catch.hpp"
+
+#include "test-typeset.h"
+
+#include "tex/layoutreader.h"
+
+#include <tuple>
+#include <vector>
+
+using Visit = std::tuple<const tex::Box*, float, float>;
+
+struct RecursiveRecorder
+{
+  std::vector<Visit>& visits;
+
+  void operator()(const std::shared_ptr<tex::Box>& box, tex::Pos pos)
+  {
+    visits.emplace_back(box.get(), pos.x, pos.y);
+  }
+};
+
+struct IterativeRecorder
+{
+  std::vector<Visit>& visits;
+
+  void operator()(const tex::Box* box, tex::Pos pos)
+  {
+    visits.emplace_back(box, pos.x, pos.y);
+  }
+
+  void operator()(const tex::Rule* rule, tex::Pos pos)
+  {
+    visits.emplace_back(rule, pos.x, pos.y);
+  }
+};
+
+struct PartialRecorder
+{
+  std::vector<Visit>& visits;
+  size_t limit;
+
+  bool operator()(const tex::Box* box, tex::Pos pos)
+  {
+    visits.emplace_back(box, pos.x, pos.y);
+    return visits.size() == limit ? tex::PartialLayoutReader::Done : tex::PartialLayoutReader::Continue;
+  }
+};
+
+static std::shared_ptr<tex::Box> make_char()
+{
+  return std::make_shared<TestBox>(tex::BoxMetrics{ 2.f, 1.f, 2.f });
+}
+
+static std::shared_ptr<tex::HBox> make_line(size_t n, float width)
+{
+  tex::List list;
+
+  for (size_t i(0); i < n; ++i)
+  {
+    if (i > 0)
+      list.push_back(tex::glue(1.f, tex::Shrink(0.5f), tex::Stretch(1.f)));
+
+    list.push_back(make_char());
+  }
+
+  return tex::hbox(std::move(list), width);
+}
+
+static std::shared_ptr<tex::VBox> make_page()
+{
+  using namespace tex;
+
+  auto fraction = vbox({ make_line(2, 4.f), hrule(4.f, 0.5f), make_line(2, 4.f) });
+  raise(hbox({ make_char() }), 1.5f);
+  auto inner = hbox({ make_char(), kern(0.5f), fraction, make_char() });
+  inner->setShiftAmount(-1.f);
+
+  List lines;
+  lines.push_back(make_line(5, 20.f));
+  lines.push_back(glue(2.f, Stretch(1.f)));
+  lines.push_back(hbox({ make_line(3, 5.f), inner, hrule(3.f, 1.f, 1.f) }));
+  lines.push_back(kern(3.f));
+  lines.push_back(make_line(8, 12.f));
+
+  return vbox(std::move(lines), 40.f);
+}
+
+TEST_CASE("traverse() visits the same boxes at the same positions as read()", "[layoutreader]")
+{
+  using namespace tex;
+
+  auto page = make_page();
+
+  std::vector<Visit> expected;
+  tex::read(RecursiveRecorder{ expected }, page, Pos{ 10.f, 20.f });
+
+  std::vector<Visit> actual;
+  tex::traverse(IterativeRecorder{ actual }, page.get(), Pos{ 10.f, 20.f });
+
+  REQUIRE(expected.size() > 30);
+  REQUIRE(actual == expected);
+}
+
+TEST_CASE("traverse() supports deeply nested boxes", "[layoutreader]")
+{
+  using namespace tex;
+
+  std::shared_ptr<Box> box = make_char();
+
+  for (size_t i(0); i < 200; ++i)
+  {
+    if (i % 2 == 0)
+      box = hbox({ kern(1.f), box, make_char() });
+    else
+      box = vbox({ make_char(), box, glue(1.f) });
+  }
+
+  std::vector<Visit> expected;
+  tex::read(RecursiveRecorder{ expected }, box);
+
+  std::vector<Visit> actual;
+  tex::traverse(IterativeRecorder{ actual }, box.get());
+
+  REQUIRE(actual == expected);
+}
+
+TEST_CASE("traverse() stops when a partial reader is done", "[layoutreader]")
+{
+  using namespace tex;
+
+  auto page = make_page();
+
+  std::vector<Visit> all;
+  tex::traverse(IterativeRecorder{ all }, page.get());
+
+  std::vector<Visit> visits;
+  tex::traverse(PartialRecorder{ visits, 12 }, page.get());
+
+  REQUIRE(visits.size() == 12);
+  REQUIRE(std::equal(visits.begin(), visits.end(), all.begin()));
+}
+
+TEST_CASE("Benchmark of the layout readers", "[layoutreader][!benchmark]")
+{
+  using namespace tex;
+
+  List lines;
+
+  for (size_t i(0); i < 500; ++i)
+  {
+    lines.push_back(hbox({ make_line(40, 100.f), make_page() }));
+    lines.push_back(glue(1.f));
+  }
+
+  auto document = vbox(std::move(lines));
+
+  BENCHMARK("read()")
+  {
+    float sum = 0.f;
+    tex::read([&sum](const std::shared_ptr<Box>& /* box */, Pos pos) { sum += pos.x; }, document);
+    return sum;
+  };
+
+  BENCHMARK("traverse()")
+  {
+    float sum = 0.f;
+    tex::traverse([&sum](const Box* /* box */, Pos pos) { sum += pos.x; }, document.get());
+    return sum;
+  };
+}
@@ -4,7 +4,16 @@
 
 #include "catch.hpp"
 
+#include "tex/incrementallexer.h"
 #include "tex/lexer.h"
+#include "tex/lexerthread.h"
+#include "tex/spscqueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <random>
+#include <thread>
 
 TEST_CASE("Tokens can be produced by the Lexer", "[lexer]")
 {
@@ -86,3 +95,605 @@ TEST_CASE("The Lexer correctly ignores spaces", "[lexer]")
     }
   }
 }
+
+TEST_CASE("Control sequences are interned", "[lexer]")
+{
+  using namespace tex;
+  using parsing::CsTable;
+
+  parsing::Lexer lex;
+  std::vector<parsing::Token>& toks = lex.output();
+
+  for (char c : std::string("\\def\\foo\\foo\\csname x\n\n"))
+    lex.write(c);
+
+  REQUIRE(toks.size() == 7);
+  REQUIRE(toks.at(0) == CsTable::Def);
+  REQUIRE(toks.at(1).controlSequenceId() == toks.at(2).controlSequenceId());
+  REQUIRE(toks.at(1).controlSequenceId() >= CsTable::BuiltinCount);
+  REQUIRE(toks.at(3) == CsTable::Csname);
+  REQUIRE(toks.at(6) == CsTable::Par);
+
+  CsTable& table = CsTable::global();
+  REQUIRE(table.find("foo") == toks.at(1).controlSequenceId());
+  REQUIRE(table.name(toks.at(1).controlSequenceId()) == "foo");
+  REQUIRE(table.intern("foo") == toks.at(1).controlSequenceId());
+  REQUIRE(table.find("an unknown control sequence") == CsTable::Invalid);
+  REQUIRE(parsing::Token{ std::string("foo") } == toks.at(1));
+
+  parsing::CsMap<int> map = { {"foo", 1}, {"def", 2} };
+  REQUIRE(*map.find(toks.at(1).controlSequenceId()) == 1);
+  REQUIRE(*map.find(CsTable::Def) == 2);
+  REQUIRE(map.find(CsTable::Par) == nullptr);
+}
+
+static std::vector<tex::parsing::Token> lex_by_char(const std::string& text, const tex::parsing::Lexer::CatCodeTable& catcodes)
+{
+  tex::parsing::Lexer lex;
+  lex.catcodes() = catcodes;
+
+  for (char c : text)
+    lex.write(c);
+
+  return lex.output();
+}
+
+static std::vector<tex::parsing::Token> lex_in_blocks(const std::string& text, const tex::parsing::Lexer::CatCodeTable& catcodes, size_t block)
+{
+  tex::parsing::Lexer lex;
+  lex.catcodes() = catcodes;
+
+  for (size_t i(0); i < text.size(); i += block)
+    lex.write(text.data() + i, std::min(block, text.size() - i));
+
+  return lex.output();
+}
+
+TEST_CASE("Writing blocks to the Lexer produces the same tokens", "[lexer]")
+{
+  using namespace tex;
+
+  const std::string text =
+    "\\def\\hello#1{Hello #1!}%   a comment \\par\n"
+    "Plain prose, with   several spaces\tand a tab; some\x7f ignored chars and \xc3\xa9t\xc3\xa9.\n"
+    "\n"
+    "  $x^2_i$ & {group} ~ \\cs\\x\\ \\@internal a very long line of text that spans more than sixteen characters\n"
+    "##1 \\end\n";
+
+  parsing::Lexer::CatCodeTable catcodes = parsing::Lexer::DefaultCatCodes;
+  const std::vector<parsing::Token> expected = lex_by_char(text, catcodes);
+
+  for (size_t block : { 1, 3, 16, 17, 1000 })
+    REQUIRE(lex_in_blocks(text, catcodes, block) == expected);
+
+  // Too many stop characters for the block scanner
+  catcodes['@'] = parsing::CharCategory::Letter;
+
+  for (char c : std::string("!,;.:?()"))
+    catcodes[static_cast<unsigned char>(c)] = parsing::CharCategory::Escape;
+
+  REQUIRE(lex_in_blocks(text, catcodes, 1000) == lex_by_char(text, catcodes));
+
+  // Catcodes changed between two writes
+  parsing::Lexer lex;
+  lex.write("a@b ");
+  lex.catcodes()['@'] = parsing::CharCategory::Comment;
+  lex.write("a@b\nc");
+
+  REQUIRE(lex.output() == lex_by_char("a@b ac", parsing::Lexer::DefaultCatCodes));
+}
+
+TEST_CASE("Lexing plain prose", "[!benchmark][lexer]")
+{
+  using namespace tex;
+
+  std::string text;
+
+  while (text.size() < 1 << 20)
+    text += "The quick brown fox jumps over the lazy dog, again and again. The end of the line is near.\n";
+
+  BENCHMARK("one character at a time")
+  {
+    parsing::Lexer lex;
+
+    for (char c : text)
+      lex.write(c);
+
+    return lex.output().size();
+  };
+
+  BENCHMARK("in a single block")
+  {
+    parsing::Lexer lex;
+    lex.write(text);
+    return lex.output().size();
+  };
+}
+
+TEST_CASE("SpscQueue transfers values between two threads", "[lexer]")
+{
+  using namespace tex;
+
+  {
+    SpscQueue<int> queue{ 3 };
+    REQUIRE(queue.capacity() == 4);
+
+    int value = 0;
+    REQUIRE(!queue.pop(value));
+
+    for (int i(0); i < 4; ++i)
+      REQUIRE(queue.push(i));
+
+    REQUIRE(!queue.push(4));
+    REQUIRE(queue.pop(value));
+    REQUIRE(value == 0);
+    REQUIRE(queue.push(4));
+  }
+
+  SpscQueue<size_t> queue{ 64 };
+  const size_t count = 100000;
+
+  std::thread producer{ [&queue, count]() {
+    for (size_t i(0); i < count; ++i)
+    {
+      while (!queue.push(i))
+        std::this_thread::yield();
+    }
+  } };
+
+  size_t expected = 0;
+  bool in_order = true;
+
+  while (expected < count)
+  {
+    size_t value;
+
+    if (queue.pop(value))
+      in_order = in_order && value == expected++;
+    else
+      std::this_thread::yield();
+  }
+
+  producer.join();
+  REQUIRE(in_order);
+}
+
+static std::vector<tex::parsing::Token> read_tokens(tex::parsing::LexerThread& lexer, size_t n = size_t(-1))
+{
+  std::vector<tex::parsing::Token> result;
+  tex::parsing::LexerThread::Item item;
+
+  while (result.size() < n && lexer.read(item))
+    result.push_back(item.token);
+
+  return result;
+}
+
+static std::unique_ptr<tex::parsing::InputSource> source(const std::string& text, size_t chunk = 100)
+{
+  return std::unique_ptr<tex::parsing::InputSource>(new tex::parsing::StringInputSource(text, chunk));
+}
+
+TEST_CASE("The LexerThread produces the tokens of the Lexer", "[lexer]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  std::string text;
+
+  for (int i(0); i < 2000; ++i)
+    text += "\\def\\hello#1{Hello #1!} % comment\n  $x^2$ \\cs\\ and text\n\n";
+
+  {
+    LexerThread lexer{ source(text), Lexer::DefaultCatCodes, 16 };
+    REQUIRE(read_tokens(lexer) == lex_by_char(text, Lexer::DefaultCatCodes));
+  }
+
+  {
+    LexerThread lexer{ source("a\nb\n\ncd\n") };
+    LexerThread::Item item;
+    std::vector<uint32_t> lines;
+
+    while (lexer.read(item))
+      lines.push_back(item.line);
+
+    REQUIRE(lines == std::vector<uint32_t>{ 0, 0, 1, 1, 2, 3, 3, 3 });
+  }
+
+  {
+    LexerThread lexer{ source("ab\ncd\n\x01\n") };
+    REQUIRE(read_tokens(lexer, 6).size() == 6);
+    LexerThread::Item item;
+    REQUIRE_THROWS(lexer.read(item));
+  }
+
+  // destroyed while lexing ahead
+  LexerThread lexer{ source(text), Lexer::DefaultCatCodes, 16 };
+  REQUIRE(read_tokens(lexer, 10).size() == 10);
+}
+
+namespace
+{
+
+// Delivers nothing until it is released
+class BlockedInputSource : public tex::parsing::StringInputSource
+{
+public:
+  BlockedInputSource(std::string text, std::shared_future<void> released)
+    : StringInputSource(std::move(text)),
+      m_released(std::move(released))
+  {
+
+  }
+
+protected:
+  bool fetch(const char*& data, size_t& size) override
+  {
+    m_released.wait();
+    return StringInputSource::fetch(data, size);
+  }
+
+private:
+  std::shared_future<void> m_released;
+};
+
+// Polls the predicate for at most 10 seconds
+template<typename F>
+bool eventually(F&& pred)
+{
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+  while (!pred() && std::chrono::steady_clock::now() < deadline)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  return pred();
+}
+
+} // namespace
+
+TEST_CASE("The LexerThread sleeps while the other side is stalled", "[lexer]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  std::string text;
+
+  for (int i(0); i < 40; ++i)
+    text += "line\n";
+
+  // stalled producer: the consumer sleeps instead of spinning
+  {
+    std::promise<void> release;
+    LexerThread lexer{ std::unique_ptr<InputSource>(new BlockedInputSource(text, release.get_future().share())) };
+
+    std::thread releaser{ [&]() {
+      eventually([&]() { return lexer.consumerSleeps() > 0; });
+      release.set_value();
+      } };
+
+    const std::vector<Token> tokens = read_tokens(lexer);
+    releaser.join();
+
+    REQUIRE(tokens == lex_by_char(text, Lexer::DefaultCatCodes));
+    REQUIRE(lexer.consumerSleeps() > 0);
+  }
+
+  // stalled consumer: the producer sleeps until half of the queue is free
+  {
+    LexerThread lexer{ source(text + text + text), Lexer::DefaultCatCodes, 16 };
+    LexerThread::Item item;
+
+    REQUIRE(lexer.read(item));
+    REQUIRE(eventually([&]() { return lexer.producerSleeps() > 0; }));
+
+    size_t count = 1;
+
+    while (lexer.read(item))
+      ++count;
+
+    REQUIRE(count == lex_by_char(text, Lexer::DefaultCatCodes).size() * 3);
+    REQUIRE(lexer.producerSleeps() <= count / 8 + 1);
+  }
+}
+
+TEST_CASE("The LexerThread resynchronizes when the catcodes change", "[lexer]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  Lexer::CatCodeTable makeatletter = Lexer::DefaultCatCodes;
+  makeatletter['@'] = CharCategory::Letter;
+
+  std::string filler;
+
+  for (int i(0); i < 1000; ++i)
+    filler += "@a @b\n";
+
+  auto expected = [&makeatletter](LexerState state, const std::string& rest) {
+    Lexer lex;
+    lex.catcodes() = makeatletter;
+    lex.state() = state;
+
+    for (char c : rest)
+      lex.write(c);
+
+    return lex.output();
+  };
+
+  {
+    // the character that ends a control word is lexed with the new catcodes
+    LexerThread lexer{ source("\\foo@bar x\n" + filler), Lexer::DefaultCatCodes, 16 };
+    REQUIRE(read_tokens(lexer, 1).at(0).controlSequence() == "foo");
+    lexer.setCatcodes(makeatletter);
+    REQUIRE(read_tokens(lexer) == expected(LexerState::StateS, "@bar x\n" + filler));
+  }
+
+  {
+    LexerThread lexer{ source("ab@c d\n" + filler), Lexer::DefaultCatCodes, 16 };
+    REQUIRE(read_tokens(lexer, 3).size() == 3);
+    lexer.setCatcodes(makeatletter);
+    REQUIRE(read_tokens(lexer) == expected(LexerState::StateM, "c d\n" + filler));
+  }
+
+  {
+    LexerThread lexer{ source("\\@ x@y\n" + filler) };
+    REQUIRE(read_tokens(lexer, 1).at(0).controlSequence() == "@");
+    lexer.setCatcodes(makeatletter);
+    REQUIRE(read_tokens(lexer) == expected(LexerState::StateM, " x@y\n" + filler));
+  }
+
+  {
+    // long after the tokens of the line were lexed
+    LexerThread lexer{ source(filler, 7), Lexer::DefaultCatCodes, 64 };
+    REQUIRE(read_tokens(lexer, 6 * 300 + 2).size() == 6 * 300 + 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    lexer.setCatcodes(makeatletter);
+    REQUIRE(read_tokens(lexer) == expected(LexerState::StateM, " @b\n" + filler.substr(6 * 301)));
+  }
+
+  {
+    LexerThread lexer{ source(filler) };
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    lexer.setCatcodes(makeatletter);
+    REQUIRE(read_tokens(lexer) == expected(LexerState::StateN, filler));
+    lexer.setCatcodes(Lexer::DefaultCatCodes);
+    REQUIRE(read_tokens(lexer).empty());
+  }
+}
+
+TEST_CASE("Lexing on a separate thread", "[!benchmark][lexer]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  std::string text;
+
+  while (text.size() < 1 << 20)
+    text += "The quick brown fox jumps over the \\emph{lazy} dog, again and again. The end of the line is near.\n";
+
+  BENCHMARK("on the same thread")
+  {
+    StringInputSource input{ text };
+    Lexer lex;
+    size_t count = 0;
+    const char* line = nullptr;
+
+    while (size_t n = input.read(line))
+    {
+      lex.write(line, n);
+      count += lex.output().size();
+      lex.output().clear();
+    }
+
+    return count;
+  };
+
+  BENCHMARK("on a lexer thread")
+  {
+    LexerThread lexer{ source(text, StringInputSource::DefaultChunkSize) };
+    LexerThread::Item item;
+    size_t count = 0;
+
+    while (lexer.read(item))
+      ++count;
+
+    return count;
+  };
+}
+
+static std::string numbered_lines(size_t n)
+{
+  std::string text;
+
+  for (size_t i(0); i < n; ++i)
+    text += "Line " + std::to_string(i) + " of the document, with \\emph{some} markup.\n";
+
+  return text;
+}
+
+TEST_CASE("The IncrementalLexer updates the tokens of an edited text", "[lexer]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  IncrementalLexer lexer;
+  lexer.setText(numbered_lines(1000));
+
+  REQUIRE(lexer.tokens() == lex_by_char(lexer.text(), Lexer::DefaultCatCodes));
+  REQUIRE(lexer.checkpoints().size() == 1001);
+
+  SECTION("a local edit only lexes its line")
+  {
+    const size_t offset = lexer.text().find("Line 500 ");
+    const IncrementalLexer::Change change = lexer.replace(offset + 5, 3, "five hundred");
+
+    REQUIRE(change.lines == 1);
+    REQUIRE(change.token == lexer.checkpoints().at(500).token);
+    REQUIRE(change.inserted == change.removed + 9);
+    REQUIRE(lexer.tokens() == lex_by_char(lexer.text(), Lexer::DefaultCatCodes));
+    REQUIRE(lexer.checkpoints().size() == 1001);
+    REQUIRE(lexer.checkpoints().at(501).offset == lexer.text().find("Line 501 "));
+  }
+
+  SECTION("inserting and removing lines")
+  {
+    size_t offset = lexer.text().find("Line 10 ");
+    IncrementalLexer::Change change = lexer.replace(offset, 0, "new\n\nlines\n");
+
+    REQUIRE(change.lines == 3);
+    REQUIRE(lexer.checkpoints().size() == 1004);
+    REQUIRE(lexer.tokens() == lex_by_char(lexer.text(), Lexer::DefaultCatCodes));
+
+    offset = lexer.text().find("Line 20 ");
+    change = lexer.replace(offset, lexer.text().find("Line 30 ") - offset, "");
+
+    REQUIRE(change.lines <= 1);
+    REQUIRE(lexer.checkpoints().size() == 994);
+    REQUIRE(lexer.tokens() == lex_by_char(lexer.text(), Lexer::DefaultCatCodes));
+  }
+
+  SECTION("an edit that changes the state at the end of its line")
+  {
+    // the control word now ends the line: the next line starts in StateS
+    // and is lexed again
+    size_t offset = lexer.text().find("Line 100 ");
+    offset = lexer.text().find('\n', offset);
+    IncrementalLexer::Change change = lexer.replace(offset, 0, " \\relax");
+
+    REQUIRE(change.lines == 2);
+    REQUIRE(lexer.checkpoints().at(101).state == LexerState::StateS);
+    REQUIRE(lexer.tokens() == lex_by_char(lexer.text(), Lexer::DefaultCatCodes));
+
+    change = lexer.replace(offset, 7, "");
+
+    REQUIRE(change.lines == 2);
+    REQUIRE(lexer.checkpoints().at(101).state == LexerState::StateN);
+    REQUIRE(lexer.tokens() == lex_by_char(lexer.text(), Lexer::DefaultCatCodes));
+  }
+
+  SECTION("a removed newline joins two lines")
+  {
+    const size_t offset = lexer.text().find("Line 200 ") - 1;
+    const IncrementalLexer::Change change = lexer.replace(offset, 1, "");
+
+    REQUIRE(change.lines == 1);
+    REQUIRE(lexer.checkpoints().size() == 1000);
+    REQUIRE(lexer.tokens() == lex_by_char(lexer.text(), Lexer::DefaultCatCodes));
+  }
+
+  SECTION("changing the catcodes lexes the whole text")
+  {
+    Lexer::CatCodeTable catcodes = Lexer::DefaultCatCodes;
+    catcodes['\n'] = CharCategory::Escape;
+    IncrementalLexer::Change change = lexer.setCatcodes(catcodes);
+
+    REQUIRE(change.lines == 1000);
+    REQUIRE(lexer.catcodesVersion() == 1);
+    REQUIRE(lexer.tokens() == lex_by_char(lexer.text(), catcodes));
+    // every line ends in a control sequence
+    REQUIRE(lexer.checkpoints().size() == 1);
+
+    change = lexer.replace(lexer.text().find("Line 900 "), 0, "x");
+
+    REQUIRE(change.lines == 1000);
+    REQUIRE(lexer.tokens() == lex_by_char(lexer.text(), catcodes));
+  }
+
+  SECTION("the text is unchanged if the lexer fails")
+  {
+    const std::string text = lexer.text();
+    const size_t offset = lexer.text().find("Line 300 ");
+
+    REQUIRE_THROWS(lexer.replace(offset, 0, std::string(1, '\0')));
+    REQUIRE(lexer.text() == text);
+    REQUIRE(lexer.tokens() == lex_by_char(text, Lexer::DefaultCatCodes));
+  }
+}
+
+TEST_CASE("Comments propagate through the IncrementalLexer", "[lexer]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  // only carriage returns end lines (and comments)
+  Lexer::CatCodeTable catcodes = Lexer::DefaultCatCodes;
+  catcodes['\n'] = CharCategory::Ignored;
+  catcodes['\r'] = CharCategory::EndOfLine;
+
+  IncrementalLexer lexer{ catcodes };
+  lexer.setText("a\nb\nc\r\nd\ne\n");
+
+  REQUIRE(lexer.checkpoints().size() == 6);
+
+  IncrementalLexer::Change change = lexer.replace(2, 0, "%");
+
+  REQUIRE(change.lines == 2);
+  REQUIRE(lexer.checkpoints().at(2).state == LexerState::StateCOM);
+  REQUIRE(lexer.tokens() == lex_by_char(lexer.text(), catcodes));
+
+  change = lexer.replace(2, 1, "");
+
+  REQUIRE(change.lines == 2);
+  REQUIRE(lexer.checkpoints().at(2).state == LexerState::StateM);
+  REQUIRE(lexer.tokens() == lex_by_char(lexer.text(), catcodes));
+}
+
+TEST_CASE("Random edits with the IncrementalLexer", "[lexer]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  const std::string alphabet = "ab \\\\%%{}\n\n\n";
+  std::mt19937 rng{ 42 };
+
+  auto random_text = [&](size_t n) -> std::string {
+    std::string result;
+
+    for (size_t i(0); i < n; ++i)
+      result.push_back(alphabet[rng() % alphabet.size()]);
+
+    return result;
+  };
+
+  IncrementalLexer lexer;
+  lexer.setText(random_text(500));
+
+  for (int i(0); i < 2000; ++i)
+  {
+    const size_t offset = rng() % (lexer.text().size() + 1);
+    const size_t length = rng() % 8;
+    lexer.replace(offset, length, random_text(rng() % 8));
+
+    REQUIRE(lexer.tokens() == lex_by_char(lexer.text(), Lexer::DefaultCatCodes));
+
+    for (const IncrementalLexer::Checkpoint& cp : lexer.checkpoints())
+    {
+      REQUIRE((cp.offset == 0 || lexer.text().at(cp.offset - 1) == '\n'));
+    }
+  }
+}
+
+TEST_CASE("Lexing after an edit", "[!benchmark][lexer]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  const std::string text = numbered_lines(20000);
+
+  IncrementalLexer lexer;
+  lexer.setText(text);
+  const size_t offset = lexer.text().size() / 2;
+
+  BENCHMARK("lexing the whole text")
+  {
+    Lexer lex;
+    lex.write(text);
+    return lex.output().size();
+  };
+
+  BENCHMARK("lexing from the last checkpoint")
+  {
+    lexer.replace(offset, 0, "x");
+    return lexer.replace(offset, 1, "").inserted;
+  };
+}
@@ -0,0 +1,146 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the typeset project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "catch.hpp"
+
+#include "test-typeset.h"
+
+#include "tex/fontmetrics.h"
+#include "tex/math/atom.h"
+#include "tex/math/fraction.h"
+#include "tex/math/math-typeset.h"
+
+#include <set>
+#include <stdexcept>
+
+namespace
+{
+
+class FontDimenCountingProvider : public TestFontMetricsProvider
+{
+public:
+  int fontdimen_calls = 0;
+
+  const tex::FontDimen& fontdimen(tex::Font f) override
+  {
+    ++fontdimen_calls;
+    return TestFontMetricsProvider::fontdimen(f);
+  }
+};
+
+class FontDimenCountingEngine : public TestTypesetEngine
+{
+public:
+  std::shared_ptr<FontDimenCountingProvider> provider = std::make_shared<FontDimenCountingProvider>();
+
+  std::shared_ptr<tex::FontMetricsProvider> metrics() const override
+  {
+    return provider;
+  }
+};
+
+class FailingProvider : public TestFontMetricsProvider
+{
+public:
+  std::set<int> loaded;
+  bool broken = false;
+
+  const tex::FontDimen& fontdimen(tex::Font f) override
+  {
+    if (broken)
+      throw std::runtime_error{ "FailingProvider: broken" };
+    else if (loaded.find(f.id()) == loaded.end())
+      throw std::out_of_range{ "FailingProvider: font not loaded" };
+
+    return TestFontMetricsProvider::fontdimen(f);
+  }
+};
+
+class FailingEngine : public TestTypesetEngine
+{
+public:
+  std::shared_ptr<FailingProvider> provider = std::make_shared<FailingProvider>();
+
+  std::shared_ptr<tex::FontMetricsProvider> metrics() const override
+  {
+    return provider;
+  }
+};
+
+std::shared_ptr<tex::math::Atom> ord(tex::Character c, int fam, std::shared_ptr<tex::Node> sup = nullptr)
+{
+  auto nucleus = std::make_shared<tex::MathSymbol>(c, tex::math::Atom::Ord, fam);
+  return tex::math::Atom::create<tex::math::Atom::Ord>(nucleus, nullptr, sup);
+}
+
+} // namespace
+
+TEST_CASE("ResolvedFontMetrics holds a copy of the font parameters", "[math]")
+{
+  using namespace tex;
+
+  auto provider = std::make_shared<TestFontMetricsProvider>();
+  const FontMetrics fm{ Font(1), provider };
+  const ResolvedFontMetrics rfm{ fm };
+
+  REQUIRE(rfm.isValid());
+  REQUIRE(rfm.font() == Font(1));
+  REQUIRE(rfm.quad() == fm.quad());
+  REQUIRE(rfm.xHeight() == fm.xHeight());
+  REQUIRE(rfm.sigma<5>() == fm.sigma<5>());
+  REQUIRE(rfm.xi<8>() == fm.xi<8>());
+
+  REQUIRE(!ResolvedFontMetrics{}.isValid());
+}
+
+TEST_CASE("MathTypesetter resolves the font parameters in setFonts()", "[math]")
+{
+  using namespace tex;
+
+  auto engine = std::make_shared<FontDimenCountingEngine>();
+
+  std::array<MathFont, 16> fonts;
+  for (int i(0); i < 16; ++i)
+    fonts[i] = MathFont{ Font(3 * i), Font(3 * i + 1), Font(3 * i + 2) };
+
+  MathTypesetter typesetter{ engine };
+  typesetter.setFonts(fonts);
+
+  // drops the fonts dimensions cached by the engine
+  engine->invalidateGlyphMetrics();
+  engine->provider->fontdimen_calls = 0;
+
+  MathList numer;
+  numer.push_back(ord('x', 1, std::make_shared<MathSymbol>('2', math::Atom::Ord, 0)));
+  MathList denom;
+  denom.push_back(ord('y', 1));
+
+  MathList mlist;
+  mlist.push_back(std::make_shared<math::Fraction>(std::move(numer), std::move(denom)));
+  mlist.push_back(ord('z', 1));
+
+  List hlist = typesetter.mlist2hlist(std::move(mlist), math::Style::D);
+
+  REQUIRE(!hlist.empty());
+  REQUIRE(engine->provider->fontdimen_calls == 0);
+}
+
+TEST_CASE("MathTypesetter only defers the fonts that are not loaded", "[math]")
+{
+  using namespace tex;
+
+  auto engine = std::make_shared<FailingEngine>();
+  engine->provider->loaded = { 0, 1, 2 };
+
+  std::array<MathFont, 16> fonts;
+  for (int i(0); i < 16; ++i)
+    fonts[i] = MathFont{ Font(3 * i), Font(3 * i + 1), Font(3 * i + 2) };
+
+  MathTypesetter typesetter{ engine };
+  REQUIRE_NOTHROW(typesetter.setFonts(fonts));
+
+  engine->invalidateGlyphMetrics();
+  engine->provider->broken = true;
+  REQUIRE_THROWS_AS(typesetter.setFonts(fonts), std::runtime_error);
+}
@@ -0,0 +1,196 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the typeset project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "catch.hpp"
+
+#include "test-typeset.h"
+
+#include "tex/pdfwriter.h"
+
+#include "tex/hbox.h"
+#include "tex/vbox.h"
+#include "tex/glue.h"
+#include "tex/rule.h"
+
+#include <chrono>
+#include <sstream>
+
+static std::shared_ptr<tex::VBox> pdf_page(size_t lines)
+{
+  using namespace tex;
+
+  List list;
+
+  for (size_t i(0); i < lines; ++i)
+  {
+    list.push_back(hbox({ test_word("Hello", 1), glue(4.f), test_word(std::to_string(i), 1), glue(4.f), test_word("(x)", 2) }));
+    list.push_back(glue(3.f));
+  }
+
+  list.push_back(hrule(100.f, 0.5f));
+
+  return vbox(std::move(list));
+}
+
+static void check_xref(const std::string& pdf)
+{
+  const size_t startxref = pdf.rfind("startxref\n");
+  REQUIRE(startxref != std::string::npos);
+
+  const size_t xref = std::stoul(pdf.substr(startxref + 10));
+  REQUIRE(pdf.compare(xref, 5, "xref\n") == 0);
+
+  std::istringstream stream{ pdf.substr(xref + 5) };
+  size_t first = 0, count = 0;
+  stream >> first >> count;
+  REQUIRE(first == 0);
+
+  std::string offset, generation, type;
+  stream >> offset >> generation >> type;
+  REQUIRE(type == "f");
+
+  for (size_t i(1); i < count; ++i)
+  {
+    stream >> offset >> generation >> type;
+    REQUIRE(type == "n");
+    REQUIRE(offset.size() == 10);
+
+    const std::string header = std::to_string(i) + " 0 obj\n";
+    REQUIRE(pdf.compare(std::stoul(offset), header.size(), header) == 0);
+  }
+}
+
+TEST_CASE("PdfWriter writes pages with a valid xref table", "[pdfwriter]")
+{
+  using namespace tex;
+
+  std::ostringstream out;
+  PdfWriter writer{ out, 200.f, 100.f };
+  writer.setFont(Font(1), "CMR10", 10.f);
+  writer.setFont(Font(2), "CMMI10", 10.f);
+
+  auto page = pdf_page(2);
+  writer.writePage(*page, Pos{ 10.f, 10.f + page->height() });
+  writer.writePage(*pdf_page(3));
+  writer.finish();
+
+  REQUIRE(writer.pageCount() == 2);
+
+  const std::string pdf = out.str();
+  REQUIRE(writer.bytesWritten() == pdf.size());
+  REQUIRE(pdf.compare(0, 9, "%PDF-1.4\n") == 0);
+  REQUIRE(pdf.compare(pdf.size() - 6, 6, "%%EOF\n") == 0);
+
+  check_xref(pdf);
+
+  REQUIRE(pdf.find("BT /F1 10 Tf 10 83 Td [(Hello) -400 (0)] TJ ET\n") != std::string::npos);
+  REQUIRE(pdf.find("BT /F2 10 Tf 48 83 Td [(\\(x\\))] TJ ET\n") != std::string::npos);
+  REQUIRE(pdf.find("10 65.5 100 0.5 re f\n") != std::string::npos);
+  REQUIRE(pdf.find("/BaseFont /CMR10 /FirstChar 48 /LastChar 111 /Widths [500 500 500") != std::string::npos);
+  REQUIRE(pdf.find("/Type /FontDescriptor /FontName /CMR10 /Flags 4 /FontBBox [0 -200 500 700] /ItalicAngle 0 /Ascent 700 /Descent -200 /CapHeight 700 /StemV 80 >>") != std::string::npos);
+  REQUIRE(pdf.find("/Type /FontDescriptor /FontName /CMMI10") != std::string::npos);
+  REQUIRE(pdf.find("/Type /Pages /Kids [") != std::string::npos);
+  REQUIRE(pdf.find("/Count 2 >>") != std::string::npos);
+}
+
+TEST_CASE("PdfWriter rejects characters outside of simple fonts", "[pdfwriter]")
+{
+  using namespace tex;
+
+  std::ostringstream out;
+  PdfWriter writer{ out, 200.f, 100.f };
+
+  auto page = vbox({ hbox({ std::make_shared<CharacterBox>(0x3B1, Font(1), BoxMetrics{ 7.f, 2.f, 5.f }) }) });
+  REQUIRE_THROWS(writer.writePage(*page));
+}
+
+TEST_CASE("PdfWriter can compress content streams", "[pdfwriter]")
+{
+  using namespace tex;
+
+  if (!PdfWriter::supportsCompression())
+  {
+    std::ostringstream out;
+    PdfWriter writer{ out, 200.f, 100.f };
+    REQUIRE_THROWS(writer.setCompression(true));
+    return;
+  }
+
+  std::ostringstream plain_out;
+  std::ostringstream compressed_out;
+
+  {
+    PdfWriter plain{ plain_out, 200.f, 800.f };
+    PdfWriter compressed{ compressed_out, 200.f, 800.f };
+    compressed.setCompression(true);
+
+    for (size_t i(0); i < 3; ++i)
+    {
+      plain.writePage(*pdf_page(40));
+      compressed.writePage(*pdf_page(40));
+    }
+
+    plain.finish();
+    compressed.finish();
+  }
+
+  const std::string pdf = compressed_out.str();
+  REQUIRE(pdf.find("/Filter /FlateDecode") != std::string::npos);
+  REQUIRE(pdf.size() < plain_out.str().size());
+
+  check_xref(pdf);
+}
+
+static double pages_per_second(bool compress)
+{
+  using namespace tex;
+
+  auto page = pdf_page(50);
+  std::ostringstream out;
+  PdfWriter writer{ out, 600.f, 800.f };
+  writer.setCompression(compress);
+
+  const auto start = std::chrono::high_resolution_clock::now();
+
+  for (size_t i(0); i < 1000; ++i)
+    writer.writePage(*page);
+
+  writer.finish();
+
+  const std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+  return 1000 / elapsed.count();
+}
+
+TEST_CASE("Benchmark of the PdfWriter", "[pdfwriter][!benchmark]")
+{
+  using namespace tex;
+
+  auto page = pdf_page(50);
+
+  BENCHMARK("one page")
+  {
+    std::ostringstream out;
+    PdfWriter writer{ out, 600.f, 800.f };
+    writer.writePage(*page);
+    writer.finish();
+    return writer.bytesWritten();
+  };
+
+  WARN("pages per second: " << pages_per_second(false));
+
+  if (PdfWriter::supportsCompression())
+  {
+    BENCHMARK("one compressed page")
+    {
+      std::ostringstream out;
+      PdfWriter writer{ out, 600.f, 800.f };
+      writer.setCompression(true);
+      writer.writePage(*page);
+      writer.finish();
+      return writer.bytesWritten();
+    };
+
+    WARN("compressed pages per second: " << pages_per_second(true));
+  }
+}
@@ -5,16 +5,18 @@
 #include "catch.hpp"
 
 #include "tex/lexer.h"
+#include "tex/parsing/expansionprofiler.h"
 #include "tex/parsing/preprocessor.h"
 
+#include <sstream>
+
 using namespace tex;
 
 static std::vector<parsing::Token> tokenize(const std::string& text)
 {
   parsing::Lexer lex;
 
-  for (char c : text)
-    lex.write(c);
+  lex.write(text);
 
   return lex.output();
 }
@@ -166,3 +168,371 @@ TEST_CASE("The preprocessor supports \\expandafter", "[preprocessor]")
   REQUIRE(preproc.output == tokenize("FBQ"));
   preproc.output.clear();
 }
+
+TEST_CASE("TokenInput reads inserted tokens first", "[preprocessor]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  TokenInput input;
+  REQUIRE(input.empty());
+
+  for (const Token& t : tokenize("de"))
+    input.push_back(t);
+
+  const std::vector<Token> ab = tokenize("ab");
+  input.push_front(tokenize("c").front());
+  input.push_front(ab.begin(), ab.end());
+  input.push_back(tokenize("f").front());
+
+  REQUIRE(input.size() == 6);
+  REQUIRE(input.front() == tokenize("a").front());
+
+  std::vector<Token> result;
+
+  while (!input.empty())
+    result.push_back(input.read());
+
+  REQUIRE(result == tokenize("abcdef"));
+}
+
+static std::string recursive_macro_input(size_t n)
+{
+  std::string text = "\\def\\stop#1{}\\def\\r#1{#1\\r}\\r ";
+
+  for (size_t i(0); i < n; ++i)
+    text.push_back('a' + (i % 26));
+
+  return text + "\\stop ";
+}
+
+TEST_CASE("The preprocessor expands recursive macros", "[preprocessor]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  Preprocessor preproc{};
+  write(preproc, recursive_macro_input(100));
+
+  REQUIRE(preproc.output.size() == 100);
+  REQUIRE(preproc.output.back() == tokenize("v").front());
+}
+
+TEST_CASE("Expanding a recursive macro", "[!benchmark][preprocessor]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  const std::vector<Token> tokens = tokenize(recursive_macro_input(20000));
+
+  BENCHMARK("20000 expansions")
+  {
+    Preprocessor preproc{};
+
+    for (const Token& t : tokens)
+      preproc.write(t);
+
+    while (!preproc.input.empty())
+      preproc.advance();
+
+    return preproc.output.size();
+  };
+}
+
+TEST_CASE("Macro definitions are local to groups", "[preprocessor]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  Preprocessor preproc{};
+
+  write(preproc, "\\def\\a{A}\\def\\b{B}");
+  REQUIRE(preproc.macros().saveStackSize() == 0);
+
+  preproc.beginGroup();
+  write(preproc, "\\def\\a{X}\\def\\a{Y}\\def\\c{C}");
+  REQUIRE(preproc.macros().saveStackSize() == 2);
+
+  preproc.beginGroup();
+  write(preproc, "\\def\\b{Z}\\a\\b\\c ");
+  REQUIRE(preproc.output == tokenize("YZC"));
+  preproc.output.clear();
+  preproc.endGroup();
+
+  write(preproc, "\\a\\b ");
+  REQUIRE(preproc.output == tokenize("YB"));
+  preproc.output.clear();
+  preproc.endGroup();
+
+  write(preproc, "\\a\\b\\c ");
+  REQUIRE(preproc.output.size() == 3);
+  REQUIRE(preproc.output.back() == Token{ std::string("c") });
+  REQUIRE(preproc.find("c") == nullptr);
+  REQUIRE(preproc.macros().size() == 2);
+  REQUIRE(preproc.macros().saveStackSize() == 0);
+
+  REQUIRE_THROWS(preproc.endGroup());
+}
+
+TEST_CASE("The MacroTable restores many definitions", "[preprocessor]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  MacroTable table;
+
+  auto define = [&table](int i, const std::string& text) {
+    table.define(Macro{ "m" + std::to_string(i), tokenize(text) });
+  };
+
+  auto text = [&table](int i) -> std::string {
+    const Macro* m = table.find(CsTable::global().intern("m" + std::to_string(i)));
+    return m == nullptr ? "" : std::string(1, m->replacementText().front().characterToken().value);
+  };
+
+  for (int i(0); i < 500; i += 2)
+    define(i, "a");
+
+  table.beginGroup();
+
+  for (int i(0); i < 1000; i += 3)
+    define(i, "b");
+
+  REQUIRE(table.size() == 250 + 334 - 84);
+
+  table.endGroup();
+
+  REQUIRE(table.size() == 250);
+
+  for (int i(0); i < 1000; ++i)
+    REQUIRE(text(i) == (i < 500 && i % 2 == 0 ? "a" : ""));
+}
+
+TEST_CASE("Looking up macros in nested groups", "[!benchmark][preprocessor]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  Preprocessor preproc{};
+
+  for (int i(0); i < 100; ++i)
+    preproc.define(Macro{ "m" + std::to_string(i), tokenize("x") });
+
+  for (int i(0); i < 50; ++i)
+    preproc.beginGroup();
+
+  const CsId cs = CsTable::global().intern("m0");
+
+  BENCHMARK("find at depth 50")
+  {
+    return preproc.find(cs);
+  };
+
+  BENCHMARK("enter and leave a group")
+  {
+    preproc.beginGroup();
+    preproc.endGroup();
+  };
+}
+
+static std::string macro_driven_input(size_t n)
+{
+  std::string text =
+    "\\def\\pair#1#2{(#1,#2)}"
+    "\\def\\item#1\\par{\\pair{#1}x}"
+    "\\def\\entries#1;#2.{\\item #1\\par\\item #2\\par}";
+
+  for (size_t i(0); i < n; ++i)
+    text += "\\entries abc;{d}ef.";
+
+  return text;
+}
+
+TEST_CASE("The preprocessor matches delimited and undelimited arguments", "[preprocessor]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  Preprocessor preproc{};
+  write(preproc, macro_driven_input(2));
+  REQUIRE(preproc.output == tokenize("(abc,x)({d}ef,x)(abc,x)({d}ef,x)"));
+}
+
+TEST_CASE("Parameter texts are compiled into matcher programs", "[preprocessor]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  Macro m{ "proclaim", tokenize("x#1. #2#3\\par "), tokenize("a#3bc#1") };
+
+  const std::vector<Macro::Instruction>& prog = m.parameterProgram();
+  REQUIRE(prog.size() == 5);
+  REQUIRE(prog.at(0).opcode == Macro::Instruction::MatchLiteral);
+  REQUIRE(prog.at(0).count == 1);
+  REQUIRE(prog.at(1).opcode == Macro::Instruction::ReadDelimited);
+  REQUIRE(prog.at(1).param == 0);
+  REQUIRE(prog.at(1).delimiter == tokenize(".").front());
+  REQUIRE(prog.at(2).opcode == Macro::Instruction::MatchLiteral);
+  REQUIRE(prog.at(2).count == 1);
+  REQUIRE(prog.at(3).opcode == Macro::Instruction::ReadUndelimited);
+  REQUIRE(prog.at(3).param == 1);
+  REQUIRE(prog.at(4).opcode == Macro::Instruction::ReadDelimited);
+  REQUIRE(prog.at(4).param == 2);
+  REQUIRE(prog.at(4).delimiter == CsTable::Par);
+
+  const std::vector<Macro::Segment>& repl = m.replacementProgram();
+  REQUIRE(repl.size() == 4);
+  REQUIRE(repl.at(0).count == 1);
+  REQUIRE(repl.at(1).param == 2);
+  REQUIRE(repl.at(2).count == 2);
+  REQUIRE(repl.at(3).param == 0);
+
+  MacroMatcher matcher;
+  matcher.reset(&m);
+
+  const std::vector<Token> text = tokenize("xab. {c}de\\par more");
+  size_t n = 0;
+
+  while (matcher.write(text.at(n)) == MacroMatcher::NeedMore)
+    ++n;
+
+  REQUIRE(matcher.status() == MacroMatcher::Matched);
+  REQUIRE(matcher.size() == 11);
+  REQUIRE(matcher.arguments()[0].offset == 1);
+  REQUIRE(matcher.arguments()[0].length == 2);
+  REQUIRE(matcher.arguments()[1].offset == 6);
+  REQUIRE(matcher.arguments()[1].length == 1);
+  REQUIRE(matcher.arguments()[2].offset == 8);
+  REQUIRE(matcher.arguments()[2].length == 2);
+
+  std::vector<Token> output;
+  m.substitute(matcher.arguments(), [&text](size_t i) -> const Token& { return text[i]; }, output);
+  REQUIRE(output == tokenize("adebcab"));
+
+  matcher.reset(&m);
+  REQUIRE(matcher.write(tokenize("y").front()) == MacroMatcher::Failed);
+}
+
+TEST_CASE("Arguments are matched the same way in the input and as they are written", "[preprocessor]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  const std::string text = macro_driven_input(3);
+
+  Preprocessor streamed{};
+
+  for (const Token& t : tokenize(text))
+  {
+    streamed.write(t);
+
+    while (!streamed.input.empty())
+      streamed.advance();
+  }
+
+  Preprocessor buffered{};
+
+  for (const Token& t : tokenize(text))
+    buffered.input.push_back(t);
+
+  while (!buffered.input.empty())
+    buffered.advance();
+
+  REQUIRE(streamed.output == buffered.output);
+  REQUIRE(streamed.output == tokenize("(abc,x)({d}ef,x)(abc,x)({d}ef,x)(abc,x)({d}ef,x)"));
+
+  Preprocessor preproc{};
+  REQUIRE_THROWS(write(preproc, "\\def\\foo#1.{#1}\\foo a}."));
+}
+
+TEST_CASE("Expanding macros with arguments", "[!benchmark][preprocessor]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  const std::vector<Token> tokens = tokenize(macro_driven_input(2000));
+
+  BENCHMARK("2000 invocations")
+  {
+    Preprocessor preproc{};
+
+    for (const Token& t : tokens)
+      preproc.write(t);
+
+    while (!preproc.input.empty())
+      preproc.advance();
+
+    return preproc.output.size();
+  };
+}
+
+TEST_CASE("The expansion profiler tracks input levels", "[preprocessor]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  const CsId outer = CsTable::global().intern("outer");
+  const CsId inner = CsTable::global().intern("inner");
+
+  ExpansionProfiler profiler;
+
+  // \outer expands to 3 tokens, the second of which is \inner
+  profiler.expand(outer, 3);
+  profiler.consume(2);
+  profiler.expand(inner, 2);
+  REQUIRE(profiler.depth() == 2);
+  profiler.consume(2);
+  REQUIRE(profiler.depth() == 1);
+  profiler.primitive(ExpansionProfiler::Csname);
+  profiler.insert(1);
+  profiler.consume(2);
+  REQUIRE(profiler.depth() == 0);
+
+  // \inner ends the expansion of \outer, so it is not nested
+  profiler.expand(outer, 1);
+  profiler.consume(1);
+  profiler.expand(inner, 2);
+  REQUIRE(profiler.depth() == 1);
+  profiler.consume(5);
+
+  REQUIRE(profiler.maxDepth() == 2);
+  REQUIRE(profiler.primitiveCount(ExpansionProfiler::Csname) == 1);
+  REQUIRE(profiler.stats(outer)->invocations == 2);
+  REQUIRE(profiler.stats(outer)->tokens == 4);
+  REQUIRE(profiler.stats(inner)->max_depth == 2);
+
+  const std::vector<ExpansionProfiler::MacroStats> report = profiler.report();
+  REQUIRE(report.size() == 2);
+  REQUIRE(report.front().cs == inner); // same counts, sorted by name
+
+  std::ostringstream folded;
+  profiler.writeFoldedStacks(folded);
+  REQUIRE(folded.str() == "inner 2\nouter 5\nouter;inner 2\n");
+
+  profiler.clear();
+  REQUIRE(profiler.stats(outer) == nullptr);
+}
+
+#if defined(LIBTYPESET_EXPANSION_PROFILER)
+
+TEST_CASE("The preprocessor reports to the expansion profiler", "[preprocessor]")
+{
+  using namespace tex;
+  using namespace parsing;
+
+  Preprocessor preproc{};
+  write(preproc, macro_driven_input(3));
+
+  const ExpansionProfiler& profiler = preproc.profiler();
+  REQUIRE(profiler.stats(CsTable::global().find("entries"))->invocations == 3);
+  REQUIRE(profiler.stats(CsTable::global().find("item"))->invocations == 6);
+  REQUIRE(profiler.stats(CsTable::global().find("pair"))->invocations == 6);
+  REQUIRE(profiler.stats(CsTable::global().find("pair"))->tokens == 3 * (7 + 9));
+  REQUIRE(profiler.depth() == 0);
+
+  std::ostringstream folded;
+  profiler.writeFoldedStacks(folded);
+  REQUIRE(folded.str().find("entries;item") != std::string::npos);
+}
+
+#endif // defined(LIBTYPESET_EXPANSION_PROFILER)
@@ -0,0 +1,629 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the typeset project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "catch.hpp"
+
+#include "tex/sfntfile.h"
+#include "tex/headless/sfnt-font-metrics.h"
+#include "tex/headless/typeset-engine.h"
+
+#include "tex/hbox.h"
+#include "tex/vbox.h"
+#include "tex/math/atom.h"
+#include "tex/math/fraction.h"
+#include "tex/math/math-typeset.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+
+struct Bytes
+{
+  std::vector<uint8_t> data;
+
+  size_t size() const { return data.size(); }
+
+  Bytes& u16(uint16_t v)
+  {
+    data.push_back(v >> 8);
+    data.push_back(v & 0xFF);
+    return *this;
+  }
+
+  Bytes& u32(uint32_t v)
+  {
+    u16(v >> 16);
+    return u16(v & 0xFFFF);
+  }
+
+  Bytes& append(const Bytes& other)
+  {
+    data.insert(data.end(), other.data.begin(), other.data.end());
+    return *this;
+  }
+
+  void pad(size_t n)
+  {
+    data.resize(n, 0);
+  }
+
+  void set16(size_t offset, uint16_t v)
+  {
+    data[offset] = v >> 8;
+    data[offset + 1] = v & 0xFF;
+  }
+};
+
+// Glyphs: .notdef, space, A, V, o and the mathematical italic A (U+1D434)
+struct TestFont
+{
+  bool format12 = false;
+  bool gpos = true;
+  bool bad_class2 = false;
+  bool classes_first = false;
+  bool off_baseline = false;
+  bool math = true;
+
+  std::vector<std::pair<uint32_t, Bytes>> tables;
+
+  static Bytes head()
+  {
+    Bytes b;
+    b.u32(0x00010000);
+    b.pad(18);
+    b.u16(1000); // unitsPerEm
+    b.pad(54);
+    return b;
+  }
+
+  static Bytes hhea()
+  {
+    Bytes b;
+    b.u32(0x00010000).u16(800).u16(uint16_t(-200));
+    b.pad(34);
+    b.u16(5); // numberOfHMetrics
+    return b;
+  }
+
+  static Bytes maxp()
+  {
+    return Bytes().u32(0x00005000).u16(6);
+  }
+
+  static Bytes hmtx()
+  {
+    Bytes b;
+
+    for (uint16_t adv : { 500, 250, 700, 650, 550 })
+      b.u16(adv).u16(0);
+
+    b.u16(0); // left side bearing of the last glyph
+    return b;
+  }
+
+  static Bytes os2()
+  {
+    Bytes b;
+    b.u16(2);
+    b.pad(86);
+    b.u16(450); // sxHeight
+    b.pad(96);
+    return b;
+  }
+
+  static Bytes post()
+  {
+    Bytes b;
+    b.u32(0x00030000).u32(uint32_t(-12 * 65536));
+    b.pad(32);
+    return b;
+  }
+
+  static Bytes cmap4()
+  {
+    const uint16_t ends[] = { 0x20, 0x41, 0x56, 0x6F, 0xFFFF };
+    const uint16_t starts[] = { 0x20, 0x41, 0x56, 0x6F, 0xFFFF };
+    const uint16_t deltas[] = { uint16_t(1 - 0x20), uint16_t(2 - 0x41), uint16_t(3 - 0x56), 0, 1 };
+    const uint16_t range_offsets[] = { 0, 0, 0, 4, 0 };
+
+    Bytes b;
+    b.u16(4).u16(0).u16(0).u16(10).u16(8).u16(2).u16(2);
+    for (uint16_t v : ends) b.u16(v);
+    b.u16(0);
+    for (uint16_t v : starts) b.u16(v);
+    for (uint16_t v : deltas) b.u16(v);
+    for (uint16_t v : range_offsets) b.u16(v);
+    b.u16(4); // glyph of 'o'
+    b.set16(2, static_cast<uint16_t>(b.size()));
+    return b;
+  }
+
+  static Bytes cmap12()
+  {
+    Bytes b;
+    b.u16(12).u16(0).u32(16 + 12 * 5).u32(0).u32(5);
+    b.u32(0x20).u32(0x20).u32(1);
+    b.u32(0x41).u32(0x41).u32(2);
+    b.u32(0x56).u32(0x56).u32(3);
+    b.u32(0x6F).u32(0x70).u32(4);
+    b.u32(0x1D434).u32(0x1D434).u32(5);
+    return b;
+  }
+
+  Bytes cmap_table() const
+  {
+    Bytes sub = format12 ? cmap12() : cmap4();
+    Bytes b;
+    b.u16(0).u16(2);
+    b.u16(1).u16(0).u32(20); // Macintosh, ignored
+    b.u16(3).u16(format12 ? 10 : 1).u32(20);
+    b.append(sub);
+    return b;
+  }
+
+  // With off_baseline, .notdef is below the baseline and the last glyph above it
+  static Bytes loca_glyf(Bytes& glyf, bool off_baseline)
+  {
+    const int16_t boxes[][4] = {
+      { 0, int16_t(off_baseline ? -300 : 0), 500, int16_t(off_baseline ? -100 : 700) },
+      { 0, 0, 0, 0 },
+      { 0, 0, 700, 700 },
+      { 0, -10, 650, 700 },
+      { 20, -12, 530, 480 },
+      { 0, int16_t(off_baseline ? 300 : 0), 600, 700 },
+    };
+
+    Bytes loca;
+
+    for (size_t i(0); i < 6; ++i)
+    {
+      loca.u16(static_cast<uint16_t>(glyf.size() / 2));
+
+      if (i == 1)
+        continue; // space has no outline
+
+      glyf.u16(1);
+
+      for (int16_t v : boxes[i])
+        glyf.u16(static_cast<uint16_t>(v));
+
+      glyf.u16(0);
+    }
+
+    loca.u16(static_cast<uint16_t>(glyf.size() / 2));
+    return loca;
+  }
+
+  static Bytes kern_table()
+  {
+    Bytes b;
+    b.u16(0).u16(1);
+    b.u16(0).u16(14 + 6 * 2).u16(0x0001).u16(2).u16(12).u16(1).u16(0);
+    b.u16(2).u16(3).u16(uint16_t(-80)); // A V
+    b.u16(3).u16(2).u16(uint16_t(-60)); // V A
+    return b;
+  }
+
+  static Bytes gpos_table(bool bad_class2, bool classes_first)
+  {
+    // Format 1 with XPlacement and XAdvance: A V = -100
+    Bytes pair1;
+    pair1.u16(1).u16(0).u16(0x0005).u16(0).u16(1).u16(0);
+    const size_t coverage1 = pair1.size();
+    pair1.u16(1).u16(1).u16(2);
+    const size_t pairset = pair1.size();
+    pair1.u16(1).u16(3).u16(uint16_t(-7)).u16(uint16_t(-100));
+    pair1.set16(2, static_cast<uint16_t>(coverage1));
+    pair1.set16(10, static_cast<uint16_t>(pairset));
+
+    // Format 2: V in class 1, o in class 1 = -50
+    // (A in class 1 and V, o in class 1 with classes_first)
+    Bytes pair2;
+    pair2.u16(2).u16(0).u16(0x0004).u16(0).u16(0).u16(0).u16(2).u16(2);
+    pair2.u16(0).u16(0).u16(0).u16(uint16_t(-50));
+    const size_t coverage2 = pair2.size();
+    pair2.u16(2).u16(1).u16(classes_first ? 2 : 3).u16(3).u16(0);
+    const size_t class1 = pair2.size();
+    if (classes_first)
+      pair2.u16(1).u16(2).u16(2).u16(1).u16(1);
+    else
+      pair2.u16(1).u16(3).u16(1).u16(1);
+    const size_t class2 = pair2.size();
+    // a malformed font may use classes that are not below Class2Count
+    pair2.u16(2).u16(1).u16(classes_first ? 3 : 4).u16(4).u16(bad_class2 ? 2 : 1);
+    pair2.set16(2, static_cast<uint16_t>(coverage2));
+    pair2.set16(8, static_cast<uint16_t>(class1));
+    pair2.set16(10, static_cast<uint16_t>(class2));
+
+    Bytes lookup1;
+    lookup1.u16(2).u16(0).u16(1).u16(8).append(pair1);
+
+    // Wrapped in an extension lookup
+    Bytes lookup2;
+    lookup2.u16(9).u16(0).u16(1).u16(8).u16(1).u16(2).u32(8).append(pair2);
+
+    if (classes_first)
+      std::swap(lookup1, lookup2);
+
+    Bytes lookups;
+    lookups.u16(2).u16(6).u16(static_cast<uint16_t>(6 + lookup1.size()));
+    lookups.append(lookup1).append(lookup2);
+
+    Bytes features;
+    features.u16(2);
+    features.data.push_back('l'); features.data.push_back('i'); features.data.push_back('g'); features.data.push_back('a');
+    features.u16(14);
+    features.data.push_back('k'); features.data.push_back('e'); features.data.push_back('r'); features.data.push_back('n');
+    features.u16(20);
+    features.u16(0).u16(1).u16(0); // liga: lookup 0 (unused)
+    features.u16(0).u16(2).u16(0).u16(1);
+
+    Bytes b;
+    b.u32(0x00010000).u16(10).u16(12).u16(static_cast<uint16_t>(12 + features.size()));
+    b.u16(0);
+    b.append(features).append(lookups);
+    return b;
+  }
+
+  static Bytes math_table()
+  {
+    Bytes b;
+    b.u32(0x00010000).u16(10).u16(0).u16(0);
+    b.u16(70).u16(50).u16(1300).u16(1500);
+
+    for (int i(4); i < 55; ++i)
+      b.u16(static_cast<uint16_t>(i == 5 ? 250 : 100 + i)).u16(0);
+
+    b.u16(60);
+    return b;
+  }
+
+  std::vector<uint8_t> build()
+  {
+    Bytes glyf;
+    Bytes loca = loca_glyf(glyf, off_baseline);
+
+    tables.clear();
+    tables.emplace_back(tex::sfnt::tag('O', 'S', '/', '2'), os2());
+    tables.emplace_back(tex::sfnt::tag('c', 'm', 'a', 'p'), cmap_table());
+    tables.emplace_back(tex::sfnt::tag('g', 'l', 'y', 'f'), glyf);
+    tables.emplace_back(tex::sfnt::tag('h', 'e', 'a', 'd'), head());
+    tables.emplace_back(tex::sfnt::tag('h', 'h', 'e', 'a'), hhea());
+    tables.emplace_back(tex::sfnt::tag('h', 'm', 't', 'x'), hmtx());
+    tables.emplace_back(tex::sfnt::tag('k', 'e', 'r', 'n'), kern_table());
+    tables.emplace_back(tex::sfnt::tag('l', 'o', 'c', 'a'), loca);
+    tables.emplace_back(tex::sfnt::tag('m', 'a', 'x', 'p'), maxp());
+    tables.emplace_back(tex::sfnt::tag('p', 'o', 's', 't'), post());
+
+    if (gpos)
+      tables.emplace_back(tex::sfnt::tag('G', 'P', 'O', 'S'), gpos_table(bad_class2, classes_first));
+
+    if (math)
+      tables.emplace_back(tex::sfnt::tag('M', 'A', 'T', 'H'), math_table());
+
+    Bytes result;
+    result.u32(0x00010000).u16(static_cast<uint16_t>(tables.size())).u16(0).u16(0).u16(0);
+
+    size_t offset = 12 + 16 * tables.size();
+
+    for (const auto& t : tables)
+    {
+      result.u32(t.first).u32(0).u32(static_cast<uint32_t>(offset)).u32(static_cast<uint32_t>(t.second.size()));
+      offset += (t.second.size() + 3) & ~size_t(3);
+    }
+
+    for (const auto& t : tables)
+    {
+      result.append(t.second);
+      result.pad((result.size() + 3) & ~size_t(3));
+    }
+
+    return result.data;
+  }
+};
+
+} // namespace
+
+TEST_CASE("A SfntFile reads the font-wide metrics", "[sfnt]")
+{
+  using namespace tex;
+
+  std::vector<uint8_t> bytes = TestFont().build();
+  SfntFile file{ bytes.data(), bytes.size() };
+
+  REQUIRE(file.hasTable(sfnt::tag('h', 'e', 'a', 'd')));
+  REQUIRE(!file.hasTable(sfnt::tag('C', 'F', 'F', ' ')));
+  REQUIRE(file.unitsPerEm() == 1000);
+  REQUIRE(file.ascender() == 800);
+  REQUIRE(file.descender() == -200);
+  REQUIRE(file.xHeight() == 450);
+  REQUIRE(file.italicAngle() == -12.f);
+  REQUIRE(file.glyphCount() == 6);
+}
+
+TEST_CASE("A SfntFile maps characters to glyphs", "[sfnt]")
+{
+  using namespace tex;
+
+  TestFont font;
+  std::vector<uint8_t> bytes = font.build();
+
+  {
+    SfntFile file{ bytes.data(), bytes.size() };
+
+    REQUIRE(file.glyphIndex(' ') == 1);
+    REQUIRE(file.glyphIndex('A') == 2);
+    REQUIRE(file.glyphIndex('V') == 3);
+    REQUIRE(file.glyphIndex('o') == 4);
+    REQUIRE(file.glyphIndex('B') == 0);
+    REQUIRE(file.glyphIndex(0x1D434) == 0);
+    REQUIRE(file.glyphIndex(-1) == 0);
+  }
+
+  font.format12 = true;
+  bytes = font.build();
+
+  {
+    SfntFile file{ bytes.data(), bytes.size() };
+
+    REQUIRE(file.glyphIndex('A') == 2);
+    REQUIRE(file.glyphIndex('o') == 4);
+    REQUIRE(file.glyphIndex('p') == 5);
+    REQUIRE(file.glyphIndex(0x1D434) == 5);
+    REQUIRE(file.glyphIndex(0x1D435) == 0);
+  }
+}
+
+TEST_CASE("A SfntFile exposes the glyph metrics", "[sfnt]")
+{
+  using namespace tex;
+
+  TestFont font;
+  font.format12 = true;
+  std::vector<uint8_t> bytes = font.build();
+  SfntFile file{ bytes.data(), bytes.size() };
+
+  REQUIRE(file.advance(2) == 700);
+  REQUIRE(file.advance(4) == 550);
+  REQUIRE(file.advance(5) == 550);
+
+  sfnt::GlyphBounds b = file.bounds(4);
+  REQUIRE(b.xMin == 20);
+  REQUIRE(b.yMin == -12);
+  REQUIRE(b.xMax == 530);
+  REQUIRE(b.yMax == 480);
+
+  b = file.bounds(1);
+  REQUIRE(b.yMin == 0);
+  REQUIRE(b.yMax == 0);
+
+  BoxMetrics m = file.metrics('o', 10.f);
+  REQUIRE(m.width == Approx(5.5f));
+  REQUIRE(m.height == Approx(4.8f));
+  REQUIRE(m.depth == Approx(0.12f));
+
+  m = file.metrics(0x1D434, 20.f);
+  REQUIRE(m.width == Approx(11.f));
+  REQUIRE(m.height == Approx(14.f));
+
+  // Glyphs wholly above or below the baseline
+  font.off_baseline = true;
+  bytes = font.build();
+  SfntFile shifted{ bytes.data(), bytes.size() };
+
+  m = shifted.metrics(0x1D434, 10.f);
+  REQUIRE(m.height == Approx(7.f));
+  REQUIRE(m.depth == 0.f);
+
+  m = shifted.metrics('B', 10.f);
+  REQUIRE(m.height == 0.f);
+  REQUIRE(m.depth == Approx(3.f));
+}
+
+TEST_CASE("A SfntFile reads kerning pairs", "[sfnt]")
+{
+  using namespace tex;
+
+  TestFont font;
+  std::vector<uint8_t> bytes = font.build();
+
+  {
+    SfntFile file{ bytes.data(), bytes.size() };
+
+    REQUIRE(file.kerning(2, 3) == -100);
+    REQUIRE(file.kerning(3, 2) == 0); // the kern table is ignored
+    REQUIRE(file.kerning(3, 4) == -50);
+    REQUIRE(file.kerning(3, 3) == 0);
+    REQUIRE(file.kerning(4, 2) == 0);
+    REQUIRE(file.kerning('V', 'o', 10.f) == Approx(-0.5f));
+  }
+
+  font.gpos = false;
+  bytes = font.build();
+
+  {
+    SfntFile file{ bytes.data(), bytes.size() };
+
+    REQUIRE(file.kerning(2, 3) == -80);
+    REQUIRE(file.kerning(3, 4) == 0);
+  }
+
+  font.gpos = true;
+  font.bad_class2 = true;
+  bytes = font.build();
+
+  {
+    SfntFile file{ bytes.data(), bytes.size() };
+
+    REQUIRE(file.kerning(2, 3) == -100);
+    REQUIRE(file.kerning(3, 4) == 0);
+  }
+
+  // The first lookup that applies to a pair wins
+  font.bad_class2 = false;
+  font.classes_first = true;
+  bytes = font.build();
+
+  {
+    SfntFile file{ bytes.data(), bytes.size() };
+
+    REQUIRE(file.kerning(2, 3) == -50);
+    REQUIRE(file.kerning(2, 4) == -50);
+    REQUIRE(file.kerning(3, 4) == -50);
+    REQUIRE(file.kerning(3, 2) == 0);
+  }
+}
+
+TEST_CASE("A SfntFile maps the MATH constants to font parameters", "[sfnt]")
+{
+  using namespace tex;
+
+  TestFont font;
+  std::vector<uint8_t> bytes = font.build();
+  SfntFile file{ bytes.data(), bytes.size() };
+
+  REQUIRE(file.hasMath());
+  REQUIRE(file.mathConstant(sfnt::MathConstant::ScriptPercentScaleDown) == 70);
+  REQUIRE(file.mathConstant(sfnt::MathConstant::DisplayOperatorMinHeight) == 1500);
+  REQUIRE(file.mathConstant(sfnt::MathConstant::AxisHeight) == 250);
+  REQUIRE(file.mathConstant(sfnt::MathConstant::FractionRuleThickness) == 100 + 38);
+  REQUIRE(file.mathConstant(sfnt::MathConstant::RadicalDegreeBottomRaisePercent) == 60);
+
+  const FontDimen fd = file.fontdimen(10.f);
+  REQUIRE(fd.slant_per_pt == Approx(std::tan(12.f * 3.14159265f / 180.f)));
+  REQUIRE(fd.interword_space == Approx(2.5f));
+  REQUIRE(fd.interword_stretch == Approx(1.25f));
+  REQUIRE(fd.x_height == Approx(4.5f));
+  REQUIRE(fd.quad == 10.f);
+  REQUIRE(fd.axis_height == Approx(2.5f));
+  REQUIRE(fd.delim1 == Approx(15.f));
+  REQUIRE(fd.default_rule_thickness == Approx(1.38f));
+  REQUIRE(fd.num1 == Approx(1.33f));
+  REQUIRE(fd.sub1 == Approx(1.08f));
+
+  font.math = false;
+  bytes = font.build();
+  SfntFile text{ bytes.data(), bytes.size() };
+  REQUIRE(!text.hasMath());
+  REQUIRE(text.fontdimen(10.f).axis_height == 0.f);
+}
+
+TEST_CASE("A SfntFile can be mapped from disk", "[sfnt]")
+{
+  using namespace tex;
+
+  std::vector<uint8_t> bytes = TestFont().build();
+  const std::string path = "test-sfnt-file.ttf";
+
+  {
+    std::ofstream out{ path, std::ios::binary };
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  }
+
+  {
+    SfntFile file{ path };
+    REQUIRE(file.size() == bytes.size());
+    REQUIRE(file.glyphIndex('V') == 3);
+  }
+
+  std::remove(path.c_str());
+
+  REQUIRE_THROWS(SfntFile{ "does-not-exist.ttf" });
+}
+
+TEST_CASE("Invalid sfnt files are rejected", "[sfnt]")
+{
+  using namespace tex;
+
+  std::vector<uint8_t> bytes = TestFont().build();
+
+  REQUIRE_THROWS(SfntFile{ bytes.data(), 8 });
+  REQUIRE_THROWS(SfntFile{ bytes.data(), 200 });
+
+  std::vector<uint8_t> copy = bytes;
+  copy[0] = 0x7F;
+  REQUIRE_THROWS(SfntFile{ copy.data(), copy.size() });
+
+  copy = bytes;
+  copy[5] = 1; // only the OS/2 table remains
+  REQUIRE_THROWS(SfntFile{ copy.data(), copy.size() });
+}
+
+TEST_CASE("The sfnt provider exposes glyph metrics and kerning", "[sfnt]")
+{
+  using namespace tex;
+
+  TestFont font;
+  std::vector<uint8_t> bytes = font.build();
+  auto file = std::make_shared<SfntFile>(bytes.data(), bytes.size());
+
+  headless::SfntFontMetricsProvider provider;
+  const Font f = provider.addFont("test", file, 10.f);
+  const Font g = provider.addFont("test", file, 20.f);
+
+  REQUIRE(provider.fontCount() == 2);
+  REQUIRE(provider.metrics('A', f).width == Approx(7.f));
+  REQUIRE(provider.metrics('A', g).width == Approx(14.f));
+  REQUIRE(provider.fontdimen(g).quad == 20.f);
+
+  LigKern lk = provider.ligKern(f, 'A', 'V');
+  REQUIRE(lk.kind == LigKern::Kern);
+  REQUIRE(lk.kern == Approx(-1.f));
+
+  lk = provider.ligKern(f, 'o', 'A');
+  REQUIRE(lk.kind == LigKern::None);
+
+  lk = provider.ligKern(f, LigKern::Boundary, 'A');
+  REQUIRE(lk.kind == LigKern::None);
+
+  REQUIRE_THROWS(provider.metrics('A', Font(2)));
+}
+
+TEST_CASE("The headless engine typesets text and math with sfnt fonts", "[sfnt][headless]")
+{
+  using namespace tex;
+
+  TestFont font;
+  std::vector<uint8_t> bytes = font.build();
+
+  auto engine = std::make_shared<headless::TypesetEngine>(std::make_shared<headless::SfntFontMetricsProvider>());
+  const Font f = engine->addFont("test", std::make_shared<SfntFile>(bytes.data(), bytes.size()), 10.f);
+  REQUIRE(engine->sfntMetrics()->fontCount() == 1);
+  REQUIRE(engine->tfmMetrics() == nullptr);
+  REQUIRE_THROWS(engine->reloadFont("test"));
+
+  auto word = engine->typeset("AVo", f);
+  REQUIRE(word->isHBox());
+  REQUIRE(word->width() == Approx(19.f));
+  REQUIRE(word->height() == Approx(7.f));
+  REQUIRE(word->depth() == Approx(0.12f));
+
+  for (int fam(0); fam < 4; ++fam)
+    engine->setMathFont(fam, f, f, f);
+
+  MathTypesetter typesetter{ engine };
+  typesetter.setFonts(engine->mathfonts());
+
+  MathList numer;
+  numer.push_back(math::Atom::create<math::Atom::Ord>(std::make_shared<MathSymbol>('A', math::Atom::Ord, 0)));
+  MathList denom;
+  denom.push_back(math::Atom::create<math::Atom::Ord>(std::make_shared<MathSymbol>('o', math::Atom::Ord, 0)));
+
+  MathList mlist;
+  mlist.push_back(std::make_shared<math::Fraction>(std::move(numer), std::move(denom)));
+
+  List hlist = typesetter.mlist2hlist(std::move(mlist), math::Style::D);
+  REQUIRE(hlist.size() == 1);
+  REQUIRE(hlist.front()->is<VBox>());
+
+  // numerator above the axis, denominator below it
+  const VBox& fraction = hlist.front()->as<VBox>();
+  REQUIRE(fraction.width() == Approx(7.f));
+  REQUIRE(fraction.height() > 7.f);
+  REQUIRE(fraction.depth() > 4.8f);
+}
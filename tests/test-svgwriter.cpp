@@ -0,0 +1,114 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the typeset project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "catch.hpp"
+
+#include "test-typeset.h"
+
+#include "tex/svgwriter.h"
+
+#include "tex/hbox.h"
+#include "tex/vbox.h"
+#include "tex/glue.h"
+#include "tex/kern.h"
+#include "tex/rule.h"
+
+#include <fstream>
+#include <sstream>
+
+static std::string read_golden_file(const std::string& name)
+{
+  std::ifstream file{ std::string(TYPESET_TESTS_DIR) + "/golden/" + name };
+  REQUIRE(file.good());
+  std::stringstream ss;
+  ss << file.rdbuf();
+  return ss.str();
+}
+
+static std::shared_ptr<tex::VBox> svg_page(const std::string& first, const std::string& second)
+{
+  using namespace tex;
+
+  auto fraction = vbox({ test_word("1", 2), hrule(5.f, 0.5f, 0.5f), test_word("2", 2) });
+  fraction->setShiftAmount(-3.f);
+
+  auto line1 = hbox({ test_word(first, 1), glue(4.f), test_word("<&>", 1), kern(2.f), fraction }, 80.f);
+  auto line2 = hbox({ test_word(second, 1), glue(4.f), test_word("x", 2) });
+
+  return vbox({ line1, glue(6.f), line2 });
+}
+
+TEST_CASE("SvgWriter output matches the golden files", "[svgwriter]")
+{
+  using namespace tex;
+
+  std::ostringstream out;
+
+  {
+    SvgWriter writer{ out, 100.f, 60.f, 2 };
+    writer.setFont(Font(1), "cmr10", 10.f);
+    writer.setFont(Font(2), "cmmi10", 10.f);
+    auto page1 = svg_page("Hello", "World");
+    auto page2 = svg_page("abc", "def");
+    writer.writePage(*page1, Pos{ 10.f, 10.f + page1->height() });
+    writer.writePage(*page2, Pos{ 10.f, 10.f + page2->height() });
+    writer.finish();
+    REQUIRE(writer.pageCount() == 2);
+  }
+
+  REQUIRE(out.str() == read_golden_file("svgwriter-pages.svg"));
+}
+
+TEST_CASE("SvgWriter streams many pages", "[svgwriter]")
+{
+  using namespace tex;
+
+  std::ostringstream out;
+  SvgWriter writer{ out, 100.f, 60.f, 300 };
+
+  for (size_t i(0); i < 300; ++i)
+    writer.writePage(*svg_page("page", std::to_string(i)));
+
+  writer.finish();
+
+  const std::string svg = out.str();
+
+  auto count = [&svg](const std::string& str) -> size_t {
+    size_t n = 0;
+    for (size_t pos = svg.find(str); pos != std::string::npos; pos = svg.find(str, pos + 1), ++n);
+    return n;
+  };
+
+  REQUIRE(count("<g id=\"page") == 300);
+  REQUIRE(count("<style>") == 2);
+  REQUIRE(count("<rect") == 300);
+  REQUIRE(svg.find("height=\"18000\"") != std::string::npos);
+}
+
+TEST_CASE("SvgWriter escapes characters that XML does not allow", "[svgwriter]")
+{
+  using namespace tex;
+
+  std::ostringstream out;
+
+  {
+    SvgWriter writer{ out, 100.f, 60.f };
+    writer.setFont(Font(1), "Latin \"Modern\" <Roman> & co", 10.f);
+
+    // "fi" is the glyph 0x0C in the TeX text fonts
+    const BoxMetrics metrics{ 7.f, 2.f, 5.f };
+    auto word = hbox({ std::make_shared<CharacterBox>(0x0C, Font(1), metrics), std::make_shared<CharacterBox>('t', Font(1), metrics),
+      std::make_shared<CharacterBox>('\t', Font(1), metrics), std::make_shared<CharacterBox>(0xFFFF, Font(1), metrics) });
+    writer.writePage(*vbox({ word }));
+    writer.finish();
+  }
+
+  const std::string svg = out.str();
+
+  REQUIRE(svg.find("&#xF00C;t&#x9;&#xFFFD;") != std::string::npos);
+  REQUIRE(svg.find("font-family:\"Latin \\\"Modern\\\" &lt;Roman&gt; &amp; co\";") != std::string::npos);
+
+  for (char c : svg)
+    REQUIRE((static_cast<unsigned char>(c) >= 0x20 || c == '\n'));
+}
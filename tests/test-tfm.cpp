@@ -0,0 +1,279 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the typeset project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "catch.hpp"
+
+#include "test-tfm.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+static void write_word(std::vector<uint8_t>& bytes, uint32_t w)
+{
+  bytes.push_back(w >> 24);
+  bytes.push_back((w >> 16) & 0xFF);
+  bytes.push_back((w >> 8) & 0xFF);
+  bytes.push_back(w & 0xFF);
+}
+
+static uint32_t fix(double x)
+{
+  return static_cast<uint32_t>(static_cast<int32_t>(x * (1 << 20)));
+}
+
+static uint8_t dimen_index(std::vector<double>& table, double value)
+{
+  auto it = std::find(table.begin(), table.end(), value);
+
+  if (it != table.end())
+    return static_cast<uint8_t>(it - table.begin());
+
+  table.push_back(value);
+  return static_cast<uint8_t>(table.size() - 1);
+}
+
+std::vector<uint8_t> TfmBuilder::build() const
+{
+  std::vector<double> widths{ 0.0 }, heights{ 0.0 }, depths{ 0.0 }, italics{ 0.0 };
+  std::vector<uint8_t> char_info;
+
+  const int bc = chars.empty() ? 1 : chars.begin()->first;
+  const int ec = chars.empty() ? 0 : chars.rbegin()->first;
+
+  for (int c(bc); c <= ec; ++c)
+  {
+    auto it = chars.find(c);
+
+    if (it == chars.end())
+    {
+      char_info.insert(char_info.end(), { 0, 0, 0, 0 });
+      continue;
+    }
+
+    const Char& ch = it->second;
+    char_info.push_back(dimen_index(widths, ch.width));
+    char_info.push_back((dimen_index(heights, ch.height) << 4) | dimen_index(depths, ch.depth));
+    char_info.push_back((dimen_index(italics, ch.italic) << 2) | static_cast<uint8_t>(ch.tag));
+    char_info.push_back(ch.remainder);
+  }
+
+  const size_t lh = 2;
+  const size_t lf = 6 + lh + (ec - bc + 1) + widths.size() + heights.size() + depths.size() + italics.size() 
+    + ligkern.size() + kerns.size() + extensibles.size() + params.size();
+
+  std::vector<uint8_t> bytes;
+  write_word(bytes, static_cast<uint32_t>((lf << 16) | lh));
+  write_word(bytes, static_cast<uint32_t>((bc << 16) | ec));
+  write_word(bytes, static_cast<uint32_t>((widths.size() << 16) | heights.size()));
+  write_word(bytes, static_cast<uint32_t>((depths.size() << 16) | italics.size()));
+  write_word(bytes, static_cast<uint32_t>((ligkern.size() << 16) | kerns.size()));
+  write_word(bytes, static_cast<uint32_t>((extensibles.size() << 16) | params.size()));
+  write_word(bytes, checksum);
+  write_word(bytes, fix(design_size));
+  bytes.insert(bytes.end(), char_info.begin(), char_info.end());
+
+  for (const std::vector<double>* table : { &widths, &heights, &depths, &italics })
+  {
+    for (double x : *table)
+      write_word(bytes, fix(x));
+  }
+
+  for (const tex::tfm::LigKernInstruction& instr : ligkern)
+    bytes.insert(bytes.end(), { instr.skip_byte, instr.next_char, instr.op_byte, instr.remainder });
+
+  for (double k : kerns)
+    write_word(bytes, fix(k));
+
+  for (const tex::tfm::ExtensibleRecipe& r : extensibles)
+    bytes.insert(bytes.end(), { r.top, r.mid, r.bot, r.rep });
+
+  for (double p : params)
+    write_word(bytes, fix(p));
+
+  return bytes;
+}
+
+namespace
+{
+
+// Builds the following font:
+// - characters 'A' to 'F'; 'E' does not exist
+// - 'A' kerns with 'B' and forms a ligature with 'C'
+// - 'B' shares the lig/kern program of 'A' through an indirection
+// - 'C' has a successor 'D', which is extensible
+// - 13 parameters, as in a math extension font
+struct TestTfm
+{
+  std::vector<uint8_t> bytes;
+
+  TestTfm()
+  {
+    using tex::tfm::Tag;
+
+    TfmBuilder builder;
+    builder.checksum = 0xCAFEBABE;
+    builder.addChar('A', 0.5, 0.7, 0.0, 0.05, Tag::LigKern, 0);
+    builder.addChar('B', 0.75, 0.25, 0.2, 0.0, Tag::LigKern, 3);
+    builder.addChar('C', 1.0, 0.7, 0.0, 0.0, Tag::CharList, 'D');
+    builder.addChar('D', 1.0, 0.25, 0.2, 0.0, Tag::Extensible, 0);
+    builder.addChar('F', 0.5, 0.7, 0.0);
+
+    builder.ligkern = {
+      { 0, 'B', 128, 0 }, // A B: kern[0]
+      { 0, 'C', 0, 'F' }, // A C: ligature F
+      { 128, 'A', 128, 1 }, // A A: kern[1], stop
+      { 129, 0, 0, 0 }, // B: goto 0
+      { 128, 'A', 128, 1 }, // unused, stop
+    };
+
+    builder.kerns = { -0.05, 0.1 };
+    builder.extensibles = { { 'A', 0, 'F', 'B' } };
+
+    for (int i(1); i <= 13; ++i)
+      builder.params.push_back(i / 100.0);
+
+    bytes = builder.build();
+  }
+};
+
+} // namespace
+
+TEST_CASE("A TfmFile exposes the character metrics", "[tfm]")
+{
+  using namespace tex;
+
+  TestTfm tfm;
+  TfmFile file{ tfm.bytes.data(), tfm.bytes.size() };
+
+  REQUIRE(file.size() == tfm.bytes.size());
+  REQUIRE(file.checksum() == 0xCAFEBABE);
+  REQUIRE(file.designSize() == 10.f);
+  REQUIRE(file.firstChar() == 'A');
+  REQUIRE(file.lastChar() == 'F');
+
+  REQUIRE(file.hasChar('A'));
+  REQUIRE(!file.hasChar('E'));
+  REQUIRE(!file.hasChar('Z'));
+
+  REQUIRE(file.width('A') == 0.5f);
+  REQUIRE(file.width('C') == 1.f);
+  REQUIRE(file.height('B') == 0.25f);
+  REQUIRE(file.depth('B') == Approx(0.2f).margin(1e-6));
+  REQUIRE(file.depth('A') == 0.f);
+  REQUIRE(file.italicCorrection('A') == Approx(0.05f).margin(1e-6));
+
+  const BoxMetrics m = file.metrics('B', 10.f);
+  REQUIRE(m.width == 7.5f);
+  REQUIRE(m.height == 2.5f);
+  REQUIRE(m.depth == Approx(2.f).margin(1e-5));
+}
+
+TEST_CASE("A TfmFile exposes the lig/kern program", "[tfm]")
+{
+  using namespace tex;
+
+  TestTfm tfm;
+  TfmFile file{ tfm.bytes.data(), tfm.bytes.size() };
+
+  REQUIRE(file.ligKernCount() == 5);
+  REQUIRE(file.ligKernStart('A') == 0);
+  REQUIRE(file.ligKernStart('B') == 0);
+  REQUIRE(file.ligKernStart('C') == TfmFile::npos);
+
+  tfm::LigKernInstruction instr = file.ligKern(0);
+  REQUIRE(instr.next_char == 'B');
+  REQUIRE(instr.isKern());
+  REQUIRE(file.kern(instr.kernIndex()) == Approx(-0.05f).margin(1e-6));
+
+  instr = file.ligKern(1);
+  REQUIRE(!instr.isKern());
+  REQUIRE(instr.remainder == 'F');
+
+  REQUIRE(file.ligKern(2).isStop());
+  REQUIRE(file.rightBoundaryChar() == -1);
+  REQUIRE(file.leftBoundaryProgram() == TfmFile::npos);
+
+  REQUIRE(file.findLigKern('A', 'B') == 0);
+  REQUIRE(file.findLigKern('A', 'A') == 2);
+  REQUIRE(file.findLigKern('B', 'C') == 1);
+  REQUIRE(file.findLigKern('A', 'F') == TfmFile::npos);
+  REQUIRE(file.findLigKern('C', 'A') == TfmFile::npos);
+  REQUIRE(file.findLigKern(-1, 'A') == TfmFile::npos);
+}
+
+TEST_CASE("A TfmFile exposes successors, extensible recipes and parameters", "[tfm]")
+{
+  using namespace tex;
+
+  TestTfm tfm;
+  TfmFile file{ tfm.bytes.data(), tfm.bytes.size() };
+
+  REQUIRE(file.successor('C') == 'D');
+  REQUIRE(file.successor('A') == -1);
+  REQUIRE(file.isExtensible('D'));
+  REQUIRE_THROWS(file.extensible('C'));
+
+  const tfm::ExtensibleRecipe recipe = file.extensible('D');
+  REQUIRE(recipe.top == 'A');
+  REQUIRE(recipe.mid == 0);
+  REQUIRE(recipe.bot == 'F');
+  REQUIRE(recipe.rep == 'B');
+
+  REQUIRE(file.paramCount() == 13);
+  REQUIRE(file.param(0) == 0.f);
+  REQUIRE(file.param(14) == 0.f);
+
+  const TFM t = file.tfm();
+  REQUIRE(t.design_size == 10.f);
+  REQUIRE(t.fontdimen.quad == Approx(0.06f));
+  REQUIRE(t.fontdimen.default_rule_thickness == Approx(0.08f));
+  REQUIRE(t.fontdimen.big_op_spacing5 == Approx(0.13f));
+  REQUIRE(t.fontdimen.axis_height == 0.f);
+}
+
+TEST_CASE("A TfmFile can be mapped from disk", "[tfm]")
+{
+  using namespace tex;
+
+  TestTfm tfm;
+  const std::string path = "test-tfm-file.tfm";
+
+  {
+    std::ofstream out{ path, std::ios::binary };
+    out.write(reinterpret_cast<const char*>(tfm.bytes.data()), tfm.bytes.size());
+  }
+
+  {
+    TfmFile file{ path };
+    REQUIRE(file.checksum() == 0xCAFEBABE);
+
+    TfmFile moved = std::move(file);
+    REQUIRE(moved.width('A') == 0.5f);
+  }
+
+  std::remove(path.c_str());
+
+  REQUIRE_THROWS(TfmFile{ "does-not-exist.tfm" });
+}
+
+TEST_CASE("Invalid TFM files are rejected", "[tfm]")
+{
+  using namespace tex;
+
+  TestTfm tfm;
+
+  REQUIRE_THROWS(tex::TfmFile{ tfm.bytes.data(), 20 });
+  REQUIRE_THROWS(tex::TfmFile{ tfm.bytes.data(), tfm.bytes.size() - 4 });
+
+  std::vector<uint8_t> bytes = tfm.bytes;
+  bytes[1] += 1; // lf
+  bytes.insert(bytes.end(), { 0, 0, 0, 0 });
+  REQUIRE_THROWS(tex::TfmFile{ bytes.data(), bytes.size() });
+
+  bytes = tfm.bytes;
+  bytes[4 * 8 + 1] = 0xF0; // height index of 'A' out of range
+  REQUIRE_THROWS(tex::TfmFile{ bytes.data(), bytes.size() });
+}
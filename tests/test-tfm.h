@@ -0,0 +1,44 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the typeset project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_TEST_TFM_H
+#define LIBTYPESET_TEST_TFM_H
+
+#include "tex/tfmfile.h"
+
+#include <map>
+#include <vector>
+
+// Writes TFM files from a description of their content, 
+// dimensions are given in units of the design size
+class TfmBuilder
+{
+public:
+  struct Char
+  {
+    double width;
+    double height;
+    double depth;
+    double italic;
+    tex::tfm::Tag tag;
+    uint8_t remainder;
+  };
+
+  uint32_t checksum = 0;
+  double design_size = 10.0;
+  std::map<int, Char> chars;
+  std::vector<tex::tfm::LigKernInstruction> ligkern;
+  std::vector<double> kerns;
+  std::vector<tex::tfm::ExtensibleRecipe> extensibles;
+  std::vector<double> params;
+
+  void addChar(int c, double w, double h, double d, double ic = 0.0, tex::tfm::Tag tag = tex::tfm::Tag::None, uint8_t rem = 0)
+  {
+    chars[c] = Char{ w, h, d, ic, tag, rem };
+  }
+
+  std::vector<uint8_t> build() const;
+};
+
+#endif // LIBTYPESET_TEST_TFM_H
@@ -4,6 +4,8 @@
 
 #include "test-typeset.h"
 
+#include "tex/charbox.h"
+
 TestFontMetricsProvider::TestFontMetricsProvider()
 {
   m_fontdimen.slant_per_pt = 0.f;
@@ -58,6 +60,7 @@ const tex::FontDimen& TestFontMetricsProvider::fontdimen(tex::Font /* f */)
 
 TestTypesetEngine::TestTypesetEngine()
 {
+  setCustomCharacterBoxes(true);
   m_metrics = std::make_shared<TestFontMetricsProvider>();
 }
 
@@ -71,6 +74,11 @@ std::shared_ptr<tex::Box> TestTypesetEngine::typeset(tex::Character c, tex::Font
   return std::make_shared<TestBox>(std::string(tex::Utf8Char{ c }.data()), metrics()->metrics(nullptr, font));
 }
 
+std::shared_ptr<tex::Box> TestTypesetEngine::typeset(tex::Character c, tex::Font /* font */, const tex::BoxMetrics& metrics)
+{
+  return std::make_shared<TestBox>(std::string(tex::Utf8Char{ c }.data()), metrics);
+}
+
 std::shared_ptr<tex::Box> TestTypesetEngine::typeset(const std::string& text, tex::Font font)
 {
   return std::make_shared<TestBox>(text, metrics()->metrics(nullptr, font));
@@ -103,3 +111,16 @@ std::shared_ptr<tex::Box> TestTypesetEngine::typesetLargeOp(const std::shared_pt
 {
   return std::make_shared<TestBox>(metrics()->metrics(symbol, tex::Font::MathRoman));
 }
+
+void test_word(tex::List& list, const std::string& str, int font, const tex::BoxMetrics& metrics)
+{
+  for (char c : str)
+    list.push_back(std::make_shared<tex::CharacterBox>(static_cast<unsigned char>(c), tex::Font(font), metrics));
+}
+
+std::shared_ptr<tex::HBox> test_word(const std::string& str, int font, const tex::BoxMetrics& metrics)
+{
+  tex::List list;
+  test_word(list, str, font, metrics);
+  return tex::hbox(std::move(list));
+}
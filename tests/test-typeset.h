@@ -7,6 +7,8 @@
 
 #include "tex/typeset.h"
 
+#include "tex/hbox.h"
+
 class TestBox : public tex::Box
 {
 public:
@@ -50,6 +52,7 @@ public:
   std::shared_ptr<tex::FontMetricsProvider> metrics() const override;
   
   std::shared_ptr<tex::Box> typeset(tex::Character c, tex::Font font) override;
+  std::shared_ptr<tex::Box> typeset(tex::Character c, tex::Font font, const tex::BoxMetrics& metrics) override;
   std::shared_ptr<tex::Box> typeset(const std::string& text, tex::Font font) override;
   std::shared_ptr<tex::Box> typeset(const std::shared_ptr<tex::Symbol>& symbol, tex::Font font)  override;
   std::shared_ptr<tex::Box> typesetRadicalSign(float minTotalHeight)  override;
@@ -60,4 +63,8 @@ private:
   std::shared_ptr<tex::FontMetricsProvider> m_metrics;
 };
 
+// Character boxes of a single font, as laid out by the output writers tests
+void test_word(tex::List& list, const std::string& str, int font, const tex::BoxMetrics& metrics = tex::BoxMetrics{ 7.f, 2.f, 5.f });
+std::shared_ptr<tex::HBox> test_word(const std::string& str, int font, const tex::BoxMetrics& metrics = tex::BoxMetrics{ 7.f, 2.f, 5.f });
+
 #endif // LIBTYPESET_TEST_TYPESET_H
@@ -0,0 +1,149 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#ifndef LIBTYPESET_TFMFILE_H
+#define LIBTYPESET_TFMFILE_H
+
+#include "tex/tfm.h"
+
+#include "tex/boxmetrics.h"
+#include "tex/mappedfile.h"
+#include "tex/unicode.h"
+
+#include <cstdint>
+#include <string>
+
+namespace tex
+{
+
+namespace tfm
+{
+
+enum class Tag
+{
+  None = 0,
+  LigKern = 1,
+  CharList = 2,
+  Extensible = 3,
+};
+
+struct CharInfo
+{
+  uint8_t width_index;
+  uint8_t height_index;
+  uint8_t depth_index;
+  uint8_t italic_index;
+  Tag tag;
+  uint8_t remainder;
+
+  bool exists() const { return width_index != 0; }
+};
+
+struct LigKernInstruction
+{
+  uint8_t skip_byte;
+  uint8_t next_char;
+  uint8_t op_byte;
+  uint8_t remainder;
+
+  bool isStop() const { return skip_byte >= 128; }
+  bool isKern() const { return op_byte >= 128; }
+  size_t kernIndex() const { return 256 * (op_byte - 128) + remainder; }
+};
+
+struct ExtensibleRecipe
+{
+  uint8_t top;
+  uint8_t mid;
+  uint8_t bot;
+  uint8_t rep;
+};
+
+} // namespace tfm
+
+/*!
+ * \class TfmFile
+ * \brief a view over the content of a TeX font metric file
+ *
+ * The file is validated when it is loaded, after which every accessor 
+ * decodes its value directly from the file content; nothing is copied.
+ * Dimensions are returned in units of the design size, as they are stored.
+ */
+class TfmFile
+{
+public:
+  TfmFile() = default;
+  TfmFile(const TfmFile&) = delete;
+  TfmFile(TfmFile&&) = default;
+  ~TfmFile() = default;
+
+  explicit TfmFile(const std::string& path);
+  TfmFile(const uint8_t* data, size_t size);
+
+  static const size_t npos = size_t(-1);
+
+  const uint8_t* data() const { return m_data; }
+  size_t size() const { return 4 * static_cast<size_t>(m_lf); }
+
+  uint32_t checksum() const;
+  float designSize() const;
+
+  int firstChar() const { return m_bc; }
+  int lastChar() const { return m_ec; }
+
+  bool hasChar(Character c) const;
+  tfm::CharInfo charInfo(Character c) const;
+
+  float width(Character c) const;
+  float height(Character c) const;
+  float depth(Character c) const;
+  float italicCorrection(Character c) const;
+  BoxMetrics metrics(Character c, float size) const;
+
+  size_t ligKernCount() const { return m_nl; }
+  tfm::LigKernInstruction ligKern(size_t i) const;
+  size_t ligKernStart(Character c) const;
+  float kern(size_t i) const;
+  int rightBoundaryChar() const;
+  size_t leftBoundaryProgram() const;
+  size_t findLigKern(Character left, Character right) const;
+
+  Character successor(Character c) const;
+  bool isExtensible(Character c) const;
+  tfm::ExtensibleRecipe extensible(Character c) const;
+
+  size_t paramCount() const { return m_np; }
+  float param(size_t n) const;
+  FontDimen fontdimen() const;
+  TFM tfm() const;
+
+  TfmFile& operator=(const TfmFile&) = delete;
+  TfmFile& operator=(TfmFile&&) = default;
+
+protected:
+  void load(const uint8_t* data, size_t size);
+
+  uint32_t word(size_t i) const;
+  float fixword(size_t i) const;
+
+private:
+  MappedFile m_file;
+  const uint8_t* m_data = nullptr;
+  uint16_t m_lf = 0, m_lh = 0, m_bc = 1, m_ec = 0;
+  uint16_t m_nw = 0, m_nh = 0, m_nd = 0, m_ni = 0;
+  uint16_t m_nl = 0, m_nk = 0, m_ne = 0, m_np = 0;
+  size_t m_char_info = 0;
+  size_t m_width = 0;
+  size_t m_height = 0;
+  size_t m_depth = 0;
+  size_t m_italic = 0;
+  size_t m_lig_kern = 0;
+  size_t m_kern = 0;
+  size_t m_exten = 0;
+  size_t m_param = 0;
+};
+
+} // namespace tex
+
+#endif // LIBTYPESET_TFMFILE_H
@@ -0,0 +1,318 @@
+// Copyright (C) 2020 Vincent Chambrin
+// This file is part of the 'typeset' project
+// For conditions of distribution and use, see copyright notice in LICENSE
+
+#include "tex/tfmfile.h"
+
+#include <stdexcept>
+
+namespace tex
+{
+
+const size_t TfmFile::npos;
+
+static uint16_t read_u16(const uint8_t* data)
+{
+  return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+
+static void tfm_check(bool cond, const char* what)
+{
+  if (!cond)
+    throw std::runtime_error{ std::string("invalid TFM file: ") + what };
+}
+
+TfmFile::TfmFile(const std::string& path)
+  : m_file(path)
+{
+  load(m_file.data(), m_file.size());
+}
+
+TfmFile::TfmFile(const uint8_t* data, size_t size)
+{
+  load(data, size);
+}
+
+void TfmFile::load(const uint8_t* data, size_t size)
+{
+  tfm_check(data != nullptr && size >= 24, "file is too short");
+
+  m_lf = read_u16(data);
+  m_lh = read_u16(data + 2);
+  m_bc = read_u16(data + 4);
+  m_ec = read_u16(data + 6);
+  m_nw = read_u16(data + 8);
+  m_nh = read_u16(data + 10);
+  m_nd = read_u16(data + 12);
+  m_ni = read_u16(data + 14);
+  m_nl = read_u16(data + 16);
+  m_nk = read_u16(data + 18);
+  m_ne = read_u16(data + 20);
+  m_np = read_u16(data + 22);
+
+  tfm_check(m_lf < 0x8000 && 4 * static_cast<size_t>(m_lf) <= size, "file is truncated");
+  tfm_check(m_lh >= 2, "header is too short");
+  tfm_check(m_bc <= m_ec + 1 && m_ec <= 255, "invalid character range");
+  tfm_check(m_nw > 0 && m_nh > 0 && m_nd > 0 && m_ni > 0, "empty dimension table");
+  tfm_check(m_ne <= 256, "too many extensible recipes");
+
+  const size_t nchars = static_cast<size_t>(m_ec) + 1 - m_bc;
+  tfm_check(m_lf == 6 + m_lh + nchars + m_nw + m_nh + m_nd + m_ni + m_nl + m_nk + m_ne + m_np, "inconsistent table sizes");
+
+  m_data = data;
+  m_char_info = 6 + m_lh;
+  m_width = m_char_info + nchars;
+  m_height = m_width + m_nw;
+  m_depth = m_height + m_nh;
+  m_italic = m_depth + m_nd;
+  m_lig_kern = m_italic + m_ni;
+  m_kern = m_lig_kern + m_nl;
+  m_exten = m_kern + m_nk;
+  m_param = m_exten + m_ne;
+
+  tfm_check(word(m_width) == 0 && word(m_height) == 0 && word(m_depth) == 0 && word(m_italic) == 0, "first dimension is not zero");
+
+  for (Character c(m_bc); c <= m_ec; ++c)
+  {
+    const tfm::CharInfo info = charInfo(c);
+
+    if (!info.exists())
+      continue;
+
+    tfm_check(info.width_index < m_nw && info.height_index < m_nh && info.depth_index < m_nd && info.italic_index < m_ni, "dimension index out of range");
+
+    if (info.tag == tfm::Tag::LigKern)
+      tfm_check(info.remainder < m_nl, "lig/kern index out of range");
+    else if (info.tag == tfm::Tag::Extensible)
+      tfm_check(info.remainder < m_ne, "extensible index out of range");
+  }
+
+  for (size_t i(0); i < m_nl; ++i)
+  {
+    const tfm::LigKernInstruction instr = ligKern(i);
+
+    if (instr.skip_byte <= 128 && instr.isKern())
+      tfm_check(instr.kernIndex() < m_nk, "kern index out of range");
+    else if (instr.skip_byte > 128)
+      tfm_check(256 * static_cast<size_t>(instr.op_byte) + instr.remainder < m_nl, "lig/kern program out of range");
+  }
+}
+
+uint32_t TfmFile::word(size_t i) const
+{
+  const uint8_t* p = m_data + 4 * i;
+  return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+float TfmFile::fixword(size_t i) const
+{
+  return static_cast<int32_t>(word(i)) / float(1 << 20);
+}
+
+uint32_t TfmFile::checksum() const
+{
+  return word(6);
+}
+
+float TfmFile::designSize() const
+{
+  return fixword(7);
+}
+
+bool TfmFile::hasChar(Character c) const
+{
+  return c >= m_bc && c <= m_ec && m_data[4 * (m_char_info + c - m_bc)] != 0;
+}
+
+tfm::CharInfo TfmFile::charInfo(Character c) const
+{
+  if (c < m_bc || c > m_ec)
+    return tfm::CharInfo{ 0, 0, 0, 0, tfm::Tag::None, 0 };
+
+  const uint8_t* p = m_data + 4 * (m_char_info + c - m_bc);
+
+  tfm::CharInfo result;
+  result.width_index = p[0];
+  result.height_index = p[1] >> 4;
+  result.depth_index = p[1] & 0xF;
+  result.italic_index = p[2] >> 2;
+  result.tag = static_cast<tfm::Tag>(p[2] & 0x3);
+  result.remainder = p[3];
+  return result;
+}
+
+float TfmFile::width(Character c) const
+{
+  return fixword(m_width + charInfo(c).width_index);
+}
+
+float TfmFile::height(Character c) const
+{
+  return fixword(m_height + charInfo(c).height_index);
+}
+
+float TfmFile::depth(Character c) const
+{
+  return fixword(m_depth + charInfo(c).depth_index);
+}
+
+float TfmFile::italicCorrection(Character c) const
+{
+  return fixword(m_italic + charInfo(c).italic_index);
+}
+
+BoxMetrics TfmFile::metrics(Character c, float size) const
+{
+  const tfm::CharInfo info = charInfo(c);
+  return BoxMetrics{ size * fixword(m_height + info.height_index), size * fixword(m_depth + info.depth_index), size * fixword(m_width + info.width_index) };
+}
+
+tfm::LigKernInstruction TfmFile::ligKern(size_t i) const
+{
+  const uint8_t* p = m_data + 4 * (m_lig_kern + i);
+  return tfm::LigKernInstruction{ p[0], p[1], p[2], p[3] };
+}
+
+size_t TfmFile::ligKernStart(Character c) const
+{
+  const tfm::CharInfo info = charInfo(c);
+
+  if (info.tag != tfm::Tag::LigKern)
+    return npos;
+
+  const tfm::LigKernInstruction first = ligKern(info.remainder);
+  return first.skip_byte > 128 ? 256 * static_cast<size_t>(first.op_byte) + first.remainder : info.remainder;
+}
+
+float TfmFile::kern(size_t i) const
+{
+  return fixword(m_kern + i);
+}
+
+int TfmFile::rightBoundaryChar() const
+{
+  if (m_nl == 0)
+    return -1;
+
+  const tfm::LigKernInstruction first = ligKern(0);
+  return first.skip_byte == 255 ? first.next_char : -1;
+}
+
+size_t TfmFile::leftBoundaryProgram() const
+{
+  if (m_nl == 0)
+    return npos;
+
+  const tfm::LigKernInstruction last = ligKern(m_nl - 1);
+  return last.skip_byte == 255 ? 256 * static_cast<size_t>(last.op_byte) + last.remainder : npos;
+}
+
+/*!
+ * \fn size_t findLigKern(Character left, Character right) const
+ * \brief returns the index of the instruction for a pair of characters
+ *
+ * A negative \a left selects the left boundary program.
+ * Returns npos if the program of \a left has no instruction for \a right.
+ */
+size_t TfmFile::findLigKern(Character left, Character right) const
+{
+  size_t i = left < 0 ? leftBoundaryProgram() : ligKernStart(left);
+
+  if (i == npos || right < 0 || right > 255)
+    return npos;
+
+  while (i < m_nl)
+  {
+    const tfm::LigKernInstruction instr = ligKern(i);
+
+    if (instr.next_char == right && instr.skip_byte <= 128)
+      return i;
+
+    if (instr.skip_byte >= 128)
+      return npos;
+
+    i += static_cast<size_t>(instr.skip_byte) + 1;
+  }
+
+  return npos;
+}
+
+Character TfmFile::successor(Character c) const
+{
+  const tfm::CharInfo info = charInfo(c);
+  return info.tag == tfm::Tag::CharList ? info.remainder : -1;
+}
+
+bool TfmFile::isExtensible(Character c) const
+{
+  return charInfo(c).tag == tfm::Tag::Extensible;
+}
+
+tfm::ExtensibleRecipe TfmFile::extensible(Character c) const
+{
+  const tfm::CharInfo info = charInfo(c);
+
+  if (info.tag != tfm::Tag::Extensible)
+    throw std::runtime_error{ "TfmFile::extensible(): character is not extensible" };
+
+  const uint8_t* p = m_data + 4 * (m_exten + info.remainder);
+  return tfm::ExtensibleRecipe{ p[0], p[1], p[2], p[3] };
+}
+
+float TfmFile::param(size_t n) const
+{
+  return n >= 1 && n <= m_np ? fixword(m_param + n - 1) : 0.f;
+}
+
+FontDimen TfmFile::fontdimen() const
+{
+  FontDimen result;
+
+  result.slant_per_pt = param(1);
+  result.interword_space = param(2);
+  result.interword_stretch = param(3);
+  result.interword_shrink = param(4);
+  result.x_height = param(5);
+  result.quad = param(6);
+  result.extra_space = param(7);
+
+  // Math symbols fonts have 22 parameters, math extension fonts have 13.
+  const bool symbols = m_np >= 22;
+
+  result.num1 = symbols ? param(8) : 0.f;
+  result.num2 = symbols ? param(9) : 0.f;
+  result.num3 = symbols ? param(10) : 0.f;
+  result.denom1 = symbols ? param(11) : 0.f;
+  result.denom2 = symbols ? param(12) : 0.f;
+  result.sup1 = symbols ? param(13) : 0.f;
+  result.sup2 = symbols ? param(14) : 0.f;
+  result.sup3 = symbols ? param(15) : 0.f;
+  result.sub1 = symbols ? param(16) : 0.f;
+  result.sub2 = symbols ? param(17) : 0.f;
+  result.sup_drop = symbols ? param(18) : 0.f;
+  result.sub_drop = symbols ? param(19) : 0.f;
+  result.delim1 = symbols ? param(20) : 0.f;
+  result.delim2 = symbols ? param(21) : 0.f;
+  result.axis_height = symbols ? param(22) : 0.f;
+
+  const bool extension = m_np >= 13 && !symbols;
+
+  result.default_rule_thickness = extension ? param(8) : 0.f;
+  result.big_op_spacing1 = extension ? param(9) : 0.f;
+  result.big_op_spacing2 = extension ? param(10) : 0.f;
+  result.big_op_spacing3 = extension ? param(11) : 0.f;
+  result.big_op_spacing4 = extension ? param(12) : 0.f;
+  result.big_op_spacing5 = extension ? param(13) : 0.f;
+
+  return result;
+}
+
+TFM TfmFile::tfm() const
+{
+  TFM result;
+  result.design_size = designSize();
+  result.fontdimen = fontdimen();
+  return result;
+}
+
+} // namespace tex